@@ -48,6 +48,45 @@ CONST EFI_PEI_PPI_DESCRIPTOR  gFspReadyForNotifyPhasePpi = {
   NULL
 };
 
+/**
+  Publish a copy of the deferred debug log in a HOB, for the boot loader to drain it.
+
+**/
+VOID
+PublishDebugLog (
+  VOID
+  )
+{
+  FSP_DEBUG_LOG_HEADER    *Log;
+  FSP_DEBUG_LOG_HOB_DATA  HobData;
+  VOID                    *Copy;
+
+  if (PcdGet32 (PcdFspDebugLogBufferSize) == 0) {
+    return;
+  }
+
+  Log = (FSP_DEBUG_LOG_HEADER *)(UINTN)GetFspGlobalDataPointer ()->DebugLogPtr;
+  if (Log == NULL) {
+    Log = (FSP_DEBUG_LOG_HEADER *)(UINTN)PcdGet32 (PcdFspDebugLogBufferBase);
+  }
+
+  if ((Log->Signature != FSP_DEBUG_LOG_SIGNATURE) ||
+      (Log->HeaderSize + Log->BufferSize > PcdGet32 (PcdFspDebugLogBufferSize)))
+  {
+    return;
+  }
+
+  HobData.LogLength = Log->HeaderSize + Log->BufferSize;
+  Copy              = AllocatePages (EFI_SIZE_TO_PAGES ((UINTN)HobData.LogLength));
+  if (Copy == NULL) {
+    return;
+  }
+
+  CopyMem (Copy, Log, (UINTN)HobData.LogLength);
+  HobData.LogPtr = (UINT64)(UINTN)Copy;
+  BuildGuidDataHob (&gFspDebugLogHobGuid, &HobData, sizeof (HobData));
+}
+
 /**
 
    This function waits for FSP notify.
@@ -81,6 +120,7 @@ WaitForNotify (
   // Give control back to BootLoader after FspSiliconInit
   //
   DEBUG ((DEBUG_INFO | DEBUG_INIT, "FSP is waiting for NOTIFY\n"));
+  PublishDebugLog ();
   FspSiliconInitDone2 (EFI_SUCCESS);
 
   //
@@ -142,6 +182,7 @@ FspNotifyPhasePeimEntryPoint (
     Status = PeiServicesReInstallPpi (OldDescriptor, &mInstallDxeIplPpi);
     ASSERT_EFI_ERROR (Status);
   } else {
+    PublishDebugLog ();
     Status = PeiServicesInstallPpi (&gFspReadyForNotifyPhasePpi);
     ASSERT_EFI_ERROR (Status);
   }
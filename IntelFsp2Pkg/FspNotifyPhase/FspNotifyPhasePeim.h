@@ -14,4 +14,9 @@
 #include <Library/FspPlatformLib.h>
 #include <Library/FspCommonLib.h>
 #include <Library/FspSwitchStackLib.h>
+#include <Library/HobLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/PcdLib.h>
+#include <Guid/FspDebugLogHob.h>
 #endif
@@ -213,6 +213,83 @@ FspGlobalDataInit (
     ));
 }
 
+/**
+
+  Get the frequency of the time stamp counter from the CPUID leaves.
+
+  @return The frequency in Hz, or 0 when the processor does not report it.
+
+**/
+STATIC
+UINT64
+FspGetTscFrequency (
+  VOID
+  )
+{
+  UINT32  MaxLeaf;
+  UINT32  Denominator;
+  UINT32  Numerator;
+  UINT32  CrystalFrequency;
+  UINT32  BaseFrequency;
+
+  AsmCpuid (0, &MaxLeaf, NULL, NULL, NULL);
+  if (MaxLeaf >= 0x15) {
+    AsmCpuid (0x15, &Denominator, &Numerator, &CrystalFrequency, NULL);
+    if ((Denominator != 0) && (Numerator != 0) && (CrystalFrequency != 0)) {
+      return DivU64x32 (MultU64x32 (CrystalFrequency, Numerator), Denominator);
+    }
+  }
+
+  //
+  // The base frequency in MHz is the nominal frequency of the time stamp counter.
+  //
+  if (MaxLeaf >= 0x16) {
+    AsmCpuid (0x16, &BaseFrequency, NULL, NULL, NULL);
+    return MultU64x32 (BaseFrequency & 0xFFFF, 1000000);
+  }
+
+  return 0;
+}
+
+/**
+
+  Initialize the FSP performance log and log the measure points taken before.
+  It needs to be done after the FSP global data region is initialized.
+
+  @param[out] PerfLog             Pointer of the performance log.
+  @param[in]  Capacity            Number of records following the log header.
+
+**/
+VOID
+FspPerfLogInit (
+  OUT FSP_PERF_LOG  *PerfLog,
+  IN  UINT32        Capacity
+  )
+{
+  FSP_GLOBAL_DATA  *FspData;
+  UINT32           Index;
+  UINT8            Id;
+
+  ZeroMem ((VOID *)PerfLog, sizeof (FSP_PERF_LOG));
+  PerfLog->Signature    = FSP_PERF_LOG_SIGNATURE;
+  PerfLog->Capacity     = Capacity;
+  PerfLog->TscFrequency = FspGetTscFrequency ();
+
+  FspData             = GetFspGlobalDataPointer ();
+  FspData->PerfLogPtr = (UINTN)PerfLog;
+
+  //
+  // PerfData[] already holds the TempRamInit points handed over on the stack,
+  // left 0 when there are none, and the FspMemoryInit entry point.
+  //
+  for (Index = 0; (Index < FspData->PerfIdx) && (Index < ARRAY_SIZE (FspData->PerfData)); Index++) {
+    if ((FspData->PerfData[Index] & FSP_PERFORMANCE_DATA_TIMER_MASK) != 0) {
+      Id = (UINT8)RShiftU64 (FspData->PerfData[Index], 56);
+      FspPerfLogRecord (Id, FSP_PERF_RECORD_TYPE_OF_ID (Id), FspData->PerfData[Index] & FSP_PERFORMANCE_DATA_TIMER_MASK);
+    }
+  }
+}
+
 /**
 
   Adjust the FSP data pointers after the stack is migrated to memory.
@@ -229,4 +306,11 @@ FspDataPointerFixUp (
 
   NewFspData = (FSP_GLOBAL_DATA *)((UINTN)GetFspGlobalDataPointer () + (UINTN)OffsetGap);
   SetFspGlobalDataPointer (NewFspData);
+
+  //
+  // The performance log is on the stack too.
+  //
+  if (NewFspData->PerfLogPtr != 0) {
+    NewFspData->PerfLogPtr = (UINTN)NewFspData->PerfLogPtr + OffsetGap;
+  }
 }
@@ -52,6 +52,21 @@ FspGlobalDataInit (
   IN UINT8                 ApiIdx
   );
 
+/**
+
+  Initialize the FSP performance log and log the measure points taken before.
+  It needs to be done after the FSP global data region is initialized.
+
+  @param[out] PerfLog             Pointer of the performance log.
+  @param[in]  Capacity            Number of records following the log header.
+
+**/
+VOID
+FspPerfLogInit (
+  OUT FSP_PERF_LOG  *PerfLog,
+  IN  UINT32        Capacity
+  );
+
 /**
 
   Adjust the FSP data pointers after the stack is migrated to memory.
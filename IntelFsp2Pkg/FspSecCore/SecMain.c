@@ -63,6 +63,7 @@ SecStartup (
   SEC_IDT_TABLE             IdtTableInStack;
   UINT32                    Index;
   FSP_GLOBAL_DATA           PeiFspData;
+  SEC_PERF_LOG              SecPerfLog;
   IA32_IDT_GATE_DESCRIPTOR  ExceptionHandler;
   UINTN                     IdtSize;
 
@@ -145,6 +146,12 @@ SecStartup (
   //
   FspGlobalDataInit (&PeiFspData, BootLoaderStack, (UINT8)ApiIdx);
 
+  //
+  // The performance log is kept next to the global data, so it is migrated
+  // to permanent memory along with it.
+  //
+  FspPerfLogInit (&SecPerfLog.Header, FixedPcdGet32 (PcdFspMaxPerfEntry));
+
   //
   // Update the base address and length of Pei temporary memory
   //
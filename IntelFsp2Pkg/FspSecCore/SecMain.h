@@ -42,6 +42,11 @@ typedef struct _SEC_IDT_TABLE {
   IA32_IDT_GATE_DESCRIPTOR    IdtTable[FixedPcdGet8 (PcdFspMaxInterruptSupported)];
 } SEC_IDT_TABLE;
 
+typedef struct {
+  FSP_PERF_LOG       Header;
+  FSP_PERF_RECORD    Records[FixedPcdGet32 (PcdFspMaxPerfEntry)];
+} SEC_PERF_LOG;
+
 /**
   Switch the stack in the temporary memory to the one in the permanent memory.
 
@@ -12,7 +12,7 @@
 
 #define FSP_IN_API_MODE          0
 #define FSP_IN_DISPATCH_MODE     1
-#define FSP_GLOBAL_DATA_VERSION  0x3
+#define FSP_GLOBAL_DATA_VERSION  0x4
 
 #pragma pack(1)
 
@@ -41,6 +41,44 @@ typedef struct  {
 #define FSP_GLOBAL_DATA_SIGNATURE        SIGNATURE_32 ('F', 'S', 'P', 'D')
 #define FSP_PERFORMANCE_DATA_SIGNATURE   SIGNATURE_32 ('P', 'E', 'R', 'F')
 #define FSP_PERFORMANCE_DATA_TIMER_MASK  0xFFFFFFFFFFFFFF
+#define FSP_PERF_LOG_SIGNATURE           SIGNATURE_32 ('F', 'P', 'L', 'G')
+
+#define FSP_PERF_RECORD_TYPE_POINT  0
+#define FSP_PERF_RECORD_TYPE_BEGIN  1
+#define FSP_PERF_RECORD_TYPE_END    2
+
+typedef struct  {
+  UINT64    TimeStamp;
+  UINT16    Id;
+  UINT8     Type;
+  ///
+  /// Number of begin records not closed by an end record when the record
+  /// was logged. A begin record and its end record have the same depth.
+  ///
+  UINT8     Depth;
+  UINT8     ApiIdx;
+  UINT8     Reserved;
+  ///
+  /// PhasesExecuted of the multi-phase API when the record was logged.
+  ///
+  UINT16    Phase;
+} FSP_PERF_RECORD;
+
+///
+/// The performance log, followed by Capacity records.
+///
+typedef struct  {
+  UINT32    Signature;
+  UINT32    Capacity;
+  UINT32    Count;
+  UINT32    Lost;
+  UINT32    Depth;
+  UINT32    Reserved;
+  ///
+  /// Frequency of the time stamp counter in Hz, 0 when it is not known.
+  ///
+  UINT64    TscFrequency;
+} FSP_PERF_LOG;
 
 typedef struct  {
   UINT32             Signature;
@@ -90,7 +128,15 @@ typedef struct  {
   /// At this point, next field offset must be either *0h or *8h to
   /// meet natural alignment requirement.
   ///
-  UINT8              Reserved4[16];
+  ///
+  /// Address of the deferred debug log once it is migrated to memory,
+  /// 0 while it is still at PcdFspDebugLogBufferBase.
+  ///
+  UINT64             DebugLogPtr;
+  ///
+  /// Address of the FSP_PERF_LOG, 0 when there is none.
+  ///
+  UINT64             PerfLogPtr;
   UINT32             PerfSig;
   UINT16             PerfLen;
   UINT16             Reserved5;
@@ -0,0 +1,84 @@
+/** @file
+  Definitions of the FSP deferred debug log and of the HOB it is published in.
+
+  When PcdFspDebugLogBufferSize is not zero, BaseFspDebugLibSerialPort does not
+  format DEBUG () messages. It records the address of the format string, the
+  error level, the raw arguments and the time stamp counter into a ring buffer
+  at PcdFspDebugLogBufferBase, which is moved to memory at the end of
+  FspMemoryInit, before the temporary RAM is torn down. FspNotifyPhasePeim
+  publishes a copy of the ring in a GUID HOB with gFspDebugLogHobGuid, and the
+  messages are formatted later, on the host, by Tools/FspDebugLogDecode.py
+  using the format strings in the FSP binary.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __FSP_DEBUG_LOG_HOB_H__
+#define __FSP_DEBUG_LOG_HOB_H__
+
+#define FSP_DEBUG_LOG_SIGNATURE  SIGNATURE_32 ('F', 'D', 'L', 'G')
+#define FSP_DEBUG_LOG_VERSION    1
+
+#pragma pack(1)
+
+///
+/// The header of the ring, followed by BufferSize bytes of records.
+///
+/// Records are 8-byte aligned and never wrap. When a record does not fit
+/// before the end of the buffer, the rest of the buffer is skipped: a reader
+/// goes back to offset 0 when fewer than sizeof (FSP_DEBUG_LOG_RECORD) bytes
+/// are left or when the record at its offset has a Size of 0. The oldest
+/// records are overwritten when the buffer is full.
+///
+typedef struct {
+  UINT32    Signature;
+  UINT16    Version;
+  UINT16    HeaderSize;
+  UINT32    BufferSize;
+  UINT32    Head;               ///< Offset of the oldest record
+  UINT32    Tail;               ///< Offset of the next record
+  UINT32    UsedSize;           ///< Bytes in use from Head to Tail, including the skipped ends
+  UINT32    LostRecords;        ///< Records overwritten before the ring was drained
+  UINT32    Reserved;
+} FSP_DEBUG_LOG_HEADER;
+
+///
+/// A DEBUG () message, followed by ArgumentSize bytes of arguments.
+///
+/// The arguments are stored in the order of the conversions of the format
+/// string, each one padded to 8 bytes:
+///   - '*' widths and precisions, and the values of %c, %d, %u, %x, %X, %p
+///     and %r, as a UINT64;
+///   - %a and %s strings as a UINT32 byte count followed by the characters,
+///     without the terminator;
+///   - the GUID of %g and the EFI_TIME of %t as 16 bytes.
+///
+typedef struct {
+  UINT16    Size;               ///< Size of the record, including this header
+  UINT16    ArgumentSize;
+  UINT32    ErrorLevel;
+  UINT64    TimeStamp;
+  UINT64    Format;             ///< Address of the format string in the FSP image
+} FSP_DEBUG_LOG_RECORD;
+
+///
+/// The data of the GUID HOB. The FSP copies the ring into memory allocated
+/// for it, so it can be drained after the temporary memory is gone.
+///
+typedef struct {
+  UINT64    LogPtr;             ///< Address of the FSP_DEBUG_LOG_HEADER of the copy
+  UINT64    LogLength;          ///< Size of the copy, header included
+} FSP_DEBUG_LOG_HOB_DATA;
+
+#pragma pack()
+
+///
+/// The largest record. Strings are truncated for the arguments to fit.
+///
+#define FSP_DEBUG_LOG_MAX_RECORD_SIZE  0x200
+
+extern EFI_GUID  gFspDebugLogHobGuid;
+
+#endif
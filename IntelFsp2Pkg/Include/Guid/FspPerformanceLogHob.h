@@ -0,0 +1,60 @@
+/** @file
+  Definitions of the HOB the FSP performance log is published in.
+
+  At the end of each FSP API, the records of the FSP performance log are
+  converted to FPDT GUID QWORD event records and published in a GUID HOB with
+  gFspPerformanceLogHobGuid. The HOB data has the layout of the extended
+  firmware performance data HOBs of the EDK II PEI performance library, so the
+  boot loader can hand it over to its FPDT producer as is.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __FSP_PERFORMANCE_LOG_HOB_H__
+#define __FSP_PERFORMANCE_LOG_HOB_H__
+
+#define FSP_PERF_FPDT_GUID_QWORD_EVENT_TYPE  0x1011
+#define FSP_PERF_FPDT_RECORD_REVISION        1
+
+#pragma pack(1)
+
+///
+/// The header of the HOB data, followed by SizeOfAllEntries bytes of records.
+///
+typedef struct {
+  UINT32    SizeOfAllEntries;
+  UINT32    LoadImageCount;     ///< Always 0
+  UINT32    HobIsFull;          ///< Not 0 when records were lost since the previous HOB
+} FSP_PERF_LOG_HOB_HEADER;
+
+///
+/// A record of the FSP performance log.
+///
+/// Qword holds the details of the FSP_PERF_RECORD:
+///   - Bits [7:0]   Type, FSP_PERF_RECORD_TYPE_xxx
+///   - Bits [15:8]  Depth
+///   - Bits [23:16] ApiIdx
+///   - Bits [47:32] Phase
+///
+typedef struct {
+  UINT16      Type;             ///< FSP_PERF_FPDT_GUID_QWORD_EVENT_TYPE
+  UINT8       Length;
+  UINT8       Revision;
+  UINT16      ProgressID;       ///< Measurement point ID
+  UINT32      ApicID;
+  ///
+  /// In nanoseconds, or in time stamp counter ticks when the processor does
+  /// not report the time stamp counter frequency in CPUID leaf 0x15 or 0x16.
+  ///
+  UINT64      Timestamp;
+  EFI_GUID    Guid;             ///< gFspPerformanceDataGuid
+  UINT64      Qword;
+} FSP_PERF_FPDT_RECORD;
+
+#pragma pack()
+
+extern EFI_GUID  gFspPerformanceLogHobGuid;
+
+#endif
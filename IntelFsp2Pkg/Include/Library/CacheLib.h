@@ -19,6 +19,15 @@ typedef INT32 EFI_MEMORY_CACHE_TYPE;
 #define EFI_CACHE_WRITEPROTECTED  5
 #define EFI_CACHE_WRITEBACK       6
 
+///
+/// A memory range and the cache type to set for it.
+///
+typedef struct {
+  EFI_PHYSICAL_ADDRESS     BaseAddress;
+  UINT64                   Length;
+  EFI_MEMORY_CACHE_TYPE    CacheType;
+} CACHE_ATTRIBUTE_RANGE;
+
 /**
  Reset all the MTRRs to a known state.
 
@@ -52,4 +61,38 @@ SetCacheAttributes (
   IN  EFI_MEMORY_CACHE_TYPE  MemoryCacheType
   );
 
+/**
+  Given a list of memory ranges and cache types, programs the MTRRs.
+
+  The MTRR set is computed for the whole list before any MTRR is written, and
+  all the MTRRs are then written under a single cache disable. When ranges
+  overlap, the later range in the list takes precedence.
+
+  The parts of the ranges below 1MB are set in the fixed MTRRs. The variable
+  MTRRs available to the BIOS are reprogrammed to describe exactly the parts
+  above 1MB, using as few MTRRs as possible: a range may be covered with a
+  larger write-back or write-through MTRR from which other types are carved
+  out with MTRRs of higher precedence.
+
+  Variable MTRRs available to the BIOS that are not needed to describe the
+  list are cleared, including those set by earlier calls to
+  SetCacheAttributes (); the caller must pass every range above 1MB that is
+  to keep its type. The MTRR pair left for the OS is not changed.
+
+  @param[in] Ranges              The list of memory ranges.
+  @param[in] RangeCount          The number of ranges in the list.
+
+  @retval EFI_SUCCESS            Mtrr are set successfully.
+  @retval EFI_LOAD_ERROR         Not enough MTRRs to describe the ranges, no MTRR is changed.
+  @retval EFI_INVALID_PARAMETER  The input parameter is not valid.
+  @retval EFI_OUT_OF_RESOURCES   The list has too many ranges.
+
+**/
+EFI_STATUS
+EFIAPI
+SetCacheAttributesList (
+  IN CONST CACHE_ATTRIBUTE_RANGE  *Ranges,
+  IN UINTN                        RangeCount
+  );
+
 #endif
@@ -11,6 +11,14 @@
 #include <FspGlobalData.h>
 #include <FspMeasurePointId.h>
 
+///
+/// Measure point IDs from 0xD0 come in pairs: an even entry ID opens a range
+/// that the odd exit ID following it closes. Other IDs are single points.
+///
+#define FSP_PERF_RECORD_TYPE_OF_ID(Id)                                        \
+  (((Id) < FSP_PERF_ID_MRC_INIT_ENTRY) ? FSP_PERF_RECORD_TYPE_POINT :          \
+   ((((Id) & 1) == 0) ? FSP_PERF_RECORD_TYPE_BEGIN : FSP_PERF_RECORD_TYPE_END))
+
 /**
   This function sets the FSP global data pointer.
 
@@ -205,6 +213,28 @@ SetFspMeasurePoint (
   IN UINT8  Id
   );
 
+/**
+  Log a record in the FSP performance log.
+
+  Begin and end records nest: the depth of a begin record is the number of
+  ranges open before it, and an end record closes the innermost open range.
+  Every record also keeps the index of the current API and its executed
+  phase count. When the log is full the record is only counted as lost.
+
+  @param[in] Id         Measurement point ID.
+  @param[in] Type       FSP_PERF_RECORD_TYPE_POINT, _BEGIN or _END.
+  @param[in] TimeStamp  Time stamp counter value, or 0 to read the counter.
+
+  @return The time stamp of the record.
+**/
+UINT64
+EFIAPI
+FspPerfLogRecord (
+  IN UINT16  Id,
+  IN UINT8   Type,
+  IN UINT64  TimeStamp
+  );
+
 /**
   This function gets the FSP info header pointer.
 
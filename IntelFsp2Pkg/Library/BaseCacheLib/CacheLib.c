@@ -153,7 +153,9 @@ EfiRecoverCacheMtrr (
 }
 
 /**
-  Programming MTRR according to Memory address, length, and type.
+  Write a variable MTRR pair according to Memory address, length, and type.
+
+  The caller is responsible for disabling the cache and the MTRRs around the write.
 
   @param[in] MtrrNumber           the variable MTRR index number
   @param[in] MemoryAddress        the address of target memory
@@ -163,7 +165,7 @@ EfiRecoverCacheMtrr (
 
 **/
 VOID
-EfiProgramMtrr (
+EfiWriteVariableMtrr (
   IN  UINT32                 MtrrNumber,
   IN  EFI_PHYSICAL_ADDRESS   MemoryAddress,
   IN  UINT64                 MemoryLength,
@@ -172,13 +174,6 @@ EfiProgramMtrr (
   )
 {
   UINT64  TempQword;
-  UINT64  OldMtrr;
-
-  if (MemoryLength == 0) {
-    return;
-  }
-
-  EfiDisableCacheMtrr (&OldMtrr);
 
   //
   // MTRR Physical Base
@@ -191,10 +186,60 @@ EfiProgramMtrr (
   //
   TempQword = ~(MemoryLength - 1);
   AsmWriteMsr64 (MtrrNumber + 1, (TempQword & ValidMtrrAddressMask) | B_EFI_MSR_CACHE_MTRR_VALID);
+}
+
+/**
+  Programming MTRR according to Memory address, length, and type.
+
+  @param[in] MtrrNumber           the variable MTRR index number
+  @param[in] MemoryAddress        the address of target memory
+  @param[in] MemoryLength         the length of target memory
+  @param[in] MemoryCacheType      the cache type of target memory
+  @param[in] ValidMtrrAddressMask the MTRR address mask
+
+**/
+VOID
+EfiProgramMtrr (
+  IN  UINT32                 MtrrNumber,
+  IN  EFI_PHYSICAL_ADDRESS   MemoryAddress,
+  IN  UINT64                 MemoryLength,
+  IN  EFI_MEMORY_CACHE_TYPE  MemoryCacheType,
+  IN  UINT64                 ValidMtrrAddressMask
+  )
+{
+  UINT64  OldMtrr;
+
+  if (MemoryLength == 0) {
+    return;
+  }
 
+  EfiDisableCacheMtrr (&OldMtrr);
+  EfiWriteVariableMtrr (MtrrNumber, MemoryAddress, MemoryLength, MemoryCacheType, ValidMtrrAddressMask);
   EfiRecoverCacheMtrr (TRUE, OldMtrr);
 }
 
+/**
+  Return the address mask of the variable MTRRs for the physical address size of the CPU.
+
+  @return The MTRR address mask.
+
+**/
+UINT64
+GetValidMtrrAddressMask (
+  VOID
+  )
+{
+  UINT32  Cpuid_RegEax;
+
+  AsmCpuid (CPUID_EXTENDED_FUNCTION, &Cpuid_RegEax, NULL, NULL, NULL);
+  if (Cpuid_RegEax >= CPUID_VIR_PHY_ADDRESS_SIZE) {
+    AsmCpuid (CPUID_VIR_PHY_ADDRESS_SIZE, &Cpuid_RegEax, NULL, NULL, NULL);
+    return (LShiftU64 ((UINT64)1, (Cpuid_RegEax & 0xFF)) - 1) & (~(UINT64)0x0FFF);
+  }
+
+  return (LShiftU64 ((UINT64)1, 36) - 1) & (~(UINT64)0x0FFF);
+}
+
 /**
   Calculate the maximum value which is a power of 2, but less the MemoryLength.
 
@@ -389,15 +434,8 @@ SetCacheAttributes (
   UINT32                 UsedMsrNum;
   EFI_MEMORY_CACHE_TYPE  UsedMemoryCacheType;
   UINT64                 ValidMtrrAddressMask;
-  UINT32                 Cpuid_RegEax;
 
-  AsmCpuid (CPUID_EXTENDED_FUNCTION, &Cpuid_RegEax, NULL, NULL, NULL);
-  if (Cpuid_RegEax >= CPUID_VIR_PHY_ADDRESS_SIZE) {
-    AsmCpuid (CPUID_VIR_PHY_ADDRESS_SIZE, &Cpuid_RegEax, NULL, NULL, NULL);
-    ValidMtrrAddressMask = (LShiftU64 ((UINT64)1, (Cpuid_RegEax & 0xFF)) - 1) & (~(UINT64)0x0FFF);
-  } else {
-    ValidMtrrAddressMask = (LShiftU64 ((UINT64)1, 36) - 1) & (~(UINT64)0x0FFF);
-  }
+  ValidMtrrAddressMask = GetValidMtrrAddressMask ();
 
   //
   // Check for invalid parameter
@@ -572,6 +610,569 @@ SetCacheAttributes (
   return EFI_SUCCESS;
 }
 
+/**
+  Return the largest MTRR block that starts at Base and does not go past End.
+
+  @param[in]  Base    Base address of the block, aligned on 4KB.
+  @param[in]  End     End address of the range to describe.
+
+  @return The size of the block, a power of 2 that Base is aligned on.
+
+**/
+STATIC
+UINT64
+MtrrPlanBlockSize (
+  IN UINT64  Base,
+  IN UINT64  End
+  )
+{
+  UINT64  Size;
+
+  Size = GetPowerOfTwo64 (End - Base);
+  if (Base != 0) {
+    Size = MIN (Size, LShiftU64 (1, (UINTN)LowBitSet64 (Base)));
+  }
+
+  return Size;
+}
+
+/**
+  Return the number of variable MTRRs needed to describe a range with a single type.
+
+  @param[in]  Base    Base address of the range.
+  @param[in]  End     End address of the range.
+
+  @return The number of variable MTRRs.
+
+**/
+STATIC
+UINTN
+MtrrPlanBlockCount (
+  IN UINT64  Base,
+  IN UINT64  End
+  )
+{
+  UINTN  Count;
+
+  for (Count = 0; Base < End; Count++) {
+    Base += MtrrPlanBlockSize (Base, End);
+  }
+
+  return Count;
+}
+
+/**
+  Append the variable MTRRs describing a range with a single type.
+
+  @param[in, out] Mtrrs       The variable MTRRs of the plan.
+  @param[in, out] MtrrCount   The number of variable MTRRs of the plan.
+  @param[in]      Base        Base address of the range.
+  @param[in]      End         End address of the range.
+  @param[in]      CacheType   Cache type of the range.
+
+**/
+STATIC
+VOID
+MtrrPlanEmitBlocks (
+  IN OUT CACHE_LIB_MTRR  *Mtrrs,
+  IN OUT UINTN           *MtrrCount,
+  IN     UINT64          Base,
+  IN     UINT64          End,
+  IN     UINT8           CacheType
+  )
+{
+  UINT64  Size;
+
+  while ((Base < End) && (*MtrrCount < CACHE_LIB_MAX_VARIABLE_MTRRS)) {
+    Size                            = MtrrPlanBlockSize (Base, End);
+    Mtrrs[*MtrrCount].BaseAddress   = Base;
+    Mtrrs[*MtrrCount].Length        = Size;
+    Mtrrs[*MtrrCount].CacheType     = CacheType;
+    (*MtrrCount)++;
+    Base += Size;
+  }
+}
+
+/**
+  Add an interval boundary to the plan, if there is room left for it.
+
+  @param[in, out] Plan      The MTRR plan.
+  @param[in]      Address   The boundary address.
+
+**/
+STATIC
+VOID
+MtrrPlanAddBoundary (
+  IN OUT CACHE_LIB_PLAN  *Plan,
+  IN     UINT64          Address
+  )
+{
+  if (Plan->Count < CACHE_LIB_MAX_PLAN_BOUNDARIES) {
+    Plan->Boundary[Plan->Count++] = Address;
+  }
+}
+
+/**
+  Split the address space into the elementary intervals of the plan.
+
+  The boundaries are the ends of the ranges and, as long as there is room, the
+  addresses a larger MTRR covering the ends of a range could start or end at:
+  the end address with its lowest set bits cleared one at a time, and the end
+  address rounded up to its next alignments.
+
+  @param[in, out] Plan          The MTRR plan.
+  @param[in]      Ranges        The list of memory ranges.
+  @param[in]      RangeCount    The number of ranges in the list.
+  @param[in]      Limit         The top of the physical address space.
+
+**/
+STATIC
+VOID
+MtrrPlanSetBoundaries (
+  IN OUT CACHE_LIB_PLAN               *Plan,
+  IN     CONST CACHE_ATTRIBUTE_RANGE  *Ranges,
+  IN     UINTN                        RangeCount,
+  IN     UINT64                       Limit
+  )
+{
+  UINTN   Index;
+  UINTN   Edge;
+  UINTN   Sorted;
+  UINT64  End;
+  UINT64  Address;
+
+  Plan->Count = 0;
+  MtrrPlanAddBoundary (Plan, 0);
+  MtrrPlanAddBoundary (Plan, BASE_1MB);
+  MtrrPlanAddBoundary (Plan, Limit);
+  for (Index = 0; Index < RangeCount; Index++) {
+    MtrrPlanAddBoundary (Plan, MAX (Ranges[Index].BaseAddress, BASE_1MB));
+    MtrrPlanAddBoundary (Plan, MAX (Ranges[Index].BaseAddress + Ranges[Index].Length, BASE_1MB));
+  }
+
+  for (Index = 0; Index < RangeCount; Index++) {
+    for (Edge = 0; Edge < 2; Edge++) {
+      End = Ranges[Index].BaseAddress + ((Edge == 0) ? 0 : Ranges[Index].Length);
+      End = MAX (End, BASE_1MB);
+
+      for (Address = End & (End - 1); Address != 0; Address &= Address - 1) {
+        MtrrPlanAddBoundary (Plan, Address);
+      }
+
+      for (Address = End; (Address & (Address - 1)) != 0;) {
+        Address += LShiftU64 (1, (UINTN)LowBitSet64 (Address));
+        if (Address > Limit) {
+          break;
+        }
+
+        MtrrPlanAddBoundary (Plan, Address);
+      }
+    }
+  }
+
+  //
+  // Sort the boundaries and drop the duplicates
+  //
+  for (Index = 1; Index < Plan->Count; Index++) {
+    Address = Plan->Boundary[Index];
+    for (Edge = Index; (Edge > 0) && (Plan->Boundary[Edge - 1] > Address); Edge--) {
+      Plan->Boundary[Edge] = Plan->Boundary[Edge - 1];
+    }
+
+    Plan->Boundary[Edge] = Address;
+  }
+
+  Sorted = 1;
+  for (Index = 1; Index < Plan->Count; Index++) {
+    if (Plan->Boundary[Index] != Plan->Boundary[Sorted - 1]) {
+      Plan->Boundary[Sorted++] = Plan->Boundary[Index];
+    }
+  }
+
+  Plan->Count = Sorted;
+}
+
+/**
+  Record a cheaper description of the address space up to a boundary.
+
+  @param[in, out] Plan        The MTRR plan.
+  @param[in]      Start       The boundary where the last piece starts.
+  @param[in]      End         The boundary where the last piece ends.
+  @param[in]      CoverType   The cover type of the last piece, CACHE_LIB_TYPE_ANY if none.
+  @param[in]      Pieces      The number of variable MTRRs of the last piece.
+
+**/
+STATIC
+VOID
+MtrrPlanRelax (
+  IN OUT CACHE_LIB_PLAN  *Plan,
+  IN     UINTN           Start,
+  IN     UINTN           End,
+  IN     UINT8           CoverType,
+  IN     UINTN           Pieces
+  )
+{
+  UINTN  Cost;
+
+  Cost = Plan->Cost[Start] + Pieces;
+  if (Cost < Plan->Cost[End]) {
+    Plan->Cost[End]      = (UINT16)Cost;
+    Plan->From[End]      = (UINT8)Start;
+    Plan->CoverType[End] = CoverType;
+  }
+}
+
+/**
+  Find the smallest set of variable MTRRs describing the types of the intervals.
+
+  The address space is described piece by piece. A piece is either a run of
+  intervals of the same type, set with positive MTRRs unless it is the default
+  type, or a write-back or write-through cover of any intervals from which the
+  others are carved out with uncacheable MTRRs, and write-through MTRRs under a
+  write-back cover, as these take precedence when variable MTRRs overlap.
+
+  @param[in, out] Plan          The MTRR plan, with its intervals and their types set.
+  @param[in]      DefaultType   The default memory type.
+
+**/
+STATIC
+VOID
+MtrrPlanSolve (
+  IN OUT CACHE_LIB_PLAN  *Plan,
+  IN     UINT8           DefaultType
+  )
+{
+  STATIC CONST UINT8  CoverTypes[] = { EFI_CACHE_WRITEBACK, EFI_CACHE_WRITETHROUGH };
+  UINTN               Start;
+  UINTN               End;
+  UINTN               Index;
+  UINT8               Type;
+  UINT8               RunType;
+  UINT8               CoverType;
+  UINT8               OverlayType;
+  UINTN               OverlayStart;
+  UINTN               OverlayCost;
+  UINTN               Pieces;
+
+  Plan->Cost[0] = 0;
+  for (End = 1; End < Plan->Count; End++) {
+    Plan->Cost[End] = MAX_UINT16;
+  }
+
+  for (Start = 0; Start + 1 < Plan->Count; Start++) {
+    //
+    // Positive runs starting at Start
+    //
+    RunType = CACHE_LIB_TYPE_ANY;
+    for (End = Start + 1; End < Plan->Count; End++) {
+      Type = Plan->Type[End - 1];
+      if (Type != CACHE_LIB_TYPE_ANY) {
+        if (RunType == CACHE_LIB_TYPE_ANY) {
+          RunType = Type;
+        } else if (RunType != Type) {
+          break;
+        }
+      }
+
+      Pieces = 0;
+      if ((RunType != CACHE_LIB_TYPE_ANY) && (RunType != DefaultType)) {
+        Pieces = MtrrPlanBlockCount (Plan->Boundary[Start], Plan->Boundary[End]);
+      }
+
+      MtrrPlanRelax (Plan, Start, End, CACHE_LIB_TYPE_ANY, Pieces);
+    }
+
+    //
+    // Covers starting at Start
+    //
+    for (Index = 0; Index < ARRAY_SIZE (CoverTypes); Index++) {
+      CoverType = CoverTypes[Index];
+      if (CoverType == DefaultType) {
+        continue;
+      }
+
+      OverlayType  = CACHE_LIB_TYPE_ANY;
+      OverlayStart = Start;
+      OverlayCost  = 0;
+      for (End = Start + 1; End < Plan->Count; End++) {
+        Type = Plan->Type[End - 1];
+        if ((Type == CACHE_LIB_TYPE_ANY) || (Type == CoverType)) {
+          Type = CACHE_LIB_TYPE_ANY;
+        } else if ((Type != EFI_CACHE_UNCACHEABLE) &&
+                   !((Type == EFI_CACHE_WRITETHROUGH) && (CoverType == EFI_CACHE_WRITEBACK)))
+        {
+          break;
+        }
+
+        if (Type != OverlayType) {
+          if (OverlayType != CACHE_LIB_TYPE_ANY) {
+            OverlayCost += MtrrPlanBlockCount (Plan->Boundary[OverlayStart], Plan->Boundary[End - 1]);
+          }
+
+          OverlayType  = Type;
+          OverlayStart = End - 1;
+        }
+
+        Pieces = OverlayCost + MtrrPlanBlockCount (Plan->Boundary[Start], Plan->Boundary[End]);
+        if (OverlayType != CACHE_LIB_TYPE_ANY) {
+          Pieces += MtrrPlanBlockCount (Plan->Boundary[OverlayStart], Plan->Boundary[End]);
+        }
+
+        MtrrPlanRelax (Plan, Start, End, CoverType, Pieces);
+      }
+    }
+  }
+}
+
+/**
+  Build the variable MTRRs of the plan found by MtrrPlanSolve ().
+
+  @param[in]  Plan          The solved MTRR plan.
+  @param[in]  DefaultType   The default memory type.
+  @param[out] Mtrrs         The variable MTRRs of the plan.
+
+  @return The number of variable MTRRs of the plan.
+
+**/
+STATIC
+UINTN
+MtrrPlanEmit (
+  IN  CONST CACHE_LIB_PLAN  *Plan,
+  IN  UINT8                 DefaultType,
+  OUT CACHE_LIB_MTRR        *Mtrrs
+  )
+{
+  UINTN  MtrrCount;
+  UINTN  Start;
+  UINTN  End;
+  UINTN  Index;
+  UINTN  RunEnd;
+  UINT8  Type;
+  UINT8  CoverType;
+
+  MtrrCount = 0;
+  for (End = Plan->Count - 1; End > 0; End = Start) {
+    Start     = Plan->From[End];
+    CoverType = Plan->CoverType[End];
+
+    if (CoverType == CACHE_LIB_TYPE_ANY) {
+      for (Index = Start; (Index < End) && (Plan->Type[Index] == CACHE_LIB_TYPE_ANY); Index++) {
+      }
+
+      if ((Index < End) && (Plan->Type[Index] != DefaultType)) {
+        MtrrPlanEmitBlocks (Mtrrs, &MtrrCount, Plan->Boundary[Start], Plan->Boundary[End], Plan->Type[Index]);
+      }
+
+      continue;
+    }
+
+    MtrrPlanEmitBlocks (Mtrrs, &MtrrCount, Plan->Boundary[Start], Plan->Boundary[End], CoverType);
+    for (Index = Start; Index < End; Index = RunEnd) {
+      Type = Plan->Type[Index];
+      for (RunEnd = Index + 1; (RunEnd < End) && (Plan->Type[RunEnd] == Type); RunEnd++) {
+      }
+
+      if ((Type != CACHE_LIB_TYPE_ANY) && (Type != CoverType)) {
+        MtrrPlanEmitBlocks (Mtrrs, &MtrrCount, Plan->Boundary[Index], Plan->Boundary[RunEnd], Type);
+      }
+    }
+  }
+
+  return MtrrCount;
+}
+
+/**
+  Given a list of memory ranges and cache types, programs the MTRRs.
+
+  The MTRR set is computed for the whole list before any MTRR is written, and
+  all the MTRRs are then written under a single cache disable. When ranges
+  overlap, the later range in the list takes precedence.
+
+  The parts of the ranges below 1MB are set in the fixed MTRRs. The variable
+  MTRRs available to the BIOS are reprogrammed to describe exactly the parts
+  above 1MB, using as few MTRRs as possible: a range may be covered with a
+  larger write-back or write-through MTRR from which other types are carved
+  out with MTRRs of higher precedence.
+
+  Variable MTRRs available to the BIOS that are not needed to describe the
+  list are cleared, including those set by earlier calls to
+  SetCacheAttributes (); the caller must pass every range above 1MB that is
+  to keep its type. The MTRR pair left for the OS is not changed.
+
+  @param[in] Ranges              The list of memory ranges.
+  @param[in] RangeCount          The number of ranges in the list.
+
+  @retval EFI_SUCCESS            Mtrr are set successfully.
+  @retval EFI_LOAD_ERROR         Not enough MTRRs to describe the ranges, no MTRR is changed.
+  @retval EFI_INVALID_PARAMETER  The input parameter is not valid.
+  @retval EFI_OUT_OF_RESOURCES   The list has too many ranges.
+
+**/
+EFI_STATUS
+EFIAPI
+SetCacheAttributesList (
+  IN CONST CACHE_ATTRIBUTE_RANGE  *Ranges,
+  IN UINTN                        RangeCount
+  )
+{
+  UINT64          ValidMtrrAddressMask;
+  UINT64          Limit;
+  UINT64          End;
+  UINT64          UnitBase;
+  UINT64          ClearMask;
+  UINT64          OldMtrr;
+  UINT64          FixedMtrr[V_EFI_FIXED_MTRR_NUMBER];
+  UINT32          FixedChanged;
+  UINT8           DefaultType;
+  UINTN           Index;
+  UINTN           Interval;
+  UINTN           MsrIndex;
+  UINTN           ByteIndex;
+  UINTN           MtrrCount;
+  UINTN           MtrrLimit;
+  CACHE_LIB_PLAN  Plan;
+  CACHE_LIB_MTRR  Mtrrs[CACHE_LIB_MAX_VARIABLE_MTRRS];
+
+  if ((Ranges == NULL) && (RangeCount != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (RangeCount > CACHE_LIB_MAX_RANGES) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ValidMtrrAddressMask = GetValidMtrrAddressMask ();
+  Limit                = ValidMtrrAddressMask + SIZE_4KB;
+
+  //
+  // Check for invalid parameter
+  //
+  for (Index = 0; Index < RangeCount; Index++) {
+    if (((Ranges[Index].BaseAddress & ~ValidMtrrAddressMask) != 0) ||
+        ((Ranges[Index].Length & ~ValidMtrrAddressMask) != 0) ||
+        (Ranges[Index].Length == 0) ||
+        (Ranges[Index].BaseAddress + Ranges[Index].Length > Limit))
+    {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    switch (Ranges[Index].CacheType) {
+      case EFI_CACHE_UNCACHEABLE:
+      case EFI_CACHE_WRITECOMBINING:
+      case EFI_CACHE_WRITETHROUGH:
+      case EFI_CACHE_WRITEPROTECTED:
+      case EFI_CACHE_WRITEBACK:
+        break;
+
+      default:
+        return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  //
+  // Merge the parts below 1MB into the fixed MTRRs, which are read only once
+  //
+  FixedChanged = 0;
+  for (MsrIndex = 0; MsrIndex < V_EFI_FIXED_MTRR_NUMBER; MsrIndex++) {
+    FixedMtrr[MsrIndex] = AsmReadMsr64 (mFixedMtrrTable[MsrIndex].Msr);
+  }
+
+  for (Index = 0; Index < RangeCount; Index++) {
+    if (Ranges[Index].BaseAddress >= BASE_1MB) {
+      continue;
+    }
+
+    End = MIN (Ranges[Index].BaseAddress + Ranges[Index].Length, BASE_1MB);
+    for (MsrIndex = 0; MsrIndex < V_EFI_FIXED_MTRR_NUMBER; MsrIndex++) {
+      for (ByteIndex = 0; ByteIndex < 8; ByteIndex++) {
+        UnitBase = mFixedMtrrTable[MsrIndex].BaseAddress + ByteIndex * mFixedMtrrTable[MsrIndex].Length;
+        if ((UnitBase + mFixedMtrrTable[MsrIndex].Length <= Ranges[Index].BaseAddress) || (UnitBase >= End)) {
+          continue;
+        }
+
+        //
+        // A fixed MTRR cannot describe part of its unit
+        //
+        if ((UnitBase < Ranges[Index].BaseAddress) || (UnitBase + mFixedMtrrTable[MsrIndex].Length > End)) {
+          return EFI_INVALID_PARAMETER;
+        }
+
+        ClearMask           = LShiftU64 ((UINT64)0xFF, (UINT32)(ByteIndex * 8));
+        FixedMtrr[MsrIndex] = (FixedMtrr[MsrIndex] & ~ClearMask) |
+                              LShiftU64 ((UINT64)Ranges[Index].CacheType, (UINT32)(ByteIndex * 8));
+        FixedChanged |= (UINT32)(1 << MsrIndex);
+      }
+    }
+  }
+
+  //
+  // Type the intervals above 1MB with the last range covering them, and plan
+  // the variable MTRRs. The fixed MTRRs take precedence below 1MB, so the
+  // variable MTRRs may describe that part with any type.
+  //
+  DefaultType = (UINT8)(AsmReadMsr64 (EFI_MSR_CACHE_IA32_MTRR_DEF_TYPE) & B_EFI_MSR_CACHE_MEMORY_TYPE);
+  MtrrPlanSetBoundaries (&Plan, Ranges, RangeCount, Limit);
+  for (Interval = 0; Interval + 1 < Plan.Count; Interval++) {
+    Plan.Type[Interval] = CACHE_LIB_TYPE_ANY;
+    if (Plan.Boundary[Interval + 1] <= BASE_1MB) {
+      continue;
+    }
+
+    Plan.Type[Interval] = DefaultType;
+    for (Index = 0; Index < RangeCount; Index++) {
+      if ((Plan.Boundary[Interval] >= Ranges[Index].BaseAddress) &&
+          (Plan.Boundary[Interval] < Ranges[Index].BaseAddress + Ranges[Index].Length))
+      {
+        Plan.Type[Interval] = (UINT8)Ranges[Index].CacheType;
+      }
+    }
+  }
+
+  MtrrPlanSolve (&Plan, DefaultType);
+
+  //
+  // Reserve the MTRR pairs for OS.
+  //
+  MtrrLimit = (UINTN)(AsmReadMsr64 (EFI_MSR_IA32_MTRR_CAP) & B_EFI_MSR_IA32_MTRR_CAP_VARIABLE_SUPPORT);
+  MtrrLimit = (MtrrLimit > EFI_CACHE_NUM_VAR_MTRR_PAIRS_FOR_OS) ? MtrrLimit - EFI_CACHE_NUM_VAR_MTRR_PAIRS_FOR_OS : 0;
+  MtrrLimit = MIN (MtrrLimit, CACHE_LIB_MAX_VARIABLE_MTRRS);
+  if (Plan.Cost[Plan.Count - 1] > MtrrLimit) {
+    return EFI_LOAD_ERROR;
+  }
+
+  MtrrCount = MtrrPlanEmit (&Plan, DefaultType, Mtrrs);
+
+  //
+  // Program MTRRs
+  //
+  EfiDisableCacheMtrr (&OldMtrr);
+
+  for (MsrIndex = 0; MsrIndex < V_EFI_FIXED_MTRR_NUMBER; MsrIndex++) {
+    if ((FixedChanged & (1 << MsrIndex)) != 0) {
+      AsmWriteMsr64 (mFixedMtrrTable[MsrIndex].Msr, FixedMtrr[MsrIndex]);
+    }
+  }
+
+  for (Index = 0; Index < MtrrLimit; Index++) {
+    if (Index < MtrrCount) {
+      EfiWriteVariableMtrr (
+        EFI_MSR_CACHE_VARIABLE_MTRR_BASE + (UINT32)(2 * Index),
+        Mtrrs[Index].BaseAddress,
+        Mtrrs[Index].Length,
+        (EFI_MEMORY_CACHE_TYPE)Mtrrs[Index].CacheType,
+        ValidMtrrAddressMask
+        );
+    } else {
+      AsmWriteMsr64 (EFI_MSR_CACHE_VARIABLE_MTRR_BASE + (UINT32)(2 * Index), 0);
+      AsmWriteMsr64 (EFI_MSR_CACHE_VARIABLE_MTRR_BASE + (UINT32)(2 * Index) + 1, 0);
+    }
+  }
+
+  EfiRecoverCacheMtrr (TRUE, OldMtrr);
+
+  return EFI_SUCCESS;
+}
+
 /**
  Reset all the MTRRs to a known state.
 
@@ -49,4 +49,35 @@
 #define CPUID_VIR_PHY_ADDRESS_SIZE  0x80000008
 #define CPUID_EXTENDED_FUNCTION     0x80000000
 
+//
+// Limits of the MTRR planner used by SetCacheAttributesList ()
+//
+#define CACHE_LIB_MAX_RANGES            32
+#define CACHE_LIB_MAX_PLAN_BOUNDARIES   128
+#define CACHE_LIB_MAX_VARIABLE_MTRRS    32
+
+//
+// Cache type of a part of the address space the variable MTRRs need not describe
+//
+#define CACHE_LIB_TYPE_ANY  0xFF
+
+typedef struct {
+  UINT64    BaseAddress;
+  UINT64    Length;
+  UINT8     CacheType;
+} CACHE_LIB_MTRR;
+
+//
+// Elementary intervals of the address space and the cheapest MTRR description
+// of the address space up to each interval boundary.
+//
+typedef struct {
+  UINTN     Count;
+  UINT64    Boundary[CACHE_LIB_MAX_PLAN_BOUNDARIES];
+  UINT8     Type[CACHE_LIB_MAX_PLAN_BOUNDARIES];        // Type of [Boundary[i], Boundary[i + 1])
+  UINT16    Cost[CACHE_LIB_MAX_PLAN_BOUNDARIES];        // MTRRs needed for [Boundary[0], Boundary[i])
+  UINT8     From[CACHE_LIB_MAX_PLAN_BOUNDARIES];        // Boundary where the last piece starts
+  UINT8     CoverType[CACHE_LIB_MAX_PLAN_BOUNDARIES];   // Cover type of the last piece, CACHE_LIB_TYPE_ANY if none
+} CACHE_LIB_PLAN;
+
 #endif
@@ -0,0 +1,548 @@
+/** @file
+  Host-based unit test of the MTRR planner of SetCacheAttributesList (), with
+  the MSRs and CPUID of the processor mocked.
+
+  Copyright (c) 2021, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/CacheLib.h>
+#include <Library/UnitTestLib.h>
+#include <Library/UnitTestHostBaseLib.h>
+
+#include "../CacheLibInternal.h"
+
+#define UNIT_TEST_NAME     "Cache Lib UnitTest"
+#define UNIT_TEST_VERSION  "0.1"
+
+//
+// Mocked processor: 39-bit physical addresses and 10 variable MTRRs, one of
+// them left for the OS.
+//
+#define TEST_PHYSICAL_ADDRESS_BITS  39
+#define TEST_VARIABLE_MTRR_COUNT    10
+#define TEST_MSR_COUNT              0x300
+
+STATIC UINT64  mMsr[TEST_MSR_COUNT];
+STATIC UINTN   mMsrWriteCount;
+
+/// === MOCKED PROCESSOR ===========================================================================
+
+/**
+  Read a mocked MSR.
+
+  @param[in] Index         The MSR index.
+
+  @return The value of the MSR.
+**/
+STATIC
+UINT64
+EFIAPI
+MockAsmReadMsr64 (
+  IN UINT32  Index
+  )
+{
+  ASSERT (Index < TEST_MSR_COUNT);
+  return mMsr[Index];
+}
+
+/**
+  Write a mocked MSR.
+
+  @param[in] Index         The MSR index.
+  @param[in] Value         The value to write.
+
+  @return Value.
+**/
+STATIC
+UINT64
+EFIAPI
+MockAsmWriteMsr64 (
+  IN UINT32  Index,
+  IN UINT64  Value
+  )
+{
+  ASSERT (Index < TEST_MSR_COUNT);
+  mMsr[Index] = Value;
+  mMsrWriteCount++;
+  return Value;
+}
+
+/**
+  Execute a mocked CPUID, reporting only the physical address size.
+
+  @param[in]  Index        The CPUID leaf.
+  @param[out] Eax          Receives EAX, or NULL.
+  @param[out] Ebx          Receives EBX, or NULL.
+  @param[out] Ecx          Receives ECX, or NULL.
+  @param[out] Edx          Receives EDX, or NULL.
+
+  @return Index.
+**/
+STATIC
+UINT32
+EFIAPI
+MockAsmCpuid (
+  IN  UINT32  Index,
+  OUT UINT32  *Eax  OPTIONAL,
+  OUT UINT32  *Ebx  OPTIONAL,
+  OUT UINT32  *Ecx  OPTIONAL,
+  OUT UINT32  *Edx  OPTIONAL
+  )
+{
+  if (Eax != NULL) {
+    *Eax = (Index == CPUID_EXTENDED_FUNCTION) ? CPUID_VIR_PHY_ADDRESS_SIZE : TEST_PHYSICAL_ADDRESS_BITS;
+  }
+
+  if (Ebx != NULL) {
+    *Ebx = 0;
+  }
+
+  if (Ecx != NULL) {
+    *Ecx = 0;
+  }
+
+  if (Edx != NULL) {
+    *Edx = 0;
+  }
+
+  return Index;
+}
+
+/**
+  Route the MSR and CPUID accesses of BaseLib to the mocked processor.
+**/
+STATIC
+VOID
+EFIAPI
+MockProcessorSetup (
+  VOID
+  )
+{
+  gUnitTestHostBaseLib.X86->AsmReadMsr64  = MockAsmReadMsr64;
+  gUnitTestHostBaseLib.X86->AsmWriteMsr64 = MockAsmWriteMsr64;
+  gUnitTestHostBaseLib.X86->AsmCpuid      = MockAsmCpuid;
+}
+
+/// === HELPER FUNCTIONS ===========================================================================
+
+/**
+  Reset the mocked MSRs, with all the MTRRs cleared.
+
+  @param[in] DefaultType   The default memory type.
+**/
+STATIC
+VOID
+ResetMsrs (
+  IN UINT8  DefaultType
+  )
+{
+  ZeroMem (mMsr, sizeof (mMsr));
+  mMsr[EFI_MSR_IA32_MTRR_CAP]            = B_EFI_MSR_IA32_MTRR_CAP_FIXED_SUPPORT | TEST_VARIABLE_MTRR_COUNT;
+  mMsr[EFI_MSR_CACHE_IA32_MTRR_DEF_TYPE] = B_EFI_MSR_GLOBAL_MTRR_ENABLE | B_EFI_MSR_FIXED_MTRR_ENABLE | DefaultType;
+  mMsrWriteCount                         = 0;
+}
+
+/**
+  Get the number of valid variable MTRRs.
+
+  @return The number of valid variable MTRRs.
+**/
+STATIC
+UINTN
+GetValidVariableMtrrCount (
+  VOID
+  )
+{
+  UINTN  Index;
+  UINTN  Count;
+
+  Count = 0;
+  for (Index = 0; Index < TEST_VARIABLE_MTRR_COUNT; Index++) {
+    if ((mMsr[EFI_MSR_CACHE_VARIABLE_MTRR_BASE + 2 * Index + 1] & B_EFI_MSR_CACHE_MTRR_VALID) != 0) {
+      Count++;
+    }
+  }
+
+  return Count;
+}
+
+/**
+  Get the memory type of an address above 1MB from the variable MTRRs, with the
+  precedence rules of the processor: UC wins, then WT over WB.
+
+  @param[in] Address       The address.
+
+  @return The memory type, or MAX_UINT8 if the MTRRs give an undefined type.
+**/
+STATIC
+UINT8
+GetEffectiveType (
+  IN UINT64  Address
+  )
+{
+  UINT64   Mask;
+  UINTN    Index;
+  UINT8    Type;
+  UINT8    Other;
+  BOOLEAN  Uncacheable;
+  BOOLEAN  WriteThrough;
+  BOOLEAN  WriteBack;
+
+  Uncacheable  = FALSE;
+  WriteThrough = FALSE;
+  WriteBack    = FALSE;
+  Other        = MAX_UINT8;
+  for (Index = 0; Index < TEST_VARIABLE_MTRR_COUNT; Index++) {
+    Mask = mMsr[EFI_MSR_CACHE_VARIABLE_MTRR_BASE + 2 * Index + 1];
+    if ((Mask & B_EFI_MSR_CACHE_MTRR_VALID) == 0) {
+      continue;
+    }
+
+    Mask &= LShiftU64 (1, TEST_PHYSICAL_ADDRESS_BITS) - SIZE_4KB;
+    if (((Address ^ mMsr[EFI_MSR_CACHE_VARIABLE_MTRR_BASE + 2 * Index]) & Mask) != 0) {
+      continue;
+    }
+
+    Type = (UINT8)(mMsr[EFI_MSR_CACHE_VARIABLE_MTRR_BASE + 2 * Index] & 0xFF);
+    if (Type == EFI_CACHE_UNCACHEABLE) {
+      Uncacheable = TRUE;
+    } else if (Type == EFI_CACHE_WRITETHROUGH) {
+      WriteThrough = TRUE;
+    } else if (Type == EFI_CACHE_WRITEBACK) {
+      WriteBack = TRUE;
+    } else if ((Other != MAX_UINT8) && (Other != Type)) {
+      return MAX_UINT8;
+    } else {
+      Other = Type;
+    }
+  }
+
+  if (Uncacheable) {
+    return EFI_CACHE_UNCACHEABLE;
+  }
+
+  if (Other != MAX_UINT8) {
+    return (WriteThrough || WriteBack) ? MAX_UINT8 : Other;
+  }
+
+  if (WriteThrough) {
+    return EFI_CACHE_WRITETHROUGH;
+  }
+
+  if (WriteBack) {
+    return EFI_CACHE_WRITEBACK;
+  }
+
+  return (UINT8)(mMsr[EFI_MSR_CACHE_IA32_MTRR_DEF_TYPE] & B_EFI_MSR_CACHE_MEMORY_TYPE);
+}
+
+/**
+  Get the memory type a list of ranges gives to an address, the later range
+  taking precedence.
+
+  @param[in] Ranges        The list of ranges.
+  @param[in] RangeCount    The number of ranges.
+  @param[in] Address       The address.
+
+  @return The memory type.
+**/
+STATIC
+UINT8
+GetExpectedType (
+  IN CONST CACHE_ATTRIBUTE_RANGE  *Ranges,
+  IN UINTN                        RangeCount,
+  IN UINT64                       Address
+  )
+{
+  UINTN  Index;
+  UINT8  Type;
+
+  Type = (UINT8)(mMsr[EFI_MSR_CACHE_IA32_MTRR_DEF_TYPE] & B_EFI_MSR_CACHE_MEMORY_TYPE);
+  for (Index = 0; Index < RangeCount; Index++) {
+    if ((Address >= Ranges[Index].BaseAddress) && (Address < Ranges[Index].BaseAddress + Ranges[Index].Length)) {
+      Type = (UINT8)Ranges[Index].CacheType;
+    }
+  }
+
+  return Type;
+}
+
+/**
+  Check that the variable MTRRs give every range boundary above 1MB, and the
+  pages around it, the type set by the list.
+
+  @param[in] Ranges        The list of ranges.
+  @param[in] RangeCount    The number of ranges.
+
+  @retval TRUE             The MTRRs match the list.
+  @retval FALSE            An address has another type.
+**/
+STATIC
+BOOLEAN
+MtrrsMatchRanges (
+  IN CONST CACHE_ATTRIBUTE_RANGE  *Ranges,
+  IN UINTN                        RangeCount
+  )
+{
+  UINTN   Index;
+  UINTN   Point;
+  UINT64  Address[4];
+
+  for (Index = 0; Index < RangeCount; Index++) {
+    Address[0] = Ranges[Index].BaseAddress;
+    Address[1] = Ranges[Index].BaseAddress - SIZE_4KB;
+    Address[2] = Ranges[Index].BaseAddress + Ranges[Index].Length - SIZE_4KB;
+    Address[3] = Ranges[Index].BaseAddress + Ranges[Index].Length;
+    for (Point = 0; Point < ARRAY_SIZE (Address); Point++) {
+      if ((Address[Point] < BASE_1MB) || (Address[Point] >= LShiftU64 (1, TEST_PHYSICAL_ADDRESS_BITS))) {
+        continue;
+      }
+
+      if (GetEffectiveType (Address[Point]) != GetExpectedType (Ranges, RangeCount, Address[Point])) {
+        DEBUG ((DEBUG_ERROR, "Address 0x%lx has type %d\n", Address[Point], GetEffectiveType (Address[Point])));
+        return FALSE;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+/// === TEST CASES =================================================================================
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+ShouldApplyLaterOverlappingRanges (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  CONST CACHE_ATTRIBUTE_RANGE  Ranges[] = {
+    { 0,          SIZE_8GB,   EFI_CACHE_WRITEBACK      },
+    { 0xC0000000, SIZE_1GB,   EFI_CACHE_UNCACHEABLE    },
+    { 0xD0000000, SIZE_256MB, EFI_CACHE_WRITECOMBINING },
+    { 0xFF000000, SIZE_16MB,  EFI_CACHE_WRITEPROTECTED }
+  };
+
+  ResetMsrs (EFI_CACHE_UNCACHEABLE);
+  UT_ASSERT_NOT_EFI_ERROR (SetCacheAttributesList (Ranges, ARRAY_SIZE (Ranges)));
+  UT_ASSERT_TRUE (MtrrsMatchRanges (Ranges, ARRAY_SIZE (Ranges)));
+  UT_ASSERT_EQUAL (GetEffectiveType (0xD8000000), EFI_CACHE_WRITECOMBINING);
+  UT_ASSERT_EQUAL (GetEffectiveType (0xE0000000), EFI_CACHE_UNCACHEABLE);
+  UT_ASSERT_EQUAL (GetEffectiveType (0xFF800000), EFI_CACHE_WRITEPROTECTED);
+
+  //
+  // The part below 1MB is set in the fixed MTRRs.
+  //
+  UT_ASSERT_EQUAL (mMsr[EFI_MSR_IA32_MTRR_FIX64K_00000], 0x0606060606060606ULL);
+  UT_ASSERT_EQUAL (mMsr[EFI_MSR_IA32_MTRR_FIX4K_F8000], 0x0606060606060606ULL);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+ShouldCarveUncacheableOutOfWriteBack (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  CONST CACHE_ATTRIBUTE_RANGE  Ranges[] = {
+    { 0,        SIZE_2GB,   EFI_CACHE_WRITEBACK   },
+    { SIZE_1GB, SIZE_256MB, EFI_CACHE_UNCACHEABLE }
+  };
+
+  //
+  // One WB MTRR covers the whole range and one UC MTRR takes the hole out.
+  //
+  ResetMsrs (EFI_CACHE_UNCACHEABLE);
+  UT_ASSERT_NOT_EFI_ERROR (SetCacheAttributesList (Ranges, ARRAY_SIZE (Ranges)));
+  UT_ASSERT_TRUE (MtrrsMatchRanges (Ranges, ARRAY_SIZE (Ranges)));
+  UT_ASSERT_EQUAL (GetValidVariableMtrrCount (), 2);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+ShouldSetWriteThroughUnderWriteBack (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  CONST CACHE_ATTRIBUTE_RANGE  Ranges[] = {
+    { 0,          SIZE_4GB, EFI_CACHE_WRITEBACK    },
+    { SIZE_1GB,   SIZE_1GB, EFI_CACHE_WRITETHROUGH },
+    { 0xFFF00000, SIZE_1MB, EFI_CACHE_UNCACHEABLE  }
+  };
+
+  //
+  // WT takes precedence over WB, so no MTRR is needed to split the WB range.
+  //
+  ResetMsrs (EFI_CACHE_UNCACHEABLE);
+  UT_ASSERT_NOT_EFI_ERROR (SetCacheAttributesList (Ranges, ARRAY_SIZE (Ranges)));
+  UT_ASSERT_TRUE (MtrrsMatchRanges (Ranges, ARRAY_SIZE (Ranges)));
+  UT_ASSERT_EQUAL (GetEffectiveType (SIZE_1GB + SIZE_512MB), EFI_CACHE_WRITETHROUGH);
+  UT_ASSERT_EQUAL (GetValidVariableMtrrCount (), 3);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+ShouldClearVariableMtrrsNotInList (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  CONST CACHE_ATTRIBUTE_RANGE  Ranges[] = {
+    { SIZE_1MB, SIZE_1GB - SIZE_1MB, EFI_CACHE_WRITEBACK }
+  };
+
+  //
+  // A WP MTRR set before the call is not part of the list, so it is cleared.
+  //
+  ResetMsrs (EFI_CACHE_UNCACHEABLE);
+  mMsr[EFI_MSR_CACHE_VARIABLE_MTRR_BASE + 6] = SIZE_4GB | EFI_CACHE_WRITEPROTECTED;
+  mMsr[EFI_MSR_CACHE_VARIABLE_MTRR_BASE + 7] = (LShiftU64 (1, TEST_PHYSICAL_ADDRESS_BITS) - SIZE_16MB) | B_EFI_MSR_CACHE_MTRR_VALID;
+
+  UT_ASSERT_NOT_EFI_ERROR (SetCacheAttributesList (Ranges, ARRAY_SIZE (Ranges)));
+  UT_ASSERT_TRUE (MtrrsMatchRanges (Ranges, ARRAY_SIZE (Ranges)));
+  UT_ASSERT_EQUAL (GetEffectiveType (SIZE_4GB), EFI_CACHE_UNCACHEABLE);
+  UT_ASSERT_EQUAL (mMsr[EFI_MSR_CACHE_VARIABLE_MTRR_BASE + 7], 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+ShouldReturnEfiLoadErrorWithoutWritingMsrs (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  CONST CACHE_ATTRIBUTE_RANGE  Ranges[] = {
+    { SIZE_1MB, 0x12345000, EFI_CACHE_WRITEBACK }
+  };
+
+  //
+  // The range needs many more MTRRs than the 3 left to the BIOS.
+  //
+  ResetMsrs (EFI_CACHE_UNCACHEABLE);
+  mMsr[EFI_MSR_IA32_MTRR_CAP] = B_EFI_MSR_IA32_MTRR_CAP_FIXED_SUPPORT | 4;
+
+  UT_ASSERT_STATUS_EQUAL (SetCacheAttributesList (Ranges, ARRAY_SIZE (Ranges)), EFI_LOAD_ERROR);
+  UT_ASSERT_EQUAL (mMsrWriteCount, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/// === TEST ENGINE ================================================================================
+
+/**
+  Run the cache library unit tests.
+
+  @retval EFI_SUCCESS     The tests were run.
+  @retval other           Some error occurred when setting up the tests.
+**/
+int
+main (
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework = NULL;
+  UNIT_TEST_SUITE_HANDLE      MtrrTests;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&MtrrTests, Framework, "Cache Lib MTRR Planner Tests", "CacheLib.SetCacheAttributesList", MockProcessorSetup, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for MtrrTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    MtrrTests,
+    "Should give overlapping ranges the type of the later range",
+    "CacheLib.SetCacheAttributesList.Overlap",
+    ShouldApplyLaterOverlappingRanges,
+    NULL,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    MtrrTests,
+    "Should carve an uncacheable range out of a write-back MTRR",
+    "CacheLib.SetCacheAttributesList.UncacheableCarveOut",
+    ShouldCarveUncacheableOutOfWriteBack,
+    NULL,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    MtrrTests,
+    "Should set a write-through range under a write-back MTRR",
+    "CacheLib.SetCacheAttributesList.WriteThroughUnderWriteBack",
+    ShouldSetWriteThroughUnderWriteBack,
+    NULL,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    MtrrTests,
+    "Should clear the variable MTRRs not in the list",
+    "CacheLib.SetCacheAttributesList.ClearOthers",
+    ShouldClearVariableMtrrsNotInList,
+    NULL,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    MtrrTests,
+    "Should return EFI_LOAD_ERROR without writing any MSR",
+    "CacheLib.SetCacheAttributesList.LoadError",
+    ShouldReturnEfiLoadErrorWithoutWritingMsrs,
+    NULL,
+    NULL,
+    NULL
+    );
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
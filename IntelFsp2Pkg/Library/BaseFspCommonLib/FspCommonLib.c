@@ -12,6 +12,7 @@
 #include <FspGlobalData.h>
 #include <FspEas.h>
 #include <Library/FspSwitchStackLib.h>
+#include <Library/FspCommonLib.h>
 
 #pragma pack(1)
 
@@ -386,18 +387,85 @@ SetFspMeasurePoint (
   )
 {
   FSP_GLOBAL_DATA  *FspData;
+  UINT64           TimeStamp;
+  UINT64           PerfData;
 
   //
   // Bit [55: 0]  will be the timestamp
   // Bit [63:56]  will be the ID
   //
+  TimeStamp = AsmReadTsc () & FSP_PERFORMANCE_DATA_TIMER_MASK;
+  PerfData  = TimeStamp | LShiftU64 (Id, 56);
+
+  //
+  // PerfData[] keeps the first points for the boot loaders reading it, the
+  // performance log has room for the rest.
+  //
   FspData = GetFspGlobalDataPointer ();
   if (FspData->PerfIdx < sizeof (FspData->PerfData) / sizeof (FspData->PerfData[0])) {
-    FspData->PerfData[FspData->PerfIdx]                  = AsmReadTsc ();
-    ((UINT8 *)(&FspData->PerfData[FspData->PerfIdx]))[7] = Id;
+    FspData->PerfData[FspData->PerfIdx] = PerfData;
+  }
+
+  FspData->PerfIdx++;
+
+  FspPerfLogRecord (Id, FSP_PERF_RECORD_TYPE_OF_ID (Id), TimeStamp);
+  return PerfData;
+}
+
+/**
+  Log a record in the FSP performance log.
+
+  @param[in] Id         Measurement point ID.
+  @param[in] Type       FSP_PERF_RECORD_TYPE_POINT, _BEGIN or _END.
+  @param[in] TimeStamp  Time stamp counter value, or 0 to read the counter.
+
+  @return The time stamp of the record.
+**/
+UINT64
+EFIAPI
+FspPerfLogRecord (
+  IN UINT16  Id,
+  IN UINT8   Type,
+  IN UINT64  TimeStamp
+  )
+{
+  FSP_GLOBAL_DATA  *FspData;
+  FSP_PERF_LOG     *PerfLog;
+  FSP_PERF_RECORD  *Record;
+
+  if (TimeStamp == 0) {
+    TimeStamp = AsmReadTsc () & FSP_PERFORMANCE_DATA_TIMER_MASK;
+  }
+
+  FspData = GetFspGlobalDataPointer ();
+  if (FspData->PerfLogPtr == 0) {
+    return TimeStamp;
+  }
+
+  PerfLog = (FSP_PERF_LOG *)(UINTN)FspData->PerfLogPtr;
+  if ((Type == FSP_PERF_RECORD_TYPE_END) && (PerfLog->Depth > 0)) {
+    PerfLog->Depth--;
+  }
+
+  if (PerfLog->Count < PerfLog->Capacity) {
+    Record            = (FSP_PERF_RECORD *)(PerfLog + 1) + PerfLog->Count;
+    Record->TimeStamp = TimeStamp;
+    Record->Id        = Id;
+    Record->Type      = Type;
+    Record->Depth     = (UINT8)PerfLog->Depth;
+    Record->ApiIdx    = FspData->ApiIdx;
+    Record->Reserved  = 0;
+    Record->Phase     = (UINT16)FspData->PhasesExecuted;
+    PerfLog->Count++;
+  } else {
+    PerfLog->Lost++;
+  }
+
+  if (Type == FSP_PERF_RECORD_TYPE_BEGIN) {
+    PerfLog->Depth++;
   }
 
-  return FspData->PerfData[(FspData->PerfIdx)++];
+  return TimeStamp;
 }
 
 /**
@@ -14,6 +14,8 @@
 #include <Library/SerialPortLib.h>
 #include <Library/DebugDeviceLib.h>
 #include <Library/DebugPrintErrorLevelLib.h>
+#include <Library/FspCommonLib.h>
+#include <Guid/FspDebugLogHob.h>
 
 //
 // Define the maximum debug and assert message length that this library supports
@@ -39,6 +41,284 @@ GetStackFramePointer (
   VOID
   );
 
+//
+// VA_LIST or BASE_LIST argument of a DEBUG () message
+//
+#define DEBUG_LOG_ARG(VaListMarker, BaseListMarker, TYPE) \
+  (((BaseListMarker) == NULL) ? VA_ARG (VaListMarker, TYPE) : BASE_ARG (BaseListMarker, TYPE))
+
+/**
+  Get the deferred debug log, and initialize it if it is not valid.
+
+  The log is at PcdFspDebugLogBufferBase until FspMemoryInitDone2 () migrates
+  it to memory and records its new address in the FSP global data.
+
+  @return The deferred debug log, or NULL if PcdFspDebugLogBufferSize is too small.
+**/
+STATIC
+FSP_DEBUG_LOG_HEADER *
+DebugLogGetHeader (
+  VOID
+  )
+{
+  FSP_DEBUG_LOG_HEADER  *Log;
+  FSP_GLOBAL_DATA       *FspData;
+  UINT32                BufferSize;
+
+  if (PcdGet32 (PcdFspDebugLogBufferSize) < sizeof (FSP_DEBUG_LOG_HEADER) + 2 * FSP_DEBUG_LOG_MAX_RECORD_SIZE) {
+    return NULL;
+  }
+
+  FspData = GetFspGlobalDataPointer ();
+  if ((FspData != NULL) && (FspData->Signature == FSP_GLOBAL_DATA_SIGNATURE) && (FspData->DebugLogPtr != 0)) {
+    Log = (FSP_DEBUG_LOG_HEADER *)(UINTN)FspData->DebugLogPtr;
+  } else {
+    Log = (FSP_DEBUG_LOG_HEADER *)(UINTN)PcdGet32 (PcdFspDebugLogBufferBase);
+  }
+
+  BufferSize = (PcdGet32 (PcdFspDebugLogBufferSize) - sizeof (FSP_DEBUG_LOG_HEADER)) & ~(UINT32)(sizeof (UINT64) - 1);
+
+  if ((Log->Signature != FSP_DEBUG_LOG_SIGNATURE) ||
+      (Log->Version != FSP_DEBUG_LOG_VERSION) ||
+      (Log->BufferSize != BufferSize) ||
+      (Log->Head >= BufferSize) ||
+      (Log->Tail >= BufferSize) ||
+      (Log->UsedSize > BufferSize))
+  {
+    ZeroMem (Log, sizeof (FSP_DEBUG_LOG_HEADER));
+    Log->Signature  = FSP_DEBUG_LOG_SIGNATURE;
+    Log->Version    = FSP_DEBUG_LOG_VERSION;
+    Log->HeaderSize = sizeof (FSP_DEBUG_LOG_HEADER);
+    Log->BufferSize = BufferSize;
+  }
+
+  return Log;
+}
+
+/**
+  Copy the arguments of a DEBUG () message into a deferred debug log record.
+
+  The format string is only scanned for its conversions, nothing is formatted.
+
+  @param  Format          Format string for the debug message.
+  @param  VaListMarker    VA_LIST marker for the variable argument list.
+  @param  BaseListMarker  BASE_LIST marker for the variable argument list.
+  @param  Buffer          The argument area of the record.
+  @param  BufferSize      The size of Buffer, a multiple of 8.
+
+  @return The number of bytes of Buffer used.
+**/
+STATIC
+UINTN
+DebugLogPackArguments (
+  IN  CONST CHAR8  *Format,
+  IN  VA_LIST      VaListMarker,
+  IN  BASE_LIST    BaseListMarker,
+  OUT UINT8        *Buffer,
+  IN  UINTN        BufferSize
+  )
+{
+  UINTN       Used;
+  UINTN       Length;
+  BOOLEAN     Long;
+  CONST VOID  *Pointer;
+  UINT64      Value;
+  UINT32      Count;
+
+  Used = 0;
+  for ( ; *Format != '\0'; Format++) {
+    if (*Format != '%') {
+      continue;
+    }
+
+    //
+    // Flags, width and precision
+    //
+    Long = FALSE;
+    for (Format++; ; Format++) {
+      if ((*Format == 'l') || (*Format == 'L')) {
+        Long = TRUE;
+      } else if (*Format == '*') {
+        if (Used + sizeof (UINT64) > BufferSize) {
+          return Used;
+        }
+
+        Value = DEBUG_LOG_ARG (VaListMarker, BaseListMarker, UINTN);
+        CopyMem (Buffer + Used, &Value, sizeof (UINT64));
+        Used += sizeof (UINT64);
+      } else if ((*Format != '-') && (*Format != '+') && (*Format != ' ') && (*Format != ',') &&
+                 (*Format != '.') && ((*Format < '0') || (*Format > '9')))
+      {
+        break;
+      }
+    }
+
+    Pointer = NULL;
+    Length  = 0;
+    switch (*Format) {
+      case '\0':
+        return Used;
+
+      case 'a':
+        Pointer = DEBUG_LOG_ARG (VaListMarker, BaseListMarker, CONST CHAR8 *);
+        Length  = (Pointer == NULL) ? 0 : AsciiStrnLenS (Pointer, BufferSize);
+        break;
+
+      case 's':
+      case 'S':
+        Pointer = DEBUG_LOG_ARG (VaListMarker, BaseListMarker, CONST CHAR16 *);
+        Length  = (Pointer == NULL) ? 0 : StrnLenS (Pointer, BufferSize / sizeof (CHAR16)) * sizeof (CHAR16);
+        break;
+
+      case 'g':
+      case 't':
+        Pointer = DEBUG_LOG_ARG (VaListMarker, BaseListMarker, CONST VOID *);
+        if (Used + 2 * sizeof (UINT64) > BufferSize) {
+          return Used;
+        }
+
+        if (Pointer == NULL) {
+          ZeroMem (Buffer + Used, 2 * sizeof (UINT64));
+        } else {
+          CopyMem (Buffer + Used, Pointer, 2 * sizeof (UINT64));
+        }
+
+        Used += 2 * sizeof (UINT64);
+        continue;
+
+      case 'c':
+      case 'p':
+      case 'r':
+        Value = DEBUG_LOG_ARG (VaListMarker, BaseListMarker, UINTN);
+        break;
+
+      case 'd':
+      case 'i':
+      case 'u':
+      case 'x':
+      case 'X':
+        if (Long) {
+          Value = DEBUG_LOG_ARG (VaListMarker, BaseListMarker, UINT64);
+        } else {
+          Value = (UINT64)(INT64)DEBUG_LOG_ARG (VaListMarker, BaseListMarker, int);
+        }
+
+        break;
+
+      default:
+        //
+        // %% and the unknown conversions have no argument
+        //
+        continue;
+    }
+
+    if ((*Format == 'a') || (*Format == 's') || (*Format == 'S')) {
+      //
+      // Keep the string in the record, as it may not be in the FSP image.
+      // A NULL string is stored with a count of MAX_UINT32.
+      //
+      if (Used + sizeof (UINT64) > BufferSize) {
+        return Used;
+      }
+
+      Length = MIN (Length, BufferSize - Used - sizeof (UINT32));
+      Count  = (Pointer == NULL) ? MAX_UINT32 : (UINT32)Length;
+      CopyMem (Buffer + Used, &Count, sizeof (UINT32));
+      CopyMem (Buffer + Used + sizeof (UINT32), Pointer, Length);
+      Used += ALIGN_VALUE (sizeof (UINT32) + Length, sizeof (UINT64));
+      continue;
+    }
+
+    if (Used + sizeof (UINT64) > BufferSize) {
+      return Used;
+    }
+
+    CopyMem (Buffer + Used, &Value, sizeof (UINT64));
+    Used += sizeof (UINT64);
+  }
+
+  return Used;
+}
+
+/**
+  Record a DEBUG () message in the deferred debug log.
+
+  @param  Log             The deferred debug log.
+  @param  ErrorLevel      The error level of the debug message.
+  @param  Format          Format string for the debug message.
+  @param  VaListMarker    VA_LIST marker for the variable argument list.
+  @param  BaseListMarker  BASE_LIST marker for the variable argument list.
+**/
+STATIC
+VOID
+DebugLogRecord (
+  IN  FSP_DEBUG_LOG_HEADER  *Log,
+  IN  UINTN                 ErrorLevel,
+  IN  CONST CHAR8           *Format,
+  IN  VA_LIST               VaListMarker,
+  IN  BASE_LIST             BaseListMarker
+  )
+{
+  UINT64                Buffer[FSP_DEBUG_LOG_MAX_RECORD_SIZE / sizeof (UINT64)];
+  FSP_DEBUG_LOG_RECORD  *Record;
+  UINT8                 *Data;
+  UINT32                Size;
+  UINT32                Skip;
+
+  Record               = (FSP_DEBUG_LOG_RECORD *)Buffer;
+  Record->TimeStamp    = AsmReadTsc ();
+  Record->ErrorLevel   = (UINT32)ErrorLevel;
+  Record->Format       = (UINT64)(UINTN)Format;
+  Record->ArgumentSize = (UINT16)DebugLogPackArguments (
+                                   Format,
+                                   VaListMarker,
+                                   BaseListMarker,
+                                   (UINT8 *)(Record + 1),
+                                   sizeof (Buffer) - sizeof (FSP_DEBUG_LOG_RECORD)
+                                   );
+  Record->Size = (UINT16)(sizeof (FSP_DEBUG_LOG_RECORD) + Record->ArgumentSize);
+  Size         = Record->Size;
+
+  //
+  // Skip the end of the buffer if the record does not fit there
+  //
+  Skip = (Log->Tail + Size > Log->BufferSize) ? Log->BufferSize - Log->Tail : 0;
+
+  //
+  // Drop the oldest records until there is room
+  //
+  Data = (UINT8 *)(Log + 1);
+  while (Log->BufferSize - Log->UsedSize < Skip + Size) {
+    if ((Log->BufferSize - Log->Head < sizeof (FSP_DEBUG_LOG_RECORD)) ||
+        (((FSP_DEBUG_LOG_RECORD *)(Data + Log->Head))->Size == 0))
+    {
+      Log->UsedSize -= Log->BufferSize - Log->Head;
+      Log->Head      = 0;
+      continue;
+    }
+
+    Log->UsedSize -= ((FSP_DEBUG_LOG_RECORD *)(Data + Log->Head))->Size;
+    Log->Head     += ((FSP_DEBUG_LOG_RECORD *)(Data + Log->Head))->Size;
+    Log->LostRecords++;
+    if (Log->Head == Log->BufferSize) {
+      Log->Head = 0;
+    }
+  }
+
+  if (Skip != 0) {
+    ((FSP_DEBUG_LOG_RECORD *)(Data + Log->Tail))->Size = 0;
+    Log->UsedSize += Skip;
+    Log->Tail      = 0;
+  }
+
+  CopyMem (Data + Log->Tail, Record, Size);
+  Log->UsedSize += Size;
+  Log->Tail     += Size;
+  if (Log->Tail == Log->BufferSize) {
+    Log->Tail = 0;
+  }
+}
+
 /**
   Prints a debug message to the debug output device if the specified error level is enabled.
 
@@ -94,7 +374,8 @@ DebugPrintMarker (
   IN  BASE_LIST    BaseListMarker
   )
 {
-  CHAR8  Buffer[MAX_DEBUG_MESSAGE_LENGTH];
+  CHAR8                 Buffer[MAX_DEBUG_MESSAGE_LENGTH];
+  FSP_DEBUG_LOG_HEADER  *Log;
 
   //
   // If Format is NULL, then ASSERT().
@@ -115,6 +396,17 @@ DebugPrintMarker (
   //
   ASSERT (Format != NULL);
 
+  //
+  // Record the DEBUG() message in the deferred debug log instead of formatting it
+  //
+  if (PcdGet32 (PcdFspDebugLogBufferSize) != 0) {
+    Log = DebugLogGetHeader ();
+    if (Log != NULL) {
+      DebugLogRecord (Log, ErrorLevel, Format, VaListMarker, BaseListMarker);
+      return;
+    }
+  }
+
   //
   // Convert the DEBUG() message to an ASCII String
   //
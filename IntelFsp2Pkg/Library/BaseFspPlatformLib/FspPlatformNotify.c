@@ -13,9 +13,12 @@
 #include <Library/PcdLib.h>
 #include <Library/DebugLib.h>
 #include <Library/HobLib.h>
+#include <Library/MemoryAllocationLib.h>
 #include <Library/FspSwitchStackLib.h>
 #include <Library/FspCommonLib.h>
 #include <Guid/EventGroup.h>
+#include <Guid/FspPerformanceLogHob.h>
+#include <Guid/FspDebugLogHob.h>
 #include <FspEas.h>
 #include <FspStatusCode.h>
 #include <Protocol/PciEnumerationComplete.h>
@@ -99,6 +102,141 @@ FspNotificationHandler (
   return Status;
 }
 
+/**
+  Convert a time stamp counter value of the FSP performance log to nanoseconds.
+
+  @param[in] PerfLog    The FSP performance log.
+  @param[in] TimeStamp  The time stamp counter value.
+
+  @return The time in nanoseconds, or TimeStamp when the frequency is not known.
+
+**/
+STATIC
+UINT64
+FspPerfLogTimeInNanoSecond (
+  IN FSP_PERF_LOG  *PerfLog,
+  IN UINT64        TimeStamp
+  )
+{
+  UINT64  Seconds;
+  UINT64  Remainder;
+
+  if (PerfLog->TscFrequency == 0) {
+    return TimeStamp;
+  }
+
+  //
+  // Split the conversion in seconds and remainder so that it does not overflow.
+  //
+  Seconds = DivU64x64Remainder (TimeStamp, PerfLog->TscFrequency, &Remainder);
+  return MultU64x32 (Seconds, 1000000000) +
+         DivU64x64Remainder (MultU64x32 (Remainder, 1000000000), PerfLog->TscFrequency, NULL);
+}
+
+/**
+  Publish the records of the FSP performance log in a GUID HOB and empty the
+  log, so it only needs room for the records of one API.
+
+  The records stay in the log when the HOB cannot be built.
+
+**/
+VOID
+FspPerfLogPublish (
+  VOID
+  )
+{
+  FSP_GLOBAL_DATA          *FspData;
+  FSP_PERF_LOG             *PerfLog;
+  FSP_PERF_RECORD          *Record;
+  FSP_PERF_LOG_HOB_HEADER  *HobHeader;
+  FSP_PERF_FPDT_RECORD     *FpdtRecord;
+  UINT32                   ApicId;
+  UINT32                   Index;
+
+  FspData = GetFspGlobalDataPointer ();
+  if (FspData->PerfLogPtr == 0) {
+    return;
+  }
+
+  PerfLog = (FSP_PERF_LOG *)(UINTN)FspData->PerfLogPtr;
+  if ((PerfLog->Count == 0) && (PerfLog->Lost == 0)) {
+    return;
+  }
+
+  HobHeader = BuildGuidHob (
+                &gFspPerformanceLogHobGuid,
+                sizeof (FSP_PERF_LOG_HOB_HEADER) + PerfLog->Count * sizeof (FSP_PERF_FPDT_RECORD)
+                );
+  if (HobHeader == NULL) {
+    return;
+  }
+
+  HobHeader->SizeOfAllEntries = PerfLog->Count * sizeof (FSP_PERF_FPDT_RECORD);
+  HobHeader->LoadImageCount   = 0;
+  HobHeader->HobIsFull        = (PerfLog->Lost != 0);
+
+  //
+  // The FSP runs on the BSP, use its initial APIC ID.
+  //
+  AsmCpuid (1, NULL, &ApicId, NULL, NULL);
+  ApicId = ApicId >> 24;
+
+  Record     = (FSP_PERF_RECORD *)(PerfLog + 1);
+  FpdtRecord = (FSP_PERF_FPDT_RECORD *)(HobHeader + 1);
+  for (Index = 0; Index < PerfLog->Count; Index++, Record++, FpdtRecord++) {
+    FpdtRecord->Type       = FSP_PERF_FPDT_GUID_QWORD_EVENT_TYPE;
+    FpdtRecord->Length     = sizeof (FSP_PERF_FPDT_RECORD);
+    FpdtRecord->Revision   = FSP_PERF_FPDT_RECORD_REVISION;
+    FpdtRecord->ProgressID = Record->Id;
+    FpdtRecord->ApicID     = ApicId;
+    FpdtRecord->Timestamp  = FspPerfLogTimeInNanoSecond (PerfLog, Record->TimeStamp);
+    CopyGuid (&FpdtRecord->Guid, &gFspPerformanceDataGuid);
+    FpdtRecord->Qword = Record->Type | ((UINT32)Record->Depth << 8) | ((UINT32)Record->ApiIdx << 16) |
+                        LShiftU64 (Record->Phase, 32);
+  }
+
+  PerfLog->Count = 0;
+  PerfLog->Lost  = 0;
+}
+
+/**
+  Move the deferred debug log from PcdFspDebugLogBufferBase to memory, as the
+  buffer may be in the temporary RAM torn down by TempRamExit. Later DEBUG ()
+  messages are recorded at the address kept in the FSP global data.
+
+**/
+VOID
+FspDebugLogMigrate (
+  VOID
+  )
+{
+  FSP_GLOBAL_DATA       *FspData;
+  FSP_DEBUG_LOG_HEADER  *Log;
+  VOID                  *NewLog;
+
+  FspData = GetFspGlobalDataPointer ();
+  if ((PcdGet32 (PcdFspDebugLogBufferSize) == 0) || (FspData->DebugLogPtr != 0)) {
+    return;
+  }
+
+  NewLog = AllocatePages (EFI_SIZE_TO_PAGES ((UINTN)PcdGet32 (PcdFspDebugLogBufferSize)));
+  if (NewLog == NULL) {
+    return;
+  }
+
+  //
+  // An invalid log is initialized again at the new address by the next DEBUG ().
+  //
+  Log = (FSP_DEBUG_LOG_HEADER *)(UINTN)PcdGet32 (PcdFspDebugLogBufferBase);
+  if (Log->Signature == FSP_DEBUG_LOG_SIGNATURE) {
+    CopyMem (NewLog, Log, PcdGet32 (PcdFspDebugLogBufferSize));
+  } else {
+    ZeroMem (NewLog, PcdGet32 (PcdFspDebugLogBufferSize));
+  }
+
+  FspData->DebugLogPtr = (UINTN)NewLog;
+}
+
 /**
   This function transfer control back to BootLoader after FspSiliconInit.
 
@@ -134,6 +272,7 @@ FspSiliconInitDone2 (
   // Give control back to the boot loader
   //
   SetFspMeasurePoint (FSP_PERF_ID_API_FSP_SILICON_INIT_EXIT);
+  FspPerfLogPublish ();
   DEBUG ((DEBUG_INFO | DEBUG_INIT, "FspSiliconInitApi() - [Status: 0x%08X] - End\n", Status));
   PERF_END_EX (&gFspPerformanceDataGuid, "EventRec", NULL, 0, FSP_STATUS_CODE_SILICON_INIT | FSP_STATUS_CODE_COMMON_CODE | FSP_STATUS_CODE_API_EXIT);
   REPORT_STATUS_CODE (EFI_PROGRESS_CODE, FSP_STATUS_CODE_COMMON_CODE | FSP_STATUS_CODE_API_EXIT);
@@ -199,6 +338,8 @@ FspMemoryInitDone2 (
   //
   DEBUG ((DEBUG_INFO | DEBUG_INIT, "FspMemoryInitApi() - [Status: 0x%08X] - End\n", Status));
   SetFspMeasurePoint (FSP_PERF_ID_API_FSP_MEMORY_INIT_EXIT);
+  FspPerfLogPublish ();
+  FspDebugLogMigrate ();
   FspData = GetFspGlobalDataPointer ();
   PERF_START_EX (&gFspPerformanceDataGuid, "EventRec", NULL, (FspData->PerfData[0] & FSP_PERFORMANCE_DATA_TIMER_MASK), FSP_STATUS_CODE_TEMP_RAM_INIT | FSP_STATUS_CODE_COMMON_CODE| FSP_STATUS_CODE_API_ENTRY);
   PERF_END_EX (&gFspPerformanceDataGuid, "EventRec", NULL, (FspData->PerfData[1] & FSP_PERFORMANCE_DATA_TIMER_MASK), FSP_STATUS_CODE_TEMP_RAM_INIT | FSP_STATUS_CODE_COMMON_CODE | FSP_STATUS_CODE_API_EXIT);
@@ -269,6 +410,7 @@ FspTempRamExitDone2 (
   //
   DEBUG ((DEBUG_INFO | DEBUG_INIT, "TempRamExitApi() - [Status: 0x%08X] - End\n", Status));
   SetFspMeasurePoint (FSP_PERF_ID_API_TEMP_RAM_EXIT_EXIT);
+  FspPerfLogPublish ();
   PERF_END_EX (&gFspPerformanceDataGuid, "EventRec", NULL, 0, FSP_STATUS_CODE_TEMP_RAM_EXIT | FSP_STATUS_CODE_COMMON_CODE | FSP_STATUS_CODE_API_EXIT);
   REPORT_STATUS_CODE (EFI_PROGRESS_CODE, FSP_STATUS_CODE_TEMP_RAM_EXIT | FSP_STATUS_CODE_COMMON_CODE | FSP_STATUS_CODE_API_EXIT);
   if (GetFspGlobalDataPointer ()->FspMode == FSP_IN_API_MODE) {
@@ -345,6 +487,7 @@ FspWaitForNotify (
 
     DEBUG ((DEBUG_INFO | DEBUG_INIT, "NotifyPhaseApi() - End  [Status: 0x%08X]\n", Status));
     SetFspMeasurePoint (FSP_PERF_ID_API_NOTIFY_POST_PCI_EXIT + Count);
+    FspPerfLogPublish ();
 
     if ((NotificationCount - 1) == 0) {
       PERF_END_EX (&gFspPerformanceDataGuid, "EventRec", NULL, 0, FSP_STATUS_CODE_POST_PCIE_ENUM_NOTIFICATION | FSP_STATUS_CODE_COMMON_CODE | FSP_STATUS_CODE_API_EXIT);
@@ -0,0 +1,237 @@
+## @file
+#  Compiler of the logical expressions of the DSC files, shared by GenCfgOpt.py
+#  and FspGenCfgData.py.
+#
+#  An expression of the DSC file is compiled once, before its macros and PCDs
+#  are expanded, into a tree of closures keyed by its text with the spaces
+#  normalized. The macros and PCDs are bound when it is evaluated. When the
+#  textual expansion could parse differently from the bound values, or when
+#  the expression has an error, evaluateExpress() runs on the expanded text
+#  instead, so results and error reports stay the same.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import re
+
+
+#
+# Base class of the CLogicalExpression parsers of the tools. The parsing
+# helpers and evaluateExpress() come from the derived class.
+#
+class CCompiledExpression:
+    CompiledCache = {}
+
+    class CompileError(Exception):
+        pass
+
+    def getSimpleValue(self, Value):
+        Match = re.match('^[ \t]*(\\w+)[ \t]*$', Value)
+        if Match is None or Match.group(1) == 'NOT':
+            raise CCompiledExpression.CompileError
+        Value = Match.group(1)
+        Number = self.getNumber(Value)
+        if Number is None:
+            return Value
+        return "%d" % Number
+
+    def getDigits(self, Value):
+        if not Value.isdigit():
+            raise CCompiledExpression.CompileError
+        return int(Value)
+
+    def compileValue(self):
+        self.skipSpace()
+        Match = re.match('\\$\\((\\w+)\\)', self.getCurr(-1))
+        if Match:
+            End = self.index + len(Match.group(0))
+            Prev = self.string[self.index - 1] if self.index > 0 else ' '
+            Next = self.string[End: End + 1] or ' '
+            if Prev not in ' \t(=!<>' or Next not in ' \t)=!<>':
+                raise CCompiledExpression.CompileError
+            self.moveNext(len(Match.group(0)))
+            Name = Match.group(1)
+            return lambda Bind: Bind(Name, True)
+        var = ''
+        while not self.isLast():
+            char = self.getCurr()
+            if re.match('^[\\w.]', char):
+                var += char
+                self.moveNext()
+            else:
+                break
+        if re.match('^\\w+\\.\\w+$', var):
+            self.PcdNames.add(var)
+            return lambda Bind: Bind(var, False)
+        if re.search('\\w\\.\\w', var):
+            raise CCompiledExpression.CompileError
+        val = self.getNumber(var)
+        if val is None:
+            value = var
+        else:
+            value = "%d" % val
+        return lambda Bind: value
+
+    def compileSingleOp(self):
+        self.skipSpace()
+        if re.match('^NOT\\W', self.getCurr(-1)):
+            self.moveNext(3)
+            Op = self.compileBrace()
+
+            def Not(Bind):
+                return "%d" % (not self.normNumber(self.getDigits(Op(Bind))))
+            return Not
+        else:
+            return self.compileValue()
+
+    def compileBrace(self):
+        self.skipSpace()
+        char = self.getCurr()
+        if char == '(':
+            self.moveNext()
+            value = self.compileExpr()
+            self.skipSpace()
+            if self.getCurr() != ')':
+                raise CCompiledExpression.CompileError
+            self.moveNext()
+            return value
+        else:
+            return self.compileSingleOp()
+
+    def compileCompare(self):
+        value = self.compileBrace()
+        while True:
+            self.skipSpace()
+            char = self.getCurr()
+            if char in ['<', '>']:
+                self.moveNext()
+                next = self.getCurr()
+                if next == '=':
+                    op = char + next
+                    self.moveNext()
+                else:
+                    op = char
+                Compare = {'<': lambda a, b: a < b,
+                           '>': lambda a, b: a > b,
+                           '<=': lambda a, b: a <= b,
+                           '>=': lambda a, b: a >= b}[op]
+
+                def Order(Bind, Left=value, Right=self.compileBrace(),
+                          Compare=Compare):
+                    Value = self.getDigits(Left(Bind))
+                    Result = self.getDigits(Right(Bind))
+                    return "%d" % self.normNumber(Compare(Value, Result))
+                value = Order
+            elif char in ['=', '!']:
+                op = self.getCurr(2)
+                if op in ['==', '!=']:
+                    self.moveNext(2)
+
+                    def Equal(Bind, Left=value, Right=self.compileBrace(),
+                              Same=(op == '==')):
+                        Value = Left(Bind)
+                        Result = Right(Bind)
+                        if self.getNonNumber(Result, Value) is None:
+                            Value = int(Value)
+                            Result = int(Result)
+                        return "%d" % self.normNumber((Value == Result) ==
+                                                      Same)
+                    value = Equal
+                else:
+                    break
+            else:
+                break
+        return value
+
+    def compileAnd(self):
+        value = self.compileCompare()
+        while True:
+            self.skipSpace()
+            if re.match('^AND\\W', self.getCurr(-1)):
+                self.moveNext(3)
+
+                def And(Bind, Left=value, Right=self.compileCompare()):
+                    Value = self.getDigits(Left(Bind))
+                    Result = self.getDigits(Right(Bind))
+                    return "%d" % self.normNumber(Value & Result)
+                value = And
+            else:
+                break
+        return value
+
+    def compileOrXor(self):
+        value = self.compileAnd()
+        while True:
+            self.skipSpace()
+            if re.match('^XOR\\W', self.getCurr(-1)):
+                self.moveNext(3)
+                Xor = True
+            elif re.match('^OR\\W', self.getCurr(-1)):
+                self.moveNext(2)
+                Xor = False
+            else:
+                break
+
+            def OrXor(Bind, Left=value, Right=self.compileAnd(), Xor=Xor):
+                Value = self.getDigits(Left(Bind))
+                Result = self.getDigits(Right(Bind))
+                return "%d" % self.normNumber(Value ^ Result if Xor else
+                                              Value | Result)
+            value = OrXor
+        return value
+
+    def compileExpr(self):
+        return self.compileOrXor()
+
+    def compileExpress(self, Expr):
+        self.index = 0
+        self.string = Expr
+        self.PcdNames = set()
+        try:
+            Program = self.compileExpr()
+            self.skipSpace()
+            if not self.isLast():
+                return None
+        except (CCompiledExpression.CompileError, IndexError):
+            return None
+        #
+        # ExpandPcds() replaces every occurrence of a PCD name, a name must
+        # not be a part of another one
+        #
+        for Name in self.PcdNames:
+            for Other in self.PcdNames:
+                if Name != Other and Name in Other:
+                    return None
+
+        def Result(Bind):
+            Value = Program(Bind)
+            if self.getNumber(Value) is None:
+                raise CCompiledExpression.CompileError
+            return int(Value)
+        return Result
+
+    def evaluateCompiled(self, Expr, MacroDict, PcdsDict, Expand):
+        Key = re.sub('[ \t]+', ' ', Expr).lstrip(' ')
+        if Key in CCompiledExpression.CompiledCache:
+            Program = CCompiledExpression.CompiledCache[Key]
+        else:
+            Program = type(self)().compileExpress(Key)
+            CCompiledExpression.CompiledCache[Key] = Program
+        if Program is not None:
+            #
+            # An undefined macro expands to its name, an undefined PCD is kept
+            #
+            def Bind(Name, IsMacro):
+                if IsMacro:
+                    return self.getSimpleValue(MacroDict.get(Name, Name))
+                if Name in PcdsDict:
+                    return self.getSimpleValue(PcdsDict[Name])
+                return Name
+            try:
+                return True if Program(Bind) else False
+            except (CCompiledExpression.CompileError, ValueError):
+                pass
+        return self.evaluateExpress(Expand(Expr))
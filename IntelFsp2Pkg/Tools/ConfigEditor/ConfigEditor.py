@@ -1220,7 +1220,8 @@ class application(tkinter.Frame):
                 gen_cfg_data.__dict__ = marshal.load(pkl_file)
             gen_cfg_data.prepare_marshal(False)
         elif file_name.endswith('.yaml'):
-            if gen_cfg_data.load_yaml(file_name) != 0:
+            cache_file = gen_cfg_data.get_cache_file(file_name)
+            if gen_cfg_data.load_yaml(file_name, cache_file) != 0:
                 raise Exception(gen_cfg_data.get_last_error())
         else:
             raise Exception('Unsupported file "%s" !' % file_name)
@@ -8,6 +8,7 @@
 import os
 import sys
 import re
+import hashlib
 import marshal
 import string
 import operator as op
@@ -18,7 +19,7 @@ import tkinter
 from datetime import date
 from collections import OrderedDict
 from CommonUtility import value_to_bytearray, value_to_bytes, \
-      bytes_to_value, get_bits_from_bytes, set_bits_to_bytes
+      bytes_to_value
 
 # Generated file copyright header
 __copyright_tmp__ = """/** @file
@@ -107,7 +108,7 @@ def read_lines(file):
     return lines
 
 
-def expand_file_value(path, value_str):
+def expand_file_value(path, value_str, dep_files=None):
     result = bytearray()
     match = re.match("\\{\\s*FILE:(.+)\\}", value_str)
     if match:
@@ -115,6 +116,8 @@ def expand_file_value(path, value_str):
         for file in file_list:
             file = file.strip()
             bin_path = os.path.join(path, file)
+            if dep_files is not None:
+                dep_files.append(bin_path)
             result.extend(bytearray(open(bin_path, 'rb').read()))
             print('\n\n result ', result)
     return result
@@ -237,6 +240,7 @@ class CFG_YAML():
         self.yaml_path = ''
         self.lines = []
         self.full_lines = []
+        self.dep_files = []
         self.index = 0
         self.re_expand = re.compile(
             r'(.+:\s+|\s*\-\s*)!expand\s+\{\s*(\w+_TMPL)\s*:\s*\[(.+)]\s*\}')
@@ -283,9 +287,12 @@ class CFG_YAML():
             try_path = os.path.join(os.path.dirname(os.path.realpath(__file__)
                                                     ), "../..", include)
             if os.path.exists(try_path):
+                # the first path is a dependency too, it must stay missing
+                self.dep_files.append(inc_path)
                 inc_path = try_path
             else:
                 raise Exception("ERROR: Cannot open file '%s'." % inc_path)
+        self.dep_files.append(inc_path)
 
         lines = read_lines(inc_path)
         current = 0
@@ -579,6 +586,14 @@ class CGenYamlCfg:
     include_tag = ['GPIO_CFG_DATA']
     keyword_set = set(['name', 'type', 'option', 'help', 'length',
                        'value', 'order', 'struct', 'condition'])
+    # state built by load_yaml(), saved in the YAML cache file
+    cache_keys = ['_old_bin', '_cfg_tree', '_tmp_tree', '_cfg_list',
+                  '_cfg_page', '_cur_page', '_var_dict', '_def_dict']
+    cache_version = 2
+    # files read while loading a YAML file, None when not loading
+    _dep_files = None
+    # flat index of the config tree, built on first use
+    _cfg_index = None
 
     def __init__(self):
         self._mode = ''
@@ -597,6 +612,7 @@ class CGenYamlCfg:
         self._var_dict = {}
         self._def_dict = {}
         self._yaml_path = ''
+        self._cfg_index = None
 
     @staticmethod
     def deep_convert_dict(layer):
@@ -765,6 +781,9 @@ class CGenYamlCfg:
             return self._cfg_list
         else:
             # build a new list for items under a page ID
+            page_index = self.get_cfg_index()['page']
+            if page_id in page_index:
+                return list(page_index[page_id])
             cfgs = [i for i in self._cfg_list if i['cname'] and
                     (i['page'] == page_id)]
             return cfgs
@@ -853,7 +872,8 @@ class CGenYamlCfg:
         elif (',' in value_str) and (value_str[0] != '{'):
             value_str = '{ %s }' % value_str
         if value_str[0] == '{':
-            result = expand_file_value(self._yaml_path, value_str)
+            result = expand_file_value(self._yaml_path, value_str,
+                                       self._dep_files)
             if len(result) == 0:
                 bin_list = value_str[1:-1].split(',')
                 value = 0
@@ -981,7 +1001,77 @@ option format '%s' !" % option)
         else:
             return None
 
+    def get_item_by_offset(self, offset):
+        # the config item with a length starting at this bit offset
+        indx = self.get_cfg_index()['offset'].get(offset)
+        if indx is None:
+            return None
+        return self.get_item_by_index(indx)
+
+    def build_cfg_index(self):
+        # Flatten the config tree once into
+        #   path   : full dotted path -> tree node
+        #   node   : id of a tree node -> (path, indexes of the items in it)
+        #   offset : bit offset -> index of the item starting there
+        #   page   : page ID -> items of the page
+        # The items are the dictionaries of _cfg_list, so the values set
+        # later are seen through the index without updating it.
+        def _build_cfg_index(root, path):
+            items = []
+            for key in root:
+                node = root[key]
+                if type(node) is not OrderedDict:
+                    continue
+                node_path = path + '.' + key if path else key
+                path_index[node_path] = node
+                node_items = _build_cfg_index(node, node_path)
+                node_index[id(node)] = (node_path, node_items)
+                if 'indx' in node:
+                    items.append(node['indx'])
+                items.extend(node_items)
+            return items
+
+        path_index = {}
+        node_index = {}
+        node_index[id(self._cfg_tree)] = ('', _build_cfg_index(
+                                          self._cfg_tree, ''))
+        offset_index = {}
+        page_index = {}
+        for indx, item in enumerate(self._cfg_list):
+            if item['length'] > 0:
+                offset_index.setdefault(item['offset'], indx)
+            if item['cname']:
+                page_index.setdefault(item['page'], []).append(item)
+        self._cfg_index = {'tree': self._cfg_tree, 'path': path_index,
+                           'node': node_index, 'offset': offset_index,
+                           'page': page_index}
+        return self._cfg_index
+
+    def get_cfg_index(self):
+        # rebuild the index when the tree is replaced, like by a new load
+        if self._cfg_index is None or \
+           self._cfg_index['tree'] is not self._cfg_tree:
+            return self.build_cfg_index()
+        return self._cfg_index
+
+    def get_cfg_item_list(self, top):
+        # indexes of the config items under a tree node, in tree order
+        node = self.get_cfg_index()['node'].get(id(top))
+        if node is not None:
+            return node[1]
+        items = []
+
+        def _get_cfg_item_list(name, cfgs, level):
+            if 'indx' in cfgs:
+                items.append(cfgs['indx'])
+        self.traverse_cfg_tree(_get_cfg_item_list, top)
+        return items
+
     def locate_cfg_path(self, item):
+        node = self.get_cfg_index()['node'].get(id(item))
+        if node is not None:
+            return node[0].split('.') if node[0] else []
+
         def _locate_cfg_path(root, level=0):
             # config structure
             if item is root:
@@ -999,6 +1089,10 @@ option format '%s' !" % option)
         return _locate_cfg_path(self._cfg_tree)
 
     def locate_cfg_item(self, path, allow_exp=True):
+        node = self.get_cfg_index()['path'].get(path)
+        if node is not None:
+            return node
+
         def _locate_cfg_item(root, path, level=0):
             if len(path) == level:
                 return root
@@ -1288,24 +1382,75 @@ option format '%s' !" % option)
                 raise SystemExit("Error: Bits length not aligned for %s !" %
                                  str(path))
 
-    def get_field_value(self, top=None):
-        def _get_field_value(name, cfgs, level):
-            if 'indx' in cfgs:
-                act_cfg = self.get_item_by_index(cfgs['indx'])
-                if act_cfg['length'] == 0:
-                    return
-                value = self.get_value(act_cfg['value'], act_cfg['length'],
-                                       False)
-                set_bits_to_bytes(result, act_cfg['offset'] -
-                                  struct_info['offset'], act_cfg['length'],
-                                  value)
+        if top is self._cfg_tree:
+            # the tree has new nodes, index it again on first use
+            self._cfg_index = None
+
+    def get_struct_layout(self, top):
+        # Plan once how the items of a structure map to its bytes, as runs
+        # of whole bytes in offset order. A run is either a byte aligned
+        # item, bit fields sharing the same bytes, or a gap of zeros, and
+        # is a tuple (byte start, byte end, ((indx, bit shift, mask), ...)).
+        layouts = self.get_cfg_index().setdefault('layout', {})
+        layout = layouts.get(id(top))
+        if layout is not None:
+            return layout
 
+        struct_info = top[CGenYamlCfg.STRUCT]
+        items = [(self.get_item_by_index(indx), indx) for indx in
+                 self.get_cfg_item_list(top)]
+        items.sort(key=lambda each: each[0]['offset'])
+        runs = []
+        end = 0
+        for act_cfg, indx in items:
+            length = act_cfg['length']
+            if length == 0:
+                continue
+            start = act_cfg['offset'] - struct_info['offset']
+            field = [indx, start, (1 << length) - 1]
+            if runs and start // 8 < runs[-1][1]:
+                # shares a byte with the previous bit field
+                run = runs[-1]
+            else:
+                if start // 8 > end:
+                    runs.append([end, start // 8, []])
+                run = [start // 8, 0, []]
+                runs.append(run)
+            field[1] -= run[0] * 8
+            run[1] = max(run[1], (start + length + 7) // 8)
+            run[2].append(tuple(field))
+            end = run[1]
+        length = (struct_info['length'] + 7) // 8
+        if length > end:
+            runs.append([end, length, []])
+
+        layout = tuple((run[0], run[1], tuple(run[2])) for run in runs)
+        layouts[id(top)] = layout
+        return layout
+
+    def get_field_value(self, top=None):
         if top is None:
             top = self._cfg_tree
-        struct_info = top[CGenYamlCfg.STRUCT]
-        result = bytearray((struct_info['length'] + 7) // 8)
-        self.traverse_cfg_tree(_get_field_value, top)
-        return result
+        parts = []
+        for start, end, fields in self.get_struct_layout(top):
+            value = 0
+            for indx, shift, mask in fields:
+                act_cfg = self.get_item_by_index(indx)
+                value |= (self.get_value(act_cfg['value'], act_cfg['length'],
+                                         False) & mask) << shift
+            parts.append(value.to_bytes(end - start, 'little'))
+        return bytearray(b''.join(parts))
+
+    def get_field_values(self, top, value_bytes):
+        # unpack the values of all items of a structure from its bytes
+        values = {}
+        for start, end, fields in self.get_struct_layout(top):
+            if not fields:
+                continue
+            run_value = bytes_to_value(value_bytes[start:end])
+            for indx, shift, mask in fields:
+                values[indx] = (run_value >> shift) & mask
+        return values
 
     data_diff = ''
 
@@ -1380,25 +1525,6 @@ option format '%s' !" % option)
                             + ': ' + config_val + '\n'
 
     def set_field_value(self, top, value_bytes, force=False):
-        def _set_field_value(name, cfgs, level):
-            if 'indx' not in cfgs:
-                return
-            act_cfg = self.get_item_by_index(cfgs['indx'])
-            actual_offset = act_cfg['offset'] - struct_info['offset']
-            if force or act_cfg['value'] == '':
-                value = get_bits_from_bytes(full_bytes,
-                                            actual_offset,
-                                            act_cfg['length'])
-                act_val = act_cfg['value']
-                if act_val == '':
-                    act_val = '%d' % value
-                act_val = self.reformat_number_per_type(act_cfg
-                                                        ['type'],
-                                                        act_val)
-                act_cfg['value'] = self.format_value_to_str(
-                    value, act_cfg['length'], act_val)
-                self.find_data_difference(act_val, act_cfg)
-
         if 'indx' in top:
             # it is config option
             value = bytes_to_value(value_bytes)
@@ -1412,7 +1538,20 @@ option format '%s' !" % option)
             full_bytes = bytearray(value_bytes[:length])
             if len(full_bytes) < length:
                 full_bytes.extend(bytearray(length - len(value_bytes)))
-            self.traverse_cfg_tree(_set_field_value, top)
+            values = self.get_field_values(top, full_bytes)
+            for indx in self.get_cfg_item_list(top):
+                act_cfg = self.get_item_by_index(indx)
+                if force or act_cfg['value'] == '':
+                    value = values.get(indx, 0)
+                    act_val = act_cfg['value']
+                    if act_val == '':
+                        act_val = '%d' % value
+                    act_val = self.reformat_number_per_type(act_cfg
+                                                            ['type'],
+                                                            act_val)
+                    act_cfg['value'] = self.format_value_to_str(
+                        value, act_cfg['length'], act_val)
+                    self.find_data_difference(act_val, act_cfg)
 
     def update_def_value(self):
         def _update_def_value(name, cfgs, level):
@@ -1455,6 +1594,11 @@ for '%s' !" % (act_cfg['value'], act_cfg['path']))
         return fsp
 
     def get_cfg_segment(self):
+        # the segments only depend on the tree, find them once per index
+        cfg_index = self.get_cfg_index()
+        if 'segment' in cfg_index:
+            return list(cfg_index['segment'])
+
         def _get_cfg_segment(name, cfgs, level):
             if 'indx' not in cfgs:
                 if name.startswith('$ACTION_'):
@@ -1480,7 +1624,8 @@ for '%s' !" % (act_cfg['value'], act_cfg['path']))
             cfg_segs.append((each[0], each[1],
                              segments[idx+1][1] - each[1]))
 
-        return cfg_segs
+        cfg_index['segment'] = cfg_segs
+        return list(cfg_segs)
 
     def get_bin_segment(self, bin_data):
         cfg_segs = self.get_cfg_segment()
@@ -1674,13 +1819,13 @@ for '%s' !" % (act_cfg['value'], act_cfg['path']))
         platform_id = None
         def_platform_id = 0
 
-        for item in self._cfg_list:
+        old_vals = self.get_field_values(self._cfg_tree, old_data)
+        new_vals = self.get_field_values(self._cfg_tree, new_data)
+        for indx, item in enumerate(self._cfg_list):
             if not full and (item['type'] in ['Reserved']):
                 continue
-            old_val = get_bits_from_bytes(old_data, item['offset'],
-                                          item['length'])
-            new_val = get_bits_from_bytes(new_data, item['offset'],
-                                          item['length'])
+            old_val = old_vals.get(indx, 0)
+            new_val = new_vals.get(indx, 0)
 
             full_name = item['path']
             if 'PLATFORMID_CFG_DATA.PlatformId' == full_name:
@@ -1724,6 +1869,8 @@ for '%s' !" % (act_cfg['value'], act_cfg['path']))
                                                  old_data, new_data, full)
 
     def prepare_marshal(self, is_save):
+        # the index refers to the tree, it is rebuilt on first use
+        self._cfg_index = None
         if is_save:
             # Ordered dict is not marshallable, convert to list
             self._cfg_tree = CGenYamlCfg.deep_convert_dict(self._cfg_tree)
@@ -2191,15 +2338,96 @@ xbe\x8f\x64\x12\x05\x8d\x0a\xa8'
 
         return 0
 
-    def load_yaml(self, cfg_file):
-        cfg_yaml = CFG_YAML()
+    @staticmethod
+    def get_cache_file(cfg_file):
+        # per user cache file of a YAML file, named after its full path
+        cache_dir = os.path.join(os.path.expanduser('~'), '.cache',
+                                 'ConfigEditor')
+        name = hashlib.sha1(os.path.abspath(cfg_file).encode()).hexdigest()
+        return os.path.join(cache_dir, name + '.cache')
+
+    @staticmethod
+    def hash_dep_files(dep_files):
+        # content hash of each file, None for a file that must not exist
+        dep_list = []
+        for dep_file in dep_files:
+            if os.path.exists(dep_file):
+                fd = open(dep_file, 'rb')
+                dep_hash = hashlib.sha1(fd.read()).hexdigest()
+                fd.close()
+            else:
+                dep_hash = None
+            dep_list.append((os.path.abspath(dep_file), dep_hash))
+        return dep_list
+
+    def load_yaml_cache(self, cfg_file, cache_file):
+        try:
+            with open(cache_file, "rb") as fd:
+                cache = marshal.loads(fd.read())
+            if cache['version'] != CGenYamlCfg.cache_version or \
+               cache['root'] != os.path.abspath(cfg_file):
+                return False
+            dep_files = [dep[0] for dep in cache['deps']]
+            if CGenYamlCfg.hash_dep_files(dep_files) != \
+               [tuple(dep) for dep in cache['deps']]:
+                return False
+            cfg_data = cache['data']
+            if set(cfg_data) != set(CGenYamlCfg.cache_keys):
+                return False
+        except Exception:
+            # a missing or broken cache is rebuilt from the YAML files
+            return False
+
         self.initialize()
-        self._cfg_tree = cfg_yaml.load_yaml(cfg_file)
-        self._def_dict = cfg_yaml.def_dict
+        self.__dict__.update(cfg_data)
         self._yaml_path = os.path.dirname(cfg_file)
-        self.build_cfg_list()
-        self.build_var_dict()
-        self.update_def_value()
+        self.prepare_marshal(False)
+        return True
+
+    def save_yaml_cache(self, cfg_file, cache_file, dep_files):
+        cfg_data = {}
+        for key in CGenYamlCfg.cache_keys:
+            cfg_data[key] = self.__dict__[key]
+        cfg_data['_cfg_tree'] = CGenYamlCfg.deep_convert_dict(self._cfg_tree)
+        cache = {'version': CGenYamlCfg.cache_version,
+                 'root': os.path.abspath(cfg_file),
+                 'deps': CGenYamlCfg.hash_dep_files(dep_files),
+                 'data': cfg_data}
+        try:
+            cache_dir = os.path.dirname(cache_file)
+            if cache_dir and not os.path.exists(cache_dir):
+                os.makedirs(cache_dir)
+            with open(cache_file, "wb") as fd:
+                fd.write(marshal.dumps(cache))
+        except Exception:
+            # the cache only saves time, go on without it
+            pass
+
+    def load_yaml(self, cfg_file, cache_file=''):
+        # the processed tree and config list are reused from the cache file
+        # as long as this tool, the YAML file and every file it includes are
+        # unchanged
+        if cache_file and os.path.exists(cfg_file) and \
+           self.load_yaml_cache(cfg_file, cache_file):
+            return 0
+
+        cfg_yaml = CFG_YAML()
+        self.initialize()
+        self._dep_files = [cfg_file]
+        try:
+            self._cfg_tree = cfg_yaml.load_yaml(cfg_file)
+            self._def_dict = cfg_yaml.def_dict
+            self._yaml_path = os.path.dirname(cfg_file)
+            self.build_cfg_list()
+            self.build_var_dict()
+            self.update_def_value()
+            dep_files = [os.path.realpath(__file__)] + self._dep_files + \
+                cfg_yaml.dep_files
+        finally:
+            del self._dep_files
+
+        if cache_file and os.path.exists(cfg_file):
+            self.save_yaml_cache(cfg_file, cache_file, dep_files)
         return 0
 
 
@@ -2219,7 +2447,10 @@ def usage():
           "    GenYamlCfg  GENYML  YamlFile             YamlOutFile"
           "  [-D Macros]",
           "    GenYamlCfg  GENHDR  YamlFile             HdrOutFile "
-          "  [-D Macros]"
+          "  [-D Macros]",
+          "",
+          "    -D YAML_CACHE[=CacheFile] reuses the YAML file parsed by a "
+          "previous run"
           ]))
 
 
@@ -2292,7 +2523,12 @@ def main():
         if argc >= 5:
             gen_cfg_data.parse_macros(sys.argv[4:])
     else:
-        gen_cfg_data.load_yaml(yml_file)
+        cache_file = ''
+        if 'YAML_CACHE' in gen_cfg_data._macro_dict:
+            cache_file = gen_cfg_data._macro_dict['YAML_CACHE']
+            if cache_file == '':
+                cache_file = gen_cfg_data.get_cache_file(yml_file)
+        gen_cfg_data.load_yaml(yml_file, cache_file)
         if command == 'GENPKL':
             gen_cfg_data.prepare_marshal(True)
             with open(out_file, "wb") as pkl_file:
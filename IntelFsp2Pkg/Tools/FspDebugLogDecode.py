@@ -0,0 +1,317 @@
+## @ FspDebugLogDecode.py
+#
+# Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+# SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import os
+import re
+import sys
+import struct
+import argparse
+
+from SplitFspBin import FirmwareDevice
+
+"""
+This utility decodes the deferred debug log of an FSP built with a non-zero
+PcdFspDebugLogBufferSize. BaseFspDebugLibSerialPort then records the address of
+the format string and the raw arguments of each DEBUG () message; the messages
+are formatted here, with the format strings read from the FSP binary.
+
+The log is a memory dump starting anywhere before the FSP_DEBUG_LOG_HEADER,
+for example the copy pointed to by the gFspDebugLogHobGuid HOB. An FV map file
+of the FSP build can be given to name the module of the messages whose format
+string is not in the binary.
+"""
+
+FSP_DEBUG_LOG_SIGNATURE = b'FDLG'
+FSP_DEBUG_LOG_VERSION   = 1
+FSP_DEBUG_LOG_HEADER    = struct.Struct('<4sHHIIIIII')
+FSP_DEBUG_LOG_RECORD    = struct.Struct('<HHIQQ')
+
+StatusStrings = [
+    'Success',              'Warning Unknown Glyph', 'Warning Delete Failure', 'Warning Write Failure',
+    'Warning Buffer Too Small', 'Warning Stale Data', 'Warning File System',   'Warning Reset Required'
+    ]
+
+ErrorStrings = [
+    'Load Error',           'Invalid Parameter',     'Unsupported',            'Bad Buffer Size',
+    'Buffer Too Small',     'Not Ready',             'Device Error',           'Write Protected',
+    'Out of Resources',     'Volume Corrupt',        'Volume Full',            'No Media',
+    'Media changed',        'Not Found',             'Access Denied',          'No Response',
+    'No mapping',           'Time out',              'Not started',            'Already started',
+    'Aborted',              'ICMP Error',            'TFTP Error',             'Protocol Error',
+    'Incompatible Version', 'Security Violation',    'CRC Error',              'End of Media',
+    'Reserved (29)',        'Reserved (30)',         'End of File',            'Invalid Language',
+    'Compromised Data',     'IP Address Conflict',   'HTTP Error'
+    ]
+
+class FormatSource:
+    def __init__(self, FspBinary, ImageBase = None, MapFile = None):
+        self.Data    = bytearray()
+        self.Images  = []
+        self.Modules = []
+        if FspBinary:
+            self.LoadBinary (FspBinary, ImageBase)
+        if MapFile:
+            self.LoadMap (MapFile)
+
+    def LoadBinary(self, FspBinary, ImageBase):
+        if ImageBase is not None:
+            with open(FspBinary, 'rb') as File:
+                self.Data = bytearray(File.read())
+            self.Images.append ((ImageBase, len(self.Data), 0))
+            return
+
+        Fd = FirmwareDevice(0, FspBinary)
+        Fd.ParseFd  ()
+        Fd.ParseFsp ()
+        if len(Fd.FspList) == 0:
+            raise Exception ("ERROR: No FSP component found in '%s', use --base for a raw binary !" % FspBinary)
+        self.Data = Fd.FdData
+        for Fsp in Fd.FspList:
+            self.Images.append ((Fsp.Fih.ImageBase, Fsp.Fih.ImageSize, Fsp.Offset))
+
+    def LoadMap(self, MapFile):
+        with open(MapFile, 'r') as File:
+            for Line in File:
+                #DxeIpl (Fixed Flash Address, BaseAddress=0x00fffb4310, EntryPoint=0x00fffb4958,Type=PE)
+                Match = re.match(r"([_a-zA-Z0-9\-]+)\s\(.+BaseAddress=(0x[0-9a-fA-F]+),", Line)
+                if Match:
+                    self.Modules.append ((int(Match.group(2), 16), Match.group(1)))
+        self.Modules.sort ()
+
+    def GetString(self, Address):
+        for Base, Size, Offset in self.Images:
+            if Base <= Address < Base + Size:
+                Start = Offset + Address - Base
+                End   = self.Data.find (b'\0', Start, Offset + Size)
+                if End < 0:
+                    return None
+                return self.Data[Start:End].decode ('latin-1')
+        return None
+
+    def GetModule(self, Address):
+        Name = None
+        for Base, Module in self.Modules:
+            if Base > Address:
+                break
+            Name = Module
+        return Name
+
+class ArgumentReader:
+    def __init__(self, Data):
+        self.Data   = Data
+        self.Offset = 0
+
+    def Value(self):
+        if self.Offset + 8 > len(self.Data):
+            return 0
+        Value = struct.unpack_from ('<Q', self.Data, self.Offset)[0]
+        self.Offset += 8
+        return Value
+
+    def Bytes(self, Length):
+        Value = self.Data[self.Offset:self.Offset + Length]
+        self.Offset += Length
+        return bytes(Value) + b'\0' * (Length - len(Value))
+
+    def String(self, Unicode):
+        if self.Offset + 4 > len(self.Data):
+            return ''
+        Count = struct.unpack_from ('<I', self.Data, self.Offset)[0]
+        if Count == 0xFFFFFFFF:
+            self.Offset += 8
+            return '<null string>'
+        Value = self.Data[self.Offset + 4:self.Offset + 4 + Count]
+        self.Offset += (4 + Count + 7) & ~7
+        if Unicode:
+            return Value.decode ('utf-16-le', 'replace')
+        return Value.decode ('latin-1')
+
+def StatusString (Value):
+    for ErrorBit in [1 << 63, 1 << 31]:
+        if (Value & ErrorBit) and (Value & ~(ErrorBit | (ErrorBit - 1))) == 0:
+            Code = Value & (ErrorBit - 1)
+            if 1 <= Code <= len(ErrorStrings):
+                return ErrorStrings[Code - 1]
+            return '%08X' % Value
+    if Value < len(StatusStrings):
+        return StatusStrings[Value]
+    return '%08X' % Value
+
+def FormatMessage (Format, Arguments):
+    """
+    Format a message the way BasePrintLib does, from the packed arguments.
+    """
+    Reader = ArgumentReader (Arguments)
+    Output = []
+    Index  = 0
+    while Index < len(Format):
+        Char = Format[Index]
+        Index += 1
+        if Char != '%':
+            Output.append (Char)
+            continue
+
+        Flags     = ''
+        Long      = False
+        Width     = None
+        Precision = None
+        while Index < len(Format):
+            Char = Format[Index]
+            if Char in '-+ ,0' and Width is None and Precision is None:
+                Flags += Char
+            elif Char in 'lL':
+                Long = True
+            elif Char == '.':
+                Precision = 0
+            elif Char == '*':
+                if Precision is None:
+                    Width = Reader.Value ()
+                else:
+                    Precision = Reader.Value ()
+            elif Char.isdigit ():
+                if Precision is None:
+                    Width = (Width or 0) * 10 + int(Char)
+                else:
+                    Precision = Precision * 10 + int(Char)
+            else:
+                break
+            Index += 1
+        if Index >= len(Format):
+            break
+        Char = Format[Index]
+        Index += 1
+
+        if Char in 'dixXup':
+            Value = Reader.Value ()
+            if Char == 'p':
+                Flags += '0'
+                Width  = 16 if Value > 0xFFFFFFFF else 8
+            elif not Long:
+                Value &= 0xFFFFFFFF
+                if Char in 'di' and Value & 0x80000000:
+                    Value -= 1 << 32
+            elif Char in 'di' and Value & (1 << 63):
+                Value -= 1 << 64
+            if Char in 'xXp':
+                Text = '%X' % Value
+            elif Char == 'u':
+                Text = '%d' % Value
+            else:
+                Text = '{:,}'.format (abs(Value)) if ',' in Flags else '%d' % abs(Value)
+                Sign = '-' if Value < 0 else ('+' if '+' in Flags else (' ' if ' ' in Flags else ''))
+                Text = Sign + Text
+            if Char in 'Xp' and Width is not None and '0' not in Flags:
+                Flags += '0'
+        elif Char in 'asS':
+            Text = Reader.String (Char != 'a')
+            if Precision is not None:
+                Text = Text[:Precision]
+        elif Char == 'c':
+            Text = chr(Reader.Value () & 0xFFFF)
+        elif Char == 'r':
+            Text = StatusString (Reader.Value ())
+        elif Char == 'g':
+            Guid = struct.unpack ('<IHH8B', Reader.Bytes (16))
+            Text = '%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X' % Guid
+        elif Char == 't':
+            Time = struct.unpack ('<HBBBBBBIhBB', Reader.Bytes (16))
+            Text = '%02d/%02d/%04d  %02d:%02d' % (Time[1], Time[2], Time[0], Time[3], Time[4])
+        elif Char == '%':
+            Text = '%'
+        else:
+            Text = ''
+
+        if Width is not None and len(Text) < Width:
+            if '-' in Flags:
+                Text = Text.ljust (Width)
+            elif '0' in Flags and Char in 'dixXup':
+                Sign = Text[0] if Text[:1] in '-+ ' and Text else ''
+                Text = Sign + Text[len(Sign):].rjust (Width - len(Sign), '0')
+            else:
+                Text = Text.rjust (Width)
+        Output.append (Text)
+
+    return ''.join (Output)
+
+def ParseDebugLog (Data):
+    """
+    Return (LostRecords, [(ErrorLevel, TimeStamp, Format, Arguments)]) from a
+    dump containing an FSP deferred debug log, oldest record first.
+    """
+    Offset = 0
+    while True:
+        Offset = Data.find (FSP_DEBUG_LOG_SIGNATURE, Offset)
+        if Offset < 0:
+            raise Exception ("ERROR: No FSP debug log found !")
+        Header = FSP_DEBUG_LOG_HEADER.unpack_from (Data, Offset)
+        Signature, Version, HeaderSize, BufferSize, Head, Tail, UsedSize, LostRecords, Reserved = Header
+        if (Version == FSP_DEBUG_LOG_VERSION) and (HeaderSize >= FSP_DEBUG_LOG_HEADER.size) and \
+           (Offset + HeaderSize + BufferSize <= len(Data)) and (UsedSize <= BufferSize):
+            break
+        Offset += 1
+
+    Buffer  = Data[Offset + HeaderSize:Offset + HeaderSize + BufferSize]
+    Records = []
+    Offset  = Head
+    while UsedSize > 0:
+        if (BufferSize - Offset < FSP_DEBUG_LOG_RECORD.size) or \
+           (struct.unpack_from ('<H', Buffer, Offset)[0] == 0):
+            UsedSize -= BufferSize - Offset
+            Offset    = 0
+            continue
+        Size, ArgumentSize, ErrorLevel, TimeStamp, Format = FSP_DEBUG_LOG_RECORD.unpack_from (Buffer, Offset)
+        if (Size < FSP_DEBUG_LOG_RECORD.size + ArgumentSize) or (Size > UsedSize):
+            raise Exception ("ERROR: Corrupted FSP debug log record at offset 0x%X !" % Offset)
+        Start = Offset + FSP_DEBUG_LOG_RECORD.size
+        Records.append ((ErrorLevel, TimeStamp, Format, Buffer[Start:Start + ArgumentSize]))
+        UsedSize -= Size
+        Offset    = (Offset + Size) % BufferSize
+
+    return LostRecords, Records
+
+def DecodeDebugLog (LogFile, Source, Level = 0xFFFFFFFF, TscFrequency = 0, Output = sys.stdout):
+    with open(LogFile, 'rb') as File:
+        Data = bytearray(File.read())
+
+    LostRecords, Records = ParseDebugLog (Data)
+    if LostRecords:
+        Output.write ("[%d older messages were lost]\n" % LostRecords)
+
+    for ErrorLevel, TimeStamp, Address, Arguments in Records:
+        if (ErrorLevel & Level) == 0:
+            continue
+        Format = Source.GetString (Address)
+        if Format is None:
+            Module = Source.GetModule (Address)
+            Message = "<format 0x%X%s>\n" % (Address, ' in ' + Module if Module else '')
+        else:
+            Message = FormatMessage (Format, Arguments)
+        if TscFrequency:
+            Message = '[%12.6f] %s' % (float(TimeStamp) / TscFrequency, Message)
+        Output.write (Message)
+
+def main ():
+    parser = argparse.ArgumentParser(description='Decode the deferred debug log of an FSP binary')
+    parser.add_argument('-l',  '--log',    dest='LogFile',   type=str, help='Memory dump containing the FSP debug log', required = True)
+    parser.add_argument('-f',  '--fspbin', dest='FspBinary', type=str, help='FSP binary file path', required = True)
+    parser.add_argument('-b',  '--base',   dest='ImageBase', type=str, help='Base address of a binary without FSP information header', default = None)
+    parser.add_argument('-m',  '--map',    dest='MapFile',   type=str, help='FV map file of the FSP build', default = None)
+    parser.add_argument('-e',  '--level',  dest='Level',     type=str, help='Error level mask of the messages to decode', default = '0xFFFFFFFF')
+    parser.add_argument('-t',  '--tsc',    dest='TscFreq',   type=int, help='TSC frequency in MHz, to prefix messages with a time stamp', default = 0)
+    args = parser.parse_args()
+
+    for Path in [args.LogFile, args.FspBinary, args.MapFile]:
+        if Path and not os.path.exists(Path):
+            raise Exception ("ERROR: Could not locate file '%s' !" % Path)
+
+    ImageBase = int(args.ImageBase, 0) if args.ImageBase else None
+    Source    = FormatSource (args.FspBinary, ImageBase, args.MapFile)
+    DecodeDebugLog (args.LogFile, Source, int(args.Level, 0), args.TscFreq * 1000000)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
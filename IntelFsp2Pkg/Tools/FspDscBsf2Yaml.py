@@ -612,6 +612,7 @@ def dsc_to_yaml(dsc_file, yaml_file):
         fo.write('  ' + line + '\n')
 
     fo.close()
+    return dsc2yaml.gen_cfg_data
 
 
 def get_fsp_name_from_path(bsf_file):
@@ -649,14 +650,23 @@ def main():
         yaml_file = os.path.join(
             yaml_file, get_fsp_name_from_path(bsf_file) + '.yaml')
 
+    # Skip the conversion when no input of the YAML file has changed
+    command = sys.argv[1:]
+    if CGenCfgData.NoInputFileChange([yaml_file], command):
+        print("No input file change, skip to create '%s'" % yaml_file)
+        return 0
+
     if bsf_file.endswith('.dsc'):
         dsc_file = bsf_file
         bsf_file = ''
+        dep_files = [__file__]
     else:
         dsc_file = os.path.splitext(yaml_file)[0] + '.dsc'
         bsf_to_dsc(bsf_file, dsc_file)
+        dep_files = [__file__, bsf_file]
 
-    dsc_to_yaml(dsc_file, yaml_file)
+    gen_cfg_data = dsc_to_yaml(dsc_file, yaml_file)
+    gen_cfg_data.SaveDepRecord([yaml_file], command, dep_files)
 
     print("'%s' was created successfully!" % yaml_file)
 
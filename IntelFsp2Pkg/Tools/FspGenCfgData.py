@@ -8,9 +8,12 @@
 import os
 import re
 import sys
+import json
 import marshal
+import hashlib
 from functools import reduce
 from datetime import date
+from CompiledExpression import CCompiledExpression
 
 # Generated file copyright header
 
@@ -105,7 +108,7 @@ def GetCopyrightHeader(FileType, AllowModify=False):
     return CopyrightHdr % (FileDescription[FileType], date.today().year)
 
 
-class CLogicalExpression:
+class CLogicalExpression(CCompiledExpression):
     def __init__(self):
         self.index = 0
         self.string = ''
@@ -625,6 +628,67 @@ EndList
 
         self._MapVer = 0
         self._MinCfgTagId = 0x100
+        self._DepFiles = []
+
+    @staticmethod
+    def GetFileDigest(FilePath):
+        if not os.path.isfile(FilePath):
+            return ''
+        with open(FilePath, 'rb') as Fd:
+            return hashlib.sha1(Fd.read()).hexdigest()
+
+    @staticmethod
+    def LoadDepRecords(DepDbFile):
+        if not os.path.exists(DepDbFile):
+            return {}
+        try:
+            with open(DepDbFile, 'r') as Fd:
+                return json.load(Fd)
+        except ValueError:
+            return {}
+
+    @staticmethod
+    def GetDepRecordKey(OutFiles):
+        # The records are kept beside the first output file
+        OutFile = os.path.abspath(OutFiles[0])
+        DepDbFile = os.path.join(os.path.dirname(OutFile), 'GenCfgData.dep')
+        return DepDbFile, OutFile
+
+    @staticmethod
+    def NoInputFileChange(OutFiles, Command):
+        # The outputs are up to date when they were generated by the same
+        # command line from inputs of the same content and have not been
+        # modified since
+        DepDbFile, Key = CGenCfgData.GetDepRecordKey(OutFiles)
+        Record = CGenCfgData.LoadDepRecords(DepDbFile).get(Key)
+        if Record is None or Record['Command'] != Command:
+            return False
+        for FilePath, Digest in Record['Inputs'].items():
+            if CGenCfgData.GetFileDigest(FilePath) != Digest:
+                return False
+        for OutFile in OutFiles:
+            Digest = Record['Outputs'].get(os.path.abspath(OutFile))
+            if CGenCfgData.GetFileDigest(OutFile) != Digest:
+                return False
+        return True
+
+    def SaveDepRecord(self, OutFiles, Command, ExtraFiles=[]):
+        Inputs = {}
+        for FilePath in [__file__] + self._DepFiles + ExtraFiles:
+            FilePath = os.path.realpath(FilePath)
+            Inputs[FilePath] = self.GetFileDigest(FilePath)
+        Outputs = {}
+        for OutFile in OutFiles:
+            Outputs[os.path.abspath(OutFile)] = self.GetFileDigest(OutFile)
+
+        DepDbFile, Key = self.GetDepRecordKey(OutFiles)
+        Records = self.LoadDepRecords(DepDbFile)
+        Records[Key] = {'Command': Command, 'Inputs': Inputs,
+                        'Outputs': Outputs}
+        TmpFile = DepDbFile + '.tmp'
+        with open(TmpFile, 'w') as Fd:
+            json.dump(Records, Fd, indent=1, sort_keys=True)
+        os.replace(TmpFile, DepDbFile)
 
     def ParseMacros(self, MacroDefStr):
         # ['-DABC=1', '-D', 'CFG_DEBUG=1', '-D', 'CFG_OUTDIR=Build']
@@ -690,11 +754,19 @@ EndList
                         print("WARN : %s is not defined" % PcdName)
         return Line
 
-    def EvaluateExpress(self, Expr):
+    def ExpandExpress(self, Expr):
         ExpExpr = self.ExpandPcds(Expr)
         ExpExpr = self.ExpandMacros(ExpExpr)
+        return ExpExpr
+
+    def EvaluateExpress(self, Expr):
         LogExpr = CLogicalExpression()
-        Result = LogExpr.evaluateExpress(ExpExpr)
+        if self.Debug:
+            Result = LogExpr.evaluateExpress(self.ExpandExpress(Expr))
+        else:
+            Result = LogExpr.evaluateCompiled(Expr, self._MacroDict,
+                                              self._PcdsDict,
+                                              self.ExpandExpress)
         if self.Debug:
             print("INFO : Eval Express [%s] : %s" % (Expr, Result))
         return Result
@@ -708,6 +780,7 @@ EndList
                 File = File.strip()
                 BinPath = os.path.join(os.path.dirname(self._DscFile), File)
                 Result.extend(bytearray(open(BinPath, 'rb').read()))
+                self._DepFiles.append(BinPath)
         else:
             try:
                 Result = bytearray(self.ValueToList(ValueStr, Length))
@@ -866,6 +939,7 @@ EndList
         self._CfgBlkDict = {}
         self._BsfTempDict = {}
         self._CfgPageTree = {'root': []}
+        self._DepFiles = []
 
         CfgDict = {}
 
@@ -894,6 +968,7 @@ EndList
             DscLines = DscFd.readlines()
             DscFd.close()
             self._DscFile = DscFile
+            self._DepFiles.append(DscFile)
 
         BsfRegExp = re.compile("(%s):{(.+?)}(?:$|\\s+)" % '|'.
                                join(self._BsfKeyList))
@@ -1016,6 +1091,7 @@ EndList
 file '%s'." % IncludeFilePath)
                                 NewDscLines = IncludeDsc.readlines()
                                 IncludeDsc.close()
+                                self._DepFiles.append(IncludeFilePath)
                                 DscLines = NewDscLines + DscLines
                                 del self._DscLines[-1]
                             else:
@@ -1392,7 +1468,7 @@ length (%d) of '%s' !" % (BitTotal, ExpectedTotal, Item['cname']))
         return Error
 
     @staticmethod
-    def ExpandIncludeFiles(FilePath, CurDir=''):
+    def ExpandIncludeFiles(FilePath, CurDir='', DepFiles=None):
         if CurDir == '':
             CurDir = os.path.dirname(FilePath)
             FilePath = os.path.basename(FilePath)
@@ -1401,6 +1477,8 @@ length (%d) of '%s' !" % (BitTotal, ExpectedTotal, Item['cname']))
         File = open(InputFilePath, "r")
         Lines = File.readlines()
         File.close()
+        if DepFiles is not None:
+            DepFiles.append(InputFilePath)
 
         NewLines = []
         for LineNum, Line in enumerate(Lines):
@@ -1421,7 +1499,7 @@ length (%d) of '%s' !" % (BitTotal, ExpectedTotal, Item['cname']))
                                      IncPath, TmpPath, 0))
                     NewLines.append(('# %s\n' % ('=' * 80), TmpPath, 0))
                     NewLines.extend(CGenCfgData.ExpandIncludeFiles
-                                    (IncPath, CurDir))
+                                    (IncPath, CurDir, DepFiles))
             else:
                 NewLines.append((Line, InputFilePath, LineNum))
 
@@ -1429,7 +1507,8 @@ length (%d) of '%s' !" % (BitTotal, ExpectedTotal, Item['cname']))
 
     def OverrideDefaultValue(self, DltFile):
         Error = 0
-        DltLines = CGenCfgData.ExpandIncludeFiles(DltFile)
+        DltLines = CGenCfgData.ExpandIncludeFiles(DltFile,
+                                                  DepFiles=self._DepFiles)
 
         PlatformId = None
         for Line, FilePath, LineNum in DltLines:
@@ -1978,24 +2057,50 @@ format '%s'!\n" % Item["embed"]
             NewValue = Fmt % Bytes2Val(Bytes)
         Item['value'] = NewValue
 
+    def GetFindOffsets(self, BinDat):
+        # Locate all the find markers in a single scan of the binary, a
+        # match found by the scan is checked for every marker starting
+        # inside it so that overlapping matches are not missed
+        Markers = []
+        for Item in self._CfgItemList:
+            if Item['length'] > 0 and Item['find']:
+                Marker = Item['find'].encode()
+                if Marker not in Markers:
+                    Markers.append(Marker)
+        Offsets = dict((Marker, []) for Marker in Markers)
+        if not Markers:
+            return Offsets
+        Markers.sort(key=len, reverse=True)
+        FindRegExp = re.compile(b'|'.join(re.escape(x) for x in Markers))
+        for Match in FindRegExp.finditer(BinDat):
+            for Pos in range(Match.start(), Match.end()):
+                for Marker in Markers:
+                    if BinDat.startswith(Marker, Pos):
+                        Offsets[Marker].append(Pos)
+        return Offsets
+
+    @staticmethod
+    def GetFindOffset(FindOffsets, Find):
+        FindBin = Find.encode()
+        Offsets = FindOffsets.get(FindBin)
+        if not Offsets:
+            raise Exception('Could not find "%s" !' % Find)
+        if Offsets[-1] >= Offsets[0] + len(FindBin):
+            raise Exception('Multiple match found for "%s" !' % Find)
+        return Offsets[0]
+
     def LoadDefaultFromBinaryArray(self, BinDat, IgnoreFind=False):
         FindOff = 0
         StartOff = 0
+        if not IgnoreFind:
+            FindOffsets = self.GetFindOffsets(BinDat)
         for Item in self._CfgItemList:
             if Item['length'] == 0:
                 continue
             if not IgnoreFind and Item['find']:
-                FindBin = Item['find'].encode()
-                Offset = BinDat.find(FindBin)
-                if Offset >= 0:
-                    TestOff = BinDat[Offset+len(FindBin):].find(FindBin)
-                    if TestOff >= 0:
-                        raise Exception('Multiple match found for "%s" !' %
-                                        Item['find'])
-                    FindOff = Offset + len(FindBin)
-                    StartOff = Item['offset']
-                else:
-                    raise Exception('Could not find "%s" !' % Item['find'])
+                Offset = self.GetFindOffset(FindOffsets, Item['find'])
+                FindOff = Offset + len(Item['find'].encode())
+                StartOff = Item['offset']
             if Item['offset'] + Item['length'] > len(BinDat):
                 raise Exception('Mismatching format between DSC \
 and BIN files !')
@@ -2012,6 +2117,7 @@ and BIN files !')
 
         PatchList = []
         CfgBin = bytearray()
+        FindOffsets = self.GetFindOffsets(BinDat)
         for Item in self._CfgItemList:
             if Item['length'] == 0:
                 continue
@@ -2019,16 +2125,8 @@ and BIN files !')
             if Item['find']:
                 if len(CfgBin) > 0:
                     PatchList.append((FileOff, CfgBin))
-                FindBin = Item['find'].encode()
-                FileOff = BinDat.find(FindBin)
-                if FileOff < 0:
-                    raise Exception('Could not find "%s" !' % Item['find'])
-                else:
-                    TestOff = BinDat[FileOff+len(FindBin):].find(FindBin)
-                    if TestOff >= 0:
-                        raise Exception('Multiple match found for "%s" !' %
-                                        Item['find'])
-                FileOff += len(FindBin)
+                FileOff = self.GetFindOffset(FindOffsets, Item['find'])
+                FileOff += len(Item['find'].encode())
                 Offset = Item['offset']
                 FindOff = Offset
                 CfgBin = bytearray()
@@ -2082,6 +2180,7 @@ x64\x12\x05\x8d\x0a\xa8'
             Fin = open(BinFile, 'rb')
             BinDat = Prefix + bytearray(Fin.read())
             Fin.close()
+            self._DepFiles.append(BinFile)
         else:
             BinDat = Prefix + self.GenerateBinaryArray()
 
@@ -2404,6 +2503,8 @@ for platform ID 0x%04X\n' % PlatformId)
 
     def GenerateDeltaFile(self, OutFile, AbsfFile):
         # Parse ABSF Build in dict
+        if AbsfFile:
+            self._DepFiles.append(AbsfFile)
         if not os.path.exists(AbsfFile):
             Lines = []
         else:
@@ -2525,6 +2626,16 @@ def Main():
     Command = sys.argv[1].upper()
     OutFile = sys.argv[3]
 
+    # Skip the generation when no input of the outputs has changed
+    DepCommand = sys.argv[1:]
+    if Command == "GENHDR":
+        OutFiles = [x.strip() for x in OutFile.split(';') if x.strip()]
+    else:
+        OutFiles = [OutFile]
+    if CGenCfgData.NoInputFileChange(OutFiles, DepCommand):
+        print("INFO: No input file change, skip to create '%s' !" % OutFile)
+        return 0
+
     if argc > 5 and GenCfgData.ParseMacros(sys.argv[4:]) != 0:
         raise Exception("ERROR: Macro parsing failed !")
 
@@ -2541,11 +2652,13 @@ def Main():
     if Command == "GENDLT" and DscFile.endswith('.dlt'):
         # It needs to expand an existing DLT file
         DltFile = DscFile
-        Lines = CGenCfgData.ExpandIncludeFiles(DltFile)
+        Lines = CGenCfgData.ExpandIncludeFiles(DltFile,
+                                               DepFiles=GenCfgData._DepFiles)
         OutTxt = ''.join([x[0] for x in Lines])
         OutFile = open(OutFile, "w")
         OutFile.write(OutTxt)
         OutFile.close()
+        GenCfgData.SaveDepRecord(OutFiles, DepCommand)
         return 0
 
     if not os.path.exists(DscFile):
@@ -2568,11 +2681,13 @@ def Main():
     if BinFile:
         if GenCfgData.GenerateDataIncFile(OutFile, BinFile) != 0:
             raise Exception(GenCfgData.Error)
+        GenCfgData.SaveDepRecord(OutFiles, DepCommand)
         return 0
 
     if DscFile.lower().endswith('.pkl'):
         with open(DscFile, "rb") as PklFile:
             GenCfgData.__dict__ = marshal.load(PklFile)
+        GenCfgData._DepFiles = [DscFile]
     else:
         if GenCfgData.ParseDscFile(DscFile) != 0:
             raise Exception(GenCfgData.Error)
@@ -2586,6 +2701,7 @@ def Main():
         if Command == 'GENPKL':
             with open(OutFile, "wb") as PklFile:
                 marshal.dump(GenCfgData.__dict__, PklFile)
+            GenCfgData.SaveDepRecord(OutFiles, DepCommand)
             return 0
 
     if DltFile and Command in ['GENHDR', 'GENBIN', 'GENINC', 'GENBSF']:
@@ -2630,6 +2746,7 @@ def Main():
     else:
         raise Exception("Unsuported command '%s' !" % Command)
 
+    GenCfgData.SaveDepRecord(OutFiles, DepCommand)
     return 0
 
 
@@ -7,10 +7,14 @@
 
 import os
 import re
+import io
 import sys
+import json
 import struct
+import hashlib
 from   datetime import date
 from functools import reduce
+from CompiledExpression import CCompiledExpression
 
 # Generated file copyright header
 
@@ -85,7 +89,7 @@ are permitted provided that the following conditions are met:
 
 BuildOptionPcd = []
 
-class CLogicalExpression:
+class CLogicalExpression(CCompiledExpression):
     def __init__(self):
         self.index    = 0
         self.string   = ''
@@ -315,7 +319,9 @@ EndList
         self._DscFile     = ''
 
         self._MapVer      = 0
-        self._DscTime     = 0
+        self._DepFiles    = []
+        self._DepDigests  = None
+        self._DepCommand  = []
 
     def ParseMacros (self, MacroDefStr):
         # ['-DABC=1', '-D', 'CFG_DEBUG=1', '-D', 'CFG_OUTDIR=Build']
@@ -380,11 +386,17 @@ EndList
                       print ("WARN : %s is not defined" % PcdName)
         return Line
 
-    def EvaluateExpress (self, Expr):
+    def ExpandExpress (self, Expr):
         ExpExpr = self.ExpandPcds(Expr)
         ExpExpr = self.ExpandMacros(ExpExpr)
+        return ExpExpr
+
+    def EvaluateExpress (self, Expr):
         LogExpr = CLogicalExpression()
-        Result  = LogExpr.evaluateExpress (ExpExpr)
+        if self.Debug:
+            Result  = LogExpr.evaluateExpress (self.ExpandExpress(Expr))
+        else:
+            Result  = LogExpr.evaluateCompiled (Expr, self._MacroDict, self._PcdsDict, self.ExpandExpress)
         if self.Debug:
             print ("INFO : Eval Express [%s] : %s" % (Expr, Result))
         return Result
@@ -398,6 +410,7 @@ EndList
             File = File.strip()
             BinPath = os.path.join(os.path.dirname(self._DscFile), File)
             Result.extend(bytearray(open(BinPath, 'rb').read()))
+            self.AddDepFile (BinPath)
         else:
             try:
                 Result  = bytearray(self.ValueToList(ValueStr, Length))
@@ -494,8 +507,9 @@ EndList
         self._DscLines    = []
         self._BsfTempDict = {}
 
-        # Initial DSC time is parent DSC time.
-        self._DscTime     = os.path.getmtime(DscFile)
+        # Track the DSC and every file it pulls in
+        self._DepFiles    = []
+        self._DepDigests  = None
 
         CfgDict = {}
 
@@ -522,6 +536,7 @@ EndList
             DscLines     = DscFd.readlines()
             DscFd.close()
             self._DscFile = DscFile
+            self.AddDepFile (DscFile)
 
         SkipLines = 0
 
@@ -637,10 +652,7 @@ EndList
                                     print("ERROR: Cannot open file '%s'" % IncludeFilePath)
                                     raise SystemExit
 
-                                # Update DscTime when newer DSC time found.
-                                CurrentDscTime = os.path.getmtime(os.path.realpath(IncludeDsc.name))
-                                if CurrentDscTime > self._DscTime:
-                                    self._DscTime = CurrentDscTime
+                                self.AddDepFile (IncludeDsc.name)
 
                                 NewDscLines = IncludeDsc.readlines()
                                 IncludeDsc.close()
@@ -942,19 +954,95 @@ EndList
                 SubItem['value'] = valuestr
         return Error
 
-    def NoDscFileChange (self, OutPutFile):
-        NoFileChange = True
+    @staticmethod
+    def GetFileDigest (FilePath):
+        if not os.path.isfile(FilePath):
+            return ''
+        with open(FilePath, 'rb') as Fd:
+            return hashlib.sha1(Fd.read()).hexdigest()
+
+    @staticmethod
+    def GetDepDbFile (OutPutFile):
+        return os.path.join(os.path.dirname(os.path.abspath(OutPutFile)), 'GenCfgOpt.dep')
+
+    def LoadDepRecords (self, OutPutFile):
+        DepDbFile = self.GetDepDbFile (OutPutFile)
+        if not os.path.exists(DepDbFile):
+            return {}
+        try:
+            with open(DepDbFile, 'r') as Fd:
+                return json.load(Fd)
+        except ValueError:
+            return {}
+
+    def SaveDepRecords (self, OutPutFile, Records):
+        DepDbFile = self.GetDepDbFile (OutPutFile)
+        TmpFile   = DepDbFile + '.tmp'
+        with open(TmpFile, 'w') as Fd:
+            json.dump(Records, Fd, indent=1, sort_keys=True)
+        os.replace(TmpFile, DepDbFile)
+
+    def AddDepFile (self, FilePath):
+        FilePath = os.path.realpath(FilePath)
+        if FilePath not in self._DepFiles:
+            self._DepFiles.append(FilePath)
+            self._DepDigests = None
+
+    #
+    # Digests of the tool, the DSC files and the extra input files of an output
+    #
+    def GetInputDigests (self, ExtraFiles = []):
+        if self._DepDigests is None:
+            self._DepDigests = {}
+            for File in [os.path.realpath(__file__)] + self._DepFiles:
+                self._DepDigests[File] = self.GetFileDigest (File)
+        Digests = dict(self._DepDigests)
+        for File in ExtraFiles:
+            File = os.path.realpath(File)
+            Digests[File] = self.GetFileDigest (File)
+        return Digests
+
+    #
+    # An output is up to date when it was generated by the same command line
+    # from inputs of the same content and has not been modified since
+    #
+    def NoDscFileChange (self, OutPutFile, ExtraFiles = []):
         if not os.path.exists(OutPutFile):
-            NoFileChange = False
-        else:
-            OutputTime = os.path.getmtime(OutPutFile)
-            if self._DscTime > OutputTime:
-                NoFileChange = False
-        return NoFileChange
+            return False
+        Record = self.LoadDepRecords (OutPutFile).get(os.path.abspath(OutPutFile))
+        if Record is None:
+            return False
+        if Record['Command'] != self._DepCommand:
+            return False
+        if Record['Inputs'] != self.GetInputDigests (ExtraFiles):
+            return False
+        return Record['Digest'] == self.GetFileDigest (OutPutFile)
+
+    #
+    # Write an output and record its inputs, the file is only rewritten when
+    # the content changes so that its time stamp is kept otherwise
+    #
+    def WriteOutputFile (self, OutPutFile, Content, ExtraFiles = []):
+        OldContent = None
+        if os.path.exists(OutPutFile):
+            with open(OutPutFile, 'r') as Fd:
+                OldContent = Fd.read()
+        if OldContent != Content:
+            with open(OutPutFile, 'w') as Fd:
+                Fd.write(Content)
+
+        Records = self.LoadDepRecords (OutPutFile)
+        Records[os.path.abspath(OutPutFile)] = {
+            'Command' : self._DepCommand,
+            'Inputs'  : self.GetInputDigests (ExtraFiles),
+            'Digest'  : self.GetFileDigest (OutPutFile)
+            }
+        self.SaveDepRecords (OutPutFile, Records)
 
     def CreateSplitUpdTxt (self, UpdTxtFile):
         GuidList = ['FSP_T_UPD_TOOL_GUID','FSP_M_UPD_TOOL_GUID','FSP_S_UPD_TOOL_GUID','FSP_I_UPD_TOOL_GUID']
         SignatureList = ['0x545F', '0x4D5F','0x535F','0x495F']        #  _T, _M, _S and _I signature for FSPT, FSPM, FSPS, FSPI
+        Created = 0
         for Index in range(len(GuidList)):
             UpdTxtFile = ''
             FvDir = self._FvDir
@@ -972,11 +1060,11 @@ EndList
 
             if (self.NoDscFileChange (UpdTxtFile)):
                 # DSC has not been modified yet
-                # So don't have to re-generate other files
-                self.Error = 'No DSC file change, skip to create UPD TXT file'
-                return 256
+                # So don't have to re-generate this file
+                continue
 
-            TxtFd = open(UpdTxtFile, "w")
+            Created += 1
+            TxtFd = io.StringIO()
             TxtFd.write("%s\n"   % (__copyright_txt__ % date.today().year))
 
             NextOffset = 0
@@ -1012,7 +1100,10 @@ EndList
                     SpaceIdx = SpaceIdx + 1
                 NextOffset = Offset + Item['length']
                 TxtFd.write("%s.%s|%s0x%04X|%s|%s\n" % (Item['space'],Item['cname'],Default,Item['offset'] - StartAddr,Item['length'],Item['value']))
-            TxtFd.close()
+            self.WriteOutputFile (UpdTxtFile, TxtFd.getvalue())
+        if Created == 0:
+            self.Error = 'No DSC file change, skip to create UPD TXT file'
+            return 256
         return 0
 
     def CreateVarDict (self):
@@ -1277,8 +1368,22 @@ EndList
         HeaderFileName = 'FspUpd.h'
         HeaderFile = os.path.join(FvDir, HeaderFileName)
 
-        # Check if header needs to be recreated
-        if (self.NoDscFileChange (HeaderFile)):
+        HeaderTFileName = 'FsptUpd.h'
+        HeaderMFileName = 'FspmUpd.h'
+        HeaderSFileName = 'FspsUpd.h'
+        HeaderIFileName = 'FspiUpd.h'
+
+        # Check if headers need to be recreated
+        if InputHeaderFile != '':
+            ExtraFiles = [InputHeaderFile]
+        else:
+            ExtraFiles = []
+        NoChange = True
+        for FileName in [HeaderFileName, HeaderTFileName, HeaderMFileName, HeaderSFileName, HeaderIFileName]:
+            if not self.NoDscFileChange (os.path.join(FvDir, FileName), ExtraFiles):
+                NoChange = False
+                break
+        if NoChange:
             # DSC has not been modified yet
             # So don't have to re-generate other files
             self.Error = 'No DSC file change, skip to create UPD header file'
@@ -1398,11 +1503,6 @@ EndList
         # Handle the embedded data structure
         TxtBody = self.PostProcessBody (TxtBody)
 
-        HeaderTFileName = 'FsptUpd.h'
-        HeaderMFileName = 'FspmUpd.h'
-        HeaderSFileName = 'FspsUpd.h'
-        HeaderIFileName = 'FspiUpd.h'
-
         UpdRegionCheck = ['FSPT', 'FSPM', 'FSPS', 'FSPI']     # FSPX_UPD_REGION
         UpdConfigCheck = ['FSP_T', 'FSP_M', 'FSP_S', 'FSP_I']  # FSP_X_CONFIG, FSP_X_TEST_CONFIG, FSP_X_RESTRICTED_CONFIG
         UpdSignatureCheck = ['FSPT_UPD_SIGNATURE', 'FSPM_UPD_SIGNATURE', 'FSPS_UPD_SIGNATURE', 'FSPI_UPD_SIGNATURE']
@@ -1421,17 +1521,15 @@ EndList
 
         for item in range(len(UpdRegionCheck)):
             if UpdRegionCheck[item] == 'FSPT':
-                HeaderFd = open(os.path.join(FvDir, HeaderTFileName), "w")
-                FileBase = os.path.basename(os.path.join(FvDir, HeaderTFileName))
+                HeaderPath = os.path.join(FvDir, HeaderTFileName)
             elif UpdRegionCheck[item] == 'FSPM':
-                HeaderFd = open(os.path.join(FvDir, HeaderMFileName), "w")
-                FileBase = os.path.basename(os.path.join(FvDir, HeaderMFileName))
+                HeaderPath = os.path.join(FvDir, HeaderMFileName)
             elif UpdRegionCheck[item] == 'FSPS':
-                HeaderFd = open(os.path.join(FvDir, HeaderSFileName), "w")
-                FileBase = os.path.basename(os.path.join(FvDir, HeaderSFileName))
+                HeaderPath = os.path.join(FvDir, HeaderSFileName)
             elif UpdRegionCheck[item] == 'FSPI':
-                HeaderFd = open(os.path.join(FvDir, HeaderIFileName), "w")
-                FileBase = os.path.basename(os.path.join(FvDir, HeaderIFileName))
+                HeaderPath = os.path.join(FvDir, HeaderIFileName)
+            HeaderFd = io.StringIO()
+            FileBase = os.path.basename(HeaderPath)
             FileName = FileBase.replace(".", "_").upper()
             HeaderFd.write("%s\n"   % (__copyright_h__ % date.today().year))
             HeaderFd.write("#ifndef __%s__\n"   % FileName)
@@ -1487,9 +1585,9 @@ EndList
                         self.WriteLinesWithoutTailingSpace(HeaderFd, Line)
             HeaderFd.write("#pragma pack()\n\n")
             HeaderFd.write("#endif\n")
-            HeaderFd.close()
+            self.WriteOutputFile (HeaderPath, HeaderFd.getvalue(), ExtraFiles)
 
-        HeaderFd = open(HeaderFile, "w")
+        HeaderFd = io.StringIO()
         FileBase = os.path.basename(HeaderFile)
         FileName = FileBase.replace(".", "_").upper()
         HeaderFd.write("%s\n"   % (__copyright_h__ % date.today().year))
@@ -1532,7 +1630,7 @@ EndList
                         self.WriteLinesWithoutTailingSpace(HeaderFd, Line)
         HeaderFd.write("#pragma pack()\n\n")
         HeaderFd.write("#endif\n")
-        HeaderFd.close()
+        self.WriteOutputFile (HeaderFile, HeaderFd.getvalue(), ExtraFiles)
 
         return 0
 
@@ -1625,7 +1723,7 @@ EndList
 
         Error = 0
         OptionDict = {}
-        BsfFd      = open(BsfFile, "w")
+        BsfFd      = io.StringIO()
         BsfFd.write("%s\n" % (__copyright_bsf__ % date.today().year))
         BsfFd.write("%s\n" % self._GlobalDataDef)
         BsfFd.write("StructDef\n")
@@ -1703,7 +1801,7 @@ EndList
                 self.WriteBsfOption (BsfFd, Item)
             BsfFd.write("EndPage\n\n")
 
-        BsfFd.close()
+        self.WriteOutputFile (BsfFile, BsfFd.getvalue())
         return  Error
 
 
@@ -1721,6 +1819,7 @@ def Main():
     i = 1
 
     GenCfgOpt = CGenCfgOpt()
+    GenCfgOpt._DepCommand = sys.argv[1:]
     while i < len(sys.argv):
         if sys.argv[i].strip().lower() == "--pcd":
             BuildOptionPcd.append(sys.argv[i+1])
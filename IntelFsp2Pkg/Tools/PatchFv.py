@@ -5,10 +5,37 @@
 #
 ##
 
+import bisect
 import os
+import pickle
 import re
 import sys
 
+#
+# Patterns of the map file lines
+#
+#DxeIpl (Fixed Flash Address, BaseAddress=0x00fffb4310, EntryPoint=0x00fffb4958[,Type=PE])
+FV_MAP_MODULE_PATTERN  = re.compile("([_a-zA-Z0-9\-]+)\s\(.+BaseAddress=(0x[0-9a-fA-F]+),\s+EntryPoint=(0x[0-9a-fA-F]+)(?:,\s*Type=\w+)?\)")
+#(GUID=86D70125-BAA3-4296-A62F-602BEBBB9081 .textbaseaddress=0x00fffb4398 .databaseaddress=0x00fffb4178)
+FV_MAP_SECTION_PATTERN = re.compile("\(GUID=([A-Z0-9\-]+)\s+\.textbaseaddress=(0x[0-9a-fA-F]+)\s+\.databaseaddress=(0x[0-9a-fA-F]+)\)")
+#   0x00fff8016c    __ModuleEntryPoint
+FV_MAP_SYMBOL_PATTERN  = re.compile("^\s+(0x[a-z0-9]+)\s+([_a-zA-Z0-9]+)")
+#                0x0000000000001d55                IoRead8
+GCC_MAP_SYMBOL_PATTERN = re.compile("\s+(0x[0-9a-fA-F]{16})\s+([^\s][^0x][_a-zA-Z0-9\-]+)\s")
+# .data._gPcd_BinaryPatch_PcdVpdBaseAddress
+#        0x0000000000003714        0x4 /tmp/ccmytayk.ltrans1.ltrans.o
+GCC_MAP_PCD_PATTERN    = re.compile("^\s\.data\.(_gPcd_BinaryPatch[_a-zA-Z0-9\-]+)")
+GCC_MAP_PCD_PATTERN2   = re.compile("\s+(0x[0-9a-fA-F]{16})\s+")
+#0003:00000190       _gComBase                  00007a50     SerialPo
+MSFT_MAP_SYMBOL_PATTERN = re.compile("^\s[0-9a-fA-F]{4}:[0-9a-fA-F]{8}\s+(\w+)\s+([0-9a-fA-F]{8,16}\s+)")
+
+#
+# Symbol cache of an FV build directory, holding what was read from each map
+# file with the modification time and the size of the file
+#
+SYMBOL_CACHE_FILE    = "PatchFvSymbols.cache"
+SYMBOL_CACHE_VERSION = 1
+
 #
 #  Read data from file
 #
@@ -99,8 +126,202 @@ def patchDataInFile (binfile, offset, value, len=1):
     fd.close()
     return len
 
+#
+#  Patch session on an FD file
+#
+#  The FD file is read once into memory. All the reads and patches of the
+#  session are done on that image, and the image is written back to the file
+#  once, when the session is closed. A patch overlapping a range that was
+#  already patched in the session is rejected.
+#
+class FdPatchSession:
+    def __init__(self, binfile):
+        self.binFile = binfile
+        fd           = open(binfile, "rb")
+        self.image   = bytearray(fd.read())
+        fd.close()
+        self.dirty   = False
+        self.starts  = []
+        self.ranges  = []
+
+    #
+    #  Convert an offset to an offset in the image
+    #
+    #  param [in]  offset      Offset, from the end of the image when bit 31 is set
+    #  param [in]  size        Size of the range at the offset
+    #
+    #  retval      offval      Offset in the image
+    #
+    def toImageOffset (self, offset, size):
+        offval = offset & 0xFFFFFFFF
+        if (offval & 0x80000000):
+            offval = len(self.image) - (0xFFFFFFFF - offval + 1)
+        if (offval < 0) or (offval + size > len(self.image)):
+            raise Exception("Range 0x%08X ~ 0x%08X is out of the FD!" % (offset & 0xFFFFFFFF, (offset & 0xFFFFFFFF) + size))
+        return offval
+
+    #
+    #  Record a patched range, rejecting the ones overlapping a patched range
+    #
+    #  param [in]  offval      Offset in the image
+    #  param [in]  size        Size
+    #  param [in]  comment     Comment of the patch
+    #
+    def addRange (self, offval, size, comment):
+        if size == 0:
+            return
+        idx = bisect.bisect_right(self.starts, offval)
+        for near in (idx - 1, idx):
+            if 0 <= near < len(self.ranges):
+                start, end, what = self.ranges[near]
+                if (offval < end) and (start < offval + size):
+                    raise Exception("Patch 0x%08X ~ 0x%08X  # %s overlaps patch 0x%08X ~ 0x%08X  # %s" %
+                                    (offval, offval + size, comment, start, end, what))
+        self.starts.insert(idx, offval)
+        self.ranges.insert(idx, (offval, offval + size, comment))
+
+    #
+    #  Read data from the image
+    #
+    #  param [in]  offset      Offset
+    #  param [in]  size        Length
+    #
+    #  retval      value       Value
+    #
+    def readData (self, offset, size=1):
+        offval = self.toImageOffset(offset, size)
+        value  = 0
+        for byte in reversed(self.image[offval:offval + size]):
+            value = value << 8 | byte
+        return value
+
+    #
+    #  Patch data in the image
+    #
+    #  param [in]  offset      Offset
+    #  param [in]  value       Patch value
+    #  param [in]  size        Length
+    #  param [in]  comment     Comment reported when the patch overlaps another one
+    #
+    #  retval      size        Length
+    #
+    def patchData (self, offset, value, size=1, comment=""):
+        offval = self.toImageOffset(offset, size)
+        self.addRange(offval, size, comment)
+        self.image[offval:offval + size] = bytearray((value >> (idx * 8)) & 0xFF for idx in range(size))
+        self.dirty = True
+        return size
+
+    #
+    #  Copy a block of the image
+    #
+    #  param [in]  src         Source offset
+    #  param [in]  dest        Destination offset
+    #  param [in]  size        Length
+    #  param [in]  comment     Comment reported when the copy overlaps a patch
+    #
+    #  retval      size        Length
+    #
+    def copyData (self, src, dest, size, comment=""):
+        srcoff  = self.toImageOffset(src, size)
+        destoff = self.toImageOffset(dest, size)
+        self.addRange(destoff, size, comment)
+        self.image[destoff:destoff + size] = self.image[srcoff:srcoff + size]
+        self.dirty = True
+        return size
+
+    #
+    #  Write the image back to the FD file if it was patched
+    #
+    def close (self):
+        if self.dirty:
+            fd = open(self.binFile, "r+b")
+            fd.write(self.image)
+            fd.close()
+            self.dirty = False
+
+
+#
+#  Scan FV MAP file
+#
+#  param [in]  mapFile     .Fv.map file
+#
+#  retval      records     List of the module headers, sections and symbols
+#                          in the order of the file:
+#                            ('MOD', name, base, entry)
+#                            ('SEC', guid, text, data, follows module header)
+#                            ('SYM', symbol, address)
+#
+def scanFvMapFile (mapFile):
+    records     = []
+    foundModHdr = False
+    fdIn        = open(mapFile, "r")
+    for rptLine in fdIn:
+        if rptLine[0] != ' ':
+            match = FV_MAP_MODULE_PATTERN.match(rptLine)
+            if match is not None:
+                foundModHdr = True
+                records.append(('MOD', match.group(1), int (match.group(2), 16), int (match.group(3), 16)))
+            match = FV_MAP_SECTION_PATTERN.match(rptLine)
+            if match is not None:
+                records.append(('SEC', match.group(1), int (match.group(2), 16), int (match.group(3), 16), foundModHdr))
+                foundModHdr = False
+        else:
+            foundModHdr = False
+            match = FV_MAP_SYMBOL_PATTERN.match(rptLine)
+            if match is not None:
+                records.append(('SYM', match.group(2), match.group(1)))
+    fdIn.close()
+    return records
+
+#
+#  Scan MOD MAP file
+#
+#  param [in]  mapFile     Module .map file
+#
+#  retval      modSymbols  Dictionary of the symbol offsets in the module
+#  retval      isGcc       The map file was produced by GCC
+#
+def scanModMapFile (mapFile):
+    modSymbols = {}
+    pcdSymbols = []
+    fdIn       = open(mapFile, "r")
+    reportLine = fdIn.readline()
+    isGcc      = reportLine.strip().find("Archive member included") != -1
+    pcdName    = None
+    while reportLine != "":
+        if isGcc:
+            match = GCC_MAP_SYMBOL_PATTERN.match(reportLine)
+            if match is not None:
+                modSymbols['_' + match.group(2)] = match.group(1)
+            #
+            # Handle extra module patchable PCD variable in Linux map since it might have different format
+            #
+            if pcdName is not None:
+                match = GCC_MAP_PCD_PATTERN2.match(reportLine)
+                if match is not None:
+                    pcdSymbols.append(('_' + pcdName, match.group(1)))
+                pcdName = None
+            else:
+                match = GCC_MAP_PCD_PATTERN.match(reportLine)
+                if match is not None:
+                    pcdName = match.group(1)
+        else:
+            match = MSFT_MAP_SYMBOL_PATTERN.match(reportLine)
+            if match is not None:
+                modSymbols[match.group(1)] = match.group(2)
+        reportLine = fdIn.readline()
+    fdIn.close()
+    for pcdName, value in pcdSymbols:
+        modSymbols[pcdName] = value
+    return modSymbols, isGcc
 
 class Symbols:
+    #
+    # Compiled expressions, keyed by their text with the spaces normalized
+    #
+    compiledExpressions = {}
+
     def __init__(self):
         self.dictSymbolAddress = {}
         self.dictGuidNameXref  = {}
@@ -108,6 +329,14 @@ class Symbols:
         self.dictVariable      = {}
         self.dictModBase       = {}
         self.fdFile            = None
+        self.fdSession         = None
+        self.fdImage           = None
+        self.dictFvOffset      = {}
+        self.dictNameGuidXref  = {}
+        self.symbolCache       = {}
+        self.symbolCacheFile   = None
+        self.symbolCacheUsed   = {}
+        self.symbolCacheDirty  = False
         self.string            = ""
         self.fdBase            = 0xFFFFFFFF
         self.fdSize            = 0
@@ -172,10 +401,16 @@ class Symbols:
         if not os.path.exists(xrefFile):
             raise Exception("Cannot open GUID Xref file '%s'!" % xrefFile)
 
+        #
+        # Load the symbol cache left by a previous run in fvDir
+        #
+        self.loadSymbolCache (fvDir)
+
         #
         # Add GUID reference to dictionary
         #
         self.dictGuidNameXref  = {}
+        self.dictNameGuidXref  = {}
         self.parseGuidXrefFile(xrefFile)
 
         #
@@ -198,6 +433,8 @@ class Symbols:
         #
         self.fdFile = fdFile
         self.fdSize = os.path.getsize(fdFile)
+        self.fdImage      = None
+        self.dictFvOffset = {}
 
         #
         # If the INF file, which is the first element of fvList, is not existing, then raise an exception
@@ -261,8 +498,76 @@ class Symbols:
                     continue
                 self.parseModMapFile(item[0x24:], mapFile)
 
+        self.saveSymbolCache ()
+        self.fdImage = None
         return 0
 
+    #
+    #  Load the symbol cache of a FV directory
+    #
+    #  param [in]  fvDir       FV's directory
+    #
+    #  retval      0           Loaded the cache, or started an empty one
+    #
+    def loadSymbolCache (self, fvDir):
+        self.symbolCacheFile  = os.path.join(fvDir, SYMBOL_CACHE_FILE)
+        self.symbolCache      = {}
+        self.symbolCacheUsed  = {}
+        self.symbolCacheDirty = False
+        try:
+            with open(self.symbolCacheFile, "rb") as fdIn:
+                cache = pickle.load(fdIn)
+            if cache.get('Version') == SYMBOL_CACHE_VERSION:
+                self.symbolCache = cache['Files']
+        except Exception:
+            #
+            # A missing or broken cache is rebuilt from the map files
+            #
+            self.symbolCache = {}
+        return 0
+
+    #
+    #  Save the symbol cache with the map files scanned in this run. Entries
+    #  of map files used by other runs are kept while the files exist.
+    #
+    #  retval      0           Saved the cache, or it was up to date
+    #
+    def saveSymbolCache (self):
+        if not self.symbolCacheDirty:
+            return 0
+        for key in list(self.symbolCache):
+            if key not in self.symbolCacheUsed and not os.path.exists(key.split('|', 1)[1]):
+                del self.symbolCache[key]
+        self.symbolCache.update(self.symbolCacheUsed)
+        try:
+            with open(self.symbolCacheFile, "wb") as fdOut:
+                pickle.dump({'Version' : SYMBOL_CACHE_VERSION, 'Files' : self.symbolCache}, fdOut, 2)
+        except (IOError, OSError):
+            #
+            # The cache only saves time, patching goes on without it
+            #
+            pass
+        return 0
+
+    #
+    #  Scan a map file, or reuse the result of a previous run
+    #
+    #  param [in]  scanner     Function scanning the map file
+    #  param [in]  mapFile     Map file
+    #
+    #  retval      records     What scanner returned for mapFile
+    #
+    def scanCached (self, scanner, mapFile):
+        stat  = os.stat(mapFile)
+        stamp = (getattr(stat, 'st_mtime_ns', stat.st_mtime), stat.st_size)
+        key   = '%s|%s' % (scanner.__name__, os.path.abspath(mapFile))
+        entry = self.symbolCache.get(key)
+        if entry is None or entry[0] != stamp:
+            entry = (stamp, scanner(mapFile))
+            self.symbolCacheDirty = True
+        self.symbolCacheUsed[key] = entry
+        return entry[1]
+
     #
     #  Get FV offset in FD file
     #
@@ -274,13 +579,18 @@ class Symbols:
         #
         # Check if the first 0x70 bytes of fvFile can be found in fdFile
         #
-        fvHandle = open(fvFile, "r+b")
-        fdHandle = open(self.fdFile, "r+b")
-        offset = fdHandle.read().find(fvHandle.read(0x70))
+        if fvFile in self.dictFvOffset:
+            return self.dictFvOffset[fvFile]
+        if self.fdImage is None:
+            fdHandle = open(self.fdFile, "rb")
+            self.fdImage = fdHandle.read()
+            fdHandle.close()
+        fvHandle = open(fvFile, "rb")
+        offset = self.fdImage.find(fvHandle.read(0x70))
         fvHandle.close()
-        fdHandle.close()
         if offset == -1:
             raise Exception("Could not locate FV file %s in FD!" % fvFile)
+        self.dictFvOffset[fvFile] = offset
         return offset
 
     #
@@ -356,43 +666,23 @@ class Symbols:
         # self.dictModBase[FspSecCore:DATA]  = 4294612280 (0xfffa9538)
         # self.dictSymbolAddress[FspSecCore:_SecStartup] = 0x00fffa4a38
         #
-        fdIn     = open(mapFile, "r")
-        rptLine  = fdIn.readline()
         modName  = ""
-        foundModHdr = False
-        while (rptLine != "" ):
-            if rptLine[0] != ' ':
-                #DxeIpl (Fixed Flash Address, BaseAddress=0x00fffb4310, EntryPoint=0x00fffb4958,Type=PE)
-                match = re.match("([_a-zA-Z0-9\-]+)\s\(.+BaseAddress=(0x[0-9a-fA-F]+),\s+EntryPoint=(0x[0-9a-fA-F]+),\s*Type=\w+\)", rptLine)
-                if match is None:
-                    #DxeIpl (Fixed Flash Address, BaseAddress=0x00fffb4310, EntryPoint=0x00fffb4958)
-                    match = re.match("([_a-zA-Z0-9\-]+)\s\(.+BaseAddress=(0x[0-9a-fA-F]+),\s+EntryPoint=(0x[0-9a-fA-F]+)\)", rptLine)
-                if match is not None:
-                    foundModHdr = True
-                    modName = match.group(1)
-                    if len(modName) == 36:
-                       modName = self.dictGuidNameXref[modName.upper()]
-                    self.dictModBase['%s:BASE'  % modName] = int (match.group(2), 16)
-                    self.dictModBase['%s:ENTRY' % modName] = int (match.group(3), 16)
-                #(GUID=86D70125-BAA3-4296-A62F-602BEBBB9081 .textbaseaddress=0x00fffb4398 .databaseaddress=0x00fffb4178)
-                match = re.match("\(GUID=([A-Z0-9\-]+)\s+\.textbaseaddress=(0x[0-9a-fA-F]+)\s+\.databaseaddress=(0x[0-9a-fA-F]+)\)", rptLine)
-                if match is not None:
-                    if foundModHdr:
-                        foundModHdr = False
-                    else:
-                        modName = match.group(1)
-                        if len(modName) == 36:
-                            modName = self.dictGuidNameXref[modName.upper()]
-                    self.dictModBase['%s:TEXT' % modName] = int (match.group(2), 16)
-                    self.dictModBase['%s:DATA' % modName] = int (match.group(3), 16)
+        for record in self.scanCached (scanFvMapFile, mapFile):
+            if record[0] == 'SYM':
+                self.dictSymbolAddress["%s:%s"%(modName, record[1])] = record[2]
+            elif record[0] == 'MOD':
+                modName = record[1]
+                if len(modName) == 36:
+                   modName = self.dictGuidNameXref[modName.upper()]
+                self.dictModBase['%s:BASE'  % modName] = record[2]
+                self.dictModBase['%s:ENTRY' % modName] = record[3]
             else:
-                #   0x00fff8016c    __ModuleEntryPoint
-                foundModHdr = False
-                match = re.match("^\s+(0x[a-z0-9]+)\s+([_a-zA-Z0-9]+)", rptLine)
-                if match is not None:
-                    self.dictSymbolAddress["%s:%s"%(modName, match.group(2))] = match.group(1)
-            rptLine  = fdIn.readline()
-        fdIn.close()
+                if not record[4]:
+                    modName = record[1]
+                    if len(modName) == 36:
+                        modName = self.dictGuidNameXref[modName.upper()]
+                self.dictModBase['%s:TEXT' % modName] = record[2]
+                self.dictModBase['%s:DATA' % modName] = record[3]
         return 0
 
     #
@@ -411,53 +701,11 @@ class Symbols:
         # For example,
         # self.dictSymbolAddress[FspSecCore:___guard_fids_count] = 0x00fffa4778
         #
-        modSymbols  = {}
-        fdIn        = open(mapFile, "r")
-        reportLines = fdIn.readlines()
-        fdIn.close()
-
         moduleEntryPoint = "__ModuleEntryPoint"
-        reportLine = reportLines[0]
-        if reportLine.strip().find("Archive member included") != -1:
-            #GCC
-            #                0x0000000000001d55                IoRead8
-            patchMapFileMatchString = "\s+(0x[0-9a-fA-F]{16})\s+([^\s][^0x][_a-zA-Z0-9\-]+)\s"
-            matchKeyGroupIndex = 2
-            matchSymbolGroupIndex  = 1
-            prefix = '_'
-        else:
-            #MSFT
-            #0003:00000190       _gComBase                  00007a50     SerialPo
-            patchMapFileMatchString =  "^\s[0-9a-fA-F]{4}:[0-9a-fA-F]{8}\s+(\w+)\s+([0-9a-fA-F]{8,16}\s+)"
-            matchKeyGroupIndex = 1
-            matchSymbolGroupIndex  = 2
-            prefix = ''
-
-        for reportLine in reportLines:
-            match = re.match(patchMapFileMatchString, reportLine)
-            if match is not None:
-                modSymbols[prefix + match.group(matchKeyGroupIndex)] = match.group(matchSymbolGroupIndex)
-
-        # Handle extra module patchable PCD variable in Linux map since it might have different format
-        # .data._gPcd_BinaryPatch_PcdVpdBaseAddress
-        #        0x0000000000003714        0x4 /tmp/ccmytayk.ltrans1.ltrans.o
-        handleNext = False
-        if matchSymbolGroupIndex == 1:
-            for reportLine in reportLines:
-                if handleNext:
-                    handleNext = False
-                    pcdName = match.group(1)
-                    match   = re.match("\s+(0x[0-9a-fA-F]{16})\s+", reportLine)
-                    if match is not None:
-                        modSymbols[prefix + pcdName] = match.group(1)
-                else:
-                    match = re.match("^\s\.data\.(_gPcd_BinaryPatch[_a-zA-Z0-9\-]+)", reportLine)
-                    if match is not None:
-                        handleNext = True
-                        continue
+        modSymbols, isGcc = self.scanCached (scanModMapFile, mapFile)
 
         if not moduleEntryPoint in modSymbols:
-            if matchSymbolGroupIndex == 2:
+            if not isGcc:
                 if not '_ModuleEntryPoint' in modSymbols:
                     return 1
                 else:
@@ -499,6 +747,8 @@ class Symbols:
             match = re.match("([0-9a-fA-F\-]+)\s([_a-zA-Z0-9]+)", rptLine)
             if match is not None:
                 self.dictGuidNameXref[match.group(1).upper()] = match.group(2)
+                if match.group(2) not in self.dictNameGuidXref:
+                    self.dictNameGuidXref[match.group(2)] = match.group(1).upper()
             rptLine  = fdIn.readline()
         fdIn.close()
         return 0
@@ -599,7 +849,7 @@ class Symbols:
     def parseBrace(self):
         self.skipSpace()
         char = self.getCurr()
-        parenthesisType = self.parenthesisOpenSet.find(char)
+        parenthesisType = self.parenthesisOpenSet.find(char) if char else -1
         if parenthesisType >= 0:
             self.moveNext()
             value = self.parseExpr()
@@ -706,12 +956,9 @@ class Symbols:
     #  retval      value
     #
     def getModGuid(self, var):
-        guid = (guid for guid,name in self.dictGuidNameXref.items() if name==var)
-        try:
-            value = guid.next()
-        except Exception:
+        if var not in self.dictNameGuidXref:
             raise Exception("Unknown module name %s !" % var)
-        return value
+        return self.dictNameGuidXref[var]
 
     #
     #  Get variable
@@ -745,6 +992,8 @@ class Symbols:
     #  retval      value
     #
     def getContent(self, value):
+        if self.fdSession:
+            return self.fdSession.readData (self.toOffset(value), 4)
         return readDataFromFile (self.fdFile, self.toOffset(value), 4)
 
     #
@@ -818,6 +1067,207 @@ class Symbols:
             raise Exception("Unknown symbol %s !" % value)
         return ret
 
+    #
+    #  Compile value
+    #
+    #  retval      function returning the value for a Symbols object
+    #
+    def compileValue(self):
+        self.skipSpace()
+        var = ''
+        while not self.isLast():
+            char = self.getCurr()
+            if char.lower() in '_ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789:-':
+                var += char
+                self.moveNext()
+            else:
+                break
+
+        if ':' in var:
+            partList = var.split(':')
+            lenList  = len(partList)
+            if lenList != 2 and lenList != 3:
+                raise Exception("Unrecognized expression %s" % var)
+            modName = partList[lenList-2]
+            modOff  = partList[lenList-1]
+            if ('-' not in  modName) and (modOff[0] in '0123456789'):
+                # MOD: OFFSET
+                def getModOff(symbols):
+                    guidOff = symbols.getModGuid(modName) + ":" + modOff
+                    if '-' in guidOff:
+                        return int(symbols.getGuidOff(guidOff))
+                    value = symbols.getSymbols(guidOff)
+                    symbols.synUsed = True
+                    return int(value)
+                return getModOff
+            if '-' in var:  # GUID:OFFSET
+                return lambda symbols: int(symbols.getGuidOff(var))
+            def getSymbols(symbols):
+                value = symbols.getSymbols(var)
+                symbols.synUsed = True
+                return int(value)
+            return getSymbols
+        else:
+            if var[0] in '0123456789':
+                value = int(self.getNumber(var))
+                return lambda symbols: value
+            else:
+                return lambda symbols: int(symbols.getVariable(var))
+
+    #
+    #  Compile single operation
+    #
+    #  retval      function returning the value for a Symbols object
+    #
+    def compileSingleOp(self):
+        self.skipSpace()
+        char = self.getCurr()
+        if char == '~':
+            self.moveNext()
+            operand = self.compileBrace()
+            return lambda symbols: ~operand(symbols)
+        else:
+            return self.compileValue()
+
+    #
+    #  Compile symbol of Brace([, {, <)
+    #
+    #  retval      function returning the value for a Symbols object
+    #
+    def compileBrace(self):
+        self.skipSpace()
+        char = self.getCurr()
+        parenthesisType = self.parenthesisOpenSet.find(char) if char else -1
+        if parenthesisType >= 0:
+            self.moveNext()
+            inner = self.compileExpr()
+            self.skipSpace()
+            if self.getCurr() != self.parenthesisCloseSet[parenthesisType]:
+                raise Exception("No closing brace")
+            self.moveNext()
+            if parenthesisType   == 1:  # [ : Get content
+                return lambda symbols: symbols.getContent(inner(symbols))
+            elif parenthesisType == 2:  # { : To  address
+                return lambda symbols: symbols.toAddress(inner(symbols))
+            elif parenthesisType == 3:  # < : To  offset
+                return lambda symbols: symbols.toOffset(inner(symbols))
+            return inner
+        else:
+            return self.compileSingleOp()
+
+    #
+    #  Compile symbol of Multiplier(*)
+    #
+    #  retval      function returning the value for a Symbols object
+    #
+    def compileMul(self):
+        operands = [self.compileBrace()]
+        while True:
+            self.skipSpace()
+            char = self.getCurr()
+            if char == '*':
+                self.moveNext()
+                operands.append(self.compileBrace())
+            else:
+                break
+        if len(operands) == 1:
+            return operands[0]
+        def mul(symbols):
+            value = 1
+            for each in operands:
+                value *= each(symbols)
+            return value
+        return mul
+
+    #
+    #  Compile symbol of And(&) and Or(|)
+    #
+    #  retval      function returning the value for a Symbols object
+    #
+    def compileAndOr(self):
+        first    = self.compileMul()
+        operands = []
+        while True:
+            self.skipSpace()
+            char = self.getCurr()
+            if char == '&' or char == '|':
+                self.moveNext()
+                operands.append((char, self.compileMul()))
+            else:
+                break
+        if len(operands) == 0:
+            return first
+        def andOr(symbols):
+            value = first(symbols)
+            for op, each in operands:
+                if op == '&':
+                    value &= each(symbols)
+                else:
+                    value |= each(symbols)
+            return value
+        return andOr
+
+    #
+    #  Compile symbol of Add(+) and Minus(-)
+    #
+    #  retval      function returning the value for a Symbols object
+    #
+    def compileAddMinus(self):
+        operands = [(1, self.compileAndOr())]
+        while True:
+            self.skipSpace()
+            char = self.getCurr()
+            if char == '+':
+                self.moveNext()
+                operands.append((1, self.compileAndOr()))
+            elif char == '-':
+                self.moveNext()
+                operands.append((-1, self.compileAndOr()))
+            else:
+                break
+        if len(operands) == 1:
+            return operands[0][1]
+        def addMinus(symbols):
+            return sum([sign * each(symbols) for sign, each in operands])
+        return addMinus
+
+    #
+    #  Compile expression
+    #
+    #  retval      self.compileAddMinus()
+    #
+    def compileExpr(self):
+        return self.compileAddMinus()
+
+    #
+    #  Compile an expression, or get it from the cache of compiled expressions
+    #
+    #  The symbols, GUIDs, variables and FD contents an expression refers to
+    #  are looked up each time the compiled expression is called, so it is
+    #  shared by all the Symbols objects.
+    #
+    #  param [in]  expression
+    #
+    #  retval      function    Function returning the value for a Symbols object
+    #  retval      None        The expression has an error, it is to be parsed
+    #                          by getResult() to report it
+    #
+    def compileExpression(self, expression):
+        key = re.sub('[ \t]+', ' ', expression).strip(' ')
+        if key in Symbols.compiledExpressions:
+            return Symbols.compiledExpressions[key]
+        self.index  = 0
+        self.string = key
+        try:
+            program = self.compileExpr()
+            self.skipSpace()
+            if not self.isLast():
+                program = None
+        except Exception:
+            program = None
+        Symbols.compiledExpressions[key] = program
+        return program
+
     #
     #  Evaluate symbols
     #
@@ -827,10 +1277,14 @@ class Symbols:
     #  retval      value & 0xFFFFFFFF
     #
     def evaluate(self, expression, isOffset):
-        self.index     = 0
+        program = self.compileExpression(expression)
         self.synUsed   = False
-        self.string    = expression
-        value = self.getResult()
+        if program is not None:
+            value = program(self)
+        else:
+            self.index     = 0
+            self.string    = expression
+            value = self.getResult()
         if isOffset:
             if self.synUsed:
                 # Consider it as an address first
@@ -851,6 +1305,86 @@ def Usage():
     print ("PatchFv Version 0.50")
     print ("Usage: \n\tPatchFv FvBuildDir [FvFileBaseNames:]FdFileBaseNameToPatch \"Offset, Value\"")
 
+#
+#  Patch the FD file
+#
+#  param [in]  symTables   Symbols of the FD file
+#  param [in]  patchList   "Offset, Value[, $Command][, @Comment]" arguments
+#  param [in]  session     FdPatchSession on the FD file
+#
+#  retval      0           Patched the FD file successfully
+#
+def patchFd(symTables, patchList, session):
+    fdSize = symTables.getFdSize()
+    symTables.fdSession = session
+    for fvFile in patchList:
+        #
+        # Check to see if it has enough arguments
+        #
+        items = fvFile.split(",")
+        if len (items) < 2:
+            raise Exception("Expect more arguments for '%s'!" % fvFile)
+
+        comment = ""
+        command = ""
+        params  = []
+        for item in items:
+            item = item.strip()
+            if item.startswith("@"):
+                comment = item[1:]
+            elif item.startswith("$"):
+                command = item[1:]
+            else:
+                if len(params) == 0:
+                    isOffset = True
+                else :
+                    isOffset = False
+                #
+                # Parse symbols then append it to params
+                #
+                params.append (symTables.evaluate(item, isOffset))
+
+        #
+        # Patch a new value into FD file if it is not a command
+        #
+        if command == "":
+            # Patch a DWORD
+            if len (params) == 2:
+                offset   = params[0]
+                value    = params[1]
+                oldvalue = session.readData(offset, 4)
+                ret = session.patchData (offset, value, 4, comment) - 4
+            else:
+                raise Exception ("Patch command needs 2 parameters !")
+
+            if ret:
+                raise Exception ("Patch failed for offset 0x%08X" % offset)
+            else:
+                print ("Patched offset 0x%08X:[%08X] with value 0x%08X  # %s" % (offset, oldvalue, value, comment))
+
+        elif command == "COPY":
+            #
+            # Copy binary block from source to destination
+            #
+            if len (params) == 3:
+                src  = symTables.toOffset(params[0])
+                dest = symTables.toOffset(params[1])
+                clen = symTables.toOffset(params[2])
+                if (dest + clen <= fdSize) and (src + clen <= fdSize):
+                    ret = session.copyData (src, dest, clen, comment) - clen
+                else:
+                    raise Exception ("Copy command OFFSET or LENGTH parameter is invalid !")
+            else:
+                raise Exception ("Copy command needs 3 parameters !")
+
+            if ret:
+                raise Exception ("Copy failed from offset 0x%08X to offset 0x%08X!" % (src, dest))
+            else :
+                print ("Copied %d bytes from offset 0x%08X ~ offset 0x%08X  # %s" % (clen, src, dest, comment))
+        else:
+            raise Exception ("Unknown command %s!" % command)
+    return 0
+
 def main():
     #
     # Parse the options and args
@@ -872,10 +1406,9 @@ def main():
         return 2
 
     #
-    # Get FD file and size
+    # Get FD file
     #
     fdFile = symTables.getFdFile()
-    fdSize = symTables.getFdSize()
 
     try:
         #
@@ -884,74 +1417,12 @@ def main():
         ret = IsFspHeaderValid(fdFile)
         if ret == False:
           raise Exception ("The FSP header is not valid. Stop patching FD.")
-        comment = ""
-        for fvFile in  sys.argv[3:]:
-            #
-            # Check to see if it has enough arguments
-            #
-            items = fvFile.split(",")
-            if len (items) < 2:
-                raise Exception("Expect more arguments for '%s'!" % fvFile)
-
-            comment = ""
-            command = ""
-            params  = []
-            for item in items:
-                item = item.strip()
-                if item.startswith("@"):
-                    comment = item[1:]
-                elif item.startswith("$"):
-                    command = item[1:]
-                else:
-                    if len(params) == 0:
-                        isOffset = True
-                    else :
-                        isOffset = False
-                    #
-                    # Parse symbols then append it to params
-                    #
-                    params.append (symTables.evaluate(item, isOffset))
-
-            #
-            # Patch a new value into FD file if it is not a command
-            #
-            if command == "":
-                # Patch a DWORD
-                if len (params) == 2:
-                    offset   = params[0]
-                    value    = params[1]
-                    oldvalue = readDataFromFile(fdFile, offset, 4)
-                    ret = patchDataInFile (fdFile, offset, value, 4) - 4
-                else:
-                    raise Exception ("Patch command needs 2 parameters !")
-
-                if ret:
-                    raise Exception ("Patch failed for offset 0x%08X" % offset)
-                else:
-                    print ("Patched offset 0x%08X:[%08X] with value 0x%08X  # %s" % (offset, oldvalue, value, comment))
-
-            elif command == "COPY":
-                #
-                # Copy binary block from source to destination
-                #
-                if len (params) == 3:
-                    src  = symTables.toOffset(params[0])
-                    dest = symTables.toOffset(params[1])
-                    clen = symTables.toOffset(params[2])
-                    if (dest + clen <= fdSize) and (src + clen <= fdSize):
-                        oldvalue = readDataFromFile(fdFile, src, clen)
-                        ret = patchDataInFile (fdFile, dest, oldvalue, clen) - clen
-                    else:
-                        raise Exception ("Copy command OFFSET or LENGTH parameter is invalid !")
-                else:
-                    raise Exception ("Copy command needs 3 parameters !")
-
-                if ret:
-                    raise Exception ("Copy failed from offset 0x%08X to offset 0x%08X!" % (src, dest))
-                else :
-                    print ("Copied %d bytes from offset 0x%08X ~ offset 0x%08X  # %s" % (clen, src, dest, comment))
-            else:
-                raise Exception ("Unknown command %s!" % command)
+        #
+        # Patch the FD image in memory, and write it once all the patches are done
+        #
+        session = FdPatchSession(fdFile)
+        patchFd(symTables, sys.argv[3:], session)
+        session.close()
         return 0
 
     except Exception as ex:
@@ -9,6 +9,7 @@ import os
 import sys
 import uuid
 import copy
+import json
 import struct
 import argparse
 from   ctypes import *
@@ -337,6 +338,9 @@ class EFI_SECTION_TYPE:
     PEI_DEPEX                  = 0x1b
     SMM_DEPEX                  = 0x1c
 
+RELOC_HIGHLOW = struct.Struct('<I')
+RELOC_DIR64   = struct.Struct('<Q')
+
 def AlignPtr (offset, alignment = 8):
     return (offset + alignment - 1) & ~(alignment - 1)
 
@@ -446,16 +450,24 @@ class FirmwareFile:
         self.FfsHdr   = EFI_FFS_FILE_HEADER.from_buffer (filedata, 0)
         self.FfsData  = filedata[0:int(self.FfsHdr.Size)]
         self.Offset   = offset
-        self.SecList  = []
+        self.Sections = None
+
+    @property
+    def SecList(self):
+        # Sections are only decoded for the files they are asked for
+        if self.Sections is None:
+            self.ParseFfs()
+        return self.Sections
 
     def ParseFfs(self):
         ffssize = len(self.FfsData)
         offset  = sizeof(self.FfsHdr)
+        self.Sections = []
         if self.FfsHdr.Name != '\xff' * 16:
             while offset < (ffssize - sizeof (EFI_COMMON_SECTION_HEADER)):
                 sechdr = EFI_COMMON_SECTION_HEADER.from_buffer (self.FfsData, offset)
                 sec = Section (offset, self.FfsData[offset:offset + int(sechdr.Size)])
-                self.SecList.append(sec)
+                self.Sections.append(sec)
                 offset += int(sechdr.Size)
                 offset  = AlignPtr(offset, 4)
 
@@ -483,7 +495,6 @@ class FirmwareVolume:
                 offset = fvsize
             else:
                 ffs = FirmwareFile (offset, self.FvData[offset:offset + int(ffshdr.Size)])
-                ffs.ParseFfs()
                 self.FfsList.append(ffs)
                 offset += int(ffshdr.Size)
                 offset = AlignPtr(offset)
@@ -531,9 +542,13 @@ class FirmwareDevice:
         self.FspList = []
         self.FdFile = fdfile
         self.Offset = 0
+        # Read the FD once, FVs, files, sections and images are memoryview
+        # windows over this buffer instead of copies of it
+        self.FdData = bytearray(os.path.getsize(self.FdFile))
         hfsp = open (self.FdFile, 'rb')
-        self.FdData = bytearray(hfsp.read())
+        hfsp.readinto(self.FdData)
         hfsp.close()
+        self.FdView = memoryview(self.FdData)
 
     def ParseFd(self):
         offset = 0
@@ -543,7 +558,7 @@ class FirmwareDevice:
             fvh = EFI_FIRMWARE_VOLUME_HEADER.from_buffer (self.FdData, offset)
             if b'_FVH' != fvh.Signature:
                 raise Exception("ERROR: Invalid FV header !")
-            fv = FirmwareVolume (offset, self.FdData[offset:offset + fvh.FvLength])
+            fv = FirmwareVolume (offset, self.FdView[offset:offset + fvh.FvLength])
             fv.ParseFv ()
             self.FvList.append(fv)
             offset += fv.FvHdr.FvLength
@@ -638,7 +653,7 @@ class PeTeImage:
     def IsTeImage(self):
         return  self.TeHdr is not None
 
-    def ParseReloc(self):
+    def GetRelocDirectory(self):
         if self.IsTeImage():
             rsize   = self.TeHdr.DataDirectoryBaseReloc.Size
             roffset = sizeof(self.TeHdr) - self.TeHdr.StrippedSize + self.TeHdr.DataDirectoryBaseReloc.VirtualAddress
@@ -649,6 +664,10 @@ class PeTeImage:
             if self.PeHdr.OptionalHeader.PePlusOptHdr.Magic == 0x20b: # PE32+ image
                 rsize   = self.PeHdr.OptionalHeader.PePlusOptHdr.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY.BASERELOC].Size
                 roffset = self.PeHdr.OptionalHeader.PePlusOptHdr.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY.BASERELOC].VirtualAddress
+        return (roffset, rsize)
+
+    def ParseReloc(self):
+        (roffset, rsize) = self.GetRelocDirectory()
 
         alignment = 4
         offset = roffset
@@ -674,6 +693,69 @@ class PeTeImage:
                 self.RelocList.append((rtype, aoff))
             offset += sizeof(rdata)
 
+    def ParseRelocTable(self):
+        # Decode every relocation block at once into runs of image offsets
+        # sharing the same relocation type, kept in the order of the table
+        (roffset, rsize) = self.GetRelocDirectory()
+        adjust = 0
+        if self.IsTeImage():
+            adjust = sizeof(self.TeHdr) - self.TeHdr.StrippedSize
+
+        self.RelocTable = []
+        offset = roffset
+        while offset < roffset + rsize:
+            offset = AlignPtr(offset, 4)
+            blkhdr = PE_RELOC_BLOCK_HEADER.from_buffer(self.Data, offset)
+            offset += sizeof(blkhdr)
+            rlen   = blkhdr.BlockSize - sizeof(PE_RELOC_BLOCK_HEADER)
+            rnum   = int (rlen/sizeof(c_uint16))
+            rdata  = struct.unpack_from('<%dH' % rnum, self.Data, offset)
+            page   = blkhdr.PageRVA + adjust
+            rtypes = set([each >> 12 for each in rdata])
+            rtypes.discard(0) # IMAGE_REL_BASED_ABSOLUTE
+            if len(rtypes) == 1 and rtypes <= set([3, 10]):
+                # IMAGE_REL_BASED_HIGHLOW or IMAGE_REL_BASED_DIR64 only
+                rtype = rtypes.pop()
+                roffs = [page + (each & 0xfff) for each in rdata if each >> 12]
+                self.AppendRelocRun(rtype, roffs)
+            else:
+                for each in rdata:
+                    rtype = each >> 12
+                    if rtype == 0: # IMAGE_REL_BASED_ABSOLUTE:
+                        continue
+                    if ((rtype != 3) and (rtype != 10)): # IMAGE_REL_BASED_HIGHLOW and IMAGE_REL_BASED_DIR64
+                        raise Exception("ERROR: Unsupported relocation type %d!" % rtype)
+                    self.AppendRelocRun(rtype, [page + (each & 0xfff)])
+            offset += rnum * sizeof(c_uint16)
+
+    def AppendRelocRun(self, rtype, roffs):
+        if self.RelocTable and self.RelocTable[-1][0] == rtype:
+            self.RelocTable[-1][1].extend(roffs)
+        else:
+            self.RelocTable.append((rtype, roffs))
+
+    def RebaseTable(self, delta, fdbin):
+        count = 0
+        if delta == 0:
+            return count
+
+        for (rtype, roffs) in self.RelocTable:
+            if rtype == 3: # IMAGE_REL_BASED_HIGHLOW
+                fmt  = RELOC_HIGHLOW
+                mask = 0xFFFFFFFF
+            else:          # IMAGE_REL_BASED_DIR64
+                fmt  = RELOC_DIR64
+                mask = 0xFFFFFFFFFFFFFFFF
+            unpack = fmt.unpack_from
+            pack   = fmt.pack_into
+            for roff in roffs:
+                offset = roff + self.Offset
+                pack(fdbin, offset, (unpack(fdbin, offset)[0] + delta) & mask)
+            count += len(roffs)
+
+        self.PatchImageBase(delta, fdbin)
+        return count
+
     def Rebase(self, delta, fdbin):
         count = 0
         if delta == 0:
@@ -695,6 +777,10 @@ class PeTeImage:
             else:
                 raise Exception('ERROR: Unknown relocation type %d !' % rtype)
 
+        self.PatchImageBase(delta, fdbin)
+        return count
+
+    def PatchImageBase(self, delta, fdbin):
         if self.IsTeImage():
             offset  = self.Offset + EFI_TE_IMAGE_HEADER.ImageBase.offset
             size    = EFI_TE_IMAGE_HEADER.ImageBase.size
@@ -711,8 +797,6 @@ class PeTeImage:
         value  = Bytes2Val(fdbin[offset:offset+size]) + delta
         fdbin[offset:offset+size] = Val2Bytes(value, size)
 
-        return count
-
 def ShowFspInfo (fspfile):
     fd = FirmwareDevice(0, fspfile)
     fd.ParseFd  ()
@@ -789,7 +873,44 @@ def SplitFspBin (fspfile, outdir, nametemplate):
             hfsp.write(fv.FvData)
         hfsp.close()
 
-def RebaseFspBin (FspBinary, FspComponent, FspBase, OutputDir, OutputFile):
+def PlanFspRebase (fd, FspComponent, FspBase):
+    # Map the FSP components to rebase to their FSP image once
+    fspmap = {}
+    for fspidx, fsp in enumerate(fd.FspList):
+        # Is this FSP 1.x single binary?
+        if fsp.Fih.HeaderRevision < 3:
+            fspmap.setdefault('x', fspidx)
+        else:
+            fspmap.setdefault(fsp.Type.lower(), fspidx)
+
+    plan = []
+    for idx, fspcomp in enumerate(FspComponent):
+        fspidx = fspmap.get('x', fspmap.get(fspcomp))
+        if fspidx is None:
+            print ("ERROR: Could not find FSP_%c component to rebase !" % fspcomp.upper())
+            return None
+
+        fspbase = FspBase[idx]
+        if fspbase.startswith('0x'):
+            newbase = int(fspbase, 16)
+        else:
+            newbase = int(fspbase)
+
+        # A component given more than once is rebased by the sum of its deltas
+        fsp   = fd.FspList[fspidx]
+        delta = newbase - fsp.Fih.ImageBase
+        for each in plan:
+            if each['FspIdx'] == fspidx:
+                each['Delta']  += delta
+                each['NewBase'] = each['OldBase'] + each['Delta']
+                break
+        else:
+            ftype = 'X' if fsp.Fih.HeaderRevision < 3 else fsp.Type
+            plan.append({'FspIdx' : fspidx, 'Component' : ftype, 'OldBase' : fsp.Fih.ImageBase,
+                         'NewBase' : newbase, 'Delta' : delta})
+    return plan
+
+def RebaseFspBin (FspBinary, FspComponent, FspBase, OutputDir, OutputFile, ReportFile = ''):
     fd = FirmwareDevice(0, FspBinary)
     fd.ParseFd  ()
     fd.ParseFsp ()
@@ -800,60 +921,53 @@ def RebaseFspBin (FspBinary, FspComponent, FspBase, OutputDir, OutputFile):
         print ("ERROR: Required number of base does not match number of FSP component !")
         return
 
-    newfspbin = fd.FdData[:]
-
-    for idx, fspcomp in enumerate(FspComponent):
-
-        found = False
-        for fsp in fd.FspList:
-            # Is this FSP 1.x single binary?
-            if fsp.Fih.HeaderRevision < 3:
-                found = True
-                ftype = 'X'
-                break
-            ftype = fsp.Type.lower()
-            if ftype == fspcomp:
-                found = True
-                break
-
-        if not found:
-            print ("ERROR: Could not find FSP_%c component to rebase !" % fspcomp.upper())
-            return
-
-        fspbase = baselist[idx]
-        if fspbase.startswith('0x'):
-            newbase = int(fspbase, 16)
-        else:
-            newbase = int(fspbase)
-        oldbase = fsp.Fih.ImageBase
-        delta = newbase - oldbase
-        print ("Rebase FSP-%c from 0x%08X to 0x%08X:" % (ftype.upper(),oldbase,newbase))
+    plan = PlanFspRebase (fd, FspComponent, baselist)
+    if plan is None:
+        return
 
-        imglist = []
-        for fvidx in fsp.FvIdxList:
-            fv = fd.FvList[fvidx]
-            for ffs in fv.FfsList:
-                for sec in ffs.SecList:
-                    if sec.SecHdr.Type in [EFI_SECTION_TYPE.TE, EFI_SECTION_TYPE.PE32]:   # TE or PE32
-                        offset = fd.Offset + fv.Offset + ffs.Offset + sec.Offset + sizeof(sec.SecHdr)
-                        imglist.append ((offset, len(sec.SecData) - sizeof(sec.SecHdr)))
-
-        fcount  = 0
-        pcount  = 0
-        for (offset, length) in imglist:
-            img = PeTeImage(offset, fd.FdData[offset:offset + length])
-            img.ParseReloc()
-            pcount += img.Rebase(delta, newfspbin)
-            fcount += 1
-
-        print ("  Patched %d entries in %d TE/PE32 images." % (pcount, fcount))
-
-        (count, applied) = fsp.Patch(delta, newfspbin)
+    # Classify the FVs by the FSP component they belong to
+    fvowner = {}
+    for each in plan:
+        each['Images']       = 0
+        each['RelocEntries'] = 0
+        for fvidx in fd.FspList[each['FspIdx']].FvIdxList:
+            fvowner[fvidx] = each
+
+    # Rebase the TE/PE32 images of all the components in one walk of the FD,
+    # the FD buffer is patched in place
+    newfspbin = fd.FdData
+    for fvidx, fv in enumerate(fd.FvList):
+        each = fvowner.get(fvidx)
+        if each is None:
+            continue
+        for ffs in fv.FfsList:
+            for sec in ffs.SecList:
+                if sec.SecHdr.Type in [EFI_SECTION_TYPE.TE, EFI_SECTION_TYPE.PE32]:   # TE or PE32
+                    offset = fd.Offset + fv.Offset + ffs.Offset + sec.Offset + sizeof(sec.SecHdr)
+                    length = len(sec.SecData) - sizeof(sec.SecHdr)
+                    img = PeTeImage(offset, fd.FdView[offset:offset + length])
+                    img.ParseRelocTable()
+                    each['RelocEntries'] += img.RebaseTable(each['Delta'], newfspbin)
+                    each['Images']       += 1
+
+    for each in plan:
+        fsp = fd.FspList[each['FspIdx']]
+        (count, applied) = fsp.Patch(each['Delta'], newfspbin)
+        each['PatchEntries']        = applied
+        each['InvalidPatchEntries'] = count - applied
+
+        print ("Rebase FSP-%c from 0x%08X to 0x%08X:" % (each['Component'], each['OldBase'], each['NewBase']))
+        print ("  Patched %d entries in %d TE/PE32 images." % (each['RelocEntries'], each['Images']))
         print ("  Patched %d entries using FSP patch table." % applied)
         if count != applied:
             print ("  %d invalid entries are ignored !" % (count - applied))
 
     if OutputFile == '':
+        fspbase = baselist[-1]
+        if fspbase.startswith('0x'):
+            newbase = int(fspbase, 16)
+        else:
+            newbase = int(fspbase)
         filename = os.path.basename(FspBinary)
         base, ext  = os.path.splitext(filename)
         OutputFile = base + "_%08X" % newbase + ext
@@ -864,6 +978,23 @@ def RebaseFspBin (FspBinary, FspComponent, FspBase, OutputDir, OutputFile):
     fd.write(newfspbin)
     fd.close()
 
+    if ReportFile != '':
+        report = {'FspBinary' : FspBinary, 'OutputFile' : filename, 'Components' : []}
+        for each in plan:
+            report['Components'].append({
+                'Component'           : each['Component'],
+                'OldBase'             : '0x%08X' % each['OldBase'],
+                'NewBase'             : '0x%08X' % each['NewBase'],
+                'Images'              : each['Images'],
+                'RelocEntries'        : each['RelocEntries'],
+                'PatchEntries'        : each['PatchEntries'],
+                'InvalidPatchEntries' : each['InvalidPatchEntries']
+                })
+        hrpt = open(ReportFile, 'w')
+        json.dump(report, hrpt, indent = 2)
+        hrpt.write('\n')
+        hrpt.close()
+
 def main ():
     parser     = argparse.ArgumentParser()
     subparsers = parser.add_subparsers(title='commands', dest="which")
@@ -875,6 +1006,7 @@ def main ():
     parser_rebase.add_argument('-b',  '--newbase', dest='FspBase', nargs='+', type=str, help='Rebased FSP binary file name', default = '', required = True)
     parser_rebase.add_argument('-o',  '--outdir' , dest='OutputDir',  type=str, help='Output directory path', default = '.')
     parser_rebase.add_argument('-n',  '--outfile', dest='OutputFile', type=str, help='Rebased FSP binary file name', default = '')
+    parser_rebase.add_argument('-r',  '--report' , dest='ReportFile', type=str, help='JSON report file of the patched entries', default = '')
 
     parser_split  = subparsers.add_parser('split',  help='split a FSP into multiple components')
     parser_split.set_defaults(which='split')
@@ -900,7 +1032,7 @@ def main ():
             raise Exception ("ERROR: Invalid output directory '%s' !" % args.OutputDir)
 
     if args.which == 'rebase':
-        RebaseFspBin (args.FspBinary, args.FspComponent, args.FspBase, args.OutputDir, args.OutputFile)
+        RebaseFspBin (args.FspBinary, args.FspComponent, args.FspBase, args.OutputDir, args.OutputFile, args.ReportFile)
     elif args.which == 'split':
         SplitFspBin (args.FspBinary, args.OutputDir, args.NameTemplate)
     elif args.which == 'genhdr':
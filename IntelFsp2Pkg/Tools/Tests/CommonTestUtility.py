@@ -0,0 +1,38 @@
+## @file
+#  File helpers shared by the regression tests and timing tests of the FSP
+#  tools.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+#
+# Read the lines of a text file, with their line feeds when keepEnds is set
+#
+def ReadLines(path, keepEnds = False):
+    fd = open(path, 'r')
+    if keepEnds:
+        lines = fd.readlines()
+    else:
+        lines = fd.read().splitlines()
+    fd.close()
+    return lines
+
+#
+# Write lines to a text file, a line feed is added to the lines without one
+#
+def WriteLines(path, lines):
+    fd = open(path, 'w')
+    fd.write(''.join([line if line.endswith('\n') else line + '\n' for line in lines]))
+    fd.close()
+
+#
+# Read the content of a binary file
+#
+def ReadFile(path):
+    fd = open(path, 'rb')
+    data = fd.read()
+    fd.close()
+    return data
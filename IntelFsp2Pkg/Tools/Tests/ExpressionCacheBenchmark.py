@@ -0,0 +1,205 @@
+## @file
+#  Micro-benchmark of the compiled expression cache of the FSP tools.
+#
+#  The DSC conditions of GenCfgOpt.py and FspGenCfgData.py and the patch
+#  expressions of PatchFv.py are evaluated once by parsing their text every
+#  time and once through the cache of compiled expressions. The results must
+#  be the same, and QemuFspPkg.dsc must parse to the same configuration.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import argparse
+import os
+import random
+import shutil
+import sys
+import tempfile
+import time
+
+currentdir = os.path.dirname(os.path.realpath(__file__))
+parentdir = os.path.dirname(currentdir)
+sys.path.append(parentdir)
+import FspGenCfgData
+import GenCfgOpt
+import PatchFv
+
+DSC_FILE = os.path.join(currentdir, "QemuFspPkg.dsc")
+
+DSC_CONDITIONS = [
+    "$(TARGET) == DEBUG",
+    "$(TARGET) == RELEASE AND $(BENCH_LEVEL) > 2",
+    "NOT ($(BENCH_LEVEL) == 0) OR $(BENCH_FLAG)",
+    "gIntelFsp2PkgTokenSpaceGuid.PcdFspHeapSizePercentage == 65 OR $(BENCH_LEVEL) >= 2",
+    "$(BENCH_FLAG) XOR (gQemuFspPkgTokenSpaceGuid.PcdFspHeaderRevision == 0x03)",
+    "$(UNDEFINED_MACRO) != DEBUG AND (0x%x < $(BENCH_LEVEL))",
+]
+
+PATCH_EXPRESSIONS = [
+    "0x%(Value)08X",
+    "Module%(Module)d:Symbol%(Symbol)d + 0x%(Value)X",
+    "[Module%(Module)d:Symbol%(Symbol)d] & 0xFFFF",
+    "{0x%(Value)X} - FDBASE + Module%(Module)d:Symbol%(Symbol)d",
+    "<Module%(Module)d:Symbol%(Symbol)d> * 2 | 0x%(Value)X",
+]
+
+#
+#  Evaluate the expressions by parsing their text every time
+#
+def DisableCache():
+    def EvaluateText(self, Expr, MacroDict, PcdsDict, Expand):
+        return self.evaluateExpress(Expand(Expr))
+    Saved = (GenCfgOpt.CLogicalExpression.evaluateCompiled,
+             FspGenCfgData.CLogicalExpression.evaluateCompiled,
+             PatchFv.Symbols.compileExpression)
+    GenCfgOpt.CLogicalExpression.evaluateCompiled = EvaluateText
+    FspGenCfgData.CLogicalExpression.evaluateCompiled = EvaluateText
+    PatchFv.Symbols.compileExpression = lambda self, expression: None
+    return Saved
+
+def RestoreCache(Saved):
+    (GenCfgOpt.CLogicalExpression.evaluateCompiled,
+     FspGenCfgData.CLogicalExpression.evaluateCompiled,
+     PatchFv.Symbols.compileExpression) = Saved
+
+#
+#  Write QemuFspPkg.dsc with blocks of conditional macros in its [Defines]
+#
+def CreateDscFile(DscDir, Count):
+    Lines = []
+    for Index in range(Count):
+        Condition = random.choice(DSC_CONDITIONS)
+        if '%' in Condition:
+            Condition = Condition % random.randrange(8)
+        Lines.append("!if %s" % Condition)
+        Lines.append("  DEFINE BENCH_VALUE%d = 0x%X" % (Index, Index))
+        Lines.append("!else")
+        Lines.append("  DEFINE BENCH_VALUE%d = 0" % Index)
+        Lines.append("!endif")
+    fd = open(DSC_FILE, "r")
+    Dsc = fd.read()
+    fd.close()
+    Dsc = Dsc.replace("[Defines]\n", "[Defines]\n" + "\n".join(Lines) + "\n", 1)
+    DscFile = os.path.join(DscDir, "BenchFspPkg.dsc")
+    fd = open(DscFile, "w")
+    fd.write(Dsc)
+    fd.close()
+    return DscFile
+
+def ParseDsc(Module, DscFile):
+    Macros = ["-D", "TARGET=RELEASE", "-D", "BENCH_LEVEL=0x3", "-D", "BENCH_FLAG=1"]
+    if Module is GenCfgOpt:
+        CfgOpt = GenCfgOpt.CGenCfgOpt()
+        CfgOpt.ParseMacros(Macros)
+        Start = time.time()
+        if CfgOpt.ParseDscFile(DscFile, os.path.dirname(DscFile)) != 0:
+            raise Exception(CfgOpt.Error)
+    else:
+        CfgOpt = FspGenCfgData.CGenCfgData()
+        CfgOpt.ParseMacros(Macros)
+        Start = time.time()
+        if CfgOpt.ParseDscFile(DscFile) != 0:
+            raise Exception(CfgOpt.Error)
+    Elapsed = time.time() - Start
+    return Elapsed, (CfgOpt._CfgItemList, CfgOpt._PcdsDict, CfgOpt._MacroDict)
+
+#
+#  Parse a DSC file without and with the cache and compare the results
+#
+def CompareDsc(Module, DscFile):
+    Saved = DisableCache()
+    try:
+        TextTime, TextResult = ParseDsc(Module, DscFile)
+    finally:
+        RestoreCache(Saved)
+    Module.CLogicalExpression.CompiledCache.clear()
+    CompiledTime, CompiledResult = ParseDsc(Module, DscFile)
+    if TextResult != CompiledResult:
+        raise Exception("%s parses %s differently with compiled expressions!" % (Module.__name__, DscFile))
+    return TextTime, CompiledTime
+
+#
+#  Evaluate patch expressions without and with the cache and compare them
+#
+def ComparePatch(Count):
+    FdDir = tempfile.mkdtemp()
+    try:
+        FdFile = os.path.join(FdDir, "BENCH.fd")
+        fd = open(FdFile, "wb")
+        fd.write(bytearray(random.getrandbits(8) for Index in range(0x10000)))
+        fd.close()
+        SymTables = PatchFv.Symbols()
+        SymTables.fdFile = FdFile
+        SymTables.fdSize = 0x10000
+        SymTables.fdBase = 0xFFFF0000
+        SymTables.dictVariable = {"FDSIZE": SymTables.fdSize, "FDBASE": SymTables.fdBase}
+        for Module in range(16):
+            for Symbol in range(16):
+                SymTables.dictSymbolAddress["Module%d:Symbol%d" % (Module, Symbol)] = \
+                    "0x00%08x" % (SymTables.fdBase + random.randrange(0x8000))
+
+        #
+        # A patch file refers to the same symbols many times
+        #
+        Patterns = []
+        for Index in range(256):
+            Args = {"Module": random.randrange(16), "Symbol": random.randrange(16), "Value": random.randrange(0x100)}
+            Patterns.append(random.choice(PATCH_EXPRESSIONS) % Args)
+        Expressions = []
+        for Index in range(Count):
+            Expressions.append((random.choice(Patterns), Index & 1 == 1))
+
+        Results = []
+        Saved = DisableCache()
+        try:
+            Start = time.time()
+            for Expression, IsOffset in Expressions:
+                Results.append(SymTables.evaluate(Expression, IsOffset))
+            TextTime = time.time() - Start
+        finally:
+            RestoreCache(Saved)
+        PatchFv.Symbols.compiledExpressions.clear()
+        Start = time.time()
+        for Index, (Expression, IsOffset) in enumerate(Expressions):
+            if SymTables.evaluate(Expression, IsOffset) != Results[Index]:
+                raise Exception("'%s' evaluates differently when compiled!" % Expression)
+        CompiledTime = time.time() - Start
+        return TextTime, CompiledTime
+    finally:
+        shutil.rmtree(FdDir)
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-c", dest="conditions", type=int, default=5000, help="Number of DSC conditions")
+    parser.add_argument("-p", dest="patches", type=int, default=20000, help="Number of patch expressions")
+    args = parser.parse_args()
+
+    random.seed(0x1234)
+    DscDir = tempfile.mkdtemp()
+    try:
+        #
+        # QemuFspPkg.dsc must parse the same way with the cache
+        #
+        for Module in (GenCfgOpt, FspGenCfgData):
+            CompareDsc(Module, DSC_FILE)
+
+        DscFile = CreateDscFile(DscDir, args.conditions)
+        for Module in (GenCfgOpt, FspGenCfgData):
+            TextTime, CompiledTime = CompareDsc(Module, DscFile)
+            print("%s, %d DSC conditions" % (Module.__name__, args.conditions))
+            print("  Parsed every time    : %8.3f s" % TextTime)
+            print("  Compiled and cached  : %8.3f s" % CompiledTime)
+    finally:
+        shutil.rmtree(DscDir)
+
+    TextTime, CompiledTime = ComparePatch(args.patches)
+    print("PatchFv, %d patch expressions" % args.patches)
+    print("  Parsed every time    : %8.3f s" % TextTime)
+    print("  Compiled and cached  : %8.3f s" % CompiledTime)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
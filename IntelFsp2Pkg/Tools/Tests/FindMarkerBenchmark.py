@@ -0,0 +1,70 @@
+## @file
+#  Timing test of the find marker lookup of FspGenCfgData.py over a generated
+#  binary.
+#
+#  A binary with config blocks behind unique find markers is generated. The
+#  blocks are patched with the marker offsets located in one scan of the
+#  binary, and again with a find per marker. The results must be the same
+#  both ways.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import argparse
+import os
+import random
+import sys
+import time
+
+currentdir = os.path.dirname(os.path.realpath(__file__))
+sys.path.append(currentdir)
+import test_gencfgopt
+
+def CreateMarkerData(markerNum, itemNum, binLen):
+    markers = ['CFG_%04d' % idx for idx in range(markerNum)]
+    binDat  = bytearray(os.urandom(binLen))
+    items   = []
+    offset  = 0
+    for idx, pos in enumerate(sorted(random.sample(range(0, binLen - 0x1000, 0x1000), markerNum))):
+        binDat[pos:pos+len(markers[idx])] = markers[idx].encode()
+        for item in range(itemNum):
+            items.append({'find': markers[idx] if item == 0 else '', 'offset': offset, 'length': 4,
+                          'value': '0x%08X' % random.randint(0, 0xFFFFFFFF),
+                          'type': '', 'option': ''})
+            offset += 4
+    return items, binDat
+
+def Measure(cfgData, binDat):
+    start = time.time()
+    result = cfgData.PatchBinaryArray(bytearray(binDat))
+    return time.time() - start, result
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-m", dest="markers", type=int, default=200, help="Number of find markers")
+    parser.add_argument("-i", dest="items", type=int, default=20, help="Number of config items per marker")
+    parser.add_argument("-s", dest="size", type=int, default=16, help="Binary size in MB")
+    args = parser.parse_args()
+
+    random.seed(0x1234)
+    items, binDat = CreateMarkerData(args.markers, args.items, args.size * 0x100000)
+    cfgData = test_gencfgopt.FspGenCfgData.CGenCfgData()
+    cfgData._CfgItemList = items
+
+    scanTime, scanResult = Measure(cfgData, binDat)
+    cfgData.GetFindOffset = lambda findOffsets, find: test_gencfgopt.RefFindOffset(binDat, find)
+    findTime, findResult = Measure(cfgData, binDat)
+    if scanResult != findResult:
+        raise Exception("The marker scan gives a different binary !")
+
+    print("FspGenCfgData, %d find markers, %d config items, %d MB binary" %
+          (args.markers, len(items), args.size))
+    print("  %-22s: %8.3f s" % ("One scan", scanTime))
+    print("  %-22s: %8.3f s" % ("Find per marker", findTime))
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,175 @@
+## @file
+#  Benchmark of the PatchFv.py patch session against the per-patch file access.
+#
+#  A synthetic FD with thousands of patch lines is patched once with a
+#  FdPatchSession, and once by reading and patching the FD file for each line
+#  like PatchFv.py used to. Both FD files must be identical. An overlapping
+#  patch must be rejected without modifying the FD file.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import argparse
+import os
+import random
+import shutil
+import sys
+import tempfile
+import time
+
+currentdir = os.path.dirname(os.path.realpath(__file__))
+parentdir = os.path.dirname(currentdir)
+sys.path.append(parentdir)
+sys.path.append(currentdir)
+import PatchFv
+from   CommonTestUtility import ReadFile
+
+#
+#  Create the synthetic FD file, its symbols and the patch lines
+#
+def CreateFd(fdFile, fdSize, patchCount):
+    fdBase = 0x100000000 - fdSize
+    random.seed(0x5A5A)
+    fd = open(fdFile, "wb")
+    fd.write(bytearray(random.getrandbits(8) for idx in range(0x10000)) * (fdSize // 0x10000))
+    fd.close()
+
+    symTables = PatchFv.Symbols()
+    symTables.fdFile = fdFile
+    symTables.fdSize = fdSize
+    symTables.fdBase = fdBase
+    symTables.dictVariable = {"FDSIZE": fdSize, "FDBASE": fdBase}
+
+    #
+    # One DWORD patch in each 0x40 bytes, with a value taken from a symbol,
+    # some of them adding the content of another DWORD of the FD
+    #
+    patchList = []
+    slots = random.sample(range(fdSize // 0x40), patchCount)
+    for idx, slot in enumerate(slots):
+        name = "Module%d:Symbol%d" % (idx % 64, idx)
+        symTables.dictSymbolAddress[name] = "0x%08X" % (fdBase + random.randrange(fdSize))
+        if idx % 4 == 0:
+            value = "%s + [0x%X]" % (name, random.randrange(fdSize // 4) * 4)
+        else:
+            value = "%s - FDBASE" % name
+        patchList.append("0x%X, %s, @Patch %d" % (slot * 0x40, value, idx))
+
+    #
+    # Copy blocks to the end of the FD, where no DWORD is patched
+    #
+    patchList.append("0x%X, 0x%X, 0x400, $COPY, @Copy block" % (fdBase + 0x100, fdBase + fdSize - 0x400))
+    return symTables, patchList
+
+#
+#  Patch the FD file reading and patching it for each line
+#
+def LegacyPatchFd(symTables, patchList):
+    fdFile = symTables.getFdFile()
+    for line in patchList:
+        items   = [item.strip() for item in line.split(",")]
+        command = ""
+        params  = []
+        for item in items:
+            if item.startswith("$"):
+                command = item[1:]
+            elif not item.startswith("@"):
+                params.append(symTables.evaluate(item, len(params) == 0))
+        if command == "":
+            PatchFv.readDataFromFile(fdFile, params[0], 4)
+            PatchFv.patchDataInFile(fdFile, params[0], params[1], 4)
+        else:
+            src  = symTables.toOffset(params[0])
+            dest = symTables.toOffset(params[1])
+            clen = symTables.toOffset(params[2])
+            PatchFv.patchDataInFile(fdFile, dest, PatchFv.readDataFromFile(fdFile, src, clen), clen)
+
+#
+#  Evaluate the expressions of the patch lines to constants
+#
+def ToConstantPatchList(symTables, patchList):
+    constantList = []
+    for line in patchList:
+        items = []
+        for item in [item.strip() for item in line.split(",")]:
+            if item[0] in "$@":
+                items.append(item)
+            else:
+                items.append("0x%X" % symTables.evaluate(item, len(items) == 0))
+        constantList.append(", ".join(items))
+    return constantList
+
+def SessionPatchFd(symTables, patchList):
+    session = PatchFv.FdPatchSession(symTables.getFdFile())
+    PatchFv.patchFd(symTables, patchList, session)
+    session.close()
+    symTables.fdSession = None
+
+def Run(func, symTables, patchList):
+    stdout = sys.stdout
+    sys.stdout = open(os.devnull, "w")
+    try:
+        start = time.time()
+        func(symTables, patchList)
+        return time.time() - start
+    finally:
+        sys.stdout.close()
+        sys.stdout = stdout
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-s", dest="size", type=lambda x: int(x, 0), default=0x800000, help="FD size")
+    parser.add_argument("-n", dest="count", type=int, default=4000, help="Number of patch lines")
+    args = parser.parse_args()
+
+    workDir = tempfile.mkdtemp()
+    try:
+        legacyFd  = os.path.join(workDir, "Legacy.fd")
+        sessionFd = os.path.join(workDir, "Session.fd")
+        symTables, patchList = CreateFd(legacyFd, args.size, args.count)
+        shutil.copyfile(legacyFd, sessionFd)
+
+        original  = ReadFile(legacyFd)
+        results   = []
+        for name, lines in (("symbols", patchList), ("constants", ToConstantPatchList(symTables, patchList))):
+            for path in (legacyFd, sessionFd):
+                fd = open(path, "wb")
+                fd.write(original)
+                fd.close()
+            symTables.fdFile = legacyFd
+            legacyTime = Run(LegacyPatchFd, symTables, lines)
+            symTables.fdFile = sessionFd
+            sessionTime = Run(SessionPatchFd, symTables, lines)
+            if ReadFile(legacyFd) != ReadFile(sessionFd):
+                print("FAIL: The FD files patched with and without session differ")
+                return 1
+            results.append((name, legacyTime, sessionTime))
+
+        #
+        # Patch a DWORD overlapping the last patched one
+        #
+        original = ReadFile(sessionFd)
+        overlap  = patchList[:-1] + ["0x%X, 0x12345678, @Overlap" % (int(patchList[-2].split(",")[0], 16) + 2)]
+        try:
+            Run(SessionPatchFd, symTables, overlap)
+            print("FAIL: The overlapping patch was not rejected")
+            return 1
+        except Exception as ex:
+            if "overlaps" not in str(ex) or ReadFile(sessionFd) != original:
+                print("FAIL: %s" % ex)
+                return 1
+
+        print("FD size %d KB, %d patch lines" % (args.size // 1024, len(patchList)))
+        for name, legacyTime, sessionTime in results:
+            print("  Lines with %s:" % name)
+            print("    Per-patch file access : %8.3f s" % legacyTime)
+            print("    Patch session         : %8.3f s (%.1fx)" % (sessionTime, legacyTime / max(sessionTime, 1e-6)))
+        return 0
+    finally:
+        shutil.rmtree(workDir)
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,143 @@
+## @file
+#  Timing test of the PatchFv.py symbol tables over generated map files.
+#
+#  An FV build directory is generated with an FV map file and module map files
+#  holding tens of thousands of symbols. The symbol tables are created once
+#  without the symbol cache of the directory and once with it. Every symbol
+#  must resolve to the address it was generated with both times.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import argparse
+import os
+import random
+import shutil
+import struct
+import sys
+import tempfile
+import time
+import uuid
+
+currentdir = os.path.dirname(os.path.realpath(__file__))
+parentdir = os.path.dirname(currentdir)
+sys.path.append(parentdir)
+sys.path.append(currentdir)
+import PatchFv
+from   CommonTestUtility import WriteLines
+
+FV_NAME = "FSPTEST"
+FV_BASE = 0xFFE00000
+FV_SIZE = 0x200000
+
+#
+#  Generate the FV build directory
+#
+#  retval      expected    Address of each "Module:Symbol"
+#
+def CreateFvDir(fvDir, modCount, symCount):
+    random.seed(0x1234)
+    fvData = bytearray(random.getrandbits(8) for idx in range(0x1000))
+    fvData[0x20:0x24] = struct.pack("<I", FV_SIZE)
+    fvData += bytearray(FV_SIZE - len(fvData))
+    for ext in (".Fv", ".fd"):
+        fd = open(os.path.join(fvDir, FV_NAME + ext), "wb")
+        fd.write(fvData)
+        fd.close()
+    WriteLines(os.path.join(fvDir, FV_NAME + ".inf"), ["[options]", "EFI_BASE_ADDRESS = 0x%08X" % FV_BASE])
+
+    expected = {}
+    xrefLines = []
+    txtLines = []
+    mapLines = []
+    modSize = (FV_SIZE // modCount) & ~0xFFF
+    for modIdx in range(modCount):
+        modName = "Module%d" % modIdx
+        modGuid = str(uuid.UUID(int=random.getrandbits(128))).upper()
+        base = FV_BASE + modIdx * modSize
+        text = base + 0x240
+        entry = text + (random.randrange(modSize // 2) & ~0xF)
+        xrefLines.append("%s %s" % (modGuid, modName))
+        txtLines.append("0x%08X %s" % (modIdx * modSize, modGuid))
+
+        #
+        # FV map: half of the modules use their GUID as name
+        #
+        name = modGuid if modIdx % 2 else modName
+        mapLines.append("%s (Fixed Flash Address, BaseAddress=0x%010x, EntryPoint=0x%010x, Type=PE)" % (name, base, entry))
+        mapLines.append("(GUID=%s .textbaseaddress=0x%010x .databaseaddress=0x%010x)" % (modGuid, text, text + modSize // 2))
+        mapLines.append("")
+        for symIdx in range(symCount):
+            symName = "MapSym%d_%d" % (modIdx, symIdx)
+            address = text + symIdx * 0x10
+            mapLines.append("  0x%010x    %s" % (address, symName))
+            expected["%s:%s" % (modName, symName)] = address
+        mapLines.append("")
+
+        #
+        # Module map: MSFT format for the even modules, GCC format for the odd ones
+        #
+        ffsDir = os.path.join(fvDir, "Ffs", modGuid + modName)
+        os.makedirs(ffsDir)
+        entryOff = 0x1000 + (entry - text)
+        modMap = []
+        if modIdx % 2 == 0:
+            modMap.append(" %s" % modName)
+            modMap.append(" 0001:%08x       _ModuleEntryPoint          %016x f   %s.obj" % (entryOff - 0x1000, entryOff, modName))
+            symbols = [("_Var%d_%d" % (modIdx, symIdx), "_Var%d_%d" % (modIdx, symIdx)) for symIdx in range(symCount)]
+            for symIdx, (symName, fullName) in enumerate(symbols):
+                modMap.append(" 0003:%08x       %s          %016x     %s.obj" % (symIdx * 8, symName, 0x8000 + symIdx * 8, modName))
+                expected["%s:%s" % (modName, fullName)] = entry - entryOff + 0x8000 + symIdx * 8
+        else:
+            modMap.append("Archive member included to satisfy reference by file (symbol)")
+            modMap.append("                0x%016x                _ModuleEntryPoint" % entryOff)
+            for symIdx in range(symCount):
+                modMap.append("                0x%016x                Var%d_%d" % (0x8000 + symIdx * 8, modIdx, symIdx))
+                expected["%s:_Var%d_%d" % (modName, modIdx, symIdx)] = entry - entryOff + 0x8000 + symIdx * 8
+            modMap.append(" .data._gPcd_BinaryPatch_PcdTest%d" % modIdx)
+            modMap.append("                0x%016x        0x4 /tmp/cc.ltrans0.ltrans.o" % 0x7F00)
+            expected["%s:__gPcd_BinaryPatch_PcdTest%d" % (modName, modIdx)] = entry - entryOff + 0x7F00
+        WriteLines(os.path.join(ffsDir, modGuid + ".map"), modMap)
+
+    WriteLines(os.path.join(fvDir, "Guid.xref"), xrefLines)
+    WriteLines(os.path.join(fvDir, FV_NAME + ".Fv.txt"), txtLines)
+    WriteLines(os.path.join(fvDir, FV_NAME + ".Fv.map"), mapLines)
+    return expected
+
+#
+#  Create the symbol tables of the FV build directory and check them
+#
+def CreateDicts(fvDir, expected):
+    symTables = PatchFv.Symbols()
+    start = time.time()
+    symTables.createDicts(fvDir, FV_NAME)
+    elapsed = time.time() - start
+    for name, address in expected.items():
+        value = symTables.evaluate(name, False)
+        if value != address & 0xFFFFFFFF:
+            raise Exception("Symbol %s is 0x%08X instead of 0x%08X" % (name, value, address))
+    return elapsed
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-m", dest="modules", type=int, default=200, help="Number of modules")
+    parser.add_argument("-s", dest="symbols", type=int, default=100, help="Number of symbols per map file")
+    args = parser.parse_args()
+
+    fvDir = tempfile.mkdtemp()
+    try:
+        expected = CreateFvDir(fvDir, args.modules, args.symbols)
+        coldTime = CreateDicts(fvDir, expected)
+        warmTime = CreateDicts(fvDir, expected)
+        print("%d modules, %d symbols" % (args.modules, len(expected)))
+        print("  Without symbol cache : %8.3f s" % coldTime)
+        print("  With symbol cache    : %8.3f s" % warmTime)
+        return 0
+    finally:
+        shutil.rmtree(fvDir)
+
+if __name__ == '__main__':
+    sys.exit(main())
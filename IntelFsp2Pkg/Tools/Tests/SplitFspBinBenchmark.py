@@ -0,0 +1,127 @@
+## @file
+#  Timing and memory test of SplitFspBin.py over a generated FSP binary.
+#
+#  A FSP 2.x binary of FSP-T, FSP-M and FSP-S components spanning several FVs
+#  of PE32, PE32+ and TE images is generated, 36 MB by default. The rebase,
+#  split and info commands are run on it in child processes, and the time and
+#  peak resident set size of each is reported. The rebased binary must match
+#  the per-entry rebase of the images and patch table entries.
+#
+#  Another revision of SplitFspBin.py can be given to compare with, its
+#  output must be the same. The peak RSS is read with os.wait4(), so the
+#  benchmark only runs on POSIX hosts. A child process starts from the peak
+#  RSS of its parent, so the binary is generated in a process of its own.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import argparse
+import multiprocessing
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+currentdir = os.path.dirname(os.path.realpath(__file__))
+parentdir = os.path.dirname(currentdir)
+sys.path.append(parentdir)
+sys.path.append(currentdir)
+import test_splitfspbin
+from   CommonTestUtility import ReadFile
+
+SPLIT_FSP_BIN = os.path.join(parentdir, "SplitFspBin.py")
+
+NEW_BASES = {'t' : 0xFEF80000, 'm' : 0xFEE00000, 's' : 0xFEA00000}
+
+#
+#  Run a SplitFspBin.py command in a child process
+#
+#  retval      (time in seconds, peak RSS in MB)
+#
+def RunTool(script, args, outDir):
+    start = time.time()
+    proc = subprocess.Popen([sys.executable, script] + args, cwd=outDir, stdout=subprocess.DEVNULL)
+    pid, status, usage = os.wait4(proc.pid, 0)
+    elapsed = time.time() - start
+    proc.returncode = status
+    if status != 0:
+        raise Exception("'%s %s' failed with status 0x%X !" % (script, ' '.join(args), status))
+    # ru_maxrss is in bytes on macOS and in kilobytes elsewhere
+    scale = 1 if sys.platform == 'darwin' else 1024
+    return elapsed, usage.ru_maxrss * scale / (1024.0 * 1024)
+
+def RunCommands(script, fdFile, outDir):
+    results = []
+    comps = ['t', 'm', 's']
+    args  = ["rebase", "-f", fdFile, "-c"] + comps + ["-b"] + ["0x%08X" % NEW_BASES[comp] for comp in comps]
+    args += ["-o", outDir, "-n", "REBASED.fd"]
+    results.append(("rebase",) + RunTool(script, args, outDir))
+    results.append(("split",) + RunTool(script, ["split", "-f", fdFile, "-o", outDir], outDir))
+    results.append(("info",) + RunTool(script, ["info", "-f", fdFile], outDir))
+    return results
+
+#
+#  Write the FSP binary and its expected rebase into the work directory
+#
+def GenerateFd(workDir, fvs, images):
+    random.seed(0x1234)
+    comps = [('t', 0xFFF80000, fvs, images), ('m', 0xFFE00000, fvs, images), ('s', 0xFFA00000, fvs, images)]
+    fdBin, layout = test_splitfspbin.GenFspFd(comps, test_splitfspbin.GenImagePool(16))
+    for (name, data) in [("BENCH.fd", fdBin), ("EXPECTED.fd", test_splitfspbin.RebaseFspLayout(fdBin, layout, NEW_BASES))]:
+        fd = open(os.path.join(workDir, name), "wb")
+        fd.write(data)
+        fd.close()
+    print("FSP binary of %.1f MB, %d FVs, %d images" %
+          (len(fdBin) / (1024.0 * 1024), len(comps) * fvs, sum([len(comp['Images']) for comp in layout])))
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-v", dest="fvs", type=int, default=2, help="Number of FVs per FSP component")
+    parser.add_argument("-i", dest="images", type=int, default=48, help="Number of images per FV")
+    parser.add_argument("-s", dest="script", type=str, default="", help="Other SplitFspBin.py to compare with")
+    args = parser.parse_args()
+
+    workDir = tempfile.mkdtemp()
+    try:
+        proc = multiprocessing.Process(target=GenerateFd, args=(workDir, args.fvs, args.images))
+        proc.start()
+        proc.join()
+        if proc.exitcode != 0:
+            raise Exception("Failed to generate the FSP binary !")
+        fdFile = os.path.join(workDir, "BENCH.fd")
+
+        scripts = [SPLIT_FSP_BIN]
+        if args.script:
+            scripts.append(os.path.realpath(args.script))
+        outDirs = []
+        for script in scripts:
+            outDir = tempfile.mkdtemp(dir=workDir)
+            results = RunCommands(script, fdFile, outDir)
+            outDirs.append(outDir)
+            print(script)
+            for (command, elapsed, peakRss) in results:
+                print("  %-8s: %8.3f s  %8.1f MB peak RSS" % (command, elapsed, peakRss))
+
+        #
+        # Compare the outputs once all the commands are measured
+        #
+        expected = ReadFile(os.path.join(workDir, "EXPECTED.fd"))
+        for idx, outDir in enumerate(outDirs):
+            if ReadFile(os.path.join(outDir, "REBASED.fd")) != expected:
+                raise Exception("%s rebased the FSP binary incorrectly !" % scripts[idx])
+            for comp in ['T', 'M', 'S']:
+                name = "BENCH_%s.fd" % comp
+                if ReadFile(os.path.join(outDir, name)) != ReadFile(os.path.join(outDirs[0], name)):
+                    raise Exception("%s split the FSP binary differently !" % scripts[idx])
+    finally:
+        shutil.rmtree(workDir)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,56 @@
+## @file
+#  Timing test of the YAML cache of GenYamlCfg.py over a generated YAML file.
+#
+#  A platform YAML file including hundreds of files of config structures is
+#  generated. It is loaded once without the cache, once to create the cache
+#  and once from the cache. The configuration must be the same every time.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import argparse
+import os
+import random
+import shutil
+import sys
+import tempfile
+import time
+
+currentdir = os.path.dirname(os.path.realpath(__file__))
+sys.path.append(currentdir)
+import test_genyamlcfg
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-f", dest="files", type=int, default=200, help="Number of included YAML files")
+    parser.add_argument("-i", dest="items", type=int, default=60, help="Number of config items per file")
+    args = parser.parse_args()
+
+    random.seed(0x1234)
+    yamlDir = tempfile.mkdtemp()
+    try:
+        yamlFile  = test_genyamlcfg.CreateLargeYaml(yamlDir, args.files, args.items)
+        cacheFile = os.path.join(yamlDir, "BenchRoot.cache")
+
+        results = []
+        for (title, cache) in [("Parsed", ""), ("Parsed, cache created", cacheFile), ("Loaded from cache", cacheFile)]:
+            start = time.time()
+            cfgData = test_genyamlcfg.LoadYaml(yamlFile, cache)
+            elapsed = time.time() - start
+            results.append((title, elapsed, test_genyamlcfg.CfgState(cfgData)))
+
+        for (title, elapsed, state) in results:
+            if state != results[0][2]:
+                raise Exception("The configuration is different when %s !" % title.lower())
+        print("GenYamlCfg, %d YAML files, %d config items" % (args.files + 1, len(results[0][2][1])))
+        for (title, elapsed, state) in results:
+            print("  %-22s: %8.3f s" % (title, elapsed))
+    finally:
+        shutil.rmtree(yamlDir)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,100 @@
+## @file
+#  Timing test of the config index of GenYamlCfg.py over a generated YAML file.
+#
+#  A platform YAML file of FSP-T, FSP-M and FSP-S UPD regions including
+#  hundreds of files of config structures is generated. The lookups of
+#  ConfigEditor and of the delta file generation are run with the config index
+#  and again with every lookup walking the config tree, the results must be
+#  the same both ways.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import argparse
+import os
+import random
+import shutil
+import sys
+import tempfile
+import time
+
+currentdir = os.path.dirname(os.path.realpath(__file__))
+sys.path.append(currentdir)
+import test_genyamlcfg
+from   CommonTestUtility import ReadLines
+
+#
+#  Run the lookups on a loaded configuration
+#
+#  retval      list of (title, time in seconds, result)
+#
+def RunLookups(cfgData, nodes, newData, dltFile):
+    results = []
+    cfgData._cfg_index = None
+    start = time.time()
+    cfgData.get_cfg_index()
+    results.append(("Index build", time.time() - start, None))
+    oldData = cfgData.generate_binary_array()
+
+    start = time.time()
+    result = [cfgData.get_item_by_path('.'.join(path)) for (path, node) in nodes if 'indx' in node]
+    results.append(("Item by path", time.time() - start, result))
+
+    start = time.time()
+    result = [cfgData.locate_cfg_path(node) for (path, node) in nodes]
+    results.append(("Path of node", time.time() - start, result))
+
+    start = time.time()
+    result = [cfgData.generate_binary_array('.'.join(path)) for (path, node) in nodes
+              if test_genyamlcfg.GenYamlCfg.CGenYamlCfg.STRUCT in node]
+    results.append(("Structure binary", time.time() - start, result))
+
+    start = time.time()
+    result = [cfgData.get_cfg_list(pageId) for pageId in ['BCH', 'NONE']]
+    results.append(("Page item list", time.time() - start, result))
+
+    cfgData.show_data_difference = lambda dataDiff: None
+    start = time.time()
+    cfgData.generate_delta_file_from_bin(dltFile, oldData, newData)
+    results.append(("Binary to delta", time.time() - start, ReadLines(dltFile)))
+    return results
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-f", dest="files", type=int, default=200, help="Number of included YAML files")
+    parser.add_argument("-i", dest="items", type=int, default=60, help="Number of config items per file")
+    parser.add_argument("-c", dest="changes", type=int, default=2000, help="Number of config items changed in the binary")
+    parser.add_argument("-n", dest="nodes", type=int, default=2000, help="Number of tree nodes looked up")
+    args = parser.parse_args()
+
+    random.seed(0x1234)
+    yamlDir = tempfile.mkdtemp()
+    try:
+        yamlFile = test_genyamlcfg.CreateLargeYaml(yamlDir, args.files, args.items)
+        cfgData  = test_genyamlcfg.LoadYaml(yamlFile)
+        walkData = test_genyamlcfg.DisableIndex(test_genyamlcfg.LoadYaml(yamlFile))
+        nodes    = test_genyamlcfg.CfgNodes(cfgData)
+        nodes    = random.sample(nodes, min(args.nodes, len(nodes)))
+        newData  = test_genyamlcfg.ChangeBinary(cfgData, cfgData.generate_binary_array(), args.changes)
+        walkNodes = [(path, walkData.locate_cfg_item('.'.join(path))) for (path, node) in nodes]
+
+        indexed = RunLookups(cfgData, nodes, newData, os.path.join(yamlDir, "Index.dlt"))
+        walked  = RunLookups(walkData, walkNodes, newData, os.path.join(yamlDir, "Walk.dlt"))
+        for idx, (title, elapsed, result) in enumerate(indexed):
+            if result != walked[idx][2]:
+                raise Exception("The config index gives a different result for '%s' !" % title)
+
+        print("GenYamlCfg, %d config items, %d nodes looked up, %d items changed" %
+              (len(cfgData.get_cfg_list()), len(nodes), args.changes))
+        print("  %-18s  %10s  %10s" % ("", "Indexed", "Tree walk"))
+        for idx, (title, elapsed, result) in enumerate(indexed):
+            print("  %-18s: %8.3f s  %8.3f s" % (title, elapsed, walked[idx][1]))
+    finally:
+        shutil.rmtree(yamlDir)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,71 @@
+## @file
+#  Timing test of the structure packing of GenYamlCfg.py over a generated
+#  YAML file.
+#
+#  A platform YAML file including hundreds of files of config structures is
+#  generated. The whole configuration is packed into a binary and unpacked
+#  from it with the structure layouts of GenYamlCfg, and again one bit field
+#  at a time. The results must be the same both ways.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import argparse
+import os
+import random
+import shutil
+import sys
+import tempfile
+import time
+
+currentdir = os.path.dirname(os.path.realpath(__file__))
+sys.path.append(currentdir)
+import test_genyamlcfg
+
+def Measure(loops, func, *args):
+    start = time.time()
+    for loop in range(loops):
+        result = func(*args)
+    return (time.time() - start) / loops, result
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-f", dest="files", type=int, default=200, help="Number of included YAML files")
+    parser.add_argument("-i", dest="items", type=int, default=60, help="Number of config items per file")
+    parser.add_argument("-l", dest="loops", type=int, default=10, help="Number of loops per measurement")
+    args = parser.parse_args()
+
+    random.seed(0x1234)
+    yamlDir = tempfile.mkdtemp()
+    try:
+        yamlFile = test_genyamlcfg.CreateLargeYaml(yamlDir, args.files, args.items)
+        cfgData  = test_genyamlcfg.LoadYaml(yamlFile)
+        top      = cfgData._cfg_tree
+        binData  = cfgData.generate_binary_array()
+
+        cfgData._cfg_index = None
+        planTime, layout = Measure(1, cfgData.get_struct_layout, top)
+        results = [
+            ("Pack",)   + Measure(args.loops, cfgData.get_field_value, top) +
+                          Measure(args.loops, test_genyamlcfg.RefFieldValue, cfgData, top),
+            ("Unpack",) + Measure(args.loops, cfgData.get_field_values, top, binData) +
+                          Measure(args.loops, test_genyamlcfg.RefFieldValues, cfgData, top, binData),
+            ]
+        for (title, bulkTime, bulkResult, bitTime, bitResult) in results:
+            if bulkResult != bitResult:
+                raise Exception("%s of the structure layout gives a different result !" % title)
+
+        print("GenYamlCfg, %d config items, %d bytes in %d runs, layout planned in %.3f s" %
+              (len(cfgData.get_cfg_list()), len(binData), len(layout), planTime))
+        print("  %-8s  %10s  %10s" % ("", "Layout", "Bit field"))
+        for (title, bulkTime, bulkResult, bitTime, bitResult) in results:
+            print("  %-8s: %8.3f s  %8.3f s" % (title, bulkTime, bitTime))
+    finally:
+        shutil.rmtree(yamlDir)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
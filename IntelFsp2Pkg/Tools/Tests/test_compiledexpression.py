@@ -0,0 +1,183 @@
+# @file
+#  Regression tests of the compiled expressions of the FSP tools.
+#
+#  The DSC conditions of GenCfgOpt.py and FspGenCfgData.py, compiled by
+#  CompiledExpression.py, and the patch expressions of PatchFv.py must
+#  evaluate to the same results, or fail the same way, as when their text is
+#  parsed every time.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+# Import Modules
+import unittest
+import io
+import random
+import shutil
+import tempfile
+from   contextlib import redirect_stdout
+
+import os, sys
+currentdir = os.path.dirname(os.path.realpath(__file__))
+parentdir = os.path.dirname(currentdir)
+sys.path.append(parentdir)
+import CompiledExpression
+import FspGenCfgData
+import GenCfgOpt
+import PatchFv
+
+#
+# Expressions the compiler handles, then expressions it leaves to the text
+# parser: macros glued to other tokens, nested PCD names and syntax errors
+#
+DSC_CONDITIONS = [
+    "$(TARGET) == DEBUG",
+    "$(TARGET) != DEBUG",
+    "$(TARGET) == RELEASE AND $(LEVEL) > 2",
+    "NOT ($(LEVEL) == 0) OR $(FLAG)",
+    "NOT $(FLAG)",
+    "$(LEVEL) >= 0x2 AND $(LEVEL) <= 3",
+    "$(LEVEL) < 2 XOR $(FLAG)",
+    "($(FLAG) OR $(LEVEL)) AND (NOT $(FLAG))",
+    "gTokenSpaceGuid.PcdLevel == 65 OR $(LEVEL) >= 2",
+    "$(FLAG) XOR (gTokenSpaceGuid.PcdRevision == 0x03)",
+    "gTokenSpaceGuid.PcdUndefined == 1",
+    "$(UNDEFINED_MACRO) != DEBUG AND (0x4 < $(LEVEL))",
+    "$(UNDEFINED_MACRO) == UNDEFINED_MACRO",
+    "\t$(TARGET)  ==\tDEBUG ",
+    "$(TARGET)_X == DEBUG_X",
+    "$(STRING) == 2",
+    "$(LEVEL)",
+    "$(TARGET)",
+    "gTokenSpaceGuid.PcdLevel == gTokenSpaceGuid.PcdLevelMax",
+    "$(LEVEL) == ",
+    "($(LEVEL) == 1",
+    "$(LEVEL) AND",
+    "$(TARGET) > 1",
+]
+
+DSC_MACROS = [
+    {'TARGET': 'DEBUG', 'LEVEL': '0x3', 'FLAG': '1', 'STRING': '1 OR 1'},
+    {'TARGET': 'RELEASE', 'LEVEL': '0', 'FLAG': '0', 'STRING': '2'},
+    {'TARGET': 'RELEASE', 'LEVEL': '2', 'FLAG': 'FALSE', 'STRING': 'A B'},
+]
+
+DSC_PCDS = [
+    {'gTokenSpaceGuid.PcdLevel': '65', 'gTokenSpaceGuid.PcdRevision': '0x03'},
+    {'gTokenSpaceGuid.PcdLevel': '0x41', 'gTokenSpaceGuid.PcdRevision': '2',
+     'gTokenSpaceGuid.PcdLevelMax': '65'},
+]
+
+PATCH_EXPRESSIONS = [
+    "0x%(Value)08X",
+    "%(Value)d",
+    "Module%(Module)d:Symbol%(Symbol)d + 0x%(Value)X",
+    "[Module%(Module)d:Symbol%(Symbol)d] & 0xFFFF",
+    "{0x%(Value)X} - FDBASE + Module%(Module)d:Symbol%(Symbol)d",
+    "<Module%(Module)d:Symbol%(Symbol)d> * 2 | 0x%(Value)X",
+    "~0x%(Value)X + FDSIZE",
+    "(FDSIZE - 0x%(Value)X) * 2 * 1 & 0xFFF0",
+    "Module%(Module)d:Symbol%(Symbol)d - 0x%(Value)X",
+    "Unknown:Symbol%(Symbol)d",
+    "UNKNOWN_VARIABLE + 1",
+    "(0x%(Value)X + 1",
+    "0x%(Value)X $",
+]
+
+#
+#  Evaluate an expression, with the error it raises as its result
+#
+def Evaluate(Function, *Args):
+    try:
+        with redirect_stdout(io.StringIO()):
+            return Function(*Args)
+    except SystemExit:
+        return 'SystemExit'
+    except Exception as Error:
+        return '%s: %s' % (type(Error).__name__, Error)
+
+class CompiledExpressionTest(unittest.TestCase):
+    def setUp(self):
+        CompiledExpression.CCompiledExpression.CompiledCache.clear()
+        PatchFv.Symbols.compiledExpressions.clear()
+
+    def test_sharedCompiler(self):
+        for Module in (GenCfgOpt, FspGenCfgData):
+            self.assertTrue(issubclass(Module.CLogicalExpression, CompiledExpression.CCompiledExpression))
+            self.assertFalse('compileExpress' in Module.CLogicalExpression.__dict__)
+
+    def compareDsc(self, Module, CfgOpt):
+        for MacroDict in DSC_MACROS:
+            for PcdsDict in DSC_PCDS:
+                CfgOpt._MacroDict = MacroDict
+                CfgOpt._PcdsDict  = PcdsDict
+                for Expr in DSC_CONDITIONS:
+                    Text     = Evaluate(Module.CLogicalExpression().evaluateExpress, CfgOpt.ExpandExpress(Expr))
+                    Compiled = Evaluate(Module.CLogicalExpression().evaluateCompiled, Expr,
+                                        MacroDict, PcdsDict, CfgOpt.ExpandExpress)
+                    self.assertEqual(Text, Compiled, "%s: '%s' with %s %s" % (Module.__name__, Expr, MacroDict, PcdsDict))
+
+        #
+        # Most conditions must not fall back to the text parser
+        #
+        Cache = CompiledExpression.CCompiledExpression.CompiledCache
+        self.assertTrue(len([Key for Key in Cache if Cache[Key] is not None]) > len(DSC_CONDITIONS) // 2)
+        self.assertEqual(Cache['$(TARGET)_X == DEBUG_X'], None)
+        self.assertEqual(Cache['($(LEVEL) == 1'], None)
+
+    def test_genCfgOptConditions(self):
+        self.compareDsc(GenCfgOpt, GenCfgOpt.CGenCfgOpt())
+
+    def test_fspGenCfgDataConditions(self):
+        self.compareDsc(FspGenCfgData, FspGenCfgData.CGenCfgData())
+
+    def test_patchExpressions(self):
+        random.seed(0x1234)
+        FdDir = tempfile.mkdtemp()
+        try:
+            FdFile = os.path.join(FdDir, "TEST.fd")
+            fd = open(FdFile, "wb")
+            fd.write(bytearray(random.getrandbits(8) for Index in range(0x10000)))
+            fd.close()
+
+            SymTables = PatchFv.Symbols()
+            SymTables.fdFile = FdFile
+            SymTables.fdSize = 0x10000
+            SymTables.fdBase = 0xFFFF0000
+            SymTables.fvList = []
+            SymTables.dictVariable = {"FDSIZE": SymTables.fdSize, "FDBASE": SymTables.fdBase}
+            for Module in range(4):
+                for Symbol in range(4):
+                    SymTables.dictSymbolAddress["Module%d:Symbol%d" % (Module, Symbol)] = \
+                        "0x00%08x" % (SymTables.fdBase + random.randrange(0x8000))
+
+            TextTables = PatchFv.Symbols()
+            TextTables.__dict__.update(SymTables.__dict__)
+            TextTables.compileExpression = lambda expression: None
+
+            for Pattern in PATCH_EXPRESSIONS:
+                for Index in range(8):
+                    Args = {"Module": random.randrange(4), "Symbol": random.randrange(4), "Value": random.randrange(0x100)}
+                    Expression = Pattern % Args
+                    for IsOffset in (False, True):
+                        self.assertEqual(Evaluate(TextTables.evaluate, Expression, IsOffset),
+                                         Evaluate(SymTables.evaluate, Expression, IsOffset),
+                                         "'%s', offset %s" % (Expression, IsOffset))
+
+            #
+            # Only the expressions with errors fall back to the text parser
+            #
+            Cache = PatchFv.Symbols.compiledExpressions
+            for Expression in ("FDSIZE - 0x10", "[Module0:Symbol0] & 0xFFFF"):
+                SymTables.evaluate(Expression, False)
+                self.assertNotEqual(Cache[Expression], None)
+            Evaluate(SymTables.evaluate, "(0x10 + 1", False)
+            self.assertEqual(Cache["(0x10 + 1"], None)
+        finally:
+            shutil.rmtree(FdDir)
+
+if __name__ == '__main__':
+    unittest.main()
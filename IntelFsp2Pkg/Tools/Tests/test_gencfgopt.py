@@ -0,0 +1,273 @@
+## @file
+#  Regression tests of the incremental generation of GenCfgOpt.py and
+#  FspGenCfgData.py.
+#
+#  QemuFspPkg.dsc is split so that the UPD section content is pulled in with
+#  an !include. The headers and the BSF file generated from it must match the
+#  expected ones, a rerun must not touch any output, and a change in the
+#  included file must only rewrite the outputs that depend on it.
+#
+#  The find marker offsets located in one scan of the binary are compared with
+#  a find per marker over generated binaries.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+# Import Modules
+import unittest
+import random
+import shutil
+import subprocess
+import tempfile
+
+import os, sys
+currentdir = os.path.dirname(os.path.realpath(__file__))
+parentdir = os.path.dirname(currentdir)
+sys.path.append(parentdir)
+sys.path.append(currentdir)
+import FspGenCfgData
+from   CommonTestUtility import ReadLines, WriteLines
+
+HdrFileHeaderLineLength = 32
+BsfFileHeaderLineLength = 19
+HeaderFiles = ['FspUpd.h', 'FsptUpd.h', 'FspmUpd.h', 'FspsUpd.h']
+OldTime = 1000000000
+
+#
+#  Copy QemuFspPkg.dsc to the directory with the UPD section content moved
+#  into an included file
+#
+def CreateSplitDsc(dscDir):
+    lines = ReadLines(os.path.join(currentdir, 'QemuFspPkg.dsc'), True)
+    start = lines.index('[PcdsDynamicVpd.Upd]\n') + 1
+    end   = lines.index('[Components.IA32]\n')
+    while lines[end - 1].startswith('#'):
+        end -= 1
+    WriteLines(os.path.join(dscDir, 'QemuFspUpd.dsc.inc'), lines[start:end])
+    WriteLines(os.path.join(dscDir, 'QemuFspPkg.dsc'),
+               lines[:start] + ['!include QemuFspUpd.dsc.inc\n'] + lines[end:])
+
+def ReplaceInFile(path, old, new):
+    lines = ReadLines(path, True)
+    text  = ''.join(lines)
+    if old not in text:
+        raise Exception("'%s' is not found in '%s' !" % (old, path))
+    WriteLines(path, [text.replace(old, new)])
+
+#
+#  Compare a generated file without its copyright header with an expected one,
+#  the expected headers differ from the generated ones in blank lines only
+#
+def SameAsExpected(path, expected, numLineToStrip, ignoreBlank):
+    lines = ReadLines(path, True)[numLineToStrip:]
+    expectedLines = ReadLines(os.path.join(currentdir, expected), True)
+    if ignoreBlank:
+        lines = [' '.join(x.split()) for x in lines if x.strip()]
+        expectedLines = [' '.join(x.split()) for x in expectedLines if x.strip()]
+    return lines == expectedLines
+
+def RunTool(tool, args, cwd):
+    env = dict(os.environ)
+    env.pop('PACKAGES_PATH', None)
+    result = subprocess.run([sys.executable, os.path.join(parentdir, tool)] + args,
+                            cwd=cwd, env=env, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT, universal_newlines=True)
+    if result.returncode != 0:
+        raise Exception("%s failed:\n%s" % (tool, result.stdout))
+    return result.stdout
+
+def AgeFiles(dirPath, files):
+    for name in files:
+        os.utime(os.path.join(dirPath, name), (OldTime, OldTime))
+
+def FileTimes(dirPath, files):
+    return dict((name, os.path.getmtime(os.path.join(dirPath, name))) for name in files)
+
+#
+#  Reference find of a marker, one find over the whole binary and one more
+#  after the match to reject multiple matches
+#
+def RefFindOffset(binDat, find):
+    findBin = find.encode()
+    offset = binDat.find(findBin)
+    if offset < 0:
+        raise Exception('Could not find "%s" !' % find)
+    if binDat[offset+len(findBin):].find(findBin) >= 0:
+        raise Exception('Multiple match found for "%s" !' % find)
+    return offset
+
+def FindResult(func, *args):
+    try:
+        return func(*args)
+    except Exception as e:
+        return str(e)
+
+#
+#  Create config items and a binary of markers from a small alphabet so that
+#  the markers overlap, repeat, contain each other or are missing
+#
+def CreateFindData(markerNum, placeNum, binLen, fill):
+    markers = []
+    while len(markers) < markerNum:
+        marker = ''.join(random.choice('AB_') for x in range(random.randint(2, 6)))
+        if marker not in markers:
+            markers.append(marker)
+    binDat = bytearray(random.choice(fill) for x in range(binLen))
+    for marker in random.sample(markers, placeNum):
+        pos = random.randint(0, binLen - 16)
+        binDat[pos:pos+len(marker)] = marker.encode()
+
+    items  = []
+    offset = 0
+    for marker in markers:
+        for find in [marker, '']:
+            items.append({'find': find, 'offset': offset, 'length': 2,
+                          'value': '0x%04X' % random.randint(0, 0xFFFF),
+                          'type': '', 'option': ''})
+            offset += 2
+    return markers, items, binDat
+
+class TestGenCfgOptIncremental(unittest.TestCase):
+    def setUp(self):
+        self.tmpDir = tempfile.mkdtemp()
+        CreateSplitDsc(self.tmpDir)
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpDir)
+
+    def Generate(self):
+        output  = RunTool('GenCfgOpt.py', ['HEADER', 'QemuFspPkg.dsc', '.'], self.tmpDir)
+        output += RunTool('GenCfgOpt.py', ['GENBSF', 'QemuFspPkg.dsc', '.', 'Output.bsf'], self.tmpDir)
+        return output
+
+    def test_generateFromSplitDsc(self):
+        self.Generate()
+        for name in HeaderFiles:
+            self.assertTrue(SameAsExpected(os.path.join(self.tmpDir, name), 'Expected' + name,
+                                           HdrFileHeaderLineLength, True), name)
+        self.assertTrue(SameAsExpected(os.path.join(self.tmpDir, 'Output.bsf'), 'ExpectedOutput.bsf',
+                                       BsfFileHeaderLineLength, False))
+
+    def test_rerunSkipped(self):
+        self.Generate()
+        outputs = HeaderFiles + ['FspiUpd.h', 'Output.bsf']
+        AgeFiles(self.tmpDir, outputs)
+        output = self.Generate()
+        self.assertIn('skip to create UPD header file', output)
+        self.assertIn('skip to create UPD BSF file', output)
+        self.assertEqual(FileTimes(self.tmpDir, outputs), dict((x, OldTime) for x in outputs))
+
+    def test_touchIncludeSkipped(self):
+        self.Generate()
+        outputs = HeaderFiles + ['Output.bsf']
+        AgeFiles(self.tmpDir, outputs)
+        os.utime(os.path.join(self.tmpDir, 'QemuFspUpd.dsc.inc'))
+        output = self.Generate()
+        self.assertIn('skip to create UPD header file', output)
+        self.assertEqual(FileTimes(self.tmpDir, outputs), dict((x, OldTime) for x in outputs))
+
+    def test_changeIncludeRewritesDependents(self):
+        self.Generate()
+        outputs = HeaderFiles + ['Output.bsf']
+        AgeFiles(self.tmpDir, outputs)
+        ReplaceInFile(os.path.join(self.tmpDir, 'QemuFspUpd.dsc.inc'),
+                      'PCI GFX Base used before', 'PCI GFX Base set before')
+        output = self.Generate()
+        self.assertNotIn('skip', output)
+        times = FileTimes(self.tmpDir, outputs)
+        for name in outputs:
+            if name in ['FspsUpd.h', 'Output.bsf']:
+                self.assertNotEqual(times[name], OldTime, name)
+                self.assertIn('PCI GFX Base set before', ''.join(ReadLines(os.path.join(self.tmpDir, name), True)))
+            else:
+                self.assertEqual(times[name], OldTime, name)
+
+    def test_modifiedOutputRegenerated(self):
+        self.Generate()
+        headerPath = os.path.join(self.tmpDir, 'FspmUpd.h')
+        expected = ReadLines(headerPath, True)
+        WriteLines(headerPath, expected[:-5])
+        output = self.Generate()
+        self.assertNotIn('skip to create UPD header file', output)
+        self.assertEqual(ReadLines(headerPath, True), expected)
+
+    def test_changeCommandRegenerated(self):
+        self.Generate()
+        AgeFiles(self.tmpDir, ['Output.bsf'])
+        output = RunTool('GenCfgOpt.py', ['GENBSF', 'QemuFspPkg.dsc', '.', 'Output.bsf', '-D', 'TARGET=RELEASE'],
+                         self.tmpDir)
+        self.assertNotIn('skip', output)
+        self.assertIn('skip', RunTool('GenCfgOpt.py', ['GENBSF', 'QemuFspPkg.dsc', '.', 'Output.bsf', '-D',
+                                                       'TARGET=RELEASE'], self.tmpDir))
+
+class TestGenCfgDataIncremental(unittest.TestCase):
+    def setUp(self):
+        self.tmpDir = tempfile.mkdtemp()
+        CreateSplitDsc(self.tmpDir)
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpDir)
+
+    def test_genHdrIncremental(self):
+        args = ['GENHDR', 'QemuFspPkg.dsc', 'Brd.h;Com.h']
+        outputs = ['Brd.h', 'Com.h']
+        RunTool('FspGenCfgData.py', args, self.tmpDir)
+        AgeFiles(self.tmpDir, outputs)
+        self.assertIn('No input file change', RunTool('FspGenCfgData.py', args, self.tmpDir))
+        self.assertEqual(FileTimes(self.tmpDir, outputs), dict((x, OldTime) for x in outputs))
+
+        ReplaceInFile(os.path.join(self.tmpDir, 'QemuFspUpd.dsc.inc'),
+                      'PCI GFX Base used before', 'PCI GFX Base set before')
+        self.assertNotIn('No input file change', RunTool('FspGenCfgData.py', args, self.tmpDir))
+        self.assertIn('PCI GFX Base set before', ''.join(ReadLines(os.path.join(self.tmpDir, 'Brd.h'), True)))
+
+    def test_genBinIncremental(self):
+        args = ['GENBIN', 'QemuFspPkg.dsc', 'Cfg.bin']
+        RunTool('FspGenCfgData.py', args, self.tmpDir)
+        AgeFiles(self.tmpDir, ['Cfg.bin'])
+        self.assertIn('No input file change', RunTool('FspGenCfgData.py', args, self.tmpDir))
+        self.assertEqual(os.path.getmtime(os.path.join(self.tmpDir, 'Cfg.bin')), OldTime)
+
+        # The binary is regenerated when one of its outputs is lost
+        os.remove(os.path.join(self.tmpDir, 'Cfg.bin'))
+        self.assertNotIn('No input file change', RunTool('FspGenCfgData.py', args, self.tmpDir))
+        self.assertTrue(os.path.exists(os.path.join(self.tmpDir, 'Cfg.bin')))
+
+    def test_dscToYamlIncremental(self):
+        args = ['QemuFspPkg.dsc', 'Qemu.yaml']
+        self.assertIn('created successfully', RunTool('FspDscBsf2Yaml.py', args, self.tmpDir))
+        self.assertIn('No input file change', RunTool('FspDscBsf2Yaml.py', args, self.tmpDir))
+        ReplaceInFile(os.path.join(self.tmpDir, 'QemuFspUpd.dsc.inc'),
+                      'PCI GFX Base used before', 'PCI GFX Base set before')
+        self.assertIn('created successfully', RunTool('FspDscBsf2Yaml.py', args, self.tmpDir))
+        self.assertIn('PCI GFX Base set before', ''.join(ReadLines(os.path.join(self.tmpDir, 'Qemu.yaml'), True)))
+
+class TestGenCfgDataFind(unittest.TestCase):
+    def setUp(self):
+        random.seed(0x5A5A)
+
+    def test_findOffsets(self):
+        for loop in range(200):
+            markers, items, binDat = CreateFindData(6, 3, 256, b'AB_\x00\x00\x00')
+            cfgData = FspGenCfgData.CGenCfgData()
+            cfgData._CfgItemList = items
+            findOffsets = cfgData.GetFindOffsets(binDat)
+            for marker in markers:
+                self.assertEqual(FindResult(cfgData.GetFindOffset, findOffsets, marker),
+                                 FindResult(RefFindOffset, binDat, marker), marker)
+
+    def test_patchBinaryArray(self):
+        for loop in range(200):
+            markers, items, binDat = CreateFindData(3, 3, 128, b'AB_' + b'\x00' * 30)
+            cfgData = FspGenCfgData.CGenCfgData()
+            cfgData._CfgItemList = items
+            newDat = FindResult(cfgData.PatchBinaryArray, bytearray(binDat))
+
+            cfgData.GetFindOffset = lambda findOffsets, find: RefFindOffset(binDat, find)
+            self.assertEqual(newDat, FindResult(cfgData.PatchBinaryArray, bytearray(binDat)))
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,490 @@
+# @file
+#  Regression tests of the YAML cache, the config index and the structure
+#  packing of GenYamlCfg.py.
+#
+#  ExpectedOutput.yaml is split into a root file and nested !include files.
+#  Loading it from the cache must give the same configuration as parsing it,
+#  and changing the content of an included file must invalidate the cache.
+#
+#  The lookups through the config index must give the same results as the
+#  walks of the config tree they replace.
+#
+#  Packing structures with their layouts must give the same bytes as setting
+#  one bit field at a time, on ExpectedOutput.yaml and on random layouts.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+# Import Modules
+import unittest
+import os
+import random
+import shutil
+import sys
+import tempfile
+import time
+
+currentdir = os.path.dirname(os.path.realpath(__file__))
+parentdir = os.path.dirname(currentdir)
+sys.path.append(os.path.join(parentdir, 'ConfigEditor'))
+sys.path.append(currentdir)
+import CommonUtility
+import GenYamlCfg
+from   CommonTestUtility import ReadLines, WriteLines
+
+YAML_FILE = os.path.join(currentdir, 'ExpectedOutput.yaml')
+
+#
+# Move the lines of the block starting with head into an included file
+#
+def MoveBlock(lines, head, inc_file, inc_dir):
+    start = lines.index(head)
+    indent = len(head) - len(head.lstrip())
+    end = start + 1
+    while end < len(lines) and (lines[end].strip() == '' or
+                                len(lines[end]) - len(lines[end].lstrip()) > indent):
+        end += 1
+    WriteLines(os.path.join(inc_dir, inc_file), [line[indent:] for line in lines[start:end]])
+    return lines[:start] + [' ' * indent + '- !include %s' % inc_file] + lines[end:]
+
+#
+# Split ExpectedOutput.yaml into Root.yaml including FspmUpd.yaml, and
+# FspsUpd.yaml including FspsConfig.yaml
+#
+def CreateSplitYaml(yaml_dir):
+    lines = ReadLines(YAML_FILE)
+    lines = MoveBlock(lines, '    - FSP_S_CONFIG :', 'FspsConfig.yaml', yaml_dir)
+    lines = MoveBlock(lines, '  - FSPM_UPD     :', 'FspmUpd.yaml', yaml_dir)
+    lines = MoveBlock(lines, '  - FSPS_UPD     :', 'FspsUpd.yaml', yaml_dir)
+    root_file = os.path.join(yaml_dir, 'Root.yaml')
+    WriteLines(root_file, lines)
+    return root_file
+
+#
+# Generate a platform YAML file including files of config structures
+#
+#   The structures are split over FSP-T, FSP-M and FSP-S UPD regions, each
+#   structure has fields of 1, 2 and 4 bytes, byte arrays and bit fields
+#
+def CreateLargeYaml(yaml_dir, inc_num, item_num):
+    lines = ['variable:', '  PLATFORM_NAME                  : BenchPkg', '',
+             'template:', '', '', 'configs:',
+             '  - $ACTION      :',
+             '      page         : BCH::"Bench Settings"']
+    for comp_idx, comp in enumerate('TMS'):
+        signature = 'BNCUPD_%s' % comp
+        lines += ['  - $ACTION      :',
+                  '      find         : %s' % signature,
+                  '  - FSP%s_UPD     :' % comp,
+                  '    - $ACTION      :',
+                  '        page         : BCH',
+                  '    - FSP_UPD_HEADER :',
+                  '      - Signature    :',
+                  '          length       : 0x08',
+                  '          value        : 0x%016X' % int.from_bytes(signature.encode(), 'little')]
+        lines += ['    - !include Bench%04d.yaml' % inc_idx for inc_idx in range(inc_num)
+                  if inc_idx * 3 // inc_num == comp_idx]
+    for inc_idx in range(inc_num):
+        inc_file = 'Bench%04d.yaml' % inc_idx
+        inc_lines = ['- BENCH_CFG_%04d :' % inc_idx]
+        item_idx = 0
+        while item_idx < item_num:
+            kind = random.randrange(4)
+            if kind == 3:
+                # a byte of bit fields
+                fields = [('%db' % bits) for bits in random.choice([[1, 7], [3, 5], [2, 2, 4], [1, 1, 1, 5]])]
+            elif kind == 2:
+                fields = ['0x%02X' % random.choice([3, 5, 8])]
+            else:
+                fields = ['0x%02X' % random.choice([1, 2, 4])]
+            for length in fields:
+                if length.endswith('b'):
+                    value = '0x%X' % random.randrange(1 << int(length[:-1]))
+                    kind  = 'Combo'
+                elif int(length, 0) in [3, 5, 8]:
+                    value = '{ %s }' % ', '.join(['0x%02X' % random.randrange(256) for idx in range(int(length, 0))])
+                    kind  = 'EditText'
+                else:
+                    value = '0x%X' % random.randrange(1 << (8 * int(length, 0)))
+                    kind  = 'EditNum, HEX, (0x00,0x%X)' % ((1 << (8 * int(length, 0))) - 1)
+                inc_lines += ['  - Field%05d :' % item_idx,
+                              '      name         : Field %d of structure %d' % (item_idx, inc_idx),
+                              '      type         : %s' % kind,
+                              '      help         : >',
+                              '                     Help of field %d' % item_idx,
+                              '      length       : %s' % length,
+                              '      value        : %s' % value]
+                item_idx += 1
+        WriteLines(os.path.join(yaml_dir, inc_file), inc_lines)
+    root_file = os.path.join(yaml_dir, 'BenchRoot.yaml')
+    WriteLines(root_file, lines)
+    return root_file
+
+#
+# Generate the fields of a random structure layout, bit fields may span bytes
+#
+def FuzzFields(indent, item_num, prefix):
+    lines = []
+    for item_idx in range(item_num):
+        kind = random.randrange(3)
+        if kind == 0:
+            # bit fields of random widths making up whole bytes
+            total = 8 * random.randrange(1, 5)
+            cuts = sorted(random.sample(range(1, total), random.randrange(min(total - 1, 6))))
+            lengths = ['%db' % (end - start) for (start, end) in zip([0] + cuts, cuts + [total])]
+        else:
+            lengths = ['0x%02X' % random.randrange(1, 13)]
+        for length in lengths:
+            if length.endswith('b'):
+                value = '0x%X' % random.randrange(1 << int(length[:-1]))
+            elif int(length, 0) > 8:
+                value = '{ %s }' % ', '.join(['0x%02X' % random.randrange(256) for idx in range(int(length, 0))])
+            else:
+                value = '0x%X' % random.randrange(1 << (8 * int(length, 0)))
+            lines += ['%s- %s%03d_%d :' % (' ' * indent, prefix, item_idx, len(lines)),
+                      '%s    length       : %s' % (' ' * indent, length),
+                      '%s    value        : %s' % (' ' * indent, value)]
+    return lines
+
+#
+# Generate a YAML file of random structure layouts, some nested
+#
+def CreateFuzzYaml(yaml_dir, struct_num, item_num):
+    lines = ['variable:', '  PLATFORM_NAME                  : FuzzPkg', '',
+             'template:', '', '', 'configs:',
+             '  - $ACTION      :',
+             '      page         : FUZ::"Fuzz Settings"',
+             '  - FUZZ_UPD      :',
+             '    - $ACTION      :',
+             '        page         : FUZ']
+    for struct_idx in range(struct_num):
+        lines.append('    - FUZZ_CFG_%03d :' % struct_idx)
+        lines += FuzzFields(6, random.randrange(1, item_num + 1), 'Field')
+        if random.randrange(2):
+            lines.append('      - SUB_CFG_%03d :' % struct_idx)
+            lines += FuzzFields(8, random.randrange(1, item_num + 1), 'SubField')
+            lines += FuzzFields(6, random.randrange(1, item_num + 1), 'Tail')
+    root_file = os.path.join(yaml_dir, 'FuzzRoot.yaml')
+    WriteLines(root_file, lines)
+    return root_file
+
+def LoadYaml(yaml_file, cache_file = ''):
+    cfg_data = GenYamlCfg.CGenYamlCfg()
+    cfg_data.load_yaml(yaml_file, cache_file)
+    return cfg_data
+
+def CfgState(cfg_data):
+    return (cfg_data._cfg_tree, cfg_data._cfg_list, cfg_data._cfg_page, cfg_data._var_dict,
+            cfg_data._def_dict, cfg_data.generate_binary_array())
+
+#
+# Make every lookup miss the config index, so the config tree is walked
+#
+def DisableIndex(cfg_data):
+    cfg_data.get_cfg_index = lambda: {'tree' : cfg_data._cfg_tree, 'path' : {}, 'node' : {},
+                                      'offset' : {}, 'page' : {}}
+    return cfg_data
+
+#
+# List the path and node of every structure and item of the config tree
+#
+def CfgNodes(cfg_data):
+    nodes = []
+    def _CfgNodes(root, path):
+        for key in root:
+            if type(root[key]) is GenYamlCfg.OrderedDict:
+                nodes.append((path + [key], root[key]))
+                _CfgNodes(root[key], path + [key])
+    _CfgNodes(cfg_data._cfg_tree, [])
+    return nodes
+
+#
+# Pack and unpack the items of a structure one bit field at a time
+#
+def RefFieldValue(cfg_data, top):
+    struct_info = top[GenYamlCfg.CGenYamlCfg.STRUCT]
+    result = bytearray((struct_info['length'] + 7) // 8)
+    def _Pack(name, cfgs, level):
+        if 'indx' in cfgs:
+            item = cfg_data.get_item_by_index(cfgs['indx'])
+            if item['length'] > 0:
+                CommonUtility.set_bits_to_bytes(result, item['offset'] - struct_info['offset'], item['length'],
+                                                cfg_data.get_value(item['value'], item['length'], False))
+    cfg_data.traverse_cfg_tree(_Pack, top)
+    return result
+
+def RefFieldValues(cfg_data, top, value_bytes):
+    struct_info = top[GenYamlCfg.CGenYamlCfg.STRUCT]
+    values = {}
+    def _Unpack(name, cfgs, level):
+        if 'indx' in cfgs:
+            item = cfg_data.get_item_by_index(cfgs['indx'])
+            if item['length'] > 0:
+                values[cfgs['indx']] = CommonUtility.get_bits_from_bytes(value_bytes, item['offset'] -
+                                                                         struct_info['offset'], item['length'])
+    cfg_data.traverse_cfg_tree(_Unpack, top)
+    return values
+
+#
+# Change random config items of a binary, but keep the signatures
+#
+def ChangeBinary(cfg_data, bin_data, count):
+    bin_data = bytearray(bin_data)
+    items = [item for item in cfg_data.get_cfg_list() if item['length'] > 0 and
+             item['type'] != 'Reserved' and 'Signature' not in item['cname']]
+    for item in random.sample(items, min(count, len(items))):
+        value = random.randrange(1 << min(item['length'], 32))
+        CommonUtility.set_bits_to_bytes(bin_data, item['offset'], min(item['length'], 32), value)
+    return bin_data
+
+class TestGenYamlCfgCache(unittest.TestCase):
+    def setUp(self):
+        self.tmpdir = tempfile.mkdtemp()
+        self.yaml_file = CreateSplitYaml(self.tmpdir)
+        self.cache_file = os.path.join(self.tmpdir, 'Cache', 'Root.cache')
+        self.parse = GenYamlCfg.CFG_YAML.load_yaml
+
+    def tearDown(self):
+        GenYamlCfg.CFG_YAML.load_yaml = self.parse
+        shutil.rmtree(self.tmpdir)
+
+    #
+    # Fail the test if the YAML file is parsed instead of loaded from cache
+    #
+    def ForbidParse(self):
+        def Parse(cfg_yaml, opt_file):
+            raise Exception("'%s' is parsed again !" % opt_file)
+        GenYamlCfg.CFG_YAML.load_yaml = Parse
+
+    def test_splitYaml(self):
+        cfg_data = LoadYaml(self.yaml_file)
+        self.assertEqual(CfgState(cfg_data)[1:], CfgState(LoadYaml(YAML_FILE))[1:])
+
+    def test_cacheMatchesParse(self):
+        expected = CfgState(LoadYaml(self.yaml_file))
+        self.assertEqual(CfgState(LoadYaml(self.yaml_file, self.cache_file)), expected)
+        self.assertTrue(os.path.exists(self.cache_file))
+        self.ForbidParse()
+        cfg_data = LoadYaml(self.yaml_file, self.cache_file)
+        self.assertEqual(CfgState(cfg_data), expected)
+        self.assertEqual(cfg_data._yaml_path, self.tmpdir)
+
+    def test_cacheYamlPath(self):
+        # The YAML path comes from the file name given, not from the cache
+        LoadYaml(self.yaml_file, self.cache_file)
+        self.ForbidParse()
+        cwd = os.getcwd()
+        os.chdir(self.tmpdir)
+        try:
+            cfg_data = LoadYaml(os.path.basename(self.yaml_file), self.cache_file)
+        finally:
+            os.chdir(cwd)
+        self.assertEqual(cfg_data._yaml_path, '')
+
+    def test_cacheToolChange(self):
+        # A change of GenYamlCfg.py drops the cache
+        LoadYaml(self.yaml_file, self.cache_file)
+        tool_file = os.path.realpath(GenYamlCfg.__file__)
+        hash_dep_files = GenYamlCfg.CGenYamlCfg.hash_dep_files
+        def HashDepFiles(dep_files):
+            return [(path, 'changed' if path == tool_file else dep_hash)
+                    for (path, dep_hash) in hash_dep_files(dep_files)]
+        GenYamlCfg.CGenYamlCfg.hash_dep_files = staticmethod(HashDepFiles)
+        try:
+            self.ForbidParse()
+            self.assertRaises(Exception, LoadYaml, self.yaml_file, self.cache_file)
+        finally:
+            GenYamlCfg.CGenYamlCfg.hash_dep_files = staticmethod(hash_dep_files)
+
+    def test_cacheTouchInclude(self):
+        LoadYaml(self.yaml_file, self.cache_file)
+        inc_file = os.path.join(self.tmpdir, 'FspsConfig.yaml')
+
+        # A newer time stamp with the same content keeps the cache
+        stamp = time.time() + 10
+        os.utime(inc_file, (stamp, stamp))
+        self.ForbidParse()
+        LoadYaml(self.yaml_file, self.cache_file)
+
+        # A change of a file included by an included file drops the cache
+        GenYamlCfg.CFG_YAML.load_yaml = self.parse
+        lines = ReadLines(inc_file)
+        idx = lines.index('  - LogoSize     :') + 6
+        lines[idx] = lines[idx].replace('0x00000000', '0x00000005')
+        WriteLines(inc_file, lines)
+        cfg_data = LoadYaml(self.yaml_file, self.cache_file)
+        item = cfg_data.get_item_by_path('FSPS_UPD.FSP_S_CONFIG.LogoSize')
+        self.assertEqual(item['value'], '0x00000005')
+        self.assertEqual(CfgState(cfg_data), CfgState(LoadYaml(self.yaml_file)))
+
+        # The cache is updated with the change
+        self.ForbidParse()
+        self.assertEqual(LoadYaml(self.yaml_file, self.cache_file).get_item_by_path(
+                         'FSPS_UPD.FSP_S_CONFIG.LogoSize')['value'], '0x00000005')
+
+    def test_cacheBroken(self):
+        os.makedirs(os.path.dirname(self.cache_file))
+        WriteLines(self.cache_file, ['Not a YAML cache'])
+        expected = CfgState(LoadYaml(self.yaml_file))
+        self.assertEqual(CfgState(LoadYaml(self.yaml_file, self.cache_file)), expected)
+        self.ForbidParse()
+        self.assertEqual(CfgState(LoadYaml(self.yaml_file, self.cache_file)), expected)
+
+class TestGenYamlCfgIndex(unittest.TestCase):
+    def setUp(self):
+        random.seed(0x1234)
+        self.tmpdir = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    #
+    # Load a binary and generate its delta file, return the outputs
+    #
+    def GenDelta(self, cfg_data, old_data, new_data):
+        diffs = []
+        cfg_data.show_data_difference = lambda data_diff: diffs.append(data_diff)
+        cfg_data.data_diff = ''
+        dlt_file = os.path.join(self.tmpdir, 'Delta.dlt')
+        cfg_data.generate_delta_file_from_bin(dlt_file, old_data, new_data)
+        return (ReadLines(dlt_file), diffs, CfgState(cfg_data))
+
+    def test_indexPathLookups(self):
+        cfg_data = LoadYaml(YAML_FILE)
+        nodes = CfgNodes(cfg_data)
+        self.assertGreater(len(nodes), len(cfg_data.get_cfg_list()))
+        indexed = [(cfg_data.locate_cfg_item('.'.join(path)), cfg_data.locate_cfg_path(node))
+                   for (path, node) in nodes]
+        DisableIndex(cfg_data)
+        walked = [(cfg_data.locate_cfg_item('.'.join(path)), cfg_data.locate_cfg_path(node))
+                  for (path, node) in nodes]
+        for idx, (path, node) in enumerate(nodes):
+            self.assertIs(indexed[idx][0], node)
+            self.assertIs(walked[idx][0], node)
+            self.assertEqual(indexed[idx][1], path)
+            self.assertEqual(walked[idx][1], path)
+        self.assertEqual(cfg_data.locate_cfg_path(cfg_data._cfg_tree), [])
+        self.assertIsNone(cfg_data.locate_cfg_item('FSPS_UPD.NotAnItem', False))
+        self.assertRaises(Exception, cfg_data.locate_cfg_item, 'FSPS_UPD.NotAnItem')
+
+    def test_indexOffsetLookups(self):
+        cfg_data = LoadYaml(YAML_FILE)
+        for item in cfg_data.get_cfg_list():
+            if item['length'] > 0:
+                first = [other for other in cfg_data.get_cfg_list()
+                         if other['length'] > 0 and other['offset'] == item['offset']][0]
+                self.assertIs(cfg_data.get_item_by_offset(item['offset']), first)
+        end = cfg_data._cfg_tree[GenYamlCfg.CGenYamlCfg.STRUCT]['length']
+        self.assertIsNone(cfg_data.get_item_by_offset(end))
+        self.assertIsNone(cfg_data.get_item_by_offset(1))
+
+    def test_indexMatchesWalk(self):
+        cfg_data = LoadYaml(YAML_FILE)
+        walk_data = DisableIndex(LoadYaml(YAML_FILE))
+        for cfg in [cfg_data, walk_data]:
+            self.assertTrue(cfg.detect_fsp())
+        self.assertEqual(cfg_data.get_cfg_segment(), walk_data.get_cfg_segment())
+        for page in cfg_data._cfg_page['root']['child']:
+            for page_id in page:
+                self.assertEqual(cfg_data.get_cfg_list(page_id), walk_data.get_cfg_list(page_id))
+        for (path, node) in CfgNodes(cfg_data):
+            if GenYamlCfg.CGenYamlCfg.STRUCT in node:
+                self.assertEqual(cfg_data.generate_binary_array('.'.join(path)),
+                                 walk_data.generate_binary_array('.'.join(path)))
+
+        # Load changed binaries and generate the delta files
+        old_data = cfg_data.generate_binary_array()
+        for count in [1, 8, 64]:
+            new_data = ChangeBinary(cfg_data, old_data, count)
+            result = self.GenDelta(cfg_data, old_data, new_data)
+            self.assertEqual(result, self.GenDelta(walk_data, old_data, new_data))
+            self.assertEqual(cfg_data.generate_binary_array(), new_data)
+            self.assertTrue([line for line in result[0] if '|' in line])
+
+    def test_indexValueChanges(self):
+        cfg_data = LoadYaml(YAML_FILE)
+        path = 'FSPS_UPD.FSP_S_CONFIG.LogoSize'
+        item = cfg_data.get_item_by_path(path)
+        self.assertEqual(item['value'], '0x00000000')
+        top = cfg_data.locate_cfg_item(path)
+        cfg_data.set_field_value(top, bytearray([5, 0, 0, 0]), True)
+        self.assertEqual(cfg_data.get_item_by_path(path)['value'], '0x00000005')
+        self.assertIs(cfg_data.get_item_by_offset(item['offset']), item)
+        struct = cfg_data.generate_binary_array('FSPS_UPD.FSP_S_CONFIG')
+        walked = DisableIndex(cfg_data).generate_binary_array('FSPS_UPD.FSP_S_CONFIG')
+        self.assertEqual(struct, walked)
+
+        # Loading another file into the same object indexes the new tree
+        del cfg_data.get_cfg_index
+        yaml_file = CreateLargeYaml(self.tmpdir, 2, 8)
+        cfg_data.load_yaml(yaml_file)
+        self.assertIsNone(cfg_data.locate_cfg_item(path, False))
+        self.assertEqual(cfg_data.get_item_by_path('FSPM_UPD.BENCH_CFG_0001.Field00003')['path'],
+                         'FSPM_UPD.BENCH_CFG_0001.Field00003')
+
+class TestGenYamlCfgPack(unittest.TestCase):
+    def setUp(self):
+        random.seed(0x1234)
+        self.tmpdir = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    #
+    # Check the layout, packing and unpacking of every structure, then load
+    # random bytes into each structure and generate them back
+    #
+    def CheckStructs(self, cfg_data):
+        structs = [([], cfg_data._cfg_tree)] + [(path, node) for (path, node) in CfgNodes(cfg_data)
+                                                if GenYamlCfg.CGenYamlCfg.STRUCT in node]
+        cfg_data.find_data_difference = lambda act_val, act_cfg: None
+        bit_fields = 0
+        for (path, node) in structs:
+            length = node[GenYamlCfg.CGenYamlCfg.STRUCT]['length'] // 8
+            layout = cfg_data.get_struct_layout(node)
+            self.assertEqual([run[0] for run in layout], [0] + [run[1] for run in layout[:-1]])
+            self.assertEqual(layout[-1][1], length)
+            bit_fields += sum([len(run[2]) for run in layout if len(run[2]) > 1])
+
+            value_bytes = cfg_data.generate_binary_array('.'.join(path))
+            self.assertEqual(value_bytes, RefFieldValue(cfg_data, node))
+            self.assertEqual(cfg_data.get_field_values(node, value_bytes),
+                             RefFieldValues(cfg_data, node, value_bytes))
+
+            new_bytes = bytearray(random.getrandbits(8) for idx in range(length))
+            self.assertEqual(cfg_data.get_field_values(node, new_bytes),
+                             RefFieldValues(cfg_data, node, new_bytes))
+            cfg_data.set_field_value(node, new_bytes, True)
+            self.assertEqual(cfg_data.generate_binary_array('.'.join(path)), new_bytes)
+
+        # A short binary is padded with zeros
+        length = len(cfg_data.generate_binary_array())
+        new_bytes = bytearray(random.getrandbits(8) for idx in range(length // 2))
+        cfg_data.set_field_value(cfg_data._cfg_tree, new_bytes, True)
+        self.assertEqual(cfg_data.generate_binary_array(), new_bytes + bytearray(length - len(new_bytes)))
+        return bit_fields
+
+    def test_packExpectedOutput(self):
+        cfg_data = LoadYaml(YAML_FILE)
+        self.assertEqual(self.CheckStructs(cfg_data), 0)
+
+    def test_packFuzzedLayouts(self):
+        bit_fields = 0
+        for loop in range(20):
+            yaml_file = CreateFuzzYaml(self.tmpdir, 12, 8)
+            bit_fields += self.CheckStructs(LoadYaml(yaml_file))
+        self.assertGreater(bit_fields, 0)
+
+    def test_packWalkedTree(self):
+        # The layout is planned the same when the config index is missed
+        yaml_file = CreateFuzzYaml(self.tmpdir, 12, 8)
+        cfg_data = LoadYaml(yaml_file)
+        layout = cfg_data.get_struct_layout(cfg_data._cfg_tree)
+        self.assertIs(cfg_data.get_struct_layout(cfg_data._cfg_tree), layout)
+        self.assertEqual(DisableIndex(cfg_data).get_struct_layout(cfg_data._cfg_tree), layout)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,393 @@
+# @file
+#  Regression tests of the relocation rebase of SplitFspBin.py.
+#
+#  PE32, PE32+ and TE images are generated with random relocation tables. The
+#  batched rebase (ParseRelocTable/RebaseTable) must produce the same bytes
+#  and counts as the per-entry rebase (ParseReloc/Rebase).
+#
+#  FSP 2.x binaries are generated from such images, in FSP components of one
+#  or more FVs. Rebasing them must patch every image and FSP patch table entry
+#  the generator placed in them, and rebasing several components at once must
+#  give the same binary as rebasing them one at a time.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+# Import Modules
+import unittest
+import json
+import random
+import shutil
+import struct
+import tempfile
+from   ctypes import sizeof
+
+import os, sys
+currentdir = os.path.dirname(os.path.realpath(__file__))
+parentdir = os.path.dirname(currentdir)
+sys.path.append(parentdir)
+import SplitFspBin
+from SplitFspBin import EFI_IMAGE_DOS_HEADER, EFI_IMAGE_NT_HEADERS32, EFI_IMAGE_OPTIONAL_HEADER32, \
+                        EFI_IMAGE_OPTIONAL_HEADER32_PLUS, EFI_TE_IMAGE_HEADER, EFI_IMAGE_DIRECTORY_ENTRY, \
+                        EFI_FIRMWARE_VOLUME_HEADER, EFI_FIRMWARE_VOLUME_EXT_HEADER, EFI_FFS_FILE_HEADER, \
+                        EFI_COMMON_SECTION_HEADER, FSP_INFORMATION_HEADER, FSP_PATCH_TABLE, \
+                        EFI_FV_FILETYPE, EFI_SECTION_TYPE, AlignPtr
+
+IMAGE_SIZE   = 0x20000
+RELOC_OFFSET = 0x18000
+PE_HDR_SIZE  = 0x200
+
+FV_HDR_SIZE  = 0x48
+FSP_PATCH_NUM = 16
+FSP_IMAGE_ID  = b'$BENCHFS'
+FSP_TYPES     = {'t' : 1, 'm' : 2, 's' : 3, 'i' : 4, 'o' : 8}
+
+def RandomBytes(length):
+    return bytearray(random.getrandbits(8 * length).to_bytes(length, 'little'))
+
+#
+# Build a relocation table for the pages in [start, end)
+#
+def GenRelocTable(rtypes, start, end, density):
+    table = bytearray()
+    for page in range(start, end, 0x1000):
+        entries = []
+        for roff in sorted(random.sample(range(0, 0xFF8), random.randrange(density))):
+            entries.append((random.choice(rtypes) << 12) | roff)
+        if len(entries) & 1:
+            entries.append(0)   # IMAGE_REL_BASED_ABSOLUTE padding
+        table += struct.pack('<II', page, 8 + 2 * len(entries))
+        table += struct.pack('<%dH' % len(entries), *entries)
+    return table
+
+def GenPeImage(magic, rtypes, density = 200):
+    image = RandomBytes(IMAGE_SIZE)
+    image[0:PE_HDR_SIZE] = bytearray(PE_HDR_SIZE)
+    doshdr = EFI_IMAGE_DOS_HEADER.from_buffer(image, 0)
+    doshdr.e_magic  = 0x5A4D
+    doshdr.e_lfanew = 0x80
+    pehdr = EFI_IMAGE_NT_HEADERS32.from_buffer(image, 0x80)
+    pehdr.Signature = 0x4550
+    if magic == 0x10b:
+        opthdr = pehdr.OptionalHeader.PeOptHdr
+        pehdr.FileHeader.SizeOfOptionalHeader = sizeof(EFI_IMAGE_OPTIONAL_HEADER32)
+        opthdr.ImageBase = 0xFFF00000
+    else:
+        opthdr = pehdr.OptionalHeader.PePlusOptHdr
+        pehdr.FileHeader.SizeOfOptionalHeader = sizeof(EFI_IMAGE_OPTIONAL_HEADER32_PLUS)
+        opthdr.ImageBase = 0xFFFFFFFF00000000
+    opthdr.Magic = magic
+    opthdr.NumberOfRvaAndSizes = 16
+    table = GenRelocTable(rtypes, 0x1000, RELOC_OFFSET, density)
+    opthdr.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY.BASERELOC].VirtualAddress = RELOC_OFFSET
+    opthdr.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY.BASERELOC].Size = len(table)
+    image[RELOC_OFFSET:RELOC_OFFSET + len(table)] = table
+    return image
+
+def GenTeImage(rtypes, density = 200):
+    image = RandomBytes(IMAGE_SIZE)
+    image[0:sizeof(EFI_TE_IMAGE_HEADER)] = bytearray(sizeof(EFI_TE_IMAGE_HEADER))
+    tehdr = EFI_TE_IMAGE_HEADER.from_buffer(image, 0)
+    tehdr.Signature    = b'VZ'
+    tehdr.StrippedSize = PE_HDR_SIZE - sizeof(EFI_TE_IMAGE_HEADER)
+    tehdr.ImageBase    = 0xFFF00000
+    adjust = tehdr.StrippedSize - sizeof(EFI_TE_IMAGE_HEADER)
+    table  = GenRelocTable(rtypes, 0x1000, RELOC_OFFSET, density)
+    tehdr.DataDirectoryBaseReloc.VirtualAddress = RELOC_OFFSET + adjust
+    tehdr.DataDirectoryBaseReloc.Size = len(table)
+    image[RELOC_OFFSET:RELOC_OFFSET + len(table)] = table
+    return image
+
+#
+# Build a FFS file holding a single section
+#
+def GenFfs(ftype, stype, secdata):
+    hdrsize = sizeof(EFI_FFS_FILE_HEADER) + sizeof(EFI_COMMON_SECTION_HEADER)
+    ffs = RandomBytes(16) + bytearray(hdrsize - 16) + secdata
+    ffshdr = EFI_FFS_FILE_HEADER.from_buffer(ffs, 0)
+    ffshdr.Type = ftype
+    ffshdr.Size.value = len(ffs)
+    ffshdr.State = 0xF8
+    sechdr = EFI_COMMON_SECTION_HEADER.from_buffer(ffs, sizeof(EFI_FFS_FILE_HEADER))
+    sechdr.Type = stype
+    sechdr.Size.value = len(ffs) - sizeof(EFI_FFS_FILE_HEADER)
+    return ffs
+
+#
+# Build a FV holding the FFS files, and return it with the FV offset of each
+#
+def GenFv(ffslist):
+    exthdr = EFI_FIRMWARE_VOLUME_EXT_HEADER()
+    exthdr.FvName[0:16] = list(RandomBytes(16))
+    exthdr.ExtHeaderSize = sizeof(exthdr)
+    fv = bytearray(FV_HDR_SIZE) + bytearray(exthdr)
+    offsets = []
+    for ffs in ffslist:
+        fv += bytearray(b'\xff' * (AlignPtr(len(fv)) - len(fv)))
+        offsets.append(len(fv))
+        fv += ffs
+    fv += bytearray(b'\xff' * (AlignPtr(len(fv)) - len(fv)))
+    fvhdr = EFI_FIRMWARE_VOLUME_HEADER.from_buffer(fv, 0)
+    fvhdr.FileSystemGuid[0:16] = list(RandomBytes(16))
+    fvhdr.FvLength = len(fv)
+    fvhdr.Signature = b'_FVH'
+    fvhdr.HeaderLength = FV_HDR_SIZE
+    fvhdr.ExtHeaderOffset = FV_HDR_SIZE
+    fvhdr.Revision = 2
+    struct.pack_into('<II', fv, sizeof(fvhdr), len(fv) // 8, 8)
+    return fv, offsets
+
+#
+# Build a FSP 2.x binary from the images of the pool
+#
+#   comps     list of (component, base, number of FVs, images per FV)
+#
+# The layout of each component is returned as a dictionary with the FD
+# offset of the component, its images and the targets of its patch table.
+#
+def GenFspFd(comps, pool):
+    fdbin  = bytearray()
+    layout = []
+    for (comp, base, fvnum, imgnum) in comps:
+        fihsize = sizeof(FSP_INFORMATION_HEADER)
+        rawdata = bytearray(fihsize + sizeof(FSP_PATCH_TABLE) + 4 * FSP_PATCH_NUM)
+        fsp     = bytearray()
+        images  = []
+        for fvidx in range(fvnum):
+            ffslist = []
+            if fvidx == 0:
+                ffslist.append(GenFfs(EFI_FV_FILETYPE.RAW, EFI_SECTION_TYPE.RAW, rawdata))
+            for imgidx in range(imgnum):
+                image = random.choice(pool)
+                stype = EFI_SECTION_TYPE.TE if image[0:2] == b'VZ' else EFI_SECTION_TYPE.PE32
+                ffslist.append(GenFfs(EFI_FV_FILETYPE.PEIM, stype, image))
+            fv, offsets = GenFv(ffslist)
+            hdrsize = sizeof(EFI_FFS_FILE_HEADER) + sizeof(EFI_COMMON_SECTION_HEADER)
+            for idx, ffs in enumerate(ffslist):
+                if fvidx == 0 and idx == 0:
+                    continue
+                images.append((len(fdbin) + len(fsp) + offsets[idx] + hdrsize, len(ffs) - hdrsize))
+            if fvidx == 0:
+                fihoff = offsets[0] + hdrsize
+            fsp += fv
+
+        # The last entry is beyond the component, so it must be ignored
+        targets = sorted(random.sample(range(0x1000, len(fsp) - 4, 4), FSP_PATCH_NUM - 1))
+        fih = FSP_INFORMATION_HEADER.from_buffer(fsp, fihoff)
+        fih.Signature = b'FSPH'
+        fih.HeaderLength = fihsize
+        fih.SpecVersion = 0x22
+        fih.HeaderRevision = 6
+        fih.ImageRevision = 0x00010203
+        fih.ImageId = FSP_IMAGE_ID
+        fih.ImageSize = len(fsp)
+        fih.ImageBase = base
+        fih.ComponentAttribute = FSP_TYPES[comp] << 12
+        fspp = FSP_PATCH_TABLE.from_buffer(fsp, fihoff + fihsize)
+        fspp.Signature = b'FSPP'
+        fspp.HeaderLength = sizeof(fspp) + 4 * FSP_PATCH_NUM
+        fspp.HeaderRevision = 1
+        fspp.PatchEntryNum = FSP_PATCH_NUM
+        struct.pack_into('<%dI' % FSP_PATCH_NUM, fsp, fihoff + fihsize + sizeof(fspp), *(targets + [len(fsp)]))
+        del fih, fspp
+
+        layout.append({'Type' : comp, 'Offset' : len(fdbin), 'Size' : len(fsp), 'Base' : base, 'Images' : images,
+                       'Patches' : [len(fdbin) + target for target in targets + [fihoff + 0x1C]]})
+        fdbin += fsp
+    return fdbin, layout
+
+#
+# Rebase a generated FSP binary with the per-entry rebase of each image
+#
+def RebaseFspLayout(fdbin, layout, newbases):
+    newbin = fdbin[:]
+    for comp in layout:
+        if comp['Type'] not in newbases:
+            continue
+        delta = newbases[comp['Type']] - comp['Base']
+        for (offset, length) in comp['Images']:
+            img = SplitFspBin.PeTeImage(offset, fdbin[offset:offset + length])
+            img.ParseReloc()
+            img.Rebase(delta, newbin)
+        for offset in comp['Patches']:
+            value = struct.unpack_from('<I', newbin, offset)[0]
+            struct.pack_into('<I', newbin, offset, (value + delta) & 0xFFFFFFFF)
+    return newbin
+
+def GenImagePool(count = 8, density = 200):
+    pool = []
+    for idx in range(count):
+        pool.append(random.choice([GenPeImage(0x10b, [3], density), GenPeImage(0x20b, [10], density),
+                                   GenTeImage([3], density)]))
+    return pool
+
+class TestSplitFspBinRebase(unittest.TestCase):
+    def setUp(self):
+        random.seed(0x5046)
+
+    #
+    # Rebase the image placed at offset in a larger binary both ways
+    #
+    def CompareRebase(self, image, delta, offset = 0x3000):
+        fdbin = bytearray(random.getrandbits(8) for idx in range(offset)) + image + bytearray(0x100)
+        oldbin = fdbin[:]
+        newbin = fdbin[:]
+
+        img = SplitFspBin.PeTeImage(offset, fdbin[offset:offset + len(image)])
+        img.ParseReloc()
+        oldcount = img.Rebase(delta, oldbin)
+
+        img = SplitFspBin.PeTeImage(offset, fdbin[offset:offset + len(image)])
+        img.ParseRelocTable()
+        newcount = img.RebaseTable(delta, newbin)
+
+        self.assertEqual(oldcount, newcount)
+        self.assertEqual(len(oldbin), len(newbin))
+        self.assertTrue(oldbin == newbin)
+        if delta != 0:
+            self.assertTrue(newcount > 0)
+            self.assertFalse(newbin == fdbin)
+        return newcount
+
+    def test_rebasePe32(self):
+        image = GenPeImage(0x10b, [3])
+        for delta in [0x100000, -0x200000, 0x12345678]:
+            self.CompareRebase(image, delta)
+
+    def test_rebasePe32Plus(self):
+        image = GenPeImage(0x20b, [10])
+        for delta in [0x100000, -0x200000, 0x12345678]:
+            self.CompareRebase(image, delta)
+
+    def test_rebaseTe(self):
+        image = GenTeImage([3])
+        for delta in [0x100000, -0x200000]:
+            self.CompareRebase(image, delta)
+
+    def test_rebaseMixedTypes(self):
+        # HIGHLOW and DIR64 entries overlap, so the order of the table matters
+        image = GenPeImage(0x20b, [3, 10, 0], 800)
+        self.CompareRebase(image, -0x10000)
+        image = GenTeImage([10, 3], 800)
+        self.CompareRebase(image, 0x10000)
+
+    def test_rebaseUnalignedImage(self):
+        image = GenPeImage(0x10b, [3])
+        self.CompareRebase(image, 0x1000, 0x3002)
+
+    def test_rebaseZeroDelta(self):
+        image = GenPeImage(0x10b, [3])
+        self.assertEqual(self.CompareRebase(image, 0), 0)
+
+    def test_unsupportedRelocType(self):
+        image = GenPeImage(0x10b, [3, 4])
+        img = SplitFspBin.PeTeImage(0, image)
+        with self.assertRaises(Exception) as old:
+            img.ParseReloc()
+        with self.assertRaises(Exception) as new:
+            img.ParseRelocTable()
+        self.assertEqual(str(old.exception), str(new.exception))
+
+class TestSplitFspBinFd(unittest.TestCase):
+    def setUp(self):
+        random.seed(0x4644)
+        self.tmpdir = tempfile.mkdtemp()
+        self.comps  = [('t', 0xFFF80000, 1, 3), ('m', 0xFFE00000, 2, 3), ('s', 0xFFC00000, 3, 2)]
+        self.fdbin, self.layout = GenFspFd(self.comps, GenImagePool())
+        self.fdfile = os.path.join(self.tmpdir, 'FSP.fd')
+        fd = open(self.fdfile, 'wb')
+        fd.write(self.fdbin)
+        fd.close()
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    def test_parseFd(self):
+        fd = SplitFspBin.FirmwareDevice(0, self.fdfile)
+        fd.ParseFd()
+        fd.ParseFsp()
+        self.assertEqual(len(fd.FvList), sum([comp[2] for comp in self.comps]))
+        self.assertEqual([fsp.Type.lower() for fsp in fd.FspList], [comp[0] for comp in self.comps])
+        # Only the sections of the first file of each FSP component are decoded
+        decoded = [ffs for fv in fd.FvList for ffs in fv.FfsList if ffs.Sections is not None]
+        self.assertEqual(decoded, [fd.FvList[fsp.FvIdxList[0]].FfsList[0] for fsp in fd.FspList])
+        images = []
+        for fv in fd.FvList:
+            # Every window shares the buffer of the FD
+            self.assertTrue(fv.FvData.obj is fd.FdData)
+            for ffs in fv.FfsList:
+                for sec in ffs.SecList:
+                    self.assertTrue(sec.SecData.obj is fd.FdData)
+                    if sec.SecHdr.Type in [EFI_SECTION_TYPE.TE, EFI_SECTION_TYPE.PE32]:
+                        images.append((fv.Offset + ffs.Offset + sec.Offset + sizeof(sec.SecHdr),
+                                       len(sec.SecData) - sizeof(sec.SecHdr)))
+        self.assertEqual(images, [image for comp in self.layout for image in comp['Images']])
+
+    def test_rebaseFspBin(self):
+        newbases = {'m' : 0xFEE00000, 's' : 0x7FC00000}
+        SplitFspBin.RebaseFspBin(self.fdfile, ['s', 'm'], ['0x%X' % newbases['s'], '%d' % newbases['m']],
+                                 self.tmpdir, 'FSP_REBASED.fd')
+        newbin = self.ReadFd('FSP_REBASED.fd')
+        self.assertTrue(newbin == RebaseFspLayout(self.fdbin, self.layout, newbases))
+
+    def ReadFd(self, name):
+        fd = open(os.path.join(self.tmpdir, name), 'rb')
+        newbin = bytearray(fd.read())
+        fd.close()
+        return newbin
+
+    def test_rebaseOneAtATime(self):
+        newbases = {'t' : 0xFEF80000, 'm' : 0xFE000000, 's' : 0xFDC00000}
+        fdfile = self.fdfile
+        for idx, comp in enumerate(['m', 't', 's']):
+            SplitFspBin.RebaseFspBin(fdfile, [comp], ['0x%X' % newbases[comp]], self.tmpdir, 'FSP_%d.fd' % idx)
+            fdfile = os.path.join(self.tmpdir, 'FSP_%d.fd' % idx)
+        SplitFspBin.RebaseFspBin(self.fdfile, ['t', 'm', 's'], ['0x%X' % newbases[comp] for comp in ['t', 'm', 's']],
+                                 self.tmpdir, 'FSP_ALL.fd')
+        newbin = self.ReadFd('FSP_ALL.fd')
+        self.assertTrue(newbin == self.ReadFd('FSP_2.fd'))
+        self.assertTrue(newbin == RebaseFspLayout(self.fdbin, self.layout, newbases))
+
+    def test_rebaseReport(self):
+        report = os.path.join(self.tmpdir, 'FSP_REBASED.json')
+        SplitFspBin.RebaseFspBin(self.fdfile, ['s', 't'], ['0xFDC00000', '0xFFF80000'], self.tmpdir, '', report)
+        self.assertTrue(os.path.exists(os.path.join(self.tmpdir, 'FSP_FFF80000.fd')))
+        fd = open(report, 'r')
+        report = json.load(fd)
+        fd.close()
+        self.assertEqual([comp['Component'] for comp in report['Components']], ['S', 'T'])
+        layout = dict([(comp['Type'], comp) for comp in self.layout])
+        for comp in report['Components']:
+            images = layout[comp['Component'].lower()]['Images']
+            relocs = 0
+            for (offset, length) in images:
+                img = SplitFspBin.PeTeImage(offset, self.fdbin[offset:offset + length])
+                img.ParseReloc()
+                relocs += len(img.RelocList)
+            self.assertEqual(comp['Images'], len(images))
+            self.assertEqual(comp['PatchEntries'], FSP_PATCH_NUM - 1)
+            self.assertEqual(comp['InvalidPatchEntries'], 1)
+            if comp['Component'] == 'T':
+                # FSP-T is rebased to the base it already has
+                self.assertEqual(comp['OldBase'], comp['NewBase'])
+                self.assertEqual(comp['RelocEntries'], 0)
+            else:
+                self.assertEqual((comp['OldBase'], comp['NewBase']), ('0xFFC00000', '0xFDC00000'))
+                self.assertEqual(comp['RelocEntries'], relocs)
+
+    def test_rebaseMissingComponent(self):
+        SplitFspBin.RebaseFspBin(self.fdfile, ['t', 'o'], ['0xFFF80000', '0xFF000000'], self.tmpdir, 'FSP_O.fd')
+        self.assertFalse(os.path.exists(os.path.join(self.tmpdir, 'FSP_O.fd')))
+
+    def test_splitFspBin(self):
+        SplitFspBin.SplitFspBin(self.fdfile, self.tmpdir, 'FSP.fd')
+        for comp in self.layout:
+            fd = open(os.path.join(self.tmpdir, 'FSP_%s.fd' % comp['Type'].upper()), 'rb')
+            self.assertTrue(fd.read() == self.fdbin[comp['Offset']:comp['Offset'] + comp['Size']])
+            fd.close()
+
+if __name__ == '__main__':
+    unittest.main()
@@ -28,6 +28,132 @@
 //
 #define PEI_ADDITIONAL_MEMORY_SIZE  (16 * EFI_PAGE_SIZE)
 
+//
+// The largest HOB PeiServicesCreateHob () can build.
+//
+#define MAX_HOB_RUN_SIZE  0xFFF8
+
+/**
+  Check whether a HOB of the FSP HOB list is to be added to the HOB list.
+
+  @param[in] Hob  The FSP HOB.
+
+  @retval TRUE   The HOB is to be added.
+  @retval FALSE  The HOB is skipped.
+**/
+typedef
+BOOLEAN
+(*FSP_HOB_FILTER)(
+  IN EFI_PEI_HOB_POINTERS  Hob
+  );
+
+/**
+  Append the HOBs of the FSP HOB list selected by a filter to the HOB list.
+
+  The selected HOBs are copied as they are, in their order, so they keep their
+  headers. Up to MAX_HOB_RUN_SIZE bytes of them are copied at a time into the
+  space of a single HOB created for them.
+
+  @param[in] FspHobList  Pointer to the HOB data structure produced by FSP.
+  @param[in] Filter      The function selecting the HOBs.
+
+**/
+VOID
+AppendFspHobs (
+  IN VOID            *FspHobList,
+  IN FSP_HOB_FILTER  Filter
+  )
+{
+  EFI_STATUS            Status;
+  EFI_PEI_HOB_POINTERS  FspHob;
+  EFI_PEI_HOB_POINTERS  RunHob;
+  UINT8                 *Buffer;
+  UINTN                 RunSize;
+
+  FspHob.Raw = FspHobList;
+  while (!END_OF_HOB_LIST (FspHob)) {
+    //
+    // Size the run of selected HOBs fitting in one HOB
+    //
+    RunHob.Raw = FspHob.Raw;
+    RunSize    = 0;
+    while (!END_OF_HOB_LIST (FspHob)) {
+      if (Filter (FspHob)) {
+        if (RunSize + FspHob.Header->HobLength > MAX_HOB_RUN_SIZE) {
+          break;
+        }
+
+        RunSize += FspHob.Header->HobLength;
+      }
+
+      FspHob.Raw = GET_NEXT_HOB (FspHob);
+    }
+
+    if (RunSize == 0) {
+      break;
+    }
+
+    Status = PeiServicesCreateHob (EFI_HOB_TYPE_UNUSED, (UINT16)RunSize, (VOID **)&Buffer);
+    ASSERT_EFI_ERROR (Status);
+    if (EFI_ERROR (Status)) {
+      return;
+    }
+
+    //
+    // The HOBs of the run overwrite the header of the created HOB
+    //
+    for ( ; RunHob.Raw != FspHob.Raw; RunHob.Raw = GET_NEXT_HOB (RunHob)) {
+      if (Filter (RunHob)) {
+        CopyMem (Buffer, RunHob.Raw, RunHob.Header->HobLength);
+        Buffer += RunHob.Header->HobLength;
+      }
+    }
+  }
+}
+
+/**
+  Check whether a resource descriptor HOB of FSP is reported again.
+
+  The system memory between 1M and 4G is reported as one resource instead.
+
+  @param[in] Hob  The FSP HOB.
+
+  @retval TRUE   The HOB is a resource descriptor HOB to report.
+  @retval FALSE  The HOB is skipped.
+**/
+BOOLEAN
+IsFspResourceHobReported (
+  IN EFI_PEI_HOB_POINTERS  Hob
+  )
+{
+  if (Hob.Header->HobType != EFI_HOB_TYPE_RESOURCE_DESCRIPTOR) {
+    return FALSE;
+  }
+
+  return (BOOLEAN)!(  (Hob.ResourceDescriptor->ResourceType == EFI_RESOURCE_SYSTEM_MEMORY)
+                   && (Hob.ResourceDescriptor->PhysicalStart >= BASE_1MB)
+                   && (Hob.ResourceDescriptor->PhysicalStart + Hob.ResourceDescriptor->ResourceLength <= BASE_4GB));
+}
+
+/**
+  Check whether a GUID extension HOB of FSP is added to the HOB list.
+
+  The PCD database HOB of the FSP binary is skipped.
+
+  @param[in] Hob  The FSP HOB.
+
+  @retval TRUE   The HOB is a GUID extension HOB to add.
+  @retval FALSE  The HOB is skipped.
+**/
+BOOLEAN
+IsFspGuidHobAdded (
+  IN EFI_PEI_HOB_POINTERS  Hob
+  )
+{
+  return (BOOLEAN)((Hob.Header->HobType == EFI_HOB_TYPE_GUID_EXTENSION) &&
+                   !CompareGuid (&Hob.Guid->Name, &gPcdDataBaseHobGuid));
+}
+
 /**
   Get the mem size in memory type information table.
 
@@ -209,16 +335,22 @@ PostFspmHobProcess (
     //
     // Report the resource hob
     //
-    BuildResourceDescriptorHob (
-      Hob.ResourceDescriptor->ResourceType,
-      Hob.ResourceDescriptor->ResourceAttribute,
-      Hob.ResourceDescriptor->PhysicalStart,
-      Hob.ResourceDescriptor->ResourceLength
-      );
+    if (!PcdGetBool (PcdFspHobBulkAppend)) {
+      BuildResourceDescriptorHob (
+        Hob.ResourceDescriptor->ResourceType,
+        Hob.ResourceDescriptor->ResourceAttribute,
+        Hob.ResourceDescriptor->PhysicalStart,
+        Hob.ResourceDescriptor->ResourceLength
+        );
+    }
 
     Hob.Raw = GET_NEXT_HOB (Hob);
   }
 
+  if (PcdGetBool (PcdFspHobBulkAppend)) {
+    AppendFspHobs (FspHobList, IsFspResourceHobReported);
+  }
+
   if (!FoundFspMemHob) {
     DEBUG ((DEBUG_INFO, "Didn't find the fsp used memory information.\n"));
     // ASSERT(FALSE);
@@ -347,6 +479,11 @@ ProcessFspHobList (
 {
   EFI_PEI_HOB_POINTERS  FspHob;
 
+  if (PcdGetBool (PcdFspHobBulkAppend)) {
+    AppendFspHobs (FspHobList, IsFspGuidHobAdded);
+    return;
+  }
+
   FspHob.Raw = FspHobList;
 
   //
@@ -637,7 +637,6 @@ InitializedProcessorMicrocodeIndex (
   UINTN       CpuIndex;
   UINTN       MicrocodeIndex;
   UINTN       TargetCpuIndex;
-  UINT32      AttemptStatus;
   EFI_STATUS  Status;
 
   for (CpuIndex = 0; CpuIndex < MicrocodeFmpPrivate->ProcessorCount; CpuIndex++) {
@@ -651,13 +650,9 @@ InitializedProcessorMicrocodeIndex (
       }
 
       TargetCpuIndex = CpuIndex;
-      Status         = VerifyMicrocode (
+      Status         = VerifyIndexedMicrocode (
                          MicrocodeFmpPrivate,
-                         MicrocodeFmpPrivate->MicrocodeInfo[MicrocodeIndex].MicrocodeEntryPoint,
-                         MicrocodeFmpPrivate->MicrocodeInfo[MicrocodeIndex].TotalSize,
-                         FALSE,
-                         &AttemptStatus,
-                         NULL,
+                         &MicrocodeFmpPrivate->PatchIndex[MicrocodeIndex],
                          &TargetCpuIndex
                          );
       if (!EFI_ERROR (Status)) {
@@ -683,6 +678,12 @@ InitializeMicrocodeDescriptor (
   EFI_STATUS  Status;
   UINT8       CurrentMicrocodeCount;
 
+  Status = UpdateMicrocodePatchIndex (MicrocodeFmpPrivate);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "UpdateMicrocodePatchIndex - %r\n", Status));
+    return Status;
+  }
+
   CurrentMicrocodeCount = (UINT8)GetMicrocodeInfo (MicrocodeFmpPrivate, 0, NULL, NULL);
 
   if (CurrentMicrocodeCount > MicrocodeFmpPrivate->DescriptorCount) {
@@ -746,12 +747,16 @@ InitializeProcessorInfo (
   IN MICROCODE_FMP_PRIVATE_DATA  *MicrocodeFmpPrivate
   )
 {
-  EFI_STATUS                Status;
-  EFI_MP_SERVICES_PROTOCOL  *MpService;
-  UINTN                     NumberOfProcessors;
-  UINTN                     NumberOfEnabledProcessors;
-  UINTN                     Index;
-  UINTN                     BspIndex;
+  EFI_STATUS                 Status;
+  EFI_MP_SERVICES_PROTOCOL   *MpService;
+  UINTN                      NumberOfProcessors;
+  UINTN                      NumberOfEnabledProcessors;
+  UINTN                      Index;
+  UINTN                      SiblingIndex;
+  UINTN                      BspIndex;
+  EFI_PROCESSOR_INFORMATION  ProcessorInfoBuffer;
+  PROCESSOR_INFO             *ProcessorInfo;
+  PROCESSOR_INFO             *SiblingInfo;
 
   Status = gBS->LocateProtocol (&gEfiMpServiceProtocolGuid, NULL, (VOID **)&MpService);
   ASSERT_EFI_ERROR (Status);
@@ -773,9 +778,23 @@ InitializeProcessorInfo (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  MicrocodeFmpPrivate->LoadReport = AllocateZeroPool (sizeof (MICROCODE_LOAD_REPORT) * MicrocodeFmpPrivate->ProcessorCount);
+  if (MicrocodeFmpPrivate->LoadReport == NULL) {
+    FreePool (MicrocodeFmpPrivate->ProcessorInfo);
+    MicrocodeFmpPrivate->ProcessorInfo = NULL;
+    return EFI_OUT_OF_RESOURCES;
+  }
+
   for (Index = 0; Index < NumberOfProcessors; Index++) {
     MicrocodeFmpPrivate->ProcessorInfo[Index].CpuIndex       = Index;
     MicrocodeFmpPrivate->ProcessorInfo[Index].MicrocodeIndex = (UINTN)-1;
+    Status                                                   = MpService->GetProcessorInfo (MpService, Index, &ProcessorInfoBuffer);
+    ASSERT_EFI_ERROR (Status);
+    if (!EFI_ERROR (Status)) {
+      MicrocodeFmpPrivate->ProcessorInfo[Index].Location = ProcessorInfoBuffer.Location;
+      MicrocodeFmpPrivate->ProcessorInfo[Index].Enabled  = (BOOLEAN)((ProcessorInfoBuffer.StatusFlag & PROCESSOR_ENABLED_BIT) != 0);
+    }
+
     if (Index == BspIndex) {
       CollectProcessorInfo (&MicrocodeFmpPrivate->ProcessorInfo[Index]);
     } else {
@@ -792,6 +811,28 @@ InitializeProcessorInfo (
     }
   }
 
+  //
+  // Only one thread per core may load Microcode. Select the BSP for its own core,
+  // and the enabled thread with the lowest index for the other cores.
+  //
+  for (Index = 0; Index < NumberOfProcessors; Index++) {
+    ProcessorInfo             = &MicrocodeFmpPrivate->ProcessorInfo[Index];
+    ProcessorInfo->CoreLoader = ProcessorInfo->Enabled;
+    for (SiblingIndex = 0; ProcessorInfo->CoreLoader && (SiblingIndex < NumberOfProcessors); SiblingIndex++) {
+      SiblingInfo = &MicrocodeFmpPrivate->ProcessorInfo[SiblingIndex];
+      if ((SiblingIndex == Index) || !SiblingInfo->Enabled ||
+          (SiblingInfo->Location.Package != ProcessorInfo->Location.Package) ||
+          (SiblingInfo->Location.Core != ProcessorInfo->Location.Core))
+      {
+        continue;
+      }
+
+      if ((SiblingIndex == BspIndex) || ((SiblingIndex < Index) && (Index != BspIndex))) {
+        ProcessorInfo->CoreLoader = FALSE;
+      }
+    }
+  }
+
   return EFI_SUCCESS;
 }
 
@@ -819,12 +860,16 @@ DumpPrivateInfo (
   for (Index = 0; Index < MicrocodeFmpPrivate->ProcessorCount; Index++) {
     DEBUG ((
       DEBUG_INFO,
-      "  ProcessorInfo[0x%x] - 0x%08x, 0x%02x, 0x%08x, (0x%x)\n",
+      "  ProcessorInfo[0x%x] - 0x%08x, 0x%02x, 0x%08x, (0x%x), (0x%x, 0x%x, 0x%x, 0x%x)\n",
       ProcessorInfo[Index].CpuIndex,
       ProcessorInfo[Index].ProcessorSignature,
       ProcessorInfo[Index].PlatformId,
       ProcessorInfo[Index].MicrocodeRevision,
-      ProcessorInfo[Index].MicrocodeIndex
+      ProcessorInfo[Index].MicrocodeIndex,
+      ProcessorInfo[Index].Location.Package,
+      ProcessorInfo[Index].Location.Core,
+      ProcessorInfo[Index].Location.Thread,
+      ProcessorInfo[Index].CoreLoader
       ));
   }
 
@@ -924,6 +969,14 @@ InitializePrivateData (
     return EFI_NOT_FOUND;
   }
 
+  //
+  // The whole Microcode region needs to be indexed at first.
+  //
+  MicrocodeFmpPrivate->PatchIndex           = NULL;
+  MicrocodeFmpPrivate->PatchIndexCount      = 0;
+  MicrocodeFmpPrivate->PatchIndexDirtyStart = 0;
+  MicrocodeFmpPrivate->PatchIndexDirtyEnd   = MicrocodeFmpPrivate->MicrocodePatchRegionSize;
+
   Status = InitializeProcessorInfo (MicrocodeFmpPrivate);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "InitializeProcessorInfo - %r\n", Status));
@@ -933,6 +986,7 @@ InitializePrivateData (
   Status = InitializeMicrocodeDescriptor (MicrocodeFmpPrivate);
   if (EFI_ERROR (Status)) {
     FreePool (MicrocodeFmpPrivate->ProcessorInfo);
+    FreePool (MicrocodeFmpPrivate->LoadReport);
     DEBUG ((DEBUG_ERROR, "InitializeMicrocodeDescriptor - %r\n", Status));
     return Status;
   }
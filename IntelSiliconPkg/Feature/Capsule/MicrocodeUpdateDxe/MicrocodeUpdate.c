@@ -167,6 +167,62 @@ LoadMicrocodeOnThis (
   }
 }
 
+/**
+  Load Microcode on all Application Processors.
+  The function prototype for invoking a function on an Application Processor.
+
+  Only the first enabled thread of each core with a matched processor signature
+  triggers the update, because the Microcode is shared by the threads of a core.
+
+  @param[in,out] Buffer  The pointer to MICROCODE_LOAD_ALL_BUFFER.
+**/
+VOID
+EFIAPI
+MicrocodeLoadAllAp (
+  IN OUT VOID  *Buffer
+  )
+{
+  MICROCODE_LOAD_ALL_BUFFER  *LoadAllBuffer;
+  EFI_STATUS                 Status;
+  UINTN                      CpuIndex;
+
+  LoadAllBuffer = Buffer;
+  Status        = LoadAllBuffer->MpService->WhoAmI (LoadAllBuffer->MpService, &CpuIndex);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  if (LoadAllBuffer->LoadReport[CpuIndex].Matched && LoadAllBuffer->ProcessorInfo[CpuIndex].CoreLoader) {
+    LoadMicrocode (LoadAllBuffer->Address);
+    LoadAllBuffer->LoadReport[CpuIndex].Loaded = TRUE;
+  }
+}
+
+/**
+  Get the Microcode revision on all Application Processors.
+  The function prototype for invoking a function on an Application Processor.
+
+  @param[in,out] Buffer  The pointer to MICROCODE_LOAD_ALL_BUFFER.
+**/
+VOID
+EFIAPI
+MicrocodeRevisionAp (
+  IN OUT VOID  *Buffer
+  )
+{
+  MICROCODE_LOAD_ALL_BUFFER  *LoadAllBuffer;
+  EFI_STATUS                 Status;
+  UINTN                      CpuIndex;
+
+  LoadAllBuffer = Buffer;
+  Status        = LoadAllBuffer->MpService->WhoAmI (LoadAllBuffer->MpService, &CpuIndex);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  LoadAllBuffer->LoadReport[CpuIndex].Revision = GetCurrentMicrocodeSignature ();
+}
+
 /**
   Collect processor information.
   The function prototype for invoking a function on an Application Processor.
@@ -187,11 +243,212 @@ CollectProcessorInfo (
   ProcessorInfo->MicrocodeRevision  = GetCurrentMicrocodeSignature ();
 }
 
+/**
+  Parse and checksum one Microcode patch of the Microcode region.
+
+  @param[in]  MicrocodeFmpPrivate        The Microcode driver private data
+  @param[in]  Offset                     The offset of the Microcode patch in the Microcode region.
+  @param[in]  TotalSize                  The size of the Microcode patch in bytes.
+  @param[out] PatchIndex                 The index entry of the Microcode patch.
+**/
+STATIC
+VOID
+IndexMicrocodePatch (
+  IN  MICROCODE_FMP_PRIVATE_DATA  *MicrocodeFmpPrivate,
+  IN  UINTN                       Offset,
+  IN  UINTN                       TotalSize,
+  OUT MICROCODE_PATCH_INDEX       *PatchIndex
+  )
+{
+  CPU_MICROCODE_HEADER                 *MicrocodeEntryPoint;
+  CPU_MICROCODE_EXTENDED_TABLE_HEADER  *ExtendedTableHeader;
+  UINTN                                DataSize;
+  UINTN                                ExtendedTableLength;
+
+  MicrocodeEntryPoint = (CPU_MICROCODE_HEADER *)((UINTN)MicrocodeFmpPrivate->MicrocodePatchAddress + Offset);
+
+  ZeroMem (PatchIndex, sizeof (MICROCODE_PATCH_INDEX));
+  PatchIndex->Offset             = Offset;
+  PatchIndex->TotalSize          = TotalSize;
+  PatchIndex->ProcessorSignature = MicrocodeEntryPoint->ProcessorSignature.Uint32;
+  PatchIndex->ProcessorFlags     = MicrocodeEntryPoint->ProcessorFlags;
+  PatchIndex->UpdateRevision     = MicrocodeEntryPoint->UpdateRevision;
+
+  //
+  // Same format checks as VerifyMicrocode(). The patch must also be inside the Microcode region.
+  //
+  if ((TotalSize <= sizeof (CPU_MICROCODE_HEADER)) ||
+      ((TotalSize & (SIZE_1KB - 1)) != 0) ||
+      (TotalSize > MicrocodeFmpPrivate->MicrocodePatchRegionSize - Offset))
+  {
+    DEBUG ((DEBUG_ERROR, "IndexMicrocodePatch - TotalSize is invalid (0x%x)\n", Offset));
+    return;
+  }
+
+  if (MicrocodeEntryPoint->DataSize == 0) {
+    DataSize = 2048 - sizeof (CPU_MICROCODE_HEADER);
+  } else {
+    DataSize = MicrocodeEntryPoint->DataSize;
+  }
+
+  if ((DataSize > TotalSize - sizeof (CPU_MICROCODE_HEADER)) || ((DataSize & 0x3) != 0)) {
+    DEBUG ((DEBUG_ERROR, "IndexMicrocodePatch - DataSize is invalid (0x%x)\n", Offset));
+    return;
+  }
+
+  if (CalculateSum32 ((UINT32 *)MicrocodeEntryPoint, DataSize + sizeof (CPU_MICROCODE_HEADER)) != 0) {
+    DEBUG ((DEBUG_ERROR, "IndexMicrocodePatch - fail on CheckSum32 (0x%x)\n", Offset));
+    return;
+  }
+
+  PatchIndex->ChecksumValid = TRUE;
+
+  //
+  // Only record an extended table whose checksum and signature count are correct.
+  //
+  ExtendedTableLength = TotalSize - (DataSize + sizeof (CPU_MICROCODE_HEADER));
+  if ((ExtendedTableLength > sizeof (CPU_MICROCODE_EXTENDED_TABLE_HEADER)) && ((ExtendedTableLength & 0x3) == 0)) {
+    ExtendedTableHeader = (CPU_MICROCODE_EXTENDED_TABLE_HEADER *)((UINT8 *)(MicrocodeEntryPoint) + DataSize + sizeof (CPU_MICROCODE_HEADER));
+    if (CalculateSum32 ((UINT32 *)ExtendedTableHeader, ExtendedTableLength) != 0) {
+      DEBUG ((DEBUG_ERROR, "IndexMicrocodePatch - The checksum for extended table is incorrect (0x%x)\n", Offset));
+    } else if (ExtendedTableHeader->ExtendedSignatureCount > (ExtendedTableLength - sizeof (CPU_MICROCODE_EXTENDED_TABLE_HEADER)) / sizeof (CPU_MICROCODE_EXTENDED_TABLE)) {
+      DEBUG ((DEBUG_ERROR, "IndexMicrocodePatch - ExtendedTableCount %d is too big\n", ExtendedTableHeader->ExtendedSignatureCount));
+    } else {
+      PatchIndex->ExtendedTableOffset    = (UINT32)(DataSize + sizeof (CPU_MICROCODE_HEADER));
+      PatchIndex->ExtendedSignatureCount = ExtendedTableHeader->ExtendedSignatureCount;
+    }
+  }
+}
+
+/**
+  Update the Microcode patch index.
+
+  Only the patches that overlap the Microcode region range written since the
+  last update are parsed and checksummed again. The other patches reuse the
+  existing index entries.
+
+  @param[in]  MicrocodeFmpPrivate        The Microcode driver private data
+
+  @retval EFI_SUCCESS           The Microcode patch index is up to date.
+  @retval EFI_OUT_OF_RESOURCES  No enough resource to update the index.
+**/
+EFI_STATUS
+UpdateMicrocodePatchIndex (
+  IN MICROCODE_FMP_PRIVATE_DATA  *MicrocodeFmpPrivate
+  )
+{
+  CPU_MICROCODE_HEADER   *MicrocodeEntryPoint;
+  MICROCODE_PATCH_INDEX  *OldIndex;
+  UINTN                  OldCount;
+  UINTN                  OldPosition;
+  MICROCODE_PATCH_INDEX  *NewIndex;
+  UINTN                  NewCount;
+  UINTN                  NewCapacity;
+  MICROCODE_PATCH_INDEX  *Buffer;
+  UINTN                  Offset;
+  UINTN                  TotalSize;
+  UINTN                  DirtyStart;
+  UINTN                  DirtyEnd;
+  UINTN                  ParsedCount;
+
+  DirtyStart = MicrocodeFmpPrivate->PatchIndexDirtyStart;
+  DirtyEnd   = MicrocodeFmpPrivate->PatchIndexDirtyEnd;
+  if (DirtyStart >= DirtyEnd) {
+    return EFI_SUCCESS;
+  }
+
+  OldIndex    = MicrocodeFmpPrivate->PatchIndex;
+  OldCount    = MicrocodeFmpPrivate->PatchIndexCount;
+  OldPosition = 0;
+  NewIndex    = NULL;
+  NewCount    = 0;
+  NewCapacity = 0;
+  ParsedCount = 0;
+
+  Offset = 0;
+  while (Offset < MicrocodeFmpPrivate->MicrocodePatchRegionSize) {
+    MicrocodeEntryPoint = (CPU_MICROCODE_HEADER *)((UINTN)MicrocodeFmpPrivate->MicrocodePatchAddress + Offset);
+    if ((MicrocodeEntryPoint->HeaderVersion != 0x1) || (MicrocodeEntryPoint->LoaderRevision != 0x1)) {
+      //
+      // It is the padding data between the microcode patches for microcode patches alignment.
+      // Because the microcode patch is the multiple of 1-KByte, we could skip SIZE_1KB padding
+      // data to find the next possible microcode patch header.
+      //
+      Offset += SIZE_1KB;
+      continue;
+    }
+
+    if (MicrocodeEntryPoint->DataSize == 0) {
+      TotalSize = 2048;
+    } else {
+      TotalSize = MicrocodeEntryPoint->TotalSize;
+    }
+
+    if (NewCount == NewCapacity) {
+      Buffer = ReallocatePool (
+                 NewCapacity * sizeof (MICROCODE_PATCH_INDEX),
+                 MAX (NewCapacity * 2, OldCount + 1) * sizeof (MICROCODE_PATCH_INDEX),
+                 NewIndex
+                 );
+      if (Buffer == NULL) {
+        if (NewIndex != NULL) {
+          FreePool (NewIndex);
+        }
+
+        return EFI_OUT_OF_RESOURCES;
+      }
+
+      NewIndex    = Buffer;
+      NewCapacity = MAX (NewCapacity * 2, OldCount + 1);
+    }
+
+    //
+    // Both lists are sorted by offset. Reuse the old entry if the patch is
+    // at the same place with the same size and was not written.
+    //
+    while ((OldPosition < OldCount) && (OldIndex[OldPosition].Offset < Offset)) {
+      OldPosition++;
+    }
+
+    if ((OldPosition < OldCount) &&
+        (OldIndex[OldPosition].Offset == Offset) &&
+        (OldIndex[OldPosition].TotalSize == TotalSize) &&
+        ((Offset + TotalSize <= DirtyStart) || (Offset >= DirtyEnd)))
+    {
+      CopyMem (&NewIndex[NewCount], &OldIndex[OldPosition], sizeof (MICROCODE_PATCH_INDEX));
+    } else {
+      IndexMicrocodePatch (MicrocodeFmpPrivate, Offset, TotalSize, &NewIndex[NewCount]);
+      ParsedCount++;
+    }
+
+    NewCount++;
+
+    //
+    // Get the next patch.
+    //
+    Offset += TotalSize;
+  }
+
+  DEBUG ((DEBUG_INFO, "UpdateMicrocodePatchIndex - PatchCount 0x%x, ParsedCount 0x%x\n", NewCount, ParsedCount));
+
+  if (OldIndex != NULL) {
+    FreePool (OldIndex);
+  }
+
+  MicrocodeFmpPrivate->PatchIndex           = NewIndex;
+  MicrocodeFmpPrivate->PatchIndexCount      = NewCount;
+  MicrocodeFmpPrivate->PatchIndexDirtyStart = MAX_UINTN;
+  MicrocodeFmpPrivate->PatchIndexDirtyEnd   = 0;
+
+  return EFI_SUCCESS;
+}
+
 /**
   Get current Microcode information.
 
   The ProcessorInformation (BspIndex/ProcessorCount/ProcessorInfo)
-  in MicrocodeFmpPrivate must be initialized.
+  in MicrocodeFmpPrivate must be initialized, and the Microcode patch
+  index must be updated by UpdateMicrocodePatchIndex().
 
   The MicrocodeInformation (DescriptorCount/ImageDescriptor/MicrocodeInfo)
   in MicrocodeFmpPrivate may not be avaiable in this function.
@@ -211,97 +468,60 @@ GetMicrocodeInfo (
   OUT MICROCODE_INFO                 *MicrocodeInfo    OPTIONAL
   )
 {
-  VOID                  *MicrocodePatchAddress;
-  UINTN                 MicrocodePatchRegionSize;
-  CPU_MICROCODE_HEADER  *MicrocodeEntryPoint;
-  UINTN                 MicrocodeEnd;
-  UINTN                 TotalSize;
-  UINTN                 Count;
-  UINT64                ImageAttributes;
-  BOOLEAN               IsInUse;
-  EFI_STATUS            Status;
-  UINT32                AttemptStatus;
-  UINTN                 TargetCpuIndex;
-
-  MicrocodePatchAddress    = MicrocodeFmpPrivate->MicrocodePatchAddress;
-  MicrocodePatchRegionSize = MicrocodeFmpPrivate->MicrocodePatchRegionSize;
-
-  DEBUG ((DEBUG_INFO, "Microcode Region - 0x%x - 0x%x\n", MicrocodePatchAddress, MicrocodePatchRegionSize));
-
-  Count = 0;
-
-  MicrocodeEnd        = (UINTN)MicrocodePatchAddress + MicrocodePatchRegionSize;
-  MicrocodeEntryPoint = (CPU_MICROCODE_HEADER *)(UINTN)MicrocodePatchAddress;
-  do {
-    if ((MicrocodeEntryPoint->HeaderVersion == 0x1) && (MicrocodeEntryPoint->LoaderRevision == 0x1)) {
-      //
-      // It is the microcode header. It is not the padding data between microcode patches
-      // becasue the padding data should not include 0x00000001 and it should be the repeated
-      // byte format (like 0xXYXYXYXY....).
-      //
-      if (MicrocodeEntryPoint->DataSize == 0) {
-        TotalSize = 2048;
-      } else {
-        TotalSize = MicrocodeEntryPoint->TotalSize;
-      }
-
-      TargetCpuIndex = (UINTN)-1;
-      Status         = VerifyMicrocode (MicrocodeFmpPrivate, MicrocodeEntryPoint, TotalSize, FALSE, &AttemptStatus, NULL, &TargetCpuIndex);
-      if (!EFI_ERROR (Status)) {
-        IsInUse = TRUE;
-        ASSERT (TargetCpuIndex < MicrocodeFmpPrivate->ProcessorCount);
-        MicrocodeFmpPrivate->ProcessorInfo[TargetCpuIndex].MicrocodeIndex = Count;
-      } else {
-        IsInUse = FALSE;
-      }
-
-      if ((ImageDescriptor != NULL) && (DescriptorCount > Count)) {
-        ImageDescriptor[Count].ImageIndex = (UINT8)(Count + 1);
-        CopyGuid (&ImageDescriptor[Count].ImageTypeId, &gMicrocodeFmpImageTypeIdGuid);
-        ImageDescriptor[Count].ImageId     = LShiftU64 (MicrocodeEntryPoint->ProcessorFlags, 32) + MicrocodeEntryPoint->ProcessorSignature.Uint32;
-        ImageDescriptor[Count].ImageIdName = NULL;
-        ImageDescriptor[Count].Version     = MicrocodeEntryPoint->UpdateRevision;
-        ImageDescriptor[Count].VersionName = NULL;
-        ImageDescriptor[Count].Size        = TotalSize;
-        ImageAttributes                    = IMAGE_ATTRIBUTE_IMAGE_UPDATABLE | IMAGE_ATTRIBUTE_RESET_REQUIRED;
-        if (IsInUse) {
-          ImageAttributes |= IMAGE_ATTRIBUTE_IN_USE;
-        }
+  MICROCODE_PATCH_INDEX  *PatchIndex;
+  CPU_MICROCODE_HEADER   *MicrocodeEntryPoint;
+  UINTN                  Count;
+  UINT64                 ImageAttributes;
+  BOOLEAN                IsInUse;
+  EFI_STATUS             Status;
+  UINTN                  TargetCpuIndex;
+
+  DEBUG ((DEBUG_INFO, "Microcode Region - 0x%x - 0x%x\n", MicrocodeFmpPrivate->MicrocodePatchAddress, MicrocodeFmpPrivate->MicrocodePatchRegionSize));
+
+  ASSERT (MicrocodeFmpPrivate->PatchIndexCount < 0xFF);
+
+  for (Count = 0; Count < MicrocodeFmpPrivate->PatchIndexCount; Count++) {
+    PatchIndex          = &MicrocodeFmpPrivate->PatchIndex[Count];
+    MicrocodeEntryPoint = (CPU_MICROCODE_HEADER *)((UINTN)MicrocodeFmpPrivate->MicrocodePatchAddress + PatchIndex->Offset);
+
+    TargetCpuIndex = (UINTN)-1;
+    Status         = VerifyIndexedMicrocode (MicrocodeFmpPrivate, PatchIndex, &TargetCpuIndex);
+    if (!EFI_ERROR (Status)) {
+      IsInUse = TRUE;
+      ASSERT (TargetCpuIndex < MicrocodeFmpPrivate->ProcessorCount);
+      MicrocodeFmpPrivate->ProcessorInfo[TargetCpuIndex].MicrocodeIndex = Count;
+    } else {
+      IsInUse = FALSE;
+    }
 
-        ImageDescriptor[Count].AttributesSupported         = ImageAttributes | IMAGE_ATTRIBUTE_IN_USE;
-        ImageDescriptor[Count].AttributesSetting           = ImageAttributes;
-        ImageDescriptor[Count].Compatibilities             = 0;
-        ImageDescriptor[Count].LowestSupportedImageVersion = MicrocodeEntryPoint->UpdateRevision; // do not support rollback
-        ImageDescriptor[Count].LastAttemptVersion          = 0;
-        ImageDescriptor[Count].LastAttemptStatus           = 0;
-        ImageDescriptor[Count].HardwareInstance            = 0;
+    if ((ImageDescriptor != NULL) && (DescriptorCount > Count)) {
+      ImageDescriptor[Count].ImageIndex = (UINT8)(Count + 1);
+      CopyGuid (&ImageDescriptor[Count].ImageTypeId, &gMicrocodeFmpImageTypeIdGuid);
+      ImageDescriptor[Count].ImageId     = LShiftU64 (PatchIndex->ProcessorFlags, 32) + PatchIndex->ProcessorSignature;
+      ImageDescriptor[Count].ImageIdName = NULL;
+      ImageDescriptor[Count].Version     = PatchIndex->UpdateRevision;
+      ImageDescriptor[Count].VersionName = NULL;
+      ImageDescriptor[Count].Size        = PatchIndex->TotalSize;
+      ImageAttributes                    = IMAGE_ATTRIBUTE_IMAGE_UPDATABLE | IMAGE_ATTRIBUTE_RESET_REQUIRED;
+      if (IsInUse) {
+        ImageAttributes |= IMAGE_ATTRIBUTE_IN_USE;
       }
 
-      if ((MicrocodeInfo != NULL) && (DescriptorCount > Count)) {
-        MicrocodeInfo[Count].MicrocodeEntryPoint = MicrocodeEntryPoint;
-        MicrocodeInfo[Count].TotalSize           = TotalSize;
-        MicrocodeInfo[Count].InUse               = IsInUse;
-      }
-    } else {
-      //
-      // It is the padding data between the microcode patches for microcode patches alignment.
-      // Because the microcode patch is the multiple of 1-KByte, the padding data should not
-      // exist if the microcode patch alignment value is not larger than 1-KByte. So, the microcode
-      // alignment value should be larger than 1-KByte. We could skip SIZE_1KB padding data to
-      // find the next possible microcode patch header.
-      //
-      MicrocodeEntryPoint = (CPU_MICROCODE_HEADER *)(((UINTN)MicrocodeEntryPoint) + SIZE_1KB);
-      continue;
+      ImageDescriptor[Count].AttributesSupported         = ImageAttributes | IMAGE_ATTRIBUTE_IN_USE;
+      ImageDescriptor[Count].AttributesSetting           = ImageAttributes;
+      ImageDescriptor[Count].Compatibilities             = 0;
+      ImageDescriptor[Count].LowestSupportedImageVersion = PatchIndex->UpdateRevision; // do not support rollback
+      ImageDescriptor[Count].LastAttemptVersion          = 0;
+      ImageDescriptor[Count].LastAttemptStatus           = 0;
+      ImageDescriptor[Count].HardwareInstance            = 0;
     }
 
-    Count++;
-    ASSERT (Count < 0xFF);
-
-    //
-    // Get the next patch.
-    //
-    MicrocodeEntryPoint = (CPU_MICROCODE_HEADER *)(((UINTN)MicrocodeEntryPoint) + TotalSize);
-  } while (((UINTN)MicrocodeEntryPoint < MicrocodeEnd));
+    if ((MicrocodeInfo != NULL) && (DescriptorCount > Count)) {
+      MicrocodeInfo[Count].MicrocodeEntryPoint = MicrocodeEntryPoint;
+      MicrocodeInfo[Count].TotalSize           = PatchIndex->TotalSize;
+      MicrocodeInfo[Count].InUse               = IsInUse;
+    }
+  }
 
   return Count;
 }
@@ -350,6 +570,252 @@ GetMatchedProcessor (
   return NULL;
 }
 
+/**
+  Verify a Microcode patch of the Microcode region with its index entry.
+
+  The checksums were verified when the index entry was built, so only the
+  ProcessorSignature/ProcessorFlags and UpdateRevision are checked here.
+
+  @param[in]  MicrocodeFmpPrivate        The Microcode driver private data
+  @param[in]  PatchIndex                 The index entry of the Microcode patch.
+  @param[in, out] TargetCpuIndex         On input, the index of target CPU which tries to match the Microcode. (UINTN)-1 means to try all.
+                                         On output, the index of target CPU which matches the Microcode.
+
+  @retval EFI_SUCCESS               The Microcode patch can be used.
+  @retval EFI_VOLUME_CORRUPTED      The Microcode patch is corrupted.
+  @retval EFI_INCOMPATIBLE_VERSION  The Microcode patch version is incorrect.
+  @retval EFI_UNSUPPORTED           The Microcode ProcessorSignature or ProcessorFlags is incorrect.
+**/
+EFI_STATUS
+VerifyIndexedMicrocode (
+  IN     MICROCODE_FMP_PRIVATE_DATA  *MicrocodeFmpPrivate,
+  IN     MICROCODE_PATCH_INDEX       *PatchIndex,
+  IN OUT UINTN                       *TargetCpuIndex
+  )
+{
+  CPU_MICROCODE_HEADER          *MicrocodeEntryPoint;
+  CPU_MICROCODE_EXTENDED_TABLE  *ExtendedTable;
+  PROCESSOR_INFO                *ProcessorInfo;
+  UINT32                        InCompleteCheckSum32;
+  UINT32                        CheckSum32;
+  UINTN                         Index;
+
+  if (!PatchIndex->ChecksumValid) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  ProcessorInfo = GetMatchedProcessor (MicrocodeFmpPrivate, PatchIndex->ProcessorSignature, PatchIndex->ProcessorFlags, TargetCpuIndex);
+  if ((ProcessorInfo == NULL) && (PatchIndex->ExtendedSignatureCount != 0)) {
+    //
+    // The CheckSum32 of the patch is 0, so an extended signature is valid if the sum
+    // is still 0 after it replaces the ProcessorSignature/ProcessorFlags/Checksum.
+    //
+    MicrocodeEntryPoint   = (CPU_MICROCODE_HEADER *)((UINTN)MicrocodeFmpPrivate->MicrocodePatchAddress + PatchIndex->Offset);
+    InCompleteCheckSum32  = 0;
+    InCompleteCheckSum32 -= PatchIndex->ProcessorSignature;
+    InCompleteCheckSum32 -= PatchIndex->ProcessorFlags;
+    InCompleteCheckSum32 -= MicrocodeEntryPoint->Checksum;
+
+    ExtendedTable = (CPU_MICROCODE_EXTENDED_TABLE *)((UINT8 *)MicrocodeEntryPoint + PatchIndex->ExtendedTableOffset + sizeof (CPU_MICROCODE_EXTENDED_TABLE_HEADER));
+    for (Index = 0; Index < PatchIndex->ExtendedSignatureCount; Index++) {
+      CheckSum32  = InCompleteCheckSum32;
+      CheckSum32 += ExtendedTable->ProcessorSignature.Uint32;
+      CheckSum32 += ExtendedTable->ProcessorFlag;
+      CheckSum32 += ExtendedTable->Checksum;
+      if (CheckSum32 == 0) {
+        ProcessorInfo = GetMatchedProcessor (MicrocodeFmpPrivate, ExtendedTable->ProcessorSignature.Uint32, ExtendedTable->ProcessorFlag, TargetCpuIndex);
+        if (ProcessorInfo != NULL) {
+          break;
+        }
+      }
+
+      ExtendedTable++;
+    }
+  }
+
+  if (ProcessorInfo == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (PatchIndex->UpdateRevision < ProcessorInfo->MicrocodeRevision) {
+    return EFI_INCOMPATIBLE_VERSION;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Load new Microcode on all processors which match it.
+
+  The Microcode is loaded by the BSP and then by all Application Processors at
+  the same time with one StartupAllAPs() call. After that, the revision of all
+  processors is collected with another StartupAllAPs() call, and recorded in
+  LoadReport and ProcessorInfo of MicrocodeFmpPrivate.
+
+  Caution: The Microcode must pass the checks of VerifyMicrocode() before it is loaded.
+
+  @param[in]  MicrocodeFmpPrivate        The Microcode driver private data
+  @param[in]  MicrocodeEntryPoint        The Microcode image buffer.
+  @param[in]  DataSize                   The DataSize of the Microcode in bytes.
+
+  @retval EFI_SUCCESS               All matched processors run the new Microcode.
+  @retval EFI_SECURITY_VIOLATION    The Microcode fails to load on some matched processors.
+**/
+EFI_STATUS
+LoadMicrocodeOnAllProcessors (
+  IN  MICROCODE_FMP_PRIVATE_DATA  *MicrocodeFmpPrivate,
+  IN  CPU_MICROCODE_HEADER        *MicrocodeEntryPoint,
+  IN  UINTN                       DataSize
+  )
+{
+  EFI_STATUS                           Status;
+  MICROCODE_LOAD_ALL_BUFFER            LoadAllBuffer;
+  MICROCODE_LOAD_REPORT                *LoadReport;
+  PROCESSOR_INFO                       *ProcessorInfo;
+  UINTN                                CpuIndex;
+  UINTN                                TargetCpuIndex;
+  UINTN                                Index;
+  UINTN                                TotalSize;
+  UINTN                                ExtendedTableLength;
+  UINT32                               ExtendedTableCount;
+  CPU_MICROCODE_EXTENDED_TABLE         *ExtendedTable;
+  CPU_MICROCODE_EXTENDED_TABLE_HEADER  *ExtendedTableHeader;
+  UINT32                               InCompleteCheckSum32;
+  UINT32                               CheckSum32;
+  UINTN                                LoadedCount;
+
+  //
+  // Get the valid extended table, if any.
+  //
+  if (MicrocodeEntryPoint->DataSize == 0) {
+    TotalSize = 2048;
+  } else {
+    TotalSize = MicrocodeEntryPoint->TotalSize;
+  }
+
+  ExtendedTableCount  = 0;
+  ExtendedTable       = NULL;
+  ExtendedTableLength = TotalSize - (DataSize + sizeof (CPU_MICROCODE_HEADER));
+  if ((ExtendedTableLength > sizeof (CPU_MICROCODE_EXTENDED_TABLE_HEADER)) && ((ExtendedTableLength & 0x3) == 0)) {
+    ExtendedTableHeader = (CPU_MICROCODE_EXTENDED_TABLE_HEADER *)((UINT8 *)(MicrocodeEntryPoint) + DataSize + sizeof (CPU_MICROCODE_HEADER));
+    if ((CalculateSum32 ((UINT32 *)ExtendedTableHeader, ExtendedTableLength) == 0) &&
+        (ExtendedTableHeader->ExtendedSignatureCount <= (ExtendedTableLength - sizeof (CPU_MICROCODE_EXTENDED_TABLE_HEADER)) / sizeof (CPU_MICROCODE_EXTENDED_TABLE)))
+    {
+      ExtendedTableCount = ExtendedTableHeader->ExtendedSignatureCount;
+      ExtendedTable      = (CPU_MICROCODE_EXTENDED_TABLE *)(ExtendedTableHeader + 1);
+    }
+  }
+
+  InCompleteCheckSum32  = 0;
+  InCompleteCheckSum32 -= MicrocodeEntryPoint->ProcessorSignature.Uint32;
+  InCompleteCheckSum32 -= MicrocodeEntryPoint->ProcessorFlags;
+  InCompleteCheckSum32 -= MicrocodeEntryPoint->Checksum;
+
+  //
+  // Find the enabled processors which match the Microcode header or one extended signature.
+  //
+  LoadReport = MicrocodeFmpPrivate->LoadReport;
+  ZeroMem (LoadReport, sizeof (MICROCODE_LOAD_REPORT) * MicrocodeFmpPrivate->ProcessorCount);
+  for (CpuIndex = 0; CpuIndex < MicrocodeFmpPrivate->ProcessorCount; CpuIndex++) {
+    if (!MicrocodeFmpPrivate->ProcessorInfo[CpuIndex].Enabled) {
+      continue;
+    }
+
+    TargetCpuIndex = CpuIndex;
+    ProcessorInfo  = GetMatchedProcessor (MicrocodeFmpPrivate, MicrocodeEntryPoint->ProcessorSignature.Uint32, MicrocodeEntryPoint->ProcessorFlags, &TargetCpuIndex);
+    for (Index = 0; (ProcessorInfo == NULL) && (Index < ExtendedTableCount); Index++) {
+      CheckSum32  = InCompleteCheckSum32;
+      CheckSum32 += ExtendedTable[Index].ProcessorSignature.Uint32;
+      CheckSum32 += ExtendedTable[Index].ProcessorFlag;
+      CheckSum32 += ExtendedTable[Index].Checksum;
+      if (CheckSum32 == 0) {
+        ProcessorInfo = GetMatchedProcessor (MicrocodeFmpPrivate, ExtendedTable[Index].ProcessorSignature.Uint32, ExtendedTable[Index].ProcessorFlag, &TargetCpuIndex);
+      }
+    }
+
+    LoadReport[CpuIndex].Matched = (BOOLEAN)(ProcessorInfo != NULL);
+  }
+
+  LoadAllBuffer.MpService     = MicrocodeFmpPrivate->MpService;
+  LoadAllBuffer.Address       = (UINTN)MicrocodeEntryPoint + sizeof (CPU_MICROCODE_HEADER);
+  LoadAllBuffer.ProcessorInfo = MicrocodeFmpPrivate->ProcessorInfo;
+  LoadAllBuffer.LoadReport    = LoadReport;
+
+  //
+  // Load on the BSP, then on all APs in parallel.
+  //
+  CpuIndex = MicrocodeFmpPrivate->BspIndex;
+  if (LoadReport[CpuIndex].Matched && MicrocodeFmpPrivate->ProcessorInfo[CpuIndex].CoreLoader) {
+    LoadMicrocode (LoadAllBuffer.Address);
+    LoadReport[CpuIndex].Loaded = TRUE;
+  }
+
+  if (MicrocodeFmpPrivate->ProcessorCount > 1) {
+    Status = LoadAllBuffer.MpService->StartupAllAPs (
+                                        LoadAllBuffer.MpService,
+                                        MicrocodeLoadAllAp,
+                                        FALSE,
+                                        NULL,
+                                        0,
+                                        &LoadAllBuffer,
+                                        NULL
+                                        );
+    ASSERT ((Status == EFI_SUCCESS) || (Status == EFI_NOT_STARTED));
+  }
+
+  //
+  // Collect the revision of all processors, including the threads that share a core with a loader.
+  //
+  LoadReport[CpuIndex].Revision = GetCurrentMicrocodeSignature ();
+  if (MicrocodeFmpPrivate->ProcessorCount > 1) {
+    Status = LoadAllBuffer.MpService->StartupAllAPs (
+                                        LoadAllBuffer.MpService,
+                                        MicrocodeRevisionAp,
+                                        FALSE,
+                                        NULL,
+                                        0,
+                                        &LoadAllBuffer,
+                                        NULL
+                                        );
+    ASSERT ((Status == EFI_SUCCESS) || (Status == EFI_NOT_STARTED));
+  }
+
+  Status      = EFI_SUCCESS;
+  LoadedCount = 0;
+  DEBUG ((DEBUG_INFO, "LoadMicrocodeOnAllProcessors - Revision 0x%08x\n", MicrocodeEntryPoint->UpdateRevision));
+  for (CpuIndex = 0; CpuIndex < MicrocodeFmpPrivate->ProcessorCount; CpuIndex++) {
+    if (!LoadReport[CpuIndex].Matched) {
+      continue;
+    }
+
+    ProcessorInfo = &MicrocodeFmpPrivate->ProcessorInfo[CpuIndex];
+    DEBUG ((
+      DEBUG_INFO,
+      "  LoadReport[0x%x] - Package 0x%x, Core 0x%x, Thread 0x%x, Loaded 0x%x, Revision 0x%08x -> 0x%08x\n",
+      CpuIndex,
+      ProcessorInfo->Location.Package,
+      ProcessorInfo->Location.Core,
+      ProcessorInfo->Location.Thread,
+      LoadReport[CpuIndex].Loaded,
+      ProcessorInfo->MicrocodeRevision,
+      LoadReport[CpuIndex].Revision
+      ));
+
+    if (LoadReport[CpuIndex].Loaded) {
+      LoadedCount++;
+    }
+
+    ProcessorInfo->MicrocodeRevision = LoadReport[CpuIndex].Revision;
+    if (LoadReport[CpuIndex].Revision < MicrocodeEntryPoint->UpdateRevision) {
+      DEBUG ((DEBUG_ERROR, "LoadMicrocodeOnAllProcessors - fail on processor 0x%x\n", CpuIndex));
+      Status = EFI_SECURITY_VIOLATION;
+    }
+  }
+
+  DEBUG ((DEBUG_INFO, "LoadMicrocodeOnAllProcessors - LoadedCount 0x%x - %r\n", LoadedCount, Status));
+  return Status;
+}
+
 /**
   Verify Microcode.
 
@@ -608,7 +1074,17 @@ VerifyMicrocode (
   //
   // try load MCU
   //
-  if (TryLoad) {
+  if (TryLoad && FeaturePcdGet (PcdMicrocodeParallelLoad)) {
+    if (EFI_ERROR (LoadMicrocodeOnAllProcessors (MicrocodeFmpPrivate, MicrocodeEntryPoint, DataSize))) {
+      DEBUG ((DEBUG_ERROR, "VerifyMicrocode - fail on LoadMicrocodeOnAllProcessors\n"));
+      *LastAttemptStatus = LAST_ATTEMPT_STATUS_ERROR_AUTH_ERROR;
+      if (AbortReason != NULL) {
+        *AbortReason = AllocateCopyPool (sizeof (L"InvalidData"), L"InvalidData");
+      }
+
+      return EFI_SECURITY_VIOLATION;
+    }
+  } else if (TryLoad) {
     CurrentRevision = LoadMicrocodeOnThis (MicrocodeFmpPrivate, ProcessorInfo->CpuIndex, (UINTN)MicrocodeEntryPoint + sizeof (CPU_MICROCODE_HEADER));
     if (MicrocodeEntryPoint->UpdateRevision != CurrentRevision) {
       DEBUG ((DEBUG_ERROR, "VerifyMicrocode - fail on LoadMicrocode\n"));
@@ -797,36 +1273,136 @@ GetCurrentMicrocodeUsedRegionSize (
          - (UINTN)MicrocodeFmpPrivate->MicrocodePatchAddress;
 }
 
+/**
+  Write a range of the Microcode region which differs from the new content.
+
+  @param[in]   MicrocodeFmpPrivate The Microcode driver private data
+  @param[in]   Address             The flash address of the range.
+  @param[in]   Buffer              The new content of the range.
+  @param[in]   Length              The size of the range in bytes.
+
+  @retval EFI_SUCCESS           The range is written.
+  @retval EFI_WRITE_PROTECTED   The flash device is read only.
+**/
+STATIC
+EFI_STATUS
+WriteMicrocodeFlashRange (
+  IN MICROCODE_FMP_PRIVATE_DATA  *MicrocodeFmpPrivate,
+  IN UINT64                      Address,
+  IN VOID                        *Buffer,
+  IN UINTN                       Length
+  )
+{
+  UINTN   Offset;
+  UINT64  EraseStart;
+  UINT64  EraseEnd;
+
+  DEBUG ((DEBUG_INFO, "  Write - 0x%lx, 0x%x\n", Address, Length));
+
+  //
+  // Mark the range dirty even if the write fails, because the flash may be
+  // partially written.
+  //
+  Offset = (UINTN)Address - (UINTN)MicrocodeFmpPrivate->MicrocodePatchAddress;
+  MicrocodeFmpPrivate->PatchIndexDirtyStart = MIN (MicrocodeFmpPrivate->PatchIndexDirtyStart, Offset);
+  MicrocodeFmpPrivate->PatchIndexDirtyEnd   = MAX (MicrocodeFmpPrivate->PatchIndexDirtyEnd, Offset + Length);
+
+  EraseStart = Address & ~(UINT64)(MICROCODE_FLASH_ERASE_BLOCK_SIZE - 1);
+  EraseEnd   = ALIGN_VALUE (Address + Length, (UINT64)MICROCODE_FLASH_ERASE_BLOCK_SIZE);
+  MicrocodeFmpPrivate->FlashWriteStatistics.BytesWritten += Length;
+  MicrocodeFmpPrivate->FlashWriteStatistics.BytesErased  += (UINTN)(EraseEnd - EraseStart);
+
+  return MicrocodeFlashWrite (Address, Buffer, Length);
+}
+
 /**
   Update Microcode.
 
-  @param[in]   Address            The flash address of Microcode.
-  @param[in]   Image              The Microcode image buffer.
-  @param[in]   ImageSize          The size of Microcode image buffer in bytes.
-  @param[out]  LastAttemptStatus  The last attempt status, which will be recorded in ESRT and FMP EFI_FIRMWARE_IMAGE_DESCRIPTOR.
+  The new content is compared with the flash content block by block. The
+  blocks which are identical are skipped, and the blocks which differ are
+  written in runs with one MicrocodeFlashWrite() call each. A run goes on
+  over identical blocks up to the next changed block in the same erase block,
+  so that no erase block is erased more than once. The written ranges are
+  recorded so that the next UpdateMicrocodePatchIndex() only parses the
+  Microcode patches inside them again.
+
+  @param[in]   MicrocodeFmpPrivate The Microcode driver private data
+  @param[in]   Address             The flash address of Microcode.
+  @param[in]   Image               The Microcode image buffer.
+  @param[in]   ImageSize           The size of Microcode image buffer in bytes.
+  @param[out]  LastAttemptStatus   The last attempt status, which will be recorded in ESRT and FMP EFI_FIRMWARE_IMAGE_DESCRIPTOR.
 
   @retval EFI_SUCCESS           The Microcode image is updated.
   @retval EFI_WRITE_PROTECTED   The flash device is read only.
 **/
 EFI_STATUS
 UpdateMicrocode (
-  IN UINT64   Address,
-  IN VOID     *Image,
-  IN UINTN    ImageSize,
-  OUT UINT32  *LastAttemptStatus
+  IN  MICROCODE_FMP_PRIVATE_DATA  *MicrocodeFmpPrivate,
+  IN  UINT64                      Address,
+  IN  VOID                        *Image,
+  IN  UINTN                       ImageSize,
+  OUT UINT32                      *LastAttemptStatus
   )
 {
   EFI_STATUS  Status;
+  UINT8       *Flash;
+  UINT8       *Buffer;
+  UINTN       Offset;
+  UINTN       BlockSize;
+  BOOLEAN     Identical;
+  UINTN       RunOffset;
+  UINTN       RunSize;
+  UINTN       RunEnd;
 
   DEBUG ((DEBUG_INFO, "PlatformUpdate:"));
   DEBUG ((DEBUG_INFO, "  Address - 0x%lx,", Address));
   DEBUG ((DEBUG_INFO, "  Length - 0x%x\n", ImageSize));
 
-  Status = MicrocodeFlashWrite (
-             Address,
-             Image,
-             ImageSize
-             );
+  Flash     = (UINT8 *)(UINTN)Address;
+  Buffer    = Image;
+  Status    = EFI_SUCCESS;
+  RunOffset = 0;
+  RunSize   = 0;
+
+  for (Offset = 0; Offset < ImageSize; Offset += BlockSize) {
+    BlockSize = MICROCODE_FLASH_BLOCK_SIZE - (UINTN)((Address + Offset) & (MICROCODE_FLASH_BLOCK_SIZE - 1));
+    BlockSize = MIN (BlockSize, ImageSize - Offset);
+
+    Identical = (BOOLEAN)(CompareMem (Flash + Offset, Buffer + Offset, BlockSize) == 0);
+    if (Identical) {
+      MicrocodeFmpPrivate->FlashWriteStatistics.BytesSkipped += BlockSize;
+      continue;
+    }
+
+    if (RunSize != 0) {
+      RunEnd = RunOffset + RunSize;
+      if ((RunEnd == Offset) ||
+          (((Address + RunEnd - 1) & ~(UINT64)(MICROCODE_FLASH_ERASE_BLOCK_SIZE - 1)) ==
+           ((Address + Offset) & ~(UINT64)(MICROCODE_FLASH_ERASE_BLOCK_SIZE - 1))))
+      {
+        //
+        // The identical blocks between the run and this block are written again
+        // rather than erasing their erase block a second time.
+        //
+        MicrocodeFmpPrivate->FlashWriteStatistics.BytesSkipped -= Offset - RunEnd;
+        RunSize = Offset + BlockSize - RunOffset;
+        continue;
+      }
+
+      Status = WriteMicrocodeFlashRange (MicrocodeFmpPrivate, Address + RunOffset, Buffer + RunOffset, RunSize);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+    }
+
+    RunOffset = Offset;
+    RunSize   = BlockSize;
+  }
+
+  if (!EFI_ERROR (Status) && (RunSize != 0)) {
+    Status = WriteMicrocodeFlashRange (MicrocodeFmpPrivate, Address + RunOffset, Buffer + RunOffset, RunSize);
+  }
+
   if (!EFI_ERROR (Status)) {
     *LastAttemptStatus = LAST_ATTEMPT_STATUS_SUCCESS;
   } else {
@@ -960,7 +1536,7 @@ UpdateMicrocodeFlashRegionWithFit (
       ScratchBufferPtr   = (UINT8 *)MicrocodePatchScratchBuffer + ScratchBufferSize;
     }
 
-    Status = UpdateMicrocode ((UINTN)TargetMicrocodeEntryPoint, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
+    Status = UpdateMicrocode (MicrocodeFmpPrivate, (UINTN)TargetMicrocodeEntryPoint, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
     return Status;
   }
 
@@ -982,7 +1558,7 @@ UpdateMicrocodeFlashRegionWithFit (
       ScratchBufferPtr   = (UINT8 *)MicrocodePatchScratchBuffer + ScratchBufferSize;
     }
 
-    Status = UpdateMicrocode ((UINTN)EmptyFitMicrocodeEntry, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
+    Status = UpdateMicrocode (MicrocodeFmpPrivate, (UINTN)EmptyFitMicrocodeEntry, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
     if (!EFI_ERROR (Status) && (TargetMicrocodeEntryPoint != NULL)) {
       //
       // Empty old microcode.
@@ -991,7 +1567,7 @@ UpdateMicrocodeFlashRegionWithFit (
       SetMem (ScratchBufferPtr, TargetTotalSize, 0xFF);
       ScratchBufferSize = TargetTotalSize;
       ScratchBufferPtr  = (UINT8 *)MicrocodePatchScratchBuffer + ScratchBufferSize;
-      UpdateMicrocode ((UINTN)TargetMicrocodeEntryPoint, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
+      UpdateMicrocode (MicrocodeFmpPrivate, (UINTN)TargetMicrocodeEntryPoint, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
     }
 
     return Status;
@@ -1015,7 +1591,7 @@ UpdateMicrocodeFlashRegionWithFit (
       ScratchBufferPtr   = (UINT8 *)MicrocodePatchScratchBuffer + ScratchBufferSize;
     }
 
-    Status = UpdateMicrocode ((UINTN)UnusedFitMicrocodeEntry, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
+    Status = UpdateMicrocode (MicrocodeFmpPrivate, (UINTN)UnusedFitMicrocodeEntry, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
     if (!EFI_ERROR (Status) && (TargetMicrocodeEntryPoint != NULL)) {
       //
       // Empty old microcode.
@@ -1024,7 +1600,7 @@ UpdateMicrocodeFlashRegionWithFit (
       SetMem (ScratchBufferPtr, TargetTotalSize, 0xFF);
       ScratchBufferSize = TargetTotalSize;
       ScratchBufferPtr  = (UINT8 *)MicrocodePatchScratchBuffer + ScratchBufferSize;
-      UpdateMicrocode ((UINTN)TargetMicrocodeEntryPoint, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
+      UpdateMicrocode (MicrocodeFmpPrivate, (UINTN)TargetMicrocodeEntryPoint, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
     }
 
     return Status;
@@ -1176,7 +1752,7 @@ UpdateMicrocodeFlashRegion (
       ScratchBufferPtr   = (UINT8 *)MicrocodePatchScratchBuffer + ScratchBufferSize;
     }
 
-    Status = UpdateMicrocode ((UINTN)TargetMicrocodeEntryPoint, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
+    Status = UpdateMicrocode (MicrocodeFmpPrivate, (UINTN)TargetMicrocodeEntryPoint, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
     return Status;
   }
 
@@ -1195,7 +1771,7 @@ UpdateMicrocodeFlashRegion (
       // |Other1|   Other    |Other2| New Image | Empty |
       // +------+------------+------+-----------+=======+
       //
-      Status = UpdateMicrocode ((UINTN)MicrocodePatchAddress + UsedRegionSize, Image, ImageSize, LastAttemptStatus);
+      Status = UpdateMicrocode (MicrocodeFmpPrivate, (UINTN)MicrocodePatchAddress + UsedRegionSize, Image, ImageSize, LastAttemptStatus);
     } else {
       DEBUG ((DEBUG_INFO, "Reorg and replace old microcode\n"));
       //
@@ -1219,7 +1795,7 @@ UpdateMicrocodeFlashRegion (
         ScratchBufferPtr   = (UINT8 *)MicrocodePatchScratchBuffer + ScratchBufferSize;
       }
 
-      Status = UpdateMicrocode ((UINTN)TargetMicrocodeEntryPoint, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
+      Status = UpdateMicrocode (MicrocodeFmpPrivate, (UINTN)TargetMicrocodeEntryPoint, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
     }
 
     return Status;
@@ -1273,7 +1849,7 @@ UpdateMicrocodeFlashRegion (
       ScratchBufferPtr   = (UINT8 *)MicrocodePatchScratchBuffer + ScratchBufferSize;
     }
 
-    Status = UpdateMicrocode ((UINTN)MicrocodePatchAddress, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
+    Status = UpdateMicrocode (MicrocodeFmpPrivate, (UINTN)MicrocodePatchAddress, MicrocodePatchScratchBuffer, ScratchBufferSize, LastAttemptStatus);
     return Status;
   }
 
@@ -1334,6 +1910,8 @@ MicrocodeWrite (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  ZeroMem (&MicrocodeFmpPrivate->FlashWriteStatistics, sizeof (MicrocodeFmpPrivate->FlashWriteStatistics));
+
   TargetCpuIndex = (UINTN)-1;
   Status         = VerifyMicrocode (MicrocodeFmpPrivate, AlignedImage, ImageSize, TRUE, LastAttemptStatus, AbortReason, &TargetCpuIndex);
   if (EFI_ERROR (Status)) {
@@ -1376,6 +1954,14 @@ MicrocodeWrite (
                );
   }
 
+  DEBUG ((
+    DEBUG_INFO,
+    "MicrocodeWrite - Skipped 0x%x, Written 0x%x, Erased 0x%x\n",
+    MicrocodeFmpPrivate->FlashWriteStatistics.BytesSkipped,
+    MicrocodeFmpPrivate->FlashWriteStatistics.BytesWritten,
+    MicrocodeFmpPrivate->FlashWriteStatistics.BytesErased
+    ));
+
   FreePool (AlignedImage);
 
   return Status;
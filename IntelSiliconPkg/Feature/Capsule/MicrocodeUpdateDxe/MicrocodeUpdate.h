@@ -38,6 +38,17 @@
 
 #define MICROCODE_FMP_PRIVATE_DATA_SIGNATURE  SIGNATURE_32('M', 'C', 'U', 'F')
 
+//
+// The granularity used to compare the new Microcode region content with the flash.
+//
+#define MICROCODE_FLASH_BLOCK_SIZE  SIZE_4KB
+
+//
+// The erase block size of the flash device holding the Microcode region.
+// MicrocodeFlashWrite() erases the erase blocks covering the range it writes.
+//
+#define MICROCODE_FLASH_ERASE_BLOCK_SIZE  SIZE_64KB
+
 //
 // Microcode FMP private data structure.
 //
@@ -61,11 +72,14 @@ typedef struct {
 } FIT_MICROCODE_INFO;
 
 typedef struct {
-  UINTN     CpuIndex;
-  UINT32    ProcessorSignature;
-  UINT8     PlatformId;
-  UINT32    MicrocodeRevision;
-  UINTN     MicrocodeIndex;
+  UINTN                        CpuIndex;
+  UINT32                       ProcessorSignature;
+  UINT8                        PlatformId;
+  UINT32                       MicrocodeRevision;
+  UINTN                        MicrocodeIndex;
+  EFI_CPU_PHYSICAL_LOCATION    Location;
+  BOOLEAN                      Enabled;
+  BOOLEAN                      CoreLoader;           // The thread loads Microcode for its core
 } PROCESSOR_INFO;
 
 typedef struct {
@@ -73,6 +87,47 @@ typedef struct {
   UINT32    Revision;
 } MICROCODE_LOAD_BUFFER;
 
+//
+// Per processor result of loading Microcode on all processors.
+//
+typedef struct {
+  BOOLEAN    Matched;                                // The Microcode matches the processor
+  BOOLEAN    Loaded;                                 // The processor triggered the Microcode update
+  UINT32     Revision;                               // The Microcode revision after the update
+} MICROCODE_LOAD_REPORT;
+
+typedef struct {
+  EFI_MP_SERVICES_PROTOCOL    *MpService;
+  UINT64                      Address;
+  PROCESSOR_INFO              *ProcessorInfo;
+  MICROCODE_LOAD_REPORT       *LoadReport;
+} MICROCODE_LOAD_ALL_BUFFER;
+
+//
+// Cached parse result of one Microcode patch in the Microcode region.
+// The header fields are copied out of flash and the checksums are verified
+// once, so that descriptor refreshes do not need to rescan the region.
+//
+typedef struct {
+  UINTN      Offset;                  // Offset of the patch from MicrocodePatchAddress
+  UINTN      TotalSize;
+  UINT32     ProcessorSignature;
+  UINT32     ProcessorFlags;
+  UINT32     UpdateRevision;
+  UINT32     ExtendedTableOffset;     // Offset of the extended table from the patch, 0 if none or corrupt
+  UINT32     ExtendedSignatureCount;
+  BOOLEAN    ChecksumValid;           // Format and CheckSum32 of the patch are correct
+} MICROCODE_PATCH_INDEX;
+
+//
+// Flash write statistics of the last MicrocodeWrite().
+//
+typedef struct {
+  UINTN    BytesSkipped;              // Identical to the flash content, not written
+  UINTN    BytesWritten;              // Passed to MicrocodeFlashWrite()
+  UINTN    BytesErased;               // Size of the erase blocks covering the written ranges
+} MICROCODE_FLASH_WRITE_STATISTICS;
+
 struct _MICROCODE_FMP_PRIVATE_DATA {
   UINT32                                 Signature;
   EFI_FIRMWARE_MANAGEMENT_PROTOCOL       Fmp;
@@ -89,8 +144,14 @@ struct _MICROCODE_FMP_PRIVATE_DATA {
   UINTN                                  BspIndex;
   UINTN                                  ProcessorCount;
   PROCESSOR_INFO                         *ProcessorInfo;
+  MICROCODE_LOAD_REPORT                  *LoadReport;
   UINT32                                 FitMicrocodeEntryCount;
   FIT_MICROCODE_INFO                     *FitMicrocodeInfo;
+  UINTN                                  PatchIndexCount;
+  MICROCODE_PATCH_INDEX                  *PatchIndex;
+  UINTN                                  PatchIndexDirtyStart;
+  UINTN                                  PatchIndexDirtyEnd;
+  MICROCODE_FLASH_WRITE_STATISTICS       FlashWriteStatistics;
 };
 
 typedef struct _MICROCODE_FMP_PRIVATE_DATA MICROCODE_FMP_PRIVATE_DATA;
@@ -142,11 +203,52 @@ CollectProcessorInfo (
   IN OUT VOID  *Buffer
   );
 
+/**
+  Update the Microcode patch index.
+
+  Only the patches that overlap the Microcode region range written since the
+  last update are parsed and checksummed again. The other patches reuse the
+  existing index entries.
+
+  @param[in]  MicrocodeFmpPrivate        The Microcode driver private data
+
+  @retval EFI_SUCCESS           The Microcode patch index is up to date.
+  @retval EFI_OUT_OF_RESOURCES  No enough resource to update the index.
+**/
+EFI_STATUS
+UpdateMicrocodePatchIndex (
+  IN MICROCODE_FMP_PRIVATE_DATA  *MicrocodeFmpPrivate
+  );
+
+/**
+  Verify a Microcode patch of the Microcode region with its index entry.
+
+  The checksums were verified when the index entry was built, so only the
+  ProcessorSignature/ProcessorFlags and UpdateRevision are checked here.
+
+  @param[in]  MicrocodeFmpPrivate        The Microcode driver private data
+  @param[in]  PatchIndex                 The index entry of the Microcode patch.
+  @param[in, out] TargetCpuIndex         On input, the index of target CPU which tries to match the Microcode. (UINTN)-1 means to try all.
+                                         On output, the index of target CPU which matches the Microcode.
+
+  @retval EFI_SUCCESS               The Microcode patch can be used.
+  @retval EFI_VOLUME_CORRUPTED      The Microcode patch is corrupt.
+  @retval EFI_INCOMPATIBLE_VERSION  The Microcode patch version is incorrect.
+  @retval EFI_UNSUPPORTED           The Microcode ProcessorSignature or ProcessorFlags is incorrect.
+**/
+EFI_STATUS
+VerifyIndexedMicrocode (
+  IN     MICROCODE_FMP_PRIVATE_DATA  *MicrocodeFmpPrivate,
+  IN     MICROCODE_PATCH_INDEX       *PatchIndex,
+  IN OUT UINTN                       *TargetCpuIndex
+  );
+
 /**
   Get current Microcode information.
 
   The ProcessorInformation (BspIndex/ProcessorCount/ProcessorInfo)
-  in MicrocodeFmpPrivate must be initialized.
+  in MicrocodeFmpPrivate must be initialized, and the Microcode patch
+  index must be updated by UpdateMicrocodePatchIndex().
 
   The MicrocodeInformation (DescriptorCount/ImageDescriptor/MicrocodeInfo)
   in MicrocodeFmpPrivate may not be avaiable in this function.
@@ -0,0 +1,249 @@
+/**@file
+  SMRAM/MMRAM mirror of the variable store firmware volume.
+
+  The NV storage, FTW working and FTW spare regions are copied once into a
+  buffer allocated by the MM driver, so reads do not need to access the
+  memory-mapped SPI flash. Every write and erase done through this driver is
+  applied to the mirror as well.
+
+Copyright (c) Microsoft Corporation.<BR>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "SpiFvbServiceCommon.h"
+#include <Guid/VariableFormat.h>
+
+FVB_FLASH_MIRROR  mFvbFlashMirror;
+
+/**
+  Check that a copy of the variable store firmware volume starts with a valid
+  firmware volume header followed by a formatted and healthy variable store.
+
+  @param[in]  BaseAddress The flash address of the variable store firmware volume.
+  @param[in]  Buffer      The copy of the variable store firmware volume.
+  @param[in]  Length      The size of the copy in bytes.
+
+  @retval     TRUE        The copy holds a valid variable store.
+  @retval     FALSE       The headers of the copy are corrupted.
+
+**/
+STATIC
+BOOLEAN
+FvbMirrorIsValid (
+  IN EFI_PHYSICAL_ADDRESS  BaseAddress,
+  IN UINT8                 *Buffer,
+  IN UINT32                Length
+  )
+{
+  EFI_FIRMWARE_VOLUME_HEADER  *FvHeader;
+  VARIABLE_STORE_HEADER       *VariableStoreHeader;
+
+  FvHeader = (EFI_FIRMWARE_VOLUME_HEADER *)Buffer;
+  if ((Length < sizeof (EFI_FIRMWARE_VOLUME_HEADER)) ||
+      (FvHeader->HeaderLength < sizeof (EFI_FIRMWARE_VOLUME_HEADER)) ||
+      (FvHeader->HeaderLength > Length - sizeof (VARIABLE_STORE_HEADER)) ||
+      !IsFvHeaderValid (BaseAddress, FvHeader))
+  {
+    return FALSE;
+  }
+
+  VariableStoreHeader = (VARIABLE_STORE_HEADER *)(Buffer + FvHeader->HeaderLength);
+  if (!CompareGuid (&VariableStoreHeader->Signature, &gEfiVariableGuid) &&
+      !CompareGuid (&VariableStoreHeader->Signature, &gEfiAuthenticatedVariableGuid))
+  {
+    return FALSE;
+  }
+
+  return (BOOLEAN)((VariableStoreHeader->Format == VARIABLE_STORE_FORMATTED) &&
+                   (VariableStoreHeader->State == VARIABLE_STORE_HEALTHY) &&
+                   (VariableStoreHeader->Size <= Length - FvHeader->HeaderLength));
+}
+
+/**
+  Copy the variable store firmware volume into the mirror.
+
+  The firmware volume header and the variable store header of the copy are
+  validated before it is used. The mirror stays disabled if it cannot be
+  allocated or validated.
+
+**/
+VOID
+FvbMirrorInitialize (
+  VOID
+  )
+{
+  EFI_PHYSICAL_ADDRESS  BaseAddress;
+  UINT32                Length;
+  UINT8                 *Buffer;
+
+  if (!FeaturePcdGet (PcdSpiFvbNvStorageMirror)) {
+    return;
+  }
+
+  GetVariableFvInfo (&BaseAddress, &Length);
+  if ((BaseAddress == 0) || (Length == 0)) {
+    return;
+  }
+
+  Buffer = AllocatePool (Length);
+  if (Buffer == NULL) {
+    DEBUG ((DEBUG_WARN, "[%a] - Not enough memory to mirror the variable store.\n", __FUNCTION__));
+    return;
+  }
+
+  CopyMem (Buffer, (VOID *)(UINTN)BaseAddress, Length);
+
+  if (!FvbMirrorIsValid (BaseAddress, Buffer, Length)) {
+    DEBUG ((DEBUG_ERROR, "[%a] - The variable store to mirror is not valid.\n", __FUNCTION__));
+    FreePool (Buffer);
+    return;
+  }
+
+  mFvbFlashMirror.Base   = (UINTN)BaseAddress;
+  mFvbFlashMirror.Length = Length;
+  mFvbFlashMirror.Buffer = Buffer;
+
+  DEBUG ((DEBUG_INFO, "[%a] - Variable store 0x%lx - 0x%lx is mirrored.\n", __FUNCTION__, BaseAddress, BaseAddress + Length));
+}
+
+/**
+  Read data from the mirror if the whole range is mirrored.
+
+  @param[in]  Address     The starting flash address of the read.
+  @param[in]  NumBytes    The number of bytes to read.
+  @param[out] Buffer      The destination data buffer for the read.
+
+  @retval     TRUE        The data has been read from the mirror.
+  @retval     FALSE       The range is not mirrored, it must be read from flash.
+
+**/
+BOOLEAN
+FvbMirrorRead (
+  IN  UINTN  Address,
+  IN  UINTN  NumBytes,
+  OUT UINT8  *Buffer
+  )
+{
+  if ((mFvbFlashMirror.Buffer == NULL) ||
+      (Address < mFvbFlashMirror.Base) ||
+      (NumBytes > mFvbFlashMirror.Length) ||
+      (Address - mFvbFlashMirror.Base > mFvbFlashMirror.Length - NumBytes))
+  {
+    return FALSE;
+  }
+
+  CopyMem (Buffer, mFvbFlashMirror.Buffer + (Address - mFvbFlashMirror.Base), NumBytes);
+  return TRUE;
+}
+
+/**
+  Get the mirrored part of a range of flash.
+
+  @param[in]  Address     The starting flash address of the range.
+  @param[in]  NumBytes    The number of bytes in the range.
+  @param[out] Start       The starting flash address of the mirrored part.
+
+  @return     The number of bytes of the range that are mirrored.
+
+**/
+STATIC
+UINTN
+FvbMirrorGetOverlap (
+  IN  UINTN  Address,
+  IN  UINTN  NumBytes,
+  OUT UINTN  *Start
+  )
+{
+  UINTN  End;
+
+  if (mFvbFlashMirror.Buffer == NULL) {
+    return 0;
+  }
+
+  *Start = MAX (Address, mFvbFlashMirror.Base);
+  End    = MIN (Address + NumBytes, mFvbFlashMirror.Base + mFvbFlashMirror.Length);
+  if (*Start >= End) {
+    return 0;
+  }
+
+  return End - *Start;
+}
+
+/**
+  Update the mirror after data has been written to flash.
+
+  Programming flash can only clear bits, so the mirrored bytes are ANDed with
+  the written data, which is what flash contains after the write.
+
+  @param[in]  Address     The starting flash address of the write.
+  @param[in]  NumBytes    The number of bytes written.
+  @param[in]  Buffer      The data written to flash.
+
+**/
+VOID
+FvbMirrorWrite (
+  IN UINTN  Address,
+  IN UINTN  NumBytes,
+  IN UINT8  *Buffer
+  )
+{
+  UINTN  Start;
+  UINTN  Length;
+  UINT8  *Mirror;
+  UINTN  Index;
+
+  Length = FvbMirrorGetOverlap (Address, NumBytes, &Start);
+  if (Length == 0) {
+    return;
+  }
+
+  Mirror = mFvbFlashMirror.Buffer + (Start - mFvbFlashMirror.Base);
+  Buffer = Buffer + (Start - Address);
+  for (Index = 0; Index < Length; Index++) {
+    Mirror[Index] &= Buffer[Index];
+  }
+}
+
+/**
+  Update the mirror after a range of flash has been erased.
+
+  @param[in]  Address     The starting flash address of the erased range.
+  @param[in]  NumBytes    The number of bytes erased.
+
+**/
+VOID
+FvbMirrorErase (
+  IN UINTN  Address,
+  IN UINTN  NumBytes
+  )
+{
+  UINTN  Start;
+  UINTN  Length;
+
+  Length = FvbMirrorGetOverlap (Address, NumBytes, &Start);
+  if (Length != 0) {
+    SetMem (mFvbFlashMirror.Buffer + (Start - mFvbFlashMirror.Base), Length, 0xFF);
+  }
+}
+
+/**
+  Stop using the mirror.
+
+  It is called when a write or an erase fails, as the content of flash is then
+  unknown. Later reads are served from flash.
+
+**/
+VOID
+FvbMirrorDisable (
+  VOID
+  )
+{
+  if (mFvbFlashMirror.Buffer == NULL) {
+    return;
+  }
+
+  DEBUG ((DEBUG_WARN, "[%a] - Variable store mirror disabled.\n", __FUNCTION__));
+  FreePool (mFvbFlashMirror.Buffer);
+  mFvbFlashMirror.Buffer = NULL;
+}
@@ -102,6 +102,75 @@ FvbGetVolumeAttributes (
   return FvbInstance->FvHeader.Attributes;
 }
 
+/**
+  Build the block map prefix table of a firmware volume block instance.
+
+  Every block map entry is recorded with the LBA and the FV offset of its first
+  block, so an LBA can be resolved with a binary search instead of a walk of the
+  block map. When all blocks have the same size, only the block length is kept
+  and an LBA is resolved with a single multiplication.
+
+  @param[in]  FvbInstance         The pointer to the EFI_FVB_INSTANCE.
+
+**/
+VOID
+FvbInitializeBlockRanges (
+  IN EFI_FVB_INSTANCE  *FvbInstance
+  )
+{
+  EFI_FV_BLOCK_MAP_ENTRY  *BlockMap;
+  UINTN                   NumOfRanges;
+  UINTN                   Index;
+  EFI_LBA                 StartLba;
+  UINTN                   Offset;
+
+  FvbInstance->UniformBlockLength = 0;
+  FvbInstance->NumOfBlockRanges   = 0;
+  FvbInstance->BlockRanges        = NULL;
+
+  BlockMap    = &(FvbInstance->FvHeader.BlockMap[0]);
+  NumOfRanges = 0;
+  while ((BlockMap[NumOfRanges].NumBlocks != 0) && (BlockMap[NumOfRanges].Length != 0)) {
+    NumOfRanges++;
+  }
+
+  if (NumOfRanges == 0) {
+    return;
+  }
+
+  for (Index = 1; Index < NumOfRanges; Index++) {
+    if (BlockMap[Index].Length != BlockMap[0].Length) {
+      break;
+    }
+  }
+
+  if (Index == NumOfRanges) {
+    FvbInstance->UniformBlockLength = BlockMap[0].Length;
+    return;
+  }
+
+  FvbInstance->BlockRanges = AllocatePool (NumOfRanges * sizeof (FVB_BLOCK_MAP_RANGE));
+  if (FvbInstance->BlockRanges == NULL) {
+    //
+    // FvbGetLbaAddress () walks the block map instead.
+    //
+    return;
+  }
+
+  StartLba = 0;
+  Offset   = 0;
+  for (Index = 0; Index < NumOfRanges; Index++) {
+    FvbInstance->BlockRanges[Index].StartLba    = StartLba;
+    FvbInstance->BlockRanges[Index].Offset      = Offset;
+    FvbInstance->BlockRanges[Index].NumBlocks   = BlockMap[Index].NumBlocks;
+    FvbInstance->BlockRanges[Index].BlockLength = BlockMap[Index].Length;
+    StartLba                                   += BlockMap[Index].NumBlocks;
+    Offset                                     += (UINTN)BlockMap[Index].NumBlocks * BlockMap[Index].Length;
+  }
+
+  FvbInstance->NumOfBlockRanges = NumOfRanges;
+}
+
 /**
   Retrieves the starting address of an LBA in an FV. It also
   return a few other attribut of the FV.
@@ -135,6 +204,55 @@ FvbGetLbaAddress (
   EFI_LBA                 StartLba;
   EFI_LBA                 NextLba;
   EFI_FV_BLOCK_MAP_ENTRY  *BlockMap;
+  FVB_BLOCK_MAP_RANGE     *Range;
+  UINTN                   Low;
+  UINTN                   High;
+  UINTN                   Middle;
+
+  //
+  // Resolve the LBA with the precomputed block map when it is available.
+  //
+  if ((FvbInstance->UniformBlockLength != 0) || (FvbInstance->BlockRanges != NULL)) {
+    if (Lba >= FvbInstance->NumOfBlocks) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    if (FvbInstance->UniformBlockLength != 0) {
+      BlockLength = FvbInstance->UniformBlockLength;
+      Offset      = (UINTN)MultU64x32 (Lba, BlockLength);
+      NextLba     = FvbInstance->NumOfBlocks;
+    } else {
+      Low  = 0;
+      High = FvbInstance->NumOfBlockRanges - 1;
+      while (Low < High) {
+        Middle = (Low + High + 1) / 2;
+        if (FvbInstance->BlockRanges[Middle].StartLba <= Lba) {
+          Low = Middle;
+        } else {
+          High = Middle - 1;
+        }
+      }
+
+      Range       = &FvbInstance->BlockRanges[Low];
+      BlockLength = Range->BlockLength;
+      Offset      = Range->Offset + (UINTN)MultU64x32 (Lba - Range->StartLba, BlockLength);
+      NextLba     = Range->StartLba + Range->NumBlocks;
+    }
+
+    if (LbaAddress != NULL) {
+      *LbaAddress = FvbInstance->FvBase + Offset;
+    }
+
+    if (LbaLength != NULL) {
+      *LbaLength = BlockLength;
+    }
+
+    if (NumOfBlocks != NULL) {
+      *NumOfBlocks = (UINTN)(NextLba - Lba);
+    }
+
+    return EFI_SUCCESS;
+  }
 
   StartLba = 0;
   Offset   = 0;
@@ -179,6 +297,49 @@ FvbGetLbaAddress (
   }
 }
 
+/**
+  Complete a write or an erase of a range of flash.
+
+  The flash device is locked and the data cache is invalidated for the range.
+  When a write session is open, the invalidation is deferred to the commit of
+  the session.
+
+  @param[in]  FvbInstance       The pointer to the EFI_FVB_INSTANCE.
+  @param[in]  Address           The starting address of the range.
+  @param[in]  Length            The length of the range.
+
+  @retval     EFI_SUCCESS       The range has been completed.
+  @retval     Others            The flash device cannot be locked.
+
+**/
+STATIC
+EFI_STATUS
+FvbCompleteFlashUpdate (
+  IN EFI_FVB_INSTANCE  *FvbInstance,
+  IN UINTN             Address,
+  IN UINTN             Length
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = SpiFlashLock ();
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (!FvbInstance->WriteSessionOpen) {
+    WriteBackInvalidateDataCacheRange ((VOID *)Address, Length);
+  } else if (FvbInstance->DirtyStart == FvbInstance->DirtyEnd) {
+    FvbInstance->DirtyStart = Address;
+    FvbInstance->DirtyEnd   = Address + Length;
+  } else {
+    FvbInstance->DirtyStart = MIN (FvbInstance->DirtyStart, Address);
+    FvbInstance->DirtyEnd   = MAX (FvbInstance->DirtyEnd, Address + Length);
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
   Reads specified number of bytes into a buffer from the specified block.
 
@@ -253,7 +414,22 @@ FvbReadBlock (
     BadBufferSize = TRUE;
   }
 
-  Status = SpiFlashRead (LbaAddress + BlockOffset, (UINT32 *)NumBytes, Buffer);
+  if (FvbMirrorRead (LbaAddress + BlockOffset, *NumBytes, Buffer)) {
+    Status = EFI_SUCCESS;
+  } else {
+    //
+    // Data written in the open write session must not be read from stale cache lines.
+    //
+    if ((*NumBytes != 0) &&
+        (FvbInstance->DirtyStart < LbaAddress + BlockOffset + *NumBytes) &&
+        (LbaAddress + BlockOffset < FvbInstance->DirtyEnd))
+    {
+      WriteBackInvalidateDataCacheRange ((VOID *)FvbInstance->DirtyStart, FvbInstance->DirtyEnd - FvbInstance->DirtyStart);
+      FvbInstance->DirtyStart = FvbInstance->DirtyEnd;
+    }
+
+    Status = SpiFlashRead (LbaAddress + BlockOffset, (UINT32 *)NumBytes, Buffer);
+  }
 
   if (!EFI_ERROR (Status) && BadBufferSize) {
     return EFI_BAD_BUFFER_SIZE;
@@ -340,16 +516,17 @@ FvbWriteBlock (
 
   Status = SpiFlashWrite (LbaAddress + BlockOffset, (UINT32 *)NumBytes, Buffer);
   if (EFI_ERROR (Status)) {
+    FvbMirrorDisable ();
     return Status;
   }
 
-  Status = SpiFlashLock ();
+  FvbMirrorWrite (LbaAddress + BlockOffset, *NumBytes, Buffer);
+
+  Status = FvbCompleteFlashUpdate (FvbInstance, LbaAddress + BlockOffset, *NumBytes);
   if (EFI_ERROR (Status)) {
     return Status;
   }
 
-  WriteBackInvalidateDataCacheRange ((VOID *)(LbaAddress + BlockOffset), *NumBytes);
-
   if (!EFI_ERROR (Status) && BadBufferSize) {
     return EFI_BAD_BUFFER_SIZE;
   } else {
@@ -358,10 +535,14 @@ FvbWriteBlock (
 }
 
 /**
-  Erases and initializes a firmware volume block.
+  Erases and initializes a range of contiguous firmware volume blocks.
+
+  The whole range is erased with a single request to the SPI flash library,
+  followed by a single flash lock and cache invalidation.
 
   @param[in]    FvbInstance       The pointer to the EFI_FVB_INSTANCE
-  @param[in]    Lba               The logical block index to be erased
+  @param[in]    Lba               The first logical block index to be erased
+  @param[in]    NumOfLba          The number of logical blocks to be erased
 
   @retval   EFI_SUCCESS           The erase request was successfully completed
   @retval   EFI_ACCESS_DENIED     The firmware volume is in the WriteDisabled state
@@ -374,12 +555,15 @@ FvbWriteBlock (
 EFI_STATUS
 FvbEraseBlock (
   IN EFI_FVB_INSTANCE  *FvbInstance,
-  IN EFI_LBA           Lba
+  IN EFI_LBA           Lba,
+  IN UINTN             NumOfLba
   )
 {
   EFI_FVB_ATTRIBUTES_2  Attributes;
   UINTN                 LbaAddress;
   UINTN                 LbaLength;
+  UINTN                 NumOfBlocks;
+  UINTN                 EraseLength;
   EFI_STATUS            Status;
 
   //
@@ -392,26 +576,42 @@ FvbEraseBlock (
   }
 
   //
-  // Get the starting address of the block for erase.
+  // Get the starting address of the first block for erase.
   //
-  Status = FvbGetLbaAddress (FvbInstance, Lba, &LbaAddress, &LbaLength, NULL);
+  Status = FvbGetLbaAddress (FvbInstance, Lba, &LbaAddress, &LbaLength, &NumOfBlocks);
   if (EFI_ERROR (Status)) {
     return Status;
   }
 
-  Status = SpiFlashBlockErase (LbaAddress, &LbaLength);
-  if (EFI_ERROR (Status)) {
-    return Status;
+  //
+  // The blocks of a FV are contiguous, so the range only needs to be summed up
+  // over the block map entries it spans.
+  //
+  EraseLength = 0;
+  while (TRUE) {
+    NumOfBlocks  = MIN (NumOfBlocks, NumOfLba);
+    EraseLength += NumOfBlocks * LbaLength;
+    NumOfLba    -= NumOfBlocks;
+    if (NumOfLba == 0) {
+      break;
+    }
+
+    Lba   += NumOfBlocks;
+    Status = FvbGetLbaAddress (FvbInstance, Lba, NULL, &LbaLength, &NumOfBlocks);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
   }
 
-  Status = SpiFlashLock ();
+  Status = SpiFlashBlockErase (LbaAddress, &EraseLength);
   if (EFI_ERROR (Status)) {
+    FvbMirrorDisable ();
     return Status;
   }
 
-  WriteBackInvalidateDataCacheRange ((VOID *)LbaAddress, LbaLength);
+  FvbMirrorErase (LbaAddress, EraseLength);
 
-  return Status;
+  return FvbCompleteFlashUpdate (FvbInstance, LbaAddress, EraseLength);
 }
 
 /**
@@ -860,7 +1060,10 @@ FvbProtocolEraseBlocks (
   VA_LIST           Args;
   EFI_LBA           StartingLba;
   UINTN             NumOfLba;
+  EFI_LBA           SpanLba;
+  UINTN             SpanNumOfLba;
   EFI_STATUS        Status;
+  BOOLEAN           SessionOpened;
 
   DEBUG ((DEBUG_INFO, "FvbProtocolEraseBlocks: \n"));
 
@@ -887,12 +1090,24 @@ FvbProtocolEraseBlocks (
     }
 
     if ((StartingLba + NumOfLba) > NumOfBlocks ) {
+      VA_END (Args);
       return EFI_INVALID_PARAMETER;
     }
   } while (1);
 
   VA_END (Args);
 
+  //
+  // Coalesce ranges that continue the previous one into a single span, so each
+  // span is erased with one request. Unless a write session is already open,
+  // the spans are erased in a session of their own, so the data cache is
+  // invalidated once for all of them.
+  //
+  SessionOpened = !EFI_ERROR (FvbBeginWriteSession (FvbInstance));
+
+  Status       = EFI_SUCCESS;
+  SpanLba      = 0;
+  SpanNumOfLba = 0;
   VA_START (Args, This);
   do {
     StartingLba = VA_ARG (Args, EFI_LBA);
@@ -902,21 +1117,33 @@ FvbProtocolEraseBlocks (
 
     NumOfLba = VA_ARG (Args, UINT32);
 
-    while ( NumOfLba > 0 ) {
-      Status = FvbEraseBlock (FvbInstance, StartingLba);
+    if ((SpanNumOfLba != 0) && (StartingLba == SpanLba + SpanNumOfLba)) {
+      SpanNumOfLba += NumOfLba;
+      continue;
+    }
+
+    if (SpanNumOfLba != 0) {
+      Status = FvbEraseBlock (FvbInstance, SpanLba, SpanNumOfLba);
       if ( EFI_ERROR (Status)) {
-        VA_END (Args);
-        return Status;
+        break;
       }
-
-      StartingLba++;
-      NumOfLba--;
     }
+
+    SpanLba      = StartingLba;
+    SpanNumOfLba = NumOfLba;
   } while (1);
 
   VA_END (Args);
 
-  return EFI_SUCCESS;
+  if (!EFI_ERROR (Status) && (SpanNumOfLba != 0)) {
+    Status = FvbEraseBlock (FvbInstance, SpanLba, SpanNumOfLba);
+  }
+
+  if (SessionOpened) {
+    FvbCommitWriteSession (FvbInstance);
+  }
+
+  return Status;
 }
 
 /**
@@ -1024,3 +1251,64 @@ FvbProtocolRead (
 
   return Status;
 }
+
+/**
+  Open a write session on the firmware volume block instance.
+
+  Writes and erases done in the session defer the invalidation of the data
+  cache to FvbCommitWriteSession (), which invalidates the union of their
+  ranges once.
+
+  @param[in]  FvbInstance         The pointer to the EFI_FVB_INSTANCE.
+
+  @retval     EFI_SUCCESS         The write session is open.
+  @retval     EFI_ALREADY_STARTED A write session is already open.
+
+**/
+EFI_STATUS
+FvbBeginWriteSession (
+  IN EFI_FVB_INSTANCE  *FvbInstance
+  )
+{
+  if (FvbInstance->WriteSessionOpen) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  FvbInstance->WriteSessionOpen = TRUE;
+  FvbInstance->DirtyStart       = 0;
+  FvbInstance->DirtyEnd         = 0;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Close the write session on the firmware volume block instance.
+
+  The data cache is invalidated once for the union of the ranges written or
+  erased during the session.
+
+  @param[in]  FvbInstance         The pointer to the EFI_FVB_INSTANCE.
+
+  @retval     EFI_SUCCESS         The write session is committed.
+  @retval     EFI_NOT_STARTED     No write session is open.
+
+**/
+EFI_STATUS
+FvbCommitWriteSession (
+  IN EFI_FVB_INSTANCE  *FvbInstance
+  )
+{
+  if (!FvbInstance->WriteSessionOpen) {
+    return EFI_NOT_STARTED;
+  }
+
+  if (FvbInstance->DirtyStart != FvbInstance->DirtyEnd) {
+    WriteBackInvalidateDataCacheRange ((VOID *)FvbInstance->DirtyStart, FvbInstance->DirtyEnd - FvbInstance->DirtyStart);
+  }
+
+  FvbInstance->WriteSessionOpen = FALSE;
+  FvbInstance->DirtyStart       = 0;
+  FvbInstance->DirtyEnd         = 0;
+
+  return EFI_SUCCESS;
+}
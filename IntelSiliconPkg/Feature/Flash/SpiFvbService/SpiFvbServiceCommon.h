@@ -46,12 +46,28 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #define FVB_INSTANCE_SIGNATURE  SIGNATURE_32('F','V','B','I')
 
+//
+// One block map entry with the LBA and the FV offset of its first block
+//
+typedef struct {
+  EFI_LBA    StartLba;
+  UINTN      Offset;
+  UINT32     NumBlocks;
+  UINT32     BlockLength;
+} FVB_BLOCK_MAP_RANGE;
+
 typedef struct {
   UINT32                                Signature;
   UINTN                                 FvBase;
   UINTN                                 NumOfBlocks;
+  UINT32                                UniformBlockLength; // Length of all blocks, 0 if the blocks differ in size
+  UINTN                                 NumOfBlockRanges;
+  FVB_BLOCK_MAP_RANGE                   *BlockRanges;       // Prefix table of the block map, NULL if not built
   EFI_DEVICE_PATH_PROTOCOL              *DevicePath;
   EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL    FvbProtocol;
+  BOOLEAN                               WriteSessionOpen;
+  UINTN                                 DirtyStart;         // Range whose cache invalidation is deferred,
+  UINTN                                 DirtyEnd;           // empty when DirtyStart == DirtyEnd
   EFI_FIRMWARE_VOLUME_HEADER            FvHeader;
 } EFI_FVB_INSTANCE;
 
@@ -80,6 +96,15 @@ typedef struct {
   UINT32    FvSize;
 } FV_INFO;
 
+//
+// SMRAM/MMRAM mirror of the variable store firmware volume
+//
+typedef struct {
+  UINTN    Base;
+  UINTN    Length;
+  UINT8    *Buffer;                 // NULL when the mirror is not used
+} FVB_FLASH_MIRROR;
+
 //
 // Protocol APIs
 //
@@ -140,6 +165,27 @@ FvbProtocolEraseBlocks (
   ...
   );
 
+/**
+  Build the block map prefix table of a firmware volume block instance.
+
+  @param[in]  FvbInstance         The pointer to the EFI_FVB_INSTANCE.
+
+**/
+VOID
+FvbInitializeBlockRanges (
+  IN EFI_FVB_INSTANCE  *FvbInstance
+  );
+
+EFI_STATUS
+FvbBeginWriteSession (
+  IN EFI_FVB_INSTANCE  *FvbInstance
+  );
+
+EFI_STATUS
+FvbCommitWriteSession (
+  IN EFI_FVB_INSTANCE  *FvbInstance
+  );
+
 BOOLEAN
 IsFvHeaderValid (
   IN       EFI_PHYSICAL_ADDRESS        FvBase,
@@ -165,6 +211,73 @@ GetVariableFvInfo (
   OUT UINT32                *Length
   );
 
+/**
+  Copy the variable store firmware volume into the mirror.
+
+  The copy is validated against flash with a CRC32 before it is used. The
+  mirror stays disabled if it cannot be allocated or validated.
+
+**/
+VOID
+FvbMirrorInitialize (
+  VOID
+  );
+
+/**
+  Read data from the mirror if the whole range is mirrored.
+
+  @param[in]  Address     The starting flash address of the read.
+  @param[in]  NumBytes    The number of bytes to read.
+  @param[out] Buffer      The destination data buffer for the read.
+
+  @retval     TRUE        The data has been read from the mirror.
+  @retval     FALSE       The range is not mirrored, it must be read from flash.
+
+**/
+BOOLEAN
+FvbMirrorRead (
+  IN  UINTN  Address,
+  IN  UINTN  NumBytes,
+  OUT UINT8  *Buffer
+  );
+
+/**
+  Update the mirror after data has been written to flash.
+
+  @param[in]  Address     The starting flash address of the write.
+  @param[in]  NumBytes    The number of bytes written.
+  @param[in]  Buffer      The data written to flash.
+
+**/
+VOID
+FvbMirrorWrite (
+  IN UINTN  Address,
+  IN UINTN  NumBytes,
+  IN UINT8  *Buffer
+  );
+
+/**
+  Update the mirror after a range of flash has been erased.
+
+  @param[in]  Address     The starting flash address of the erased range.
+  @param[in]  NumBytes    The number of bytes erased.
+
+**/
+VOID
+FvbMirrorErase (
+  IN UINTN  Address,
+  IN UINTN  NumBytes
+  );
+
+/**
+  Stop using the mirror, e.g. after a failed write or erase.
+
+**/
+VOID
+FvbMirrorDisable (
+  VOID
+  );
+
 extern FVB_GLOBAL                          mFvbModuleGlobal;
 extern FV_MEMMAP_DEVICE_PATH               mFvMemmapDevicePathTemplate;
 extern FV_PIWG_DEVICE_PATH                 mFvPIWGDevicePathTemplate;
@@ -366,6 +366,8 @@ FvbInitialize (
         FvbInstance->NumOfBlocks += PtrBlockMapEntry->NumBlocks;
       }
 
+      FvbInitializeBlockRanges (FvbInstance);
+
       //
       // Add a FVB Protocol Instance
       //
@@ -379,5 +381,10 @@ FvbInitialize (
                                          FvHeader->HeaderLength +
                                          (sizeof (EFI_FVB_INSTANCE) - sizeof (EFI_FIRMWARE_VOLUME_HEADER)));
     }
+
+    //
+    // Mirror the variable store after the FV headers have been restored.
+    //
+    FvbMirrorInitialize ();
   }
 }
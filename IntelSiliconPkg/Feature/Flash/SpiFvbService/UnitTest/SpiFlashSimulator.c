@@ -0,0 +1,367 @@
+/** @file
+  Host-based simulation of a SPI flash device behind PCH_SPI2_PROTOCOL.
+
+  Copyright (c) Microsoft Corporation.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "SpiFlashSimulator.h"
+
+#define SPI_FLASH_SIMULATOR_FROM_THIS(a)  BASE_CR (a, SPI_FLASH_SIMULATOR, Protocol)
+
+/**
+  Check that a range of a request is within the flash device.
+
+  @param[in]  Simulator         The simulated device.
+  @param[in]  Address           The starting address of the range.
+  @param[in]  ByteCount         The number of bytes in the range.
+
+  @retval     TRUE              The range is within the flash device.
+  @retval     FALSE             The range is outside the flash device.
+**/
+STATIC
+BOOLEAN
+SpiFlashSimulatorIsValidRange (
+  IN SPI_FLASH_SIMULATOR  *Simulator,
+  IN UINT32               Address,
+  IN UINT32               ByteCount
+  )
+{
+  return (BOOLEAN)((Address <= Simulator->Config.FlashSize) &&
+                   (ByteCount <= Simulator->Config.FlashSize - Address));
+}
+
+/**
+  Read data from the simulated flash array.
+
+  @param[in]  This              Pointer to the PCH_SPI2_PROTOCOL instance.
+  @param[in]  FlashRegionGuid   Flash region, all regions start at the beginning of the device.
+  @param[in]  Address           The flash address to start reading from.
+  @param[in]  ByteCount         Number of bytes to read.
+  @param[out] Buffer            The destination data buffer.
+
+  @retval EFI_SUCCESS           The data is read.
+  @retval EFI_INVALID_PARAMETER The range is outside the flash device.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+SpiFlashSimulatorRead (
+  IN     PCH_SPI2_PROTOCOL  *This,
+  IN     EFI_GUID           *FlashRegionGuid,
+  IN     UINT32             Address,
+  IN     UINT32             ByteCount,
+  OUT    UINT8              *Buffer
+  )
+{
+  SPI_FLASH_SIMULATOR  *Simulator;
+
+  Simulator = SPI_FLASH_SIMULATOR_FROM_THIS (This);
+  if ((Buffer == NULL) || !SpiFlashSimulatorIsValidRange (Simulator, Address, ByteCount)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Buffer, Simulator->Flash + Address, ByteCount);
+  Simulator->Statistics.DeviceTime += Simulator->Config.CommandTime;
+  return EFI_SUCCESS;
+}
+
+/**
+  Program data into the simulated flash array.
+
+  The request is split at program page boundaries, as a flash controller does.
+  Programming can only clear bits: a 1 written over a 0 is ignored by the
+  device and counted as a program violation.
+
+  @param[in]  This              Pointer to the PCH_SPI2_PROTOCOL instance.
+  @param[in]  FlashRegionGuid   Flash region, all regions start at the beginning of the device.
+  @param[in]  Address           The flash address to start writing to.
+  @param[in]  ByteCount         Number of bytes to write.
+  @param[in]  Buffer            The source data buffer.
+
+  @retval EFI_SUCCESS           The data is programmed.
+  @retval EFI_INVALID_PARAMETER The range is outside the flash device.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+SpiFlashSimulatorWrite (
+  IN     PCH_SPI2_PROTOCOL  *This,
+  IN     EFI_GUID           *FlashRegionGuid,
+  IN     UINT32             Address,
+  IN     UINT32             ByteCount,
+  IN     UINT8              *Buffer
+  )
+{
+  SPI_FLASH_SIMULATOR  *Simulator;
+  UINT32               Index;
+  UINT32               PageEnd;
+  UINT8                *Flash;
+
+  Simulator = SPI_FLASH_SIMULATOR_FROM_THIS (This);
+  if ((Buffer == NULL) || !SpiFlashSimulatorIsValidRange (Simulator, Address, ByteCount)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Simulator->Statistics.DeviceTime += Simulator->Config.CommandTime;
+
+  Flash = Simulator->Flash + Address;
+  Index = 0;
+  while (Index < ByteCount) {
+    PageEnd = MIN (ByteCount, ALIGN_VALUE (Address + Index + 1, Simulator->Config.PageSize) - Address);
+    for ( ; Index < PageEnd; Index++) {
+      if ((Buffer[Index] & ~Flash[Index]) != 0) {
+        Simulator->Statistics.ProgramViolations++;
+      }
+
+      Flash[Index] &= Buffer[Index];
+    }
+
+    Simulator->Statistics.ProgramCommands++;
+    Simulator->Statistics.DeviceTime += Simulator->Config.PageProgramTime;
+  }
+
+  Simulator->Statistics.BytesProgrammed += ByteCount;
+  return EFI_SUCCESS;
+}
+
+/**
+  Erase a range of the simulated flash array.
+
+  The range is erased with block erase commands where it is block aligned, and
+  with sector erase commands elsewhere, as a flash controller does.
+
+  @param[in]  This              Pointer to the PCH_SPI2_PROTOCOL instance.
+  @param[in]  FlashRegionGuid   Flash region, all regions start at the beginning of the device.
+  @param[in]  Address           The flash address to start erasing, sector aligned.
+  @param[in]  ByteCount         Number of bytes to erase, a multiple of the sector size.
+
+  @retval EFI_SUCCESS           The range is erased.
+  @retval EFI_INVALID_PARAMETER The range is not sector aligned or is outside the flash device.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+SpiFlashSimulatorErase (
+  IN     PCH_SPI2_PROTOCOL  *This,
+  IN     EFI_GUID           *FlashRegionGuid,
+  IN     UINT32             Address,
+  IN     UINT32             ByteCount
+  )
+{
+  SPI_FLASH_SIMULATOR  *Simulator;
+  UINT32               Length;
+
+  Simulator = SPI_FLASH_SIMULATOR_FROM_THIS (This);
+  if (!SpiFlashSimulatorIsValidRange (Simulator, Address, ByteCount) ||
+      ((Address % Simulator->Config.SectorSize) != 0) ||
+      ((ByteCount % Simulator->Config.SectorSize) != 0))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Simulator->Statistics.DeviceTime += Simulator->Config.CommandTime;
+
+  while (ByteCount > 0) {
+    if (((Address % Simulator->Config.BlockSize) == 0) && (ByteCount >= Simulator->Config.BlockSize)) {
+      Length                            = Simulator->Config.BlockSize;
+      Simulator->Statistics.DeviceTime += Simulator->Config.BlockEraseTime;
+    } else {
+      Length                            = Simulator->Config.SectorSize;
+      Simulator->Statistics.DeviceTime += Simulator->Config.SectorEraseTime;
+    }
+
+    SetMem (Simulator->Flash + Address, Length, 0xFF);
+    Simulator->Statistics.EraseCommands++;
+    Simulator->Statistics.BytesErased += Length;
+    Address                           += Length;
+    ByteCount                         -= Length;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Report the flash region location. Every region covers the whole device.
+
+  @param[in]  This              Pointer to the PCH_SPI2_PROTOCOL instance.
+  @param[in]  FlashRegionGuid   Flash region.
+  @param[out] BaseAddress       The base address of the region.
+  @param[out] RegionSize        The size of the region.
+
+  @retval EFI_SUCCESS           The region location is returned.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+SpiFlashSimulatorGetRegionAddress (
+  IN     PCH_SPI2_PROTOCOL  *This,
+  IN     EFI_GUID           *FlashRegionGuid,
+  OUT    UINT32             *BaseAddress,
+  OUT    UINT32             *RegionSize
+  )
+{
+  *BaseAddress = 0;
+  *RegionSize  = SPI_FLASH_SIMULATOR_FROM_THIS (This)->Config.FlashSize;
+  return EFI_SUCCESS;
+}
+
+/**
+  Create a simulated SPI flash device.
+
+  The flash array is blank unless Config->ImagePath names an existing image
+  file of Config->FlashSize bytes, which is then loaded.
+
+  @param[in]  Config                The geometry and latencies of the device.
+  @param[out] Simulator             On output, the simulated device.
+
+  @retval EFI_SUCCESS               The device is created.
+  @retval EFI_INVALID_PARAMETER     The geometry is not consistent.
+  @retval EFI_OUT_OF_RESOURCES      The flash array cannot be allocated.
+  @retval EFI_LOAD_ERROR            The image file cannot be read.
+**/
+EFI_STATUS
+SpiFlashSimulatorCreate (
+  IN  CONST SPI_FLASH_SIMULATOR_CONFIG  *Config,
+  OUT SPI_FLASH_SIMULATOR               **Simulator
+  )
+{
+  SPI_FLASH_SIMULATOR  *Device;
+  FILE                 *Image;
+  size_t               ReadSize;
+
+  if ((Config == NULL) || (Simulator == NULL) ||
+      (Config->SectorSize == 0) || (Config->PageSize == 0) ||
+      (Config->BlockSize < Config->SectorSize) || ((Config->BlockSize % Config->SectorSize) != 0) ||
+      (Config->FlashSize == 0) || ((Config->FlashSize % Config->BlockSize) != 0))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Device = AllocateZeroPool (sizeof (SPI_FLASH_SIMULATOR));
+  if (Device == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Device->Flash = AllocatePool (Config->FlashSize);
+  if (Device->Flash == NULL) {
+    FreePool (Device);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  SetMem (Device->Flash, Config->FlashSize, 0xFF);
+  CopyMem (&Device->Config, Config, sizeof (SPI_FLASH_SIMULATOR_CONFIG));
+
+  if (Config->ImagePath != NULL) {
+    Image = fopen (Config->ImagePath, "rb");
+    if (Image != NULL) {
+      ReadSize = fread (Device->Flash, 1, Config->FlashSize, Image);
+      fclose (Image);
+      if (ReadSize != Config->FlashSize) {
+        DEBUG ((DEBUG_ERROR, "[%a] - %a is not a 0x%x byte flash image.\n", __FUNCTION__, Config->ImagePath, Config->FlashSize));
+        SpiFlashSimulatorDestroy (Device);
+        return EFI_LOAD_ERROR;
+      }
+    }
+  }
+
+  Device->Protocol.Revision         = PCH_SPI_SERVICES_REVISION;
+  Device->Protocol.FlashRead        = SpiFlashSimulatorRead;
+  Device->Protocol.FlashWrite       = SpiFlashSimulatorWrite;
+  Device->Protocol.FlashErase       = SpiFlashSimulatorErase;
+  Device->Protocol.GetRegionAddress = SpiFlashSimulatorGetRegionAddress;
+
+  *Simulator = Device;
+  return EFI_SUCCESS;
+}
+
+/**
+  Save the flash array of a simulated device to its image file.
+
+  @param[in]  Simulator             The simulated device.
+
+  @retval EFI_SUCCESS               The flash array is saved, or the device has no image file.
+  @retval EFI_DEVICE_ERROR          The image file cannot be written.
+**/
+EFI_STATUS
+SpiFlashSimulatorSave (
+  IN SPI_FLASH_SIMULATOR  *Simulator
+  )
+{
+  FILE    *Image;
+  size_t  WriteSize;
+
+  if (Simulator->Config.ImagePath == NULL) {
+    return EFI_SUCCESS;
+  }
+
+  Image = fopen (Simulator->Config.ImagePath, "wb");
+  if (Image == NULL) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  WriteSize = fwrite (Simulator->Flash, 1, Simulator->Config.FlashSize, Image);
+  if ((fclose (Image) != 0) || (WriteSize != Simulator->Config.FlashSize)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Free a simulated SPI flash device.
+
+  @param[in]  Simulator             The simulated device.
+**/
+VOID
+SpiFlashSimulatorDestroy (
+  IN SPI_FLASH_SIMULATOR  *Simulator
+  )
+{
+  if (Simulator == NULL) {
+    return;
+  }
+
+  FreePool (Simulator->Flash);
+  FreePool (Simulator);
+}
+
+/**
+  Account for a read of the memory-mapped flash array.
+
+  Such reads do not go through the protocol, so their device time is added by
+  the caller.
+
+  @param[in]  Simulator             The simulated device.
+  @param[in]  Length                The number of bytes read.
+**/
+VOID
+SpiFlashSimulatorMappedRead (
+  IN SPI_FLASH_SIMULATOR  *Simulator,
+  IN UINTN                Length
+  )
+{
+  Simulator->Statistics.DeviceTime += Simulator->Config.MappedReadTime * Length;
+}
+
+/**
+  Clear the statistics of a simulated SPI flash device.
+
+  @param[in]  Simulator             The simulated device.
+**/
+VOID
+SpiFlashSimulatorResetStatistics (
+  IN SPI_FLASH_SIMULATOR  *Simulator
+  )
+{
+  ZeroMem (&Simulator->Statistics, sizeof (SPI_FLASH_SIMULATOR_STATISTICS));
+}
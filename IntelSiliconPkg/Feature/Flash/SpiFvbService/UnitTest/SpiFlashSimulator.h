@@ -0,0 +1,130 @@
+/** @file
+  Host-based simulation of a SPI flash device behind PCH_SPI2_PROTOCOL.
+
+  The flash array is kept in host memory, optionally loaded from and saved to
+  an image file. The memory is used as the memory-mapped BIOS region, so the
+  SPI flash common library and the SPI FVB service read it directly and write
+  or erase it through the protocol, as on hardware.
+
+  Like a NOR flash device, programming can only clear bits and erasing sets a
+  whole sector or block to 0xFF. The device time of every command is modeled
+  from configurable latencies instead of being waited for.
+
+  Copyright (c) Microsoft Corporation.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _SPI_FLASH_SIMULATOR_H_
+#define _SPI_FLASH_SIMULATOR_H_
+
+#include <Uefi.h>
+#include <Protocol/Spi2.h>
+
+typedef struct {
+  UINT32         FlashSize;          // Size of the flash device, a multiple of BlockSize
+  UINT32         SectorSize;         // Smallest erase unit, usually 4KB
+  UINT32         BlockSize;          // Largest erase unit, usually 64KB
+  UINT32         PageSize;           // Program page size, usually 256 bytes
+  UINT64         SectorEraseTime;    // Device time in ns to erase a sector
+  UINT64         BlockEraseTime;     // Device time in ns to erase a block
+  UINT64         PageProgramTime;    // Device time in ns to program a page, or a part of it
+  UINT64         CommandTime;        // Controller time in ns for each protocol call
+  UINT64         MappedReadTime;     // Device time in ns to read a byte through the memory-mapped window
+  CONST CHAR8    *ImagePath;         // Optional image file backing the flash array
+} SPI_FLASH_SIMULATOR_CONFIG;
+
+typedef struct {
+  UINT64    EraseCommands;           // Sector and block erase commands sent to the device
+  UINT64    ProgramCommands;         // Page program commands sent to the device
+  UINT64    BytesErased;
+  UINT64    BytesProgrammed;
+  UINT64    ProgramViolations;       // Bytes programmed with a 1 over a 0, which the device ignores
+  UINT64    DeviceTime;              // Modeled time in ns of all the commands
+} SPI_FLASH_SIMULATOR_STATISTICS;
+
+typedef struct {
+  PCH_SPI2_PROTOCOL                 Protocol;
+  SPI_FLASH_SIMULATOR_CONFIG        Config;
+  UINT8                             *Flash;
+  SPI_FLASH_SIMULATOR_STATISTICS    Statistics;
+} SPI_FLASH_SIMULATOR;
+
+///
+/// Latencies of a typical 3.3V serial NOR flash device.
+///
+#define SPI_FLASH_SIMULATOR_DEFAULT_SECTOR_ERASE_TIME  45000000ULL
+#define SPI_FLASH_SIMULATOR_DEFAULT_BLOCK_ERASE_TIME   150000000ULL
+#define SPI_FLASH_SIMULATOR_DEFAULT_PAGE_PROGRAM_TIME  700000ULL
+#define SPI_FLASH_SIMULATOR_DEFAULT_COMMAND_TIME       2000ULL
+#define SPI_FLASH_SIMULATOR_DEFAULT_MAPPED_READ_TIME   40ULL
+
+/**
+  Create a simulated SPI flash device.
+
+  The flash array is blank unless Config->ImagePath names an existing image
+  file of Config->FlashSize bytes, which is then loaded.
+
+  @param[in]  Config                The geometry and latencies of the device.
+  @param[out] Simulator             On output, the simulated device.
+
+  @retval EFI_SUCCESS               The device is created.
+  @retval EFI_INVALID_PARAMETER     The geometry is not consistent.
+  @retval EFI_OUT_OF_RESOURCES      The flash array cannot be allocated.
+  @retval EFI_LOAD_ERROR            The image file cannot be read.
+**/
+EFI_STATUS
+SpiFlashSimulatorCreate (
+  IN  CONST SPI_FLASH_SIMULATOR_CONFIG  *Config,
+  OUT SPI_FLASH_SIMULATOR               **Simulator
+  );
+
+/**
+  Save the flash array of a simulated device to its image file.
+
+  @param[in]  Simulator             The simulated device.
+
+  @retval EFI_SUCCESS               The flash array is saved, or the device has no image file.
+  @retval EFI_DEVICE_ERROR          The image file cannot be written.
+**/
+EFI_STATUS
+SpiFlashSimulatorSave (
+  IN SPI_FLASH_SIMULATOR  *Simulator
+  );
+
+/**
+  Free a simulated SPI flash device.
+
+  @param[in]  Simulator             The simulated device.
+**/
+VOID
+SpiFlashSimulatorDestroy (
+  IN SPI_FLASH_SIMULATOR  *Simulator
+  );
+
+/**
+  Account for a read of the memory-mapped flash array.
+
+  Such reads do not go through the protocol, so their device time is added by
+  the caller.
+
+  @param[in]  Simulator             The simulated device.
+  @param[in]  Length                The number of bytes read.
+**/
+VOID
+SpiFlashSimulatorMappedRead (
+  IN SPI_FLASH_SIMULATOR  *Simulator,
+  IN UINTN                Length
+  );
+
+/**
+  Clear the statistics of a simulated SPI flash device.
+
+  @param[in]  Simulator             The simulated device.
+**/
+VOID
+SpiFlashSimulatorResetStatistics (
+  IN SPI_FLASH_SIMULATOR  *Simulator
+  );
+
+#endif
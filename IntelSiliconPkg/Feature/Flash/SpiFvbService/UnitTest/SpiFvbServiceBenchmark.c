@@ -0,0 +1,1232 @@
+/** @file
+  Host-based benchmark of the SPI FVB service on a simulated SPI flash device.
+
+  The FVB protocol functions of SpiFvbServiceCommon.c and the SPI flash common
+  library run unmodified on top of the simulated PCH_SPI2_PROTOCOL. Variable
+  store workloads replay the flash access sequence of the variable and fault
+  tolerant write drivers: SetVariable () storms and reclaims through the FTW
+  spare block. Every workload is checked against a model of the flash content
+  and reports its operation rate, the bytes erased and programmed, and the
+  latency percentiles of each FVB operation from the modeled device time.
+
+  Copyright (c) Microsoft Corporation.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <time.h>
+#include <cmocka.h>
+
+#include "../SpiFvbServiceCommon.h"
+#include <Library/UnitTestLib.h>
+
+#include "SpiFlashSimulator.h"
+
+#ifndef INTERNAL_UNIT_TEST
+  #error Make sure to build this with INTERNAL_UNIT_TEST enabled! Otherwise, some important tests may be skipped!
+#endif
+
+#define UNIT_TEST_NAME     "SPI FVB Service Benchmark"
+#define UNIT_TEST_VERSION  "0.1"
+
+/// === BENCHMARK CONFIGURATION ====================================================================
+
+//
+// Simulated device: 1MB, 4KB sectors, 64KB blocks, 256 bytes program pages.
+//
+#define BENCHMARK_FLASH_SIZE   SIZE_1MB
+#define BENCHMARK_SECTOR_SIZE  SIZE_4KB
+#define BENCHMARK_BLOCK_SIZE   SIZE_64KB
+#define BENCHMARK_PAGE_SIZE    0x100
+
+//
+// Variable store firmware volume: 64KB variable store, 64KB FTW working area
+// and 64KB FTW spare area, in 4KB FV blocks.
+//
+#define BENCHMARK_FV_OFFSET          0x80000
+#define BENCHMARK_FV_BLOCK_SIZE      SIZE_4KB
+#define BENCHMARK_STORE_LBA          0
+#define BENCHMARK_WORKING_LBA        16
+#define BENCHMARK_SPARE_LBA          32
+#define BENCHMARK_AREA_NUM_BLOCKS    16
+#define BENCHMARK_FV_NUM_BLOCKS      48
+#define BENCHMARK_AREA_SIZE          (BENCHMARK_AREA_NUM_BLOCKS * BENCHMARK_FV_BLOCK_SIZE)
+#define BENCHMARK_FV_SIZE            (BENCHMARK_FV_NUM_BLOCKS * BENCHMARK_FV_BLOCK_SIZE)
+#define BENCHMARK_VARIABLE_START     0x100
+#define BENCHMARK_FTW_RECORD_SIZE    0x40
+#define BENCHMARK_MAX_OPS_PER_TYPE   0x10000
+#define BENCHMARK_READ_CHUNK_SIZE    0x200
+
+//
+// Variable header and state transitions, as written by the variable driver.
+//
+#define BENCHMARK_VARIABLE_DATA        0x55AA
+#define VAR_HEADER_VALID_ONLY          0x7F
+#define VAR_ADDED                      0x3F
+#define VAR_IN_DELETED_TRANSITION      0xFE
+#define VAR_DELETED                    0xFD
+#define BENCHMARK_VARIABLE_NAME_SIZE   0x10
+
+//
+// FTW write record states, cleared one bit at a time.
+//
+#define FTW_SPARE_COMPLETED   0xFE
+#define FTW_UPDATE_COMPLETED  0xFC
+
+#pragma pack(1)
+typedef struct {
+  UINT16      StartId;
+  UINT8       State;
+  UINT8       Reserved;
+  UINT32      Attributes;
+  UINT32      NameSize;
+  UINT32      DataSize;
+  EFI_GUID    VendorGuid;
+} BENCHMARK_VARIABLE_HEADER;
+#pragma pack()
+
+typedef enum {
+  BenchmarkOpRead,
+  BenchmarkOpWrite,
+  BenchmarkOpErase,
+  BenchmarkOpMax
+} BENCHMARK_OP_TYPE;
+
+STATIC CONST CHAR8  *mBenchmarkOpNames[BenchmarkOpMax] = { "Read", "Write", "Erase" };
+
+typedef struct _BENCHMARK_CONTEXT BENCHMARK_CONTEXT;
+
+typedef
+UNIT_TEST_STATUS
+(*BENCHMARK_WORKLOAD)(
+  IN BENCHMARK_CONTEXT  *Context
+  );
+
+typedef struct {
+  CONST CHAR8           *Name;
+  CONST CHAR8           *ClassName;
+  BENCHMARK_WORKLOAD    Workload;
+  BOOLEAN               UseWriteSessions;
+  UINT32                Iterations;
+} BENCHMARK_DESCRIPTOR;
+
+struct _BENCHMARK_CONTEXT {
+  CONST BENCHMARK_DESCRIPTOR            *Descriptor;
+  SPI_FLASH_SIMULATOR                   *Simulator;
+  EFI_FVB_INSTANCE                      *FvbInstance;
+  EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL    *Fvb;
+  UINT8                                 *Model;        // Expected content of the firmware volume
+  UINT32                                *LiveVariable; // Offset of the live copy of each variable, 0 if none
+  UINT32                                NumVariables;
+  UINT32                                StoreEnd;      // Offset of the first free byte of the variable store
+  UINT32                                WorkingEnd;    // Offset of the first free FTW write record
+  UINT32                                Seed;
+  UINT32                                Reclaims;
+  UINT64                                *Latency[BenchmarkOpMax];
+  UINTN                                 NumOps[BenchmarkOpMax];
+};
+
+extern PCH_SPI2_PROTOCOL  *mSpi2Protocol;
+
+extern UINTN  mBiosAreaBaseAddress;
+extern UINTN  mBiosSize;
+extern UINTN  mBiosOffset;
+
+extern UINT64  mSpiFlashBytesErased;
+extern UINT64  mSpiFlashBytesProgrammed;
+
+STATIC BENCHMARK_CONTEXT  mBenchmarkContext;
+
+/// === HELPER FUNCTIONS ===========================================================================
+
+/**
+  Return a pseudo-random number, so every run replays the same workload.
+
+  @param[in, out] Context   The benchmark context.
+
+  @return A pseudo-random 31-bit number.
+**/
+STATIC
+UINT32
+BenchmarkRandom (
+  IN OUT BENCHMARK_CONTEXT  *Context
+  )
+{
+  Context->Seed = Context->Seed * 1103515245 + 12345;
+  return (Context->Seed >> 1) & 0x7FFFFFFF;
+}
+
+/**
+  Record the modeled device time of an FVB operation.
+
+  @param[in, out] Context     The benchmark context.
+  @param[in]      Type        The type of the operation.
+  @param[in]      StartTime   The device time before the operation.
+**/
+STATIC
+VOID
+BenchmarkRecordOp (
+  IN OUT BENCHMARK_CONTEXT  *Context,
+  IN BENCHMARK_OP_TYPE      Type,
+  IN UINT64                 StartTime
+  )
+{
+  if (Context->NumOps[Type] < BENCHMARK_MAX_OPS_PER_TYPE) {
+    Context->Latency[Type][Context->NumOps[Type]] = Context->Simulator->Statistics.DeviceTime - StartTime;
+    Context->NumOps[Type]++;
+  }
+}
+
+/**
+  Read a range of the firmware volume through the FVB protocol, one block at a
+  time, and check it against the model.
+
+  @param[in, out] Context     The benchmark context.
+  @param[in]      Offset      The offset of the range in the firmware volume.
+  @param[in]      Length      The length of the range.
+  @param[out]     Buffer      The destination data buffer.
+
+  @retval UNIT_TEST_PASSED    The range is read and matches the model.
+**/
+STATIC
+UNIT_TEST_STATUS
+BenchmarkRead (
+  IN OUT BENCHMARK_CONTEXT  *Context,
+  IN UINT32                 Offset,
+  IN UINT32                 Length,
+  OUT UINT8                 *Buffer
+  )
+{
+  UINT32  Chunk;
+  UINTN   NumBytes;
+  UINT64  StartTime;
+
+  while (Length > 0) {
+    Chunk     = MIN (Length, BENCHMARK_FV_BLOCK_SIZE - (Offset % BENCHMARK_FV_BLOCK_SIZE));
+    NumBytes  = Chunk;
+    StartTime = Context->Simulator->Statistics.DeviceTime;
+    UT_ASSERT_NOT_EFI_ERROR (
+      Context->Fvb->Read (Context->Fvb, Offset / BENCHMARK_FV_BLOCK_SIZE, Offset % BENCHMARK_FV_BLOCK_SIZE, &NumBytes, Buffer)
+      );
+    SpiFlashSimulatorMappedRead (Context->Simulator, NumBytes);
+    BenchmarkRecordOp (Context, BenchmarkOpRead, StartTime);
+    UT_ASSERT_EQUAL (NumBytes, Chunk);
+    UT_ASSERT_MEM_EQUAL (Buffer, Context->Model + Offset, Chunk);
+
+    Offset += Chunk;
+    Length -= Chunk;
+    Buffer += Chunk;
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Write a range of the firmware volume through the FVB protocol, one block at
+  a time, and apply it to the model.
+
+  @param[in, out] Context     The benchmark context.
+  @param[in]      Offset      The offset of the range in the firmware volume.
+  @param[in]      Length      The length of the range.
+  @param[in]      Buffer      The source data buffer.
+
+  @retval UNIT_TEST_PASSED    The range is written.
+**/
+STATIC
+UNIT_TEST_STATUS
+BenchmarkWrite (
+  IN OUT BENCHMARK_CONTEXT  *Context,
+  IN UINT32                 Offset,
+  IN UINT32                 Length,
+  IN CONST UINT8            *Buffer
+  )
+{
+  UINT32  Chunk;
+  UINTN   NumBytes;
+  UINT64  StartTime;
+  UINT32  Index;
+
+  while (Length > 0) {
+    Chunk     = MIN (Length, BENCHMARK_FV_BLOCK_SIZE - (Offset % BENCHMARK_FV_BLOCK_SIZE));
+    NumBytes  = Chunk;
+    StartTime = Context->Simulator->Statistics.DeviceTime;
+    UT_ASSERT_NOT_EFI_ERROR (
+      Context->Fvb->Write (Context->Fvb, Offset / BENCHMARK_FV_BLOCK_SIZE, Offset % BENCHMARK_FV_BLOCK_SIZE, &NumBytes, (UINT8 *)Buffer)
+      );
+    BenchmarkRecordOp (Context, BenchmarkOpWrite, StartTime);
+    UT_ASSERT_EQUAL (NumBytes, Chunk);
+
+    for (Index = 0; Index < Chunk; Index++) {
+      Context->Model[Offset + Index] &= Buffer[Index];
+    }
+
+    Offset += Chunk;
+    Length -= Chunk;
+    Buffer += Chunk;
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Clear bits of one byte of the firmware volume, as done for state updates.
+
+  @param[in, out] Context     The benchmark context.
+  @param[in]      Offset      The offset of the byte in the firmware volume.
+  @param[in]      Mask        The bits to keep.
+
+  @retval UNIT_TEST_PASSED    The byte is written.
+**/
+STATIC
+UNIT_TEST_STATUS
+BenchmarkWriteState (
+  IN OUT BENCHMARK_CONTEXT  *Context,
+  IN UINT32                 Offset,
+  IN UINT8                  Mask
+  )
+{
+  UINT8  State;
+
+  State = Context->Model[Offset] & Mask;
+  return BenchmarkWrite (Context, Offset, sizeof (State), &State);
+}
+
+/**
+  Erase a range of blocks of the firmware volume through the FVB protocol and
+  apply it to the model.
+
+  @param[in, out] Context     The benchmark context.
+  @param[in]      Lba         The first block to erase.
+  @param[in]      NumOfLba    The number of blocks to erase.
+
+  @retval UNIT_TEST_PASSED    The blocks are erased.
+**/
+STATIC
+UNIT_TEST_STATUS
+BenchmarkErase (
+  IN OUT BENCHMARK_CONTEXT  *Context,
+  IN EFI_LBA                Lba,
+  IN UINTN                  NumOfLba
+  )
+{
+  UINT64  StartTime;
+
+  StartTime = Context->Simulator->Statistics.DeviceTime;
+  UT_ASSERT_NOT_EFI_ERROR (Context->Fvb->EraseBlocks (Context->Fvb, Lba, NumOfLba, EFI_LBA_LIST_TERMINATOR));
+  BenchmarkRecordOp (Context, BenchmarkOpErase, StartTime);
+
+  SetMem (Context->Model + Lba * BENCHMARK_FV_BLOCK_SIZE, NumOfLba * BENCHMARK_FV_BLOCK_SIZE, 0xFF);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Open a write session if the benchmark uses them.
+
+  @param[in]  Context         The benchmark context.
+
+  @retval UNIT_TEST_PASSED    The session is open, or the benchmark does not use sessions.
+**/
+STATIC
+UNIT_TEST_STATUS
+BenchmarkBeginSession (
+  IN BENCHMARK_CONTEXT  *Context
+  )
+{
+  if (Context->Descriptor->UseWriteSessions) {
+    UT_ASSERT_NOT_EFI_ERROR (FvbBeginWriteSession (Context->FvbInstance));
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Commit the write session if the benchmark uses them.
+
+  @param[in]  Context         The benchmark context.
+
+  @retval UNIT_TEST_PASSED    The session is committed, or the benchmark does not use sessions.
+**/
+STATIC
+UNIT_TEST_STATUS
+BenchmarkCommitSession (
+  IN BENCHMARK_CONTEXT  *Context
+  )
+{
+  if (Context->Descriptor->UseWriteSessions) {
+    UT_ASSERT_NOT_EFI_ERROR (FvbCommitWriteSession (Context->FvbInstance));
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Get the size of a variable record in the model.
+
+  @param[in]  Context         The benchmark context.
+  @param[in]  Offset          The offset of the variable record in the firmware volume.
+
+  @return The size of the variable record, including its alignment padding.
+**/
+STATIC
+UINT32
+BenchmarkVariableSize (
+  IN BENCHMARK_CONTEXT  *Context,
+  IN UINT32             Offset
+  )
+{
+  BENCHMARK_VARIABLE_HEADER  Header;
+
+  CopyMem (&Header, Context->Model + Offset, sizeof (Header));
+  return ALIGN_VALUE (sizeof (Header) + Header.NameSize + Header.DataSize, sizeof (UINT32));
+}
+
+/**
+  Reclaim the variable store through the FTW spare area.
+
+  The live variables are compacted into a new store image, which is written to
+  the spare area and then to the variable store, with the FTW write record
+  updated between the steps.
+
+  @param[in, out] Context     The benchmark context.
+
+  @retval UNIT_TEST_PASSED    The variable store is reclaimed.
+**/
+STATIC
+UNIT_TEST_STATUS
+BenchmarkReclaim (
+  IN OUT BENCHMARK_CONTEXT  *Context
+  )
+{
+  UNIT_TEST_STATUS  Status;
+  UINT8             *Image;
+  UINT8             Record[BENCHMARK_FTW_RECORD_SIZE];
+  UINT32            Index;
+  UINT32            Size;
+  UINT32            End;
+  UINT32            RecordOffset;
+
+  Image = AllocatePool (BENCHMARK_AREA_SIZE);
+  UT_ASSERT_NOT_NULL (Image);
+
+  SetMem (Image, BENCHMARK_AREA_SIZE, 0xFF);
+  CopyMem (Image, Context->Model, BENCHMARK_VARIABLE_START);
+  End = BENCHMARK_VARIABLE_START;
+  for (Index = 0; Index < Context->NumVariables; Index++) {
+    if (Context->LiveVariable[Index] != 0) {
+      Size = BenchmarkVariableSize (Context, Context->LiveVariable[Index]);
+      CopyMem (Image + End, Context->Model + Context->LiveVariable[Index], Size);
+      Context->LiveVariable[Index] = End;
+      End                         += Size;
+    }
+  }
+
+  Status = BenchmarkBeginSession (Context);
+  if (Status != UNIT_TEST_PASSED) {
+    FreePool (Image);
+    return Status;
+  }
+
+  if (Context->WorkingEnd + BENCHMARK_FTW_RECORD_SIZE > BENCHMARK_AREA_SIZE) {
+    Status = BenchmarkErase (Context, BENCHMARK_WORKING_LBA, BENCHMARK_AREA_NUM_BLOCKS);
+    Context->WorkingEnd = 0;
+  }
+
+  RecordOffset = BENCHMARK_WORKING_LBA * BENCHMARK_FV_BLOCK_SIZE + Context->WorkingEnd;
+  SetMem (Record, sizeof (Record), 0xFF);
+  Record[0] = 0xFE;
+  CopyMem (&Record[4], &Context->Reclaims, sizeof (Context->Reclaims));
+
+  if (Status == UNIT_TEST_PASSED) {
+    Status = BenchmarkWrite (Context, RecordOffset, sizeof (Record), Record);
+  }
+
+  if (Status == UNIT_TEST_PASSED) {
+    Status = BenchmarkErase (Context, BENCHMARK_SPARE_LBA, BENCHMARK_AREA_NUM_BLOCKS);
+  }
+
+  if (Status == UNIT_TEST_PASSED) {
+    Status = BenchmarkWrite (Context, BENCHMARK_SPARE_LBA * BENCHMARK_FV_BLOCK_SIZE, BENCHMARK_AREA_SIZE, Image);
+  }
+
+  if (Status == UNIT_TEST_PASSED) {
+    Status = BenchmarkWriteState (Context, RecordOffset + 1, FTW_SPARE_COMPLETED);
+  }
+
+  if (Status == UNIT_TEST_PASSED) {
+    Status = BenchmarkErase (Context, BENCHMARK_STORE_LBA, BENCHMARK_AREA_NUM_BLOCKS);
+  }
+
+  if (Status == UNIT_TEST_PASSED) {
+    Status = BenchmarkWrite (Context, BENCHMARK_STORE_LBA * BENCHMARK_FV_BLOCK_SIZE, BENCHMARK_AREA_SIZE, Image);
+  }
+
+  if (Status == UNIT_TEST_PASSED) {
+    Status = BenchmarkWriteState (Context, RecordOffset + 1, FTW_UPDATE_COMPLETED);
+  }
+
+  FreePool (Image);
+  if (Status != UNIT_TEST_PASSED) {
+    return Status;
+  }
+
+  Context->StoreEnd    = End;
+  Context->WorkingEnd += BENCHMARK_FTW_RECORD_SIZE;
+  Context->Reclaims++;
+
+  return BenchmarkCommitSession (Context);
+}
+
+/**
+  Set a variable the way the variable driver updates the store.
+
+  The previous copy is marked in deleted transition, the new copy is written
+  header first, then name and data, then marked added, and the previous copy is
+  marked deleted. The store is reclaimed first when it has no room left.
+
+  @param[in, out] Context     The benchmark context.
+  @param[in]      Variable    The index of the variable.
+  @param[in]      DataSize    The size of the variable data.
+
+  @retval UNIT_TEST_PASSED    The variable is set.
+**/
+STATIC
+UNIT_TEST_STATUS
+BenchmarkSetVariable (
+  IN OUT BENCHMARK_CONTEXT  *Context,
+  IN UINT32                 Variable,
+  IN UINT32                 DataSize
+  )
+{
+  UNIT_TEST_STATUS           Status;
+  BENCHMARK_VARIABLE_HEADER  Header;
+  BENCHMARK_VARIABLE_HEADER  PreviousHeader;
+  UINT8                      Payload[BENCHMARK_VARIABLE_NAME_SIZE + SIZE_4KB];
+  UINT32                     Size;
+  UINT32                     Offset;
+  UINT32                     Previous;
+  UINT32                     Index;
+
+  UT_ASSERT_TRUE (DataSize <= SIZE_4KB);
+
+  Size = ALIGN_VALUE (sizeof (Header) + BENCHMARK_VARIABLE_NAME_SIZE + DataSize, sizeof (UINT32));
+  if (Context->StoreEnd + Size > BENCHMARK_AREA_SIZE) {
+    Status = BenchmarkReclaim (Context);
+    if (Status != UNIT_TEST_PASSED) {
+      return Status;
+    }
+
+    UT_ASSERT_TRUE (Context->StoreEnd + Size <= BENCHMARK_AREA_SIZE);
+  }
+
+  Status = BenchmarkBeginSession (Context);
+  if (Status != UNIT_TEST_PASSED) {
+    return Status;
+  }
+
+  Previous = Context->LiveVariable[Variable];
+  Offset   = Context->StoreEnd;
+
+  ZeroMem (&Header, sizeof (Header));
+  Header.StartId          = BENCHMARK_VARIABLE_DATA;
+  Header.State            = VAR_HEADER_VALID_ONLY;
+  Header.Attributes       = EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS;
+  Header.NameSize         = BENCHMARK_VARIABLE_NAME_SIZE;
+  Header.DataSize         = DataSize;
+  Header.VendorGuid.Data1 = Variable;
+
+  for (Index = 0; Index < BENCHMARK_VARIABLE_NAME_SIZE + DataSize; Index++) {
+    Payload[Index] = (UINT8)BenchmarkRandom (Context);
+  }
+
+  if (Previous != 0) {
+    Status = BenchmarkRead (Context, Previous, sizeof (PreviousHeader), (UINT8 *)&PreviousHeader);
+    if (Status != UNIT_TEST_PASSED) {
+      return Status;
+    }
+
+    UT_ASSERT_EQUAL (PreviousHeader.StartId, BENCHMARK_VARIABLE_DATA);
+    UT_ASSERT_EQUAL (PreviousHeader.State, VAR_ADDED);
+    UT_ASSERT_EQUAL (PreviousHeader.VendorGuid.Data1, Variable);
+    if (Status == UNIT_TEST_PASSED) {
+      Status = BenchmarkWriteState (Context, Previous + OFFSET_OF (BENCHMARK_VARIABLE_HEADER, State), VAR_IN_DELETED_TRANSITION);
+    }
+  }
+
+  if (Status == UNIT_TEST_PASSED) {
+    Status = BenchmarkWrite (Context, Offset, sizeof (Header), (UINT8 *)&Header);
+  }
+
+  if (Status == UNIT_TEST_PASSED) {
+    Status = BenchmarkWrite (Context, Offset + sizeof (Header), BENCHMARK_VARIABLE_NAME_SIZE + DataSize, Payload);
+  }
+
+  if (Status == UNIT_TEST_PASSED) {
+    Status = BenchmarkWriteState (Context, Offset + OFFSET_OF (BENCHMARK_VARIABLE_HEADER, State), VAR_ADDED);
+  }
+
+  if ((Status == UNIT_TEST_PASSED) && (Previous != 0)) {
+    Status = BenchmarkWriteState (Context, Previous + OFFSET_OF (BENCHMARK_VARIABLE_HEADER, State), VAR_DELETED);
+  }
+
+  if (Status != UNIT_TEST_PASSED) {
+    return Status;
+  }
+
+  Context->LiveVariable[Variable] = Offset;
+  Context->StoreEnd              += Size;
+
+  return BenchmarkCommitSession (Context);
+}
+
+/**
+  Compute a latency percentile of a sorted latency array.
+
+  @param[in]  Latency         The sorted latencies.
+  @param[in]  Count           The number of latencies, not 0.
+  @param[in]  Percent         The percentile.
+
+  @return The latency in ns at the percentile.
+**/
+STATIC
+UINT64
+BenchmarkPercentile (
+  IN CONST UINT64  *Latency,
+  IN UINTN         Count,
+  IN UINTN         Percent
+  )
+{
+  return Latency[((Count - 1) * Percent) / 100];
+}
+
+/**
+  Compare two latencies for qsort ().
+
+  @param[in]  Left            The first latency.
+  @param[in]  Right           The second latency.
+
+  @return -1, 0 or 1 as Left is lower than, equal to or greater than Right.
+**/
+STATIC
+int
+BenchmarkCompareLatency (
+  IN CONST VOID  *Left,
+  IN CONST VOID  *Right
+  )
+{
+  UINT64  A;
+  UINT64  B;
+
+  A = *(CONST UINT64 *)Left;
+  B = *(CONST UINT64 *)Right;
+  return (A < B) ? -1 : ((A > B) ? 1 : 0);
+}
+
+/**
+  Print the result of a benchmark.
+
+  @param[in, out] Context         The benchmark context.
+  @param[in]      BytesErased     The bytes erased reported by the SPI flash common library.
+  @param[in]      BytesProgrammed The bytes programmed reported by the SPI flash common library.
+  @param[in]      HostTime        The host time in ns taken by the workload.
+**/
+STATIC
+VOID
+BenchmarkReport (
+  IN OUT BENCHMARK_CONTEXT  *Context,
+  IN UINT64                 BytesErased,
+  IN UINT64                 BytesProgrammed,
+  IN UINT64                 HostTime
+  )
+{
+  SPI_FLASH_SIMULATOR_STATISTICS  *Statistics;
+  UINTN                           Type;
+  UINTN                           TotalOps;
+
+  Statistics = &Context->Simulator->Statistics;
+  TotalOps   = 0;
+  for (Type = 0; Type < BenchmarkOpMax; Type++) {
+    TotalOps += Context->NumOps[Type];
+  }
+
+  printf (
+    "\n  %s: %llu FVB operations, %u reclaims\n",
+    Context->Descriptor->Name,
+    (unsigned long long)TotalOps,
+    Context->Reclaims
+    );
+  printf (
+    "    device time %llu us, %llu ops/s (host time %llu us)\n",
+    (unsigned long long)(Statistics->DeviceTime / 1000),
+    (unsigned long long)((Statistics->DeviceTime == 0) ? 0 : (UINT64)TotalOps * 1000000000ULL / Statistics->DeviceTime),
+    (unsigned long long)(HostTime / 1000)
+    );
+  printf (
+    "    erased %llu bytes in %llu commands, programmed %llu bytes in %llu page commands\n",
+    (unsigned long long)Statistics->BytesErased,
+    (unsigned long long)Statistics->EraseCommands,
+    (unsigned long long)Statistics->BytesProgrammed,
+    (unsigned long long)Statistics->ProgramCommands
+    );
+  printf (
+    "    library counters: erased %llu bytes, programmed %llu bytes\n",
+    (unsigned long long)BytesErased,
+    (unsigned long long)BytesProgrammed
+    );
+
+  for (Type = 0; Type < BenchmarkOpMax; Type++) {
+    if (Context->NumOps[Type] == 0) {
+      continue;
+    }
+
+    qsort (Context->Latency[Type], Context->NumOps[Type], sizeof (UINT64), BenchmarkCompareLatency);
+    printf (
+      "    %-5s n=%-6llu p50=%llu us p90=%llu us p99=%llu us max=%llu us\n",
+      mBenchmarkOpNames[Type],
+      (unsigned long long)Context->NumOps[Type],
+      (unsigned long long)(BenchmarkPercentile (Context->Latency[Type], Context->NumOps[Type], 50) / 1000),
+      (unsigned long long)(BenchmarkPercentile (Context->Latency[Type], Context->NumOps[Type], 90) / 1000),
+      (unsigned long long)(BenchmarkPercentile (Context->Latency[Type], Context->NumOps[Type], 99) / 1000),
+      (unsigned long long)(Context->Latency[Type][Context->NumOps[Type] - 1] / 1000)
+      );
+  }
+}
+
+/// === WORKLOADS ==================================================================================
+
+/**
+  SetVariable () storm: updates of variables of random sizes, with the store
+  reclaimed whenever it is full.
+
+  @param[in, out] Context     The benchmark context.
+
+  @retval UNIT_TEST_PASSED    The workload completed.
+**/
+STATIC
+UNIT_TEST_STATUS
+BenchmarkSetVariableStorm (
+  IN OUT BENCHMARK_CONTEXT  *Context
+  )
+{
+  UNIT_TEST_STATUS  Status;
+  UINT32            Iteration;
+
+  for (Iteration = 0; Iteration < Context->Descriptor->Iterations; Iteration++) {
+    Status = BenchmarkSetVariable (
+               Context,
+               BenchmarkRandom (Context) % Context->NumVariables,
+               16 + BenchmarkRandom (Context) % 1024
+               );
+    if (Status != UNIT_TEST_PASSED) {
+      return Status;
+    }
+  }
+
+  UT_ASSERT_TRUE (Context->Reclaims > 0);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Boot scan: the variable store is filled once, then read back in chunks as
+  done when the variable and FTW drivers start.
+
+  @param[in, out] Context     The benchmark context.
+
+  @retval UNIT_TEST_PASSED    The workload completed.
+**/
+STATIC
+UNIT_TEST_STATUS
+BenchmarkBootScan (
+  IN OUT BENCHMARK_CONTEXT  *Context
+  )
+{
+  UNIT_TEST_STATUS  Status;
+  UINT8             Buffer[BENCHMARK_READ_CHUNK_SIZE];
+  UINT32            Index;
+  UINT32            Offset;
+
+  for (Index = 0; Index < Context->NumVariables; Index++) {
+    Status = BenchmarkSetVariable (Context, Index, 16 + BenchmarkRandom (Context) % 512);
+    if (Status != UNIT_TEST_PASSED) {
+      return Status;
+    }
+  }
+
+  for (Index = 0; Index < Context->Descriptor->Iterations; Index++) {
+    for (Offset = 0; Offset < BENCHMARK_FV_SIZE; Offset += sizeof (Buffer)) {
+      Status = BenchmarkRead (Context, Offset, sizeof (Buffer), Buffer);
+      if (Status != UNIT_TEST_PASSED) {
+        return Status;
+      }
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/// === SIMULATOR TEST CASES =======================================================================
+
+STATIC CONST SPI_FLASH_SIMULATOR_CONFIG  mBenchmarkFlashConfig = {
+  BENCHMARK_FLASH_SIZE,
+  BENCHMARK_SECTOR_SIZE,
+  BENCHMARK_BLOCK_SIZE,
+  BENCHMARK_PAGE_SIZE,
+  SPI_FLASH_SIMULATOR_DEFAULT_SECTOR_ERASE_TIME,
+  SPI_FLASH_SIMULATOR_DEFAULT_BLOCK_ERASE_TIME,
+  SPI_FLASH_SIMULATOR_DEFAULT_PAGE_PROGRAM_TIME,
+  SPI_FLASH_SIMULATOR_DEFAULT_COMMAND_TIME,
+  SPI_FLASH_SIMULATOR_DEFAULT_MAPPED_READ_TIME,
+  NULL
+};
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+ProgramShouldOnlyClearBits (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  SPI_FLASH_SIMULATOR  *Simulator;
+  UINT8                Data;
+
+  UT_ASSERT_NOT_EFI_ERROR (SpiFlashSimulatorCreate (&mBenchmarkFlashConfig, &Simulator));
+
+  Data = 0xF0;
+  UT_ASSERT_NOT_EFI_ERROR (Simulator->Protocol.FlashWrite (&Simulator->Protocol, &gFlashRegionBiosGuid, 0x10, 1, &Data));
+  UT_ASSERT_EQUAL (Simulator->Flash[0x10], 0xF0);
+  UT_ASSERT_EQUAL (Simulator->Statistics.ProgramViolations, 0);
+
+  Data = 0x3F;
+  UT_ASSERT_NOT_EFI_ERROR (Simulator->Protocol.FlashWrite (&Simulator->Protocol, &gFlashRegionBiosGuid, 0x10, 1, &Data));
+  UT_ASSERT_EQUAL (Simulator->Flash[0x10], 0x30);
+  UT_ASSERT_EQUAL (Simulator->Statistics.ProgramViolations, 1);
+
+  //
+  // A write crossing a page boundary takes two page program commands.
+  //
+  SpiFlashSimulatorResetStatistics (Simulator);
+  UT_ASSERT_NOT_EFI_ERROR (Simulator->Protocol.FlashWrite (&Simulator->Protocol, &gFlashRegionBiosGuid, 0xFF, 2, Simulator->Flash));
+  UT_ASSERT_EQUAL (Simulator->Statistics.ProgramCommands, 2);
+
+  SpiFlashSimulatorDestroy (Simulator);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+EraseShouldUseLargestAlignedCommands (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  SPI_FLASH_SIMULATOR  *Simulator;
+  UINT8                Data;
+
+  UT_ASSERT_NOT_EFI_ERROR (SpiFlashSimulatorCreate (&mBenchmarkFlashConfig, &Simulator));
+
+  UT_ASSERT_STATUS_EQUAL (
+    Simulator->Protocol.FlashErase (&Simulator->Protocol, &gFlashRegionBiosGuid, 0x800, SIZE_4KB),
+    EFI_INVALID_PARAMETER
+    );
+  UT_ASSERT_STATUS_EQUAL (
+    Simulator->Protocol.FlashErase (&Simulator->Protocol, &gFlashRegionBiosGuid, BENCHMARK_FLASH_SIZE - SIZE_4KB, SIZE_8KB),
+    EFI_INVALID_PARAMETER
+    );
+
+  Data = 0;
+  UT_ASSERT_NOT_EFI_ERROR (Simulator->Protocol.FlashWrite (&Simulator->Protocol, &gFlashRegionBiosGuid, 0x10000, 1, &Data));
+
+  //
+  // 0xF000 - 0x20FFF: one sector, one block and one sector.
+  //
+  SpiFlashSimulatorResetStatistics (Simulator);
+  UT_ASSERT_NOT_EFI_ERROR (Simulator->Protocol.FlashErase (&Simulator->Protocol, &gFlashRegionBiosGuid, 0xF000, 0x12000));
+  UT_ASSERT_EQUAL (Simulator->Flash[0x10000], 0xFF);
+  UT_ASSERT_EQUAL (Simulator->Statistics.EraseCommands, 3);
+  UT_ASSERT_EQUAL (Simulator->Statistics.BytesErased, 0x12000);
+  UT_ASSERT_EQUAL (
+    Simulator->Statistics.DeviceTime,
+    SPI_FLASH_SIMULATOR_DEFAULT_COMMAND_TIME + 2 * SPI_FLASH_SIMULATOR_DEFAULT_SECTOR_ERASE_TIME + SPI_FLASH_SIMULATOR_DEFAULT_BLOCK_ERASE_TIME
+    );
+
+  SpiFlashSimulatorDestroy (Simulator);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+ImageFileShouldPersistFlashContent (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  SPI_FLASH_SIMULATOR_CONFIG  Config;
+  SPI_FLASH_SIMULATOR         *Simulator;
+  UINT8                       Data;
+
+  CopyMem (&Config, &mBenchmarkFlashConfig, sizeof (Config));
+  Config.ImagePath = "SpiFlashSimulatorImage.bin";
+  remove (Config.ImagePath);
+
+  UT_ASSERT_NOT_EFI_ERROR (SpiFlashSimulatorCreate (&Config, &Simulator));
+  Data = 0x5A;
+  UT_ASSERT_NOT_EFI_ERROR (Simulator->Protocol.FlashWrite (&Simulator->Protocol, &gFlashRegionBiosGuid, 0x1234, 1, &Data));
+  UT_ASSERT_NOT_EFI_ERROR (SpiFlashSimulatorSave (Simulator));
+  SpiFlashSimulatorDestroy (Simulator);
+
+  UT_ASSERT_NOT_EFI_ERROR (SpiFlashSimulatorCreate (&Config, &Simulator));
+  UT_ASSERT_EQUAL (Simulator->Flash[0x1233], 0xFF);
+  UT_ASSERT_EQUAL (Simulator->Flash[0x1234], 0x5A);
+  SpiFlashSimulatorDestroy (Simulator);
+
+  remove (Config.ImagePath);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+WriteShouldNotSetBits (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  SPI_FLASH_SIMULATOR  *Simulator;
+  UINT8                Data[2];
+  UINT32               NumBytes;
+
+  if (!FeaturePcdGet (PcdSpiFlashSkipUnchanged)) {
+    return UNIT_TEST_SKIPPED;
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (SpiFlashSimulatorCreate (&mBenchmarkFlashConfig, &Simulator));
+  mSpi2Protocol        = &Simulator->Protocol;
+  mBiosAreaBaseAddress = (UINTN)Simulator->Flash;
+  mBiosSize            = BENCHMARK_FLASH_SIZE;
+  mBiosOffset          = 0;
+
+  //
+  // A byte with bits changed from 1 to 0 is programmed, an unchanged byte is not.
+  //
+  Data[0]  = 0xF0;
+  Data[1]  = 0xFF;
+  NumBytes = sizeof (Data);
+  UT_ASSERT_NOT_EFI_ERROR (SpiFlashWrite (mBiosAreaBaseAddress + 0x10, &NumBytes, Data));
+  UT_ASSERT_EQUAL (NumBytes, sizeof (Data));
+  UT_ASSERT_EQUAL (Simulator->Flash[0x10], 0xF0);
+  UT_ASSERT_EQUAL (Simulator->Statistics.BytesProgrammed, 1);
+
+  //
+  // A byte with a bit changed from 0 to 1 needs an erase, the write fails
+  // without programming it.
+  //
+  Data[0]  = 0x0F;
+  NumBytes = 1;
+  UT_ASSERT_STATUS_EQUAL (SpiFlashWrite (mBiosAreaBaseAddress + 0x10, &NumBytes, Data), EFI_DEVICE_ERROR);
+  UT_ASSERT_EQUAL (NumBytes, 0);
+  UT_ASSERT_EQUAL (Simulator->Flash[0x10], 0xF0);
+  UT_ASSERT_EQUAL (Simulator->Statistics.BytesProgrammed, 1);
+  UT_ASSERT_EQUAL (Simulator->Statistics.ProgramViolations, 0);
+
+  mSpi2Protocol = NULL;
+  SpiFlashSimulatorDestroy (Simulator);
+  return UNIT_TEST_PASSED;
+}
+
+/// === BENCHMARK TEST CASES =======================================================================
+
+/**
+  Create the simulated device and the FVB instance of the variable store
+  firmware volume, and format the firmware volume.
+
+  @param[in]  Context           The benchmark descriptor.
+
+  @retval UNIT_TEST_PASSED      The benchmark is ready to run.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+BenchmarkSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  BENCHMARK_CONTEXT           *Benchmark;
+  EFI_FIRMWARE_VOLUME_HEADER  *FvHeader;
+  UINT32                      HeaderLength;
+  UINTN                       Type;
+
+  Benchmark = &mBenchmarkContext;
+  ZeroMem (Benchmark, sizeof (BENCHMARK_CONTEXT));
+  Benchmark->Descriptor   = (CONST BENCHMARK_DESCRIPTOR *)Context;
+  Benchmark->Seed         = 0x5EED;
+  Benchmark->NumVariables = 48;
+
+  UT_ASSERT_NOT_EFI_ERROR (SpiFlashSimulatorCreate (&mBenchmarkFlashConfig, &Benchmark->Simulator));
+
+  mSpi2Protocol        = &Benchmark->Simulator->Protocol;
+  mBiosAreaBaseAddress = (UINTN)Benchmark->Simulator->Flash;
+  mBiosSize            = BENCHMARK_FLASH_SIZE;
+  mBiosOffset          = 0;
+
+  //
+  // Firmware volume header with a single block map entry and its terminator.
+  //
+  HeaderLength = sizeof (EFI_FIRMWARE_VOLUME_HEADER) + sizeof (EFI_FV_BLOCK_MAP_ENTRY);
+  Benchmark->FvbInstance = AllocateZeroPool (sizeof (EFI_FVB_INSTANCE) + sizeof (EFI_FV_BLOCK_MAP_ENTRY));
+  UT_ASSERT_NOT_NULL (Benchmark->FvbInstance);
+
+  FvHeader = &Benchmark->FvbInstance->FvHeader;
+  CopyGuid (&FvHeader->FileSystemGuid, &gEfiSystemNvDataFvGuid);
+  FvHeader->FvLength              = BENCHMARK_FV_SIZE;
+  FvHeader->Signature             = EFI_FVH_SIGNATURE;
+  FvHeader->Attributes            = EFI_FVB2_READ_ENABLED_CAP | EFI_FVB2_READ_STATUS |
+                                    EFI_FVB2_WRITE_ENABLED_CAP | EFI_FVB2_WRITE_STATUS |
+                                    EFI_FVB2_ERASE_POLARITY | EFI_FVB2_MEMORY_MAPPED;
+  FvHeader->HeaderLength          = (UINT16)HeaderLength;
+  FvHeader->Revision              = EFI_FVH_REVISION;
+  FvHeader->BlockMap[0].NumBlocks = BENCHMARK_FV_NUM_BLOCKS;
+  FvHeader->BlockMap[0].Length    = BENCHMARK_FV_BLOCK_SIZE;
+  FvHeader->Checksum              = CalculateCheckSum16 ((UINT16 *)FvHeader, HeaderLength);
+
+  Benchmark->FvbInstance->Signature   = FVB_INSTANCE_SIGNATURE;
+  Benchmark->FvbInstance->FvBase      = mBiosAreaBaseAddress + BENCHMARK_FV_OFFSET;
+  Benchmark->FvbInstance->NumOfBlocks = BENCHMARK_FV_NUM_BLOCKS;
+  CopyMem (&Benchmark->FvbInstance->FvbProtocol, &mFvbProtocolTemplate, sizeof (EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL));
+  FvbInitializeBlockRanges (Benchmark->FvbInstance);
+  Benchmark->Fvb = &Benchmark->FvbInstance->FvbProtocol;
+
+  Benchmark->Model        = AllocatePool (BENCHMARK_FV_SIZE);
+  Benchmark->LiveVariable = AllocateZeroPool (Benchmark->NumVariables * sizeof (UINT32));
+  UT_ASSERT_NOT_NULL (Benchmark->Model);
+  UT_ASSERT_NOT_NULL (Benchmark->LiveVariable);
+  for (Type = 0; Type < BenchmarkOpMax; Type++) {
+    Benchmark->Latency[Type] = AllocatePool (BENCHMARK_MAX_OPS_PER_TYPE * sizeof (UINT64));
+    UT_ASSERT_NOT_NULL (Benchmark->Latency[Type]);
+  }
+
+  //
+  // Program the firmware volume header into the erased firmware volume.
+  //
+  CopyMem (Benchmark->Model, Benchmark->Simulator->Flash + BENCHMARK_FV_OFFSET, BENCHMARK_FV_SIZE);
+  UT_ASSERT_EQUAL (BenchmarkErase (Benchmark, 0, BENCHMARK_FV_NUM_BLOCKS), UNIT_TEST_PASSED);
+  UT_ASSERT_EQUAL (BenchmarkWrite (Benchmark, 0, HeaderLength, (UINT8 *)FvHeader), UNIT_TEST_PASSED);
+  Benchmark->StoreEnd = BENCHMARK_VARIABLE_START;
+
+  ZeroMem (Benchmark->NumOps, sizeof (Benchmark->NumOps));
+  SpiFlashSimulatorResetStatistics (Benchmark->Simulator);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Free the resources of a benchmark.
+
+  @param[in]  Context           The benchmark descriptor.
+**/
+VOID
+EFIAPI
+BenchmarkCleanup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  BENCHMARK_CONTEXT  *Benchmark;
+  UINTN              Type;
+
+  Benchmark = &mBenchmarkContext;
+  for (Type = 0; Type < BenchmarkOpMax; Type++) {
+    if (Benchmark->Latency[Type] != NULL) {
+      FreePool (Benchmark->Latency[Type]);
+    }
+  }
+
+  if (Benchmark->LiveVariable != NULL) {
+    FreePool (Benchmark->LiveVariable);
+  }
+
+  if (Benchmark->Model != NULL) {
+    FreePool (Benchmark->Model);
+  }
+
+  if (Benchmark->FvbInstance != NULL) {
+    if (Benchmark->FvbInstance->BlockRanges != NULL) {
+      FreePool (Benchmark->FvbInstance->BlockRanges);
+    }
+
+    FreePool (Benchmark->FvbInstance);
+  }
+
+  SpiFlashSimulatorDestroy (Benchmark->Simulator);
+  mSpi2Protocol = NULL;
+  ZeroMem (Benchmark, sizeof (BENCHMARK_CONTEXT));
+}
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+RunBenchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  BENCHMARK_CONTEXT  *Benchmark;
+  UNIT_TEST_STATUS   Status;
+  UINT64             ErasedBefore;
+  UINT64             ProgrammedBefore;
+  UINT64             Erased;
+  UINT64             Programmed;
+  clock_t            HostStart;
+  UINT64             HostTime;
+
+  Benchmark = &mBenchmarkContext;
+
+  ErasedBefore     = mSpiFlashBytesErased;
+  ProgrammedBefore = mSpiFlashBytesProgrammed;
+  HostStart = clock ();
+
+  Status = Benchmark->Descriptor->Workload (Benchmark);
+
+  HostTime = (UINT64)(clock () - HostStart) * 1000000000ULL / CLOCKS_PER_SEC;
+  if (Status != UNIT_TEST_PASSED) {
+    return Status;
+  }
+
+  Erased     = mSpiFlashBytesErased - ErasedBefore;
+  Programmed = mSpiFlashBytesProgrammed - ProgrammedBefore;
+
+  //
+  // The flash content must match the model, and the workload must never have
+  // relied on programming a 1 over a 0.
+  //
+  UT_ASSERT_MEM_EQUAL (Benchmark->Simulator->Flash + BENCHMARK_FV_OFFSET, Benchmark->Model, BENCHMARK_FV_SIZE);
+  UT_ASSERT_EQUAL (Benchmark->Simulator->Statistics.ProgramViolations, 0);
+  UT_ASSERT_EQUAL (Erased, Benchmark->Simulator->Statistics.BytesErased);
+  UT_ASSERT_EQUAL (Programmed, Benchmark->Simulator->Statistics.BytesProgrammed);
+  UT_ASSERT_FALSE (Benchmark->FvbInstance->WriteSessionOpen);
+
+  BenchmarkReport (Benchmark, Erased, Programmed, HostTime);
+  return UNIT_TEST_PASSED;
+}
+
+/// === TEST ENGINE ================================================================================
+
+STATIC CONST BENCHMARK_DESCRIPTOR  mBenchmarks[] = {
+  { "SetVariable storm",                     "SpiFvb.Benchmark.SetVariableStorm",        BenchmarkSetVariableStorm, FALSE, 2000 },
+  { "SetVariable storm with write sessions", "SpiFvb.Benchmark.SetVariableStormSession", BenchmarkSetVariableStorm, TRUE,  2000 },
+  { "Boot scan",                             "SpiFvb.Benchmark.BootScan",                BenchmarkBootScan,         FALSE, 16   }
+};
+
+/**
+  SpiFvbServiceBenchmark
+
+  @retval EFI_SUCCESS     The entry point executed successfully.
+  @retval other           Some error occurred when executing this entry point.
+
+**/
+int
+main (
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework = NULL;
+  UNIT_TEST_SUITE_HANDLE      SimulatorTests;
+  UNIT_TEST_SUITE_HANDLE      BenchmarkTests;
+  UINTN                       Index;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&SimulatorTests, Framework, "SPI Flash Simulator Tests", "SpiFvb.Simulator", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for SimulatorTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    SimulatorTests,
+    "Programming should only clear bits",
+    "SpiFvb.Simulator.Program",
+    ProgramShouldOnlyClearBits,
+    NULL,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    SimulatorTests,
+    "Erase should use block commands on aligned blocks and sector commands elsewhere",
+    "SpiFvb.Simulator.Erase",
+    EraseShouldUseLargestAlignedCommands,
+    NULL,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    SimulatorTests,
+    "The image file should keep the flash content across instances",
+    "SpiFvb.Simulator.ImageFile",
+    ImageFileShouldPersistFlashContent,
+    NULL,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    SimulatorTests,
+    "SpiFlashWrite should not program bits from 0 to 1",
+    "SpiFvb.Simulator.WriteChanged",
+    WriteShouldNotSetBits,
+    NULL,
+    NULL,
+    NULL
+    );
+
+  Status = CreateUnitTestSuite (&BenchmarkTests, Framework, "SPI FVB Service Benchmarks", "SpiFvb.Benchmark", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for BenchmarkTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  for (Index = 0; Index < ARRAY_SIZE (mBenchmarks); Index++) {
+    AddTestCase (
+      BenchmarkTests,
+      (CHAR8 *)mBenchmarks[Index].Name,
+      (CHAR8 *)mBenchmarks[Index].ClassName,
+      RunBenchmark,
+      BenchmarkSetup,
+      BenchmarkCleanup,
+      (UNIT_TEST_CONTEXT)&mBenchmarks[Index]
+      );
+  }
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
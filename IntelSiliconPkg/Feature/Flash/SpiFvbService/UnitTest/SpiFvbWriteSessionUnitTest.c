@@ -0,0 +1,336 @@
+/** @file
+  Host-based unit test of the SPI FVB write sessions on a simulated SPI flash
+  device.
+
+  Copyright (c) Microsoft Corporation.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "../SpiFvbServiceCommon.h"
+#include <Library/UnitTestLib.h>
+
+#include "SpiFlashSimulator.h"
+
+#ifndef INTERNAL_UNIT_TEST
+  #error Make sure to build this with INTERNAL_UNIT_TEST enabled! Otherwise, some important tests may be skipped!
+#endif
+
+#define UNIT_TEST_NAME     "SPI FVB Write Session UnitTest"
+#define UNIT_TEST_VERSION  "0.1"
+
+//
+// Simulated device: 1MB, 4KB sectors, 64KB blocks, 256 bytes program pages.
+// Firmware volume: 16 blocks of 4KB.
+//
+#define TEST_FLASH_SIZE      SIZE_1MB
+#define TEST_FV_OFFSET       0x80000
+#define TEST_FV_BLOCK_SIZE   SIZE_4KB
+#define TEST_FV_NUM_BLOCKS   16
+#define TEST_FV_SIZE         (TEST_FV_NUM_BLOCKS * TEST_FV_BLOCK_SIZE)
+#define TEST_WRITE_LBA       4
+#define TEST_WRITE_OFFSET    0xF00
+#define TEST_WRITE_SIZE      0x200
+
+extern PCH_SPI2_PROTOCOL  *mSpi2Protocol;
+
+extern UINTN  mBiosAreaBaseAddress;
+extern UINTN  mBiosSize;
+extern UINTN  mBiosOffset;
+
+STATIC SPI_FLASH_SIMULATOR  *mSimulator;
+STATIC EFI_FVB_INSTANCE     *mFvbInstance;
+
+STATIC CONST SPI_FLASH_SIMULATOR_CONFIG  mTestFlashConfig = {
+  TEST_FLASH_SIZE,
+  SIZE_4KB,
+  SIZE_64KB,
+  0x100,
+  SPI_FLASH_SIMULATOR_DEFAULT_SECTOR_ERASE_TIME,
+  SPI_FLASH_SIMULATOR_DEFAULT_BLOCK_ERASE_TIME,
+  SPI_FLASH_SIMULATOR_DEFAULT_PAGE_PROGRAM_TIME,
+  SPI_FLASH_SIMULATOR_DEFAULT_COMMAND_TIME,
+  SPI_FLASH_SIMULATOR_DEFAULT_MAPPED_READ_TIME,
+  NULL
+};
+
+/// === HELPER FUNCTIONS ===========================================================================
+
+/**
+  Create the simulated device and the FVB instance of an erased firmware volume.
+
+  @param[in]  Context           Not used.
+
+  @retval UNIT_TEST_PASSED      The FVB instance is ready.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+WriteSessionSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_FIRMWARE_VOLUME_HEADER  *FvHeader;
+
+  UT_ASSERT_NOT_EFI_ERROR (SpiFlashSimulatorCreate (&mTestFlashConfig, &mSimulator));
+  mSpi2Protocol        = &mSimulator->Protocol;
+  mBiosAreaBaseAddress = (UINTN)mSimulator->Flash;
+  mBiosSize            = TEST_FLASH_SIZE;
+  mBiosOffset          = 0;
+
+  //
+  // Firmware volume header with a single block map entry and its terminator.
+  //
+  mFvbInstance = AllocateZeroPool (sizeof (EFI_FVB_INSTANCE) + sizeof (EFI_FV_BLOCK_MAP_ENTRY));
+  UT_ASSERT_NOT_NULL (mFvbInstance);
+
+  FvHeader = &mFvbInstance->FvHeader;
+  CopyGuid (&FvHeader->FileSystemGuid, &gEfiSystemNvDataFvGuid);
+  FvHeader->FvLength              = TEST_FV_SIZE;
+  FvHeader->Signature             = EFI_FVH_SIGNATURE;
+  FvHeader->Attributes            = EFI_FVB2_READ_ENABLED_CAP | EFI_FVB2_READ_STATUS |
+                                    EFI_FVB2_WRITE_ENABLED_CAP | EFI_FVB2_WRITE_STATUS |
+                                    EFI_FVB2_ERASE_POLARITY | EFI_FVB2_MEMORY_MAPPED;
+  FvHeader->HeaderLength          = (UINT16)(sizeof (EFI_FIRMWARE_VOLUME_HEADER) + sizeof (EFI_FV_BLOCK_MAP_ENTRY));
+  FvHeader->Revision              = EFI_FVH_REVISION;
+  FvHeader->BlockMap[0].NumBlocks = TEST_FV_NUM_BLOCKS;
+  FvHeader->BlockMap[0].Length    = TEST_FV_BLOCK_SIZE;
+
+  mFvbInstance->Signature   = FVB_INSTANCE_SIGNATURE;
+  mFvbInstance->FvBase      = mBiosAreaBaseAddress + TEST_FV_OFFSET;
+  mFvbInstance->NumOfBlocks = TEST_FV_NUM_BLOCKS;
+  CopyMem (&mFvbInstance->FvbProtocol, &mFvbProtocolTemplate, sizeof (EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL));
+  FvbInitializeBlockRanges (mFvbInstance);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Free the simulated device and the FVB instance.
+
+  @param[in]  Context           Not used.
+**/
+VOID
+EFIAPI
+WriteSessionCleanup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  if (mFvbInstance != NULL) {
+    if (mFvbInstance->BlockRanges != NULL) {
+      FreePool (mFvbInstance->BlockRanges);
+    }
+
+    FreePool (mFvbInstance);
+    mFvbInstance = NULL;
+  }
+
+  SpiFlashSimulatorDestroy (mSimulator);
+  mSimulator    = NULL;
+  mSpi2Protocol = NULL;
+}
+
+/// === TEST CASES =================================================================================
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+SessionShouldDeferAndCommitWrites (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Fvb;
+  UINT8                               Data[TEST_WRITE_SIZE];
+  UINT8                               Buffer[TEST_WRITE_SIZE];
+  UINTN                               NumBytes;
+  UINTN                               DirtyStart;
+  UINTN                               DirtyEnd;
+
+  Fvb = &mFvbInstance->FvbProtocol;
+
+  UT_ASSERT_NOT_EFI_ERROR (FvbBeginWriteSession (mFvbInstance));
+  UT_ASSERT_STATUS_EQUAL (FvbBeginWriteSession (mFvbInstance), EFI_ALREADY_STARTED);
+  UT_ASSERT_TRUE (mFvbInstance->WriteSessionOpen);
+
+  //
+  // Write the end of one block and the start of the next one. The cache
+  // invalidation is deferred, so the written range is recorded as dirty.
+  //
+  SetMem (Data, sizeof (Data), 0x5A);
+  NumBytes = TEST_FV_BLOCK_SIZE - TEST_WRITE_OFFSET;
+  UT_ASSERT_NOT_EFI_ERROR (Fvb->Write (Fvb, TEST_WRITE_LBA, TEST_WRITE_OFFSET, &NumBytes, Data));
+  UT_ASSERT_EQUAL (NumBytes, TEST_FV_BLOCK_SIZE - TEST_WRITE_OFFSET);
+  NumBytes = TEST_WRITE_SIZE - (TEST_FV_BLOCK_SIZE - TEST_WRITE_OFFSET);
+  UT_ASSERT_NOT_EFI_ERROR (Fvb->Write (Fvb, TEST_WRITE_LBA + 1, 0, &NumBytes, Data));
+
+  DirtyStart = mFvbInstance->FvBase + TEST_WRITE_LBA * TEST_FV_BLOCK_SIZE + TEST_WRITE_OFFSET;
+  DirtyEnd   = DirtyStart + TEST_WRITE_SIZE;
+  UT_ASSERT_EQUAL (mFvbInstance->DirtyStart, DirtyStart);
+  UT_ASSERT_EQUAL (mFvbInstance->DirtyEnd, DirtyEnd);
+
+  //
+  // A read outside of the dirty range keeps it dirty.
+  //
+  NumBytes = sizeof (Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Fvb->Read (Fvb, 0, 0, &NumBytes, Buffer));
+  UT_ASSERT_EQUAL (mFvbInstance->DirtyEnd, DirtyEnd);
+
+  //
+  // A read reduced to zero bytes at the end of a block does not overlap the
+  // dirty range, even if the range starts right after the block.
+  //
+  NumBytes = sizeof (Buffer);
+  UT_ASSERT_STATUS_EQUAL (Fvb->Read (Fvb, TEST_WRITE_LBA, TEST_FV_BLOCK_SIZE, &NumBytes, Buffer), EFI_BAD_BUFFER_SIZE);
+  UT_ASSERT_EQUAL (NumBytes, 0);
+  UT_ASSERT_EQUAL (mFvbInstance->DirtyStart, DirtyStart);
+  UT_ASSERT_EQUAL (mFvbInstance->DirtyEnd, DirtyEnd);
+
+  //
+  // A read of the dirty overlap returns the new data and flushes the dirty range.
+  //
+  NumBytes = TEST_FV_BLOCK_SIZE - TEST_WRITE_OFFSET;
+  UT_ASSERT_NOT_EFI_ERROR (Fvb->Read (Fvb, TEST_WRITE_LBA, TEST_WRITE_OFFSET, &NumBytes, Buffer));
+  UT_ASSERT_EQUAL (NumBytes, TEST_FV_BLOCK_SIZE - TEST_WRITE_OFFSET);
+  UT_ASSERT_MEM_EQUAL (Buffer, Data, NumBytes);
+  UT_ASSERT_EQUAL (mFvbInstance->DirtyStart, mFvbInstance->DirtyEnd);
+  UT_ASSERT_TRUE (mFvbInstance->WriteSessionOpen);
+
+  UT_ASSERT_NOT_EFI_ERROR (FvbCommitWriteSession (mFvbInstance));
+  UT_ASSERT_FALSE (mFvbInstance->WriteSessionOpen);
+  UT_ASSERT_STATUS_EQUAL (FvbCommitWriteSession (mFvbInstance), EFI_NOT_STARTED);
+
+  //
+  // The data is in flash, and writes after the commit are completed at once.
+  //
+  UT_ASSERT_MEM_EQUAL (mSimulator->Flash + TEST_FV_OFFSET + TEST_WRITE_LBA * TEST_FV_BLOCK_SIZE + TEST_WRITE_OFFSET, Data, TEST_WRITE_SIZE);
+  UT_ASSERT_EQUAL (mSimulator->Statistics.ProgramViolations, 0);
+
+  NumBytes = sizeof (Data);
+  UT_ASSERT_NOT_EFI_ERROR (Fvb->Write (Fvb, TEST_WRITE_LBA + 2, 0, &NumBytes, Data));
+  UT_ASSERT_EQUAL (mFvbInstance->DirtyStart, mFvbInstance->DirtyEnd);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+SessionShouldRecordErasedBlocks (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Fvb;
+  UINT8                               Data[TEST_WRITE_SIZE];
+  UINTN                               NumBytes;
+  UINTN                               Lba;
+
+  Fvb = &mFvbInstance->FvbProtocol;
+
+  SetMem (Data, sizeof (Data), 0);
+  for (Lba = TEST_WRITE_LBA; Lba < TEST_WRITE_LBA + 5; Lba++) {
+    NumBytes = sizeof (Data);
+    UT_ASSERT_NOT_EFI_ERROR (Fvb->Write (Fvb, Lba, 0, &NumBytes, Data));
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (FvbBeginWriteSession (mFvbInstance));
+  UT_ASSERT_NOT_EFI_ERROR (Fvb->EraseBlocks (Fvb, (EFI_LBA)TEST_WRITE_LBA, (UINTN)2, EFI_LBA_LIST_TERMINATOR));
+  UT_ASSERT_TRUE (mFvbInstance->WriteSessionOpen);
+  UT_ASSERT_EQUAL (mFvbInstance->DirtyStart, mFvbInstance->FvBase + TEST_WRITE_LBA * TEST_FV_BLOCK_SIZE);
+  UT_ASSERT_EQUAL (mFvbInstance->DirtyEnd, mFvbInstance->FvBase + (TEST_WRITE_LBA + 2) * TEST_FV_BLOCK_SIZE);
+  UT_ASSERT_NOT_EFI_ERROR (FvbCommitWriteSession (mFvbInstance));
+  UT_ASSERT_EQUAL (mSimulator->Flash[TEST_FV_OFFSET + TEST_WRITE_LBA * TEST_FV_BLOCK_SIZE], 0xFF);
+  UT_ASSERT_EQUAL (mFvbInstance->DirtyStart, mFvbInstance->DirtyEnd);
+
+  //
+  // Without an open session, EraseBlocks () erases the spans of its list in a
+  // session of its own, committed before it returns.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (
+    Fvb->EraseBlocks (
+           Fvb,
+           (EFI_LBA)TEST_WRITE_LBA + 2,
+           (UINTN)1,
+           (EFI_LBA)TEST_WRITE_LBA + 4,
+           (UINTN)1,
+           EFI_LBA_LIST_TERMINATOR
+           )
+    );
+  UT_ASSERT_FALSE (mFvbInstance->WriteSessionOpen);
+  UT_ASSERT_EQUAL (mFvbInstance->DirtyStart, mFvbInstance->DirtyEnd);
+  UT_ASSERT_EQUAL (mSimulator->Flash[TEST_FV_OFFSET + (TEST_WRITE_LBA + 2) * TEST_FV_BLOCK_SIZE], 0xFF);
+  UT_ASSERT_EQUAL (mSimulator->Flash[TEST_FV_OFFSET + (TEST_WRITE_LBA + 3) * TEST_FV_BLOCK_SIZE], 0x00);
+  UT_ASSERT_EQUAL (mSimulator->Flash[TEST_FV_OFFSET + (TEST_WRITE_LBA + 4) * TEST_FV_BLOCK_SIZE], 0xFF);
+
+  return UNIT_TEST_PASSED;
+}
+
+/// === TEST ENGINE ================================================================================
+
+/**
+  SpiFvbWriteSessionUnitTest
+
+  @retval EFI_SUCCESS     The entry point executed successfully.
+  @retval other           Some error occurred when executing this entry point.
+
+**/
+int
+main (
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework = NULL;
+  UNIT_TEST_SUITE_HANDLE      SessionTests;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&SessionTests, Framework, "SPI FVB Write Session Tests", "SpiFvb.WriteSession", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for SessionTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    SessionTests,
+    "A write session should defer the cache flush of writes to the commit",
+    "SpiFvb.WriteSession.Write",
+    SessionShouldDeferAndCommitWrites,
+    WriteSessionSetup,
+    WriteSessionCleanup,
+    NULL
+    );
+  AddTestCase (
+    SessionTests,
+    "A write session should record the erased blocks as dirty",
+    "SpiFvb.WriteSession.Erase",
+    SessionShouldRecordErasedBlocks,
+    WriteSessionSetup,
+    WriteSessionCleanup,
+    NULL
+    );
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
@@ -0,0 +1,59 @@
+/** @file
+  Microcode shadow cache library NULL instance.
+
+  Copyright (c) 2021, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiPei.h>
+
+#include <Library/MicrocodeShadowCacheLib.h>
+
+/**
+  Restore the microcode shadow cache record saved to the LockBox in a previous boot.
+
+  @param[out] CacheRecord          Pointer to receive the microcode shadow cache record.
+
+  @retval EFI_UNSUPPORTED          The microcode shadow cache is not supported.
+**/
+EFI_STATUS
+EFIAPI
+MicrocodeShadowCacheRestoreRecord (
+  OUT EDKII_MICROCODE_SHADOW_CACHE_RECORD  *CacheRecord
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  Compute the digests of the microcode shadow cache content into its record.
+
+  @param[in, out] CacheRecord      The microcode shadow cache record.
+
+  @retval EFI_UNSUPPORTED          The microcode shadow cache is not supported.
+**/
+EFI_STATUS
+EFIAPI
+MicrocodeShadowCacheComputeDigests (
+  IN OUT EDKII_MICROCODE_SHADOW_CACHE_RECORD  *CacheRecord
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  Check that the microcode shadow cache content matches the digests of its record.
+
+  @param[in]  CacheRecord          The microcode shadow cache record.
+
+  @retval EFI_UNSUPPORTED          The microcode shadow cache is not supported.
+**/
+EFI_STATUS
+EFIAPI
+MicrocodeShadowCacheVerifyDigests (
+  IN CONST EDKII_MICROCODE_SHADOW_CACHE_RECORD  *CacheRecord
+  )
+{
+  return EFI_UNSUPPORTED;
+}
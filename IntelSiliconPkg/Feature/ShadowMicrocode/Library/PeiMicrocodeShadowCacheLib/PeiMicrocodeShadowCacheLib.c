@@ -0,0 +1,102 @@
+/** @file
+  Microcode shadow cache library PEI instance.
+
+  The record is restored from the LockBox, which the OS cannot modify, and the
+  content of the cache is checked against its SHA-256 digests.
+
+  Copyright (c) 2021, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiPei.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/BaseCryptLib.h>
+#include <Library/LockBoxLib.h>
+#include <Library/MicrocodeShadowCacheLib.h>
+
+/**
+  Restore the microcode shadow cache record saved to the LockBox in a previous boot.
+
+  @param[out] CacheRecord          Pointer to receive the microcode shadow cache record.
+
+  @retval EFI_SUCCESS              The record is restored.
+  @retval EFI_NOT_FOUND            No microcode shadow cache record is saved.
+**/
+EFI_STATUS
+EFIAPI
+MicrocodeShadowCacheRestoreRecord (
+  OUT EDKII_MICROCODE_SHADOW_CACHE_RECORD  *CacheRecord
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Size;
+
+  Size   = sizeof (*CacheRecord);
+  Status = RestoreLockBox (&gEdkiiMicrocodeShadowCacheGuid, CacheRecord, &Size);
+  if (EFI_ERROR (Status) || (Size != sizeof (*CacheRecord))) {
+    return EFI_NOT_FOUND;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Compute the digests of the microcode shadow cache content into its record.
+
+  The PatchDataSize and HobDataLength bytes of the content at CacheAddress are
+  hashed into PatchDataHash and HobDataHash.
+
+  @param[in, out] CacheRecord      The microcode shadow cache record.
+
+  @retval EFI_SUCCESS              The digests are computed.
+  @retval EFI_DEVICE_ERROR         The digests cannot be computed.
+**/
+EFI_STATUS
+EFIAPI
+MicrocodeShadowCacheComputeDigests (
+  IN OUT EDKII_MICROCODE_SHADOW_CACHE_RECORD  *CacheRecord
+  )
+{
+  UINT8  *PatchData;
+
+  PatchData = (UINT8 *)(UINTN)CacheRecord->CacheAddress;
+  if (!Sha256HashAll (PatchData, (UINTN)CacheRecord->PatchDataSize, CacheRecord->PatchDataHash) ||
+      !Sha256HashAll (PatchData + ALIGN_VALUE (CacheRecord->PatchDataSize, 8), (UINTN)CacheRecord->HobDataLength, CacheRecord->HobDataHash))
+  {
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Check that the microcode shadow cache content matches the digests of its record.
+
+  @param[in]  CacheRecord          The microcode shadow cache record.
+
+  @retval EFI_SUCCESS              The content matches the digests.
+  @retval EFI_VOLUME_CORRUPTED     The content does not match the digests.
+**/
+EFI_STATUS
+EFIAPI
+MicrocodeShadowCacheVerifyDigests (
+  IN CONST EDKII_MICROCODE_SHADOW_CACHE_RECORD  *CacheRecord
+  )
+{
+  UINT8  *PatchData;
+  UINT8  Digest[SHA256_DIGEST_SIZE];
+
+  PatchData = (UINT8 *)(UINTN)CacheRecord->CacheAddress;
+  if (!Sha256HashAll (PatchData + ALIGN_VALUE (CacheRecord->PatchDataSize, 8), (UINTN)CacheRecord->HobDataLength, Digest) ||
+      (CompareMem (Digest, CacheRecord->HobDataHash, sizeof (Digest)) != 0) ||
+      !Sha256HashAll (PatchData, (UINTN)CacheRecord->PatchDataSize, Digest) ||
+      (CompareMem (Digest, CacheRecord->PatchDataHash, sizeof (Digest)) != 0))
+  {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  return EFI_SUCCESS;
+}
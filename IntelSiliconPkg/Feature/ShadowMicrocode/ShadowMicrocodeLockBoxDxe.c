@@ -0,0 +1,94 @@
+/** @file
+  Save the microcode shadow cache record to the LockBox.
+
+  The shadow microcode PEIM publishes the record of the microcode patches kept in
+  reserved memory in a GUIDed HOB. PEI cannot save to the LockBox, so this driver
+  saves the record, and the S3 resume path restores it to reuse the patches.
+
+Copyright (c) 2021, Intel Corporation. All rights reserved.<BR>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiDxe.h>
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HobLib.h>
+#include <Library/LockBoxLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Guid/EventGroup.h>
+#include <Guid/MicrocodeShadowCache.h>
+
+/**
+  Save the microcode shadow cache record to the LockBox at the end of DXE, which
+  is before the LockBox is locked.
+
+  @param[in]  Event    The event handle.
+  @param[in]  Context  The event content.
+**/
+VOID
+EFIAPI
+OnEndOfDxe (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  EFI_STATUS         Status;
+  EFI_HOB_GUID_TYPE  *GuidHob;
+
+  gBS->CloseEvent (Event);
+
+  GuidHob = GetFirstGuidHob (&gEdkiiMicrocodeShadowCacheGuid);
+  if ((GuidHob == NULL) || (GET_GUID_HOB_DATA_SIZE (GuidHob) != sizeof (EDKII_MICROCODE_SHADOW_CACHE_RECORD))) {
+    DEBUG ((DEBUG_INFO, "%a: No microcode shadow cache record.\n", __FUNCTION__));
+    return;
+  }
+
+  Status = SaveLockBox (
+             &gEdkiiMicrocodeShadowCacheGuid,
+             GET_GUID_HOB_DATA (GuidHob),
+             sizeof (EDKII_MICROCODE_SHADOW_CACHE_RECORD)
+             );
+  if (Status == EFI_ALREADY_STARTED) {
+    Status = UpdateLockBox (
+               &gEdkiiMicrocodeShadowCacheGuid,
+               0,
+               GET_GUID_HOB_DATA (GuidHob),
+               sizeof (EDKII_MICROCODE_SHADOW_CACHE_RECORD)
+               );
+  }
+
+  DEBUG ((DEBUG_INFO, "%a: Save the microcode shadow cache record - %r\n", __FUNCTION__, Status));
+}
+
+/**
+  The entry point of the driver.
+
+  @param[in]  ImageHandle          The firmware allocated handle for the EFI image.
+  @param[in]  SystemTable          A pointer to the EFI System Table.
+
+  @retval EFI_SUCCESS              The End of DXE callback is registered.
+  @retval other                    Some error occurs when registering the callback.
+**/
+EFI_STATUS
+EFIAPI
+ShadowMicrocodeLockBoxDxeEntryPoint (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS  Status;
+  EFI_EVENT   EndOfDxeEvent;
+
+  Status = gBS->CreateEventEx (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  OnEndOfDxe,
+                  NULL,
+                  &gEfiEndOfDxeEventGroupGuid,
+                  &EndOfDxeEvent
+                  );
+  ASSERT_EFI_ERROR (Status);
+
+  return Status;
+}
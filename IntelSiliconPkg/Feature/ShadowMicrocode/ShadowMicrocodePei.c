@@ -14,10 +14,13 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/MicrocodeLib.h>
+#include <Library/MicrocodeShadowCacheLib.h>
+#include <Library/BaseLib.h>
 #include <IndustryStandard/FirmwareInterfaceTable.h>
 #include <Register/Intel/Microcode.h>
 #include <Register/Intel/Cpuid.h>
 #include <Guid/MicrocodeShadowInfoHob.h>
+
 //
 // Data structure for microcode patch information
 //
@@ -69,9 +72,164 @@ EFI_PEI_PPI_DESCRIPTOR  mPeiShadowMicrocodePpiList[] = {
   }
 };
 
+/**
+  Compute the hash that identifies a set of shadowed microcode patches.
+
+  The hash covers the FIT table, the processor signature list and the header
+  of every selected patch, so it changes when a patch is added, removed, moved
+  or updated in flash. Only the headers are read from flash.
+
+  @param[in]  FitEntry             Pointer to the FIT table.
+  @param[in]  EntryNum             Number of entries in the FIT table.
+  @param[in]  MicrocodeCpuId       A pointer to an array of EDKII_PEI_MICROCODE_CPU_ID
+                                   structures.
+  @param[in]  CpuIdCount           Number of elements in MicrocodeCpuId array.
+  @param[in]  Patches              The selected microcode patches.
+  @param[in]  PatchCount           The number of selected microcode patches.
+  @param[out] KeyHash              Pointer to receive the hash.
+
+  @retval EFI_SUCCESS              The hash has been computed.
+  @retval EFI_OUT_OF_RESOURCES     The operation fails due to lack of resources.
+**/
+STATIC
+EFI_STATUS
+GetMicrocodeShadowKeyHash (
+  IN  FIRMWARE_INTERFACE_TABLE_ENTRY  *FitEntry,
+  IN  UINT32                          EntryNum,
+  IN  EDKII_PEI_MICROCODE_CPU_ID      *MicrocodeCpuId,
+  IN  UINTN                           CpuIdCount,
+  IN  MICROCODE_PATCH_INFO            *Patches,
+  IN  UINTN                           PatchCount,
+  OUT UINT32                          *KeyHash
+  )
+{
+  UINT32  *Hashes;
+  UINTN   Index;
+
+  Hashes = AllocatePool ((PatchCount + 2) * sizeof (UINT32));
+  if (Hashes == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Hashes[0] = CalculateCrc32 (FitEntry, sizeof (FIRMWARE_INTERFACE_TABLE_ENTRY) * EntryNum);
+  Hashes[1] = 0;
+  if (CpuIdCount != 0) {
+    Hashes[1] = CalculateCrc32 (MicrocodeCpuId, sizeof (EDKII_PEI_MICROCODE_CPU_ID) * CpuIdCount);
+  }
+
+  for (Index = 0; Index < PatchCount; Index++) {
+    Hashes[Index + 2] = CalculateCrc32 ((VOID *)Patches[Index].Address, sizeof (CPU_MICROCODE_HEADER));
+  }
+
+  *KeyHash = CalculateCrc32 (Hashes, (PatchCount + 2) * sizeof (UINT32));
+  FreePool (Hashes);
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the record of the microcode patches shadowed in a previous boot.
+
+  The record is restored by the MicrocodeShadowCacheLib. Only its layout is
+  checked here, the content of the cache is not.
+
+  @param[out] CacheRecord          Pointer to receive the microcode shadow cache record.
+
+  @retval EFI_SUCCESS              The record is restored.
+  @retval EFI_NOT_FOUND            No valid microcode shadow cache record is found.
+**/
+STATIC
+EFI_STATUS
+GetMicrocodeShadowCacheRecord (
+  OUT EDKII_MICROCODE_SHADOW_CACHE_RECORD  *CacheRecord
+  )
+{
+  if (EFI_ERROR (MicrocodeShadowCacheRestoreRecord (CacheRecord))) {
+    return EFI_NOT_FOUND;
+  }
+
+  if ((CacheRecord->CacheAddress == 0) ||
+      (CacheRecord->CacheSize > MAX_ADDRESS - CacheRecord->CacheAddress) ||
+      (CacheRecord->CacheSize < sizeof (EDKII_MICROCODE_SHADOW_INFO_HOB) + 8) ||
+      (CacheRecord->PatchDataSize > CacheRecord->CacheSize - sizeof (EDKII_MICROCODE_SHADOW_INFO_HOB) - 8) ||
+      (CacheRecord->HobDataLength < sizeof (EDKII_MICROCODE_SHADOW_INFO_HOB)) ||
+      (CacheRecord->HobDataLength > CacheRecord->CacheSize - ALIGN_VALUE (CacheRecord->PatchDataSize, 8)))
+  {
+    DEBUG ((DEBUG_ERROR, "%a: Invalid microcode shadow cache record.\n", __FUNCTION__));
+    return EFI_NOT_FOUND;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Reuse the microcode patches shadowed in a previous boot.
+
+  The cache is reused only when it was built from the same FIT microcode entries
+  and its content matches the SHA-256 digests of the record, in which case the
+  microcode shadow info HOB is rebuilt from the cached data.
+
+  @param[in]  CacheRecord          The microcode shadow cache record.
+  @param[in]  KeyHash              The hash of the microcode patches to shadow.
+  @param[out] BufferSize           Pointer to receive the total size of Buffer.
+  @param[out] Buffer               Pointer to receive address of the cached
+                                   microcode patches.
+
+  @retval EFI_SUCCESS              The cached microcode patches are reused.
+  @retval EFI_NOT_FOUND            The cache was built from different microcode patches.
+  @retval EFI_VOLUME_CORRUPTED     The content of the cache is corrupted.
+**/
+STATIC
+EFI_STATUS
+ReuseMicrocodeShadowCache (
+  IN  EDKII_MICROCODE_SHADOW_CACHE_RECORD  *CacheRecord,
+  IN  UINT32                               KeyHash,
+  OUT UINTN                                *BufferSize,
+  OUT VOID                                 **Buffer
+  )
+{
+  UINT8                            *PatchData;
+  EDKII_MICROCODE_SHADOW_INFO_HOB  *MicrocodeShadowHob;
+
+  if (CacheRecord->KeyHash != KeyHash) {
+    DEBUG ((DEBUG_INFO, "%a: FIT microcode patches changed, shadow them again.\n", __FUNCTION__));
+    return EFI_NOT_FOUND;
+  }
+
+  if (EFI_ERROR (MicrocodeShadowCacheVerifyDigests (CacheRecord))) {
+    DEBUG ((DEBUG_ERROR, "%a: Microcode shadow cache is corrupted.\n", __FUNCTION__));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  PatchData          = (UINT8 *)(UINTN)CacheRecord->CacheAddress;
+  MicrocodeShadowHob = (EDKII_MICROCODE_SHADOW_INFO_HOB *)(PatchData + ALIGN_VALUE (CacheRecord->PatchDataSize, 8));
+
+  BuildGuidDataHob (
+    &gEdkiiMicrocodeShadowInfoHobGuid,
+    MicrocodeShadowHob,
+    (UINTN)CacheRecord->HobDataLength
+    );
+
+  *Buffer     = PatchData;
+  *BufferSize = (UINTN)CacheRecord->PatchDataSize;
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: Reuse the microcode patches shadowed at 0x%lx, with size 0x%lx.\n",
+    __FUNCTION__,
+    *Buffer,
+    *BufferSize
+    ));
+
+  return EFI_SUCCESS;
+}
+
 /**
   Actual worker function that shadows the required microcode patches into memory.
 
+  Every patch is read from flash only once: it is copied into memory first and
+  the copy is validated, including the checksum. Patches failing the validation
+  are dropped from the shadowed set.
+
   @param[in]       Patches          The pointer to an array of information on
                                     the microcode patches that will be loaded
                                     into memory.
@@ -79,66 +237,132 @@ EFI_PEI_PPI_DESCRIPTOR  mPeiShadowMicrocodePpiList[] = {
                                     be loaded into memory.
   @param[in]       TotalLoadSize    The total size of all the microcode patches
                                     to be loaded.
+  @param[in]       MicrocodeCpuId   A pointer to an array of EDKII_PEI_MICROCODE_CPU_ID
+                                    structures.
+  @param[in]       CpuIdCount       Number of elements in MicrocodeCpuId array.
+  @param[in]       KeyHash          The hash of the microcode patches to save in the
+                                    microcode shadow cache, or NULL if the shadowed
+                                    patches are not kept for S3 resume.
+  @param[in]       CacheRecord      The record of the microcode shadow cache of a
+                                    previous boot, whose memory is reused if it is
+                                    large enough, or NULL.
   @param[out] BufferSize            Pointer to receive the total size of Buffer.
   @param[out] Buffer                Pointer to receive address of allocated memory
                                     with microcode patches data in it.
+
+  @retval EFI_SUCCESS               The microcode has been shadowed to memory.
+  @retval EFI_NOT_FOUND             No valid microcode found.
+  @retval EFI_OUT_OF_RESOURCES      The operation fails due to lack of resources.
 **/
-VOID
+EFI_STATUS
 ShadowMicrocodePatchWorker (
-  IN  MICROCODE_PATCH_INFO  *Patches,
-  IN  UINTN                 PatchCount,
-  IN  UINTN                 TotalLoadSize,
-  OUT UINTN                 *BufferSize,
-  OUT VOID                  **Buffer
+  IN  MICROCODE_PATCH_INFO                 *Patches,
+  IN  UINTN                                PatchCount,
+  IN  UINTN                                TotalLoadSize,
+  IN  EDKII_PEI_MICROCODE_CPU_ID           *MicrocodeCpuId,
+  IN  UINTN                                CpuIdCount,
+  IN  UINT32                               *KeyHash OPTIONAL,
+  IN  EDKII_MICROCODE_SHADOW_CACHE_RECORD  *CacheRecord OPTIONAL,
+  OUT UINTN                                *BufferSize,
+  OUT VOID                                 **Buffer
   )
 {
   UINTN                                     Index;
+  UINTN                                     ValidCount;
   VOID                                      *MicrocodePatchInRam;
   UINT8                                     *Walker;
+  UINTN                                     ShadowedSize;
   EDKII_MICROCODE_SHADOW_INFO_HOB           *MicrocodeShadowHob;
   UINTN                                     HobDataLength;
   UINT64                                    *MicrocodeAddressInMemory;
   EFI_MICROCODE_STORAGE_TYPE_FLASH_CONTEXT  *Flashcontext;
+  UINTN                                     CacheSize;
+  UINTN                                     Pages;
+  EDKII_MICROCODE_SHADOW_CACHE_RECORD       Record;
 
   ASSERT ((Patches != NULL) && (PatchCount != 0));
 
   //
-  // Init microcode shadow info HOB content.
+  // Allocate memory for microcode shadow operation. When the shadowed patches are
+  // kept for S3 resume, the HOB data follows the patches in reserved memory. The
+  // memory recorded by a previous boot is reused, so that a failed restore on S3
+  // resume does not allocate reserved memory again.
   //
-  HobDataLength = sizeof (EDKII_MICROCODE_SHADOW_INFO_HOB) +
-                  sizeof (UINT64) * PatchCount * 2;
-  MicrocodeShadowHob = AllocatePool (HobDataLength);
-  if (MicrocodeShadowHob == NULL) {
-    ASSERT (FALSE);
-    return;
+  CacheSize = ALIGN_VALUE (TotalLoadSize, 8) +
+              sizeof (EDKII_MICROCODE_SHADOW_INFO_HOB) +
+              sizeof (UINT64) * PatchCount * 2;
+  Pages = 0;
+  if ((CacheRecord != NULL) && (CacheRecord->CacheSize >= CacheSize)) {
+    MicrocodePatchInRam = (VOID *)(UINTN)CacheRecord->CacheAddress;
+    CacheSize           = (UINTN)CacheRecord->CacheSize;
+  } else if ((KeyHash != NULL) && (CacheRecord == NULL)) {
+    Pages               = EFI_SIZE_TO_PAGES (CacheSize);
+    MicrocodePatchInRam = AllocateReservedPages (Pages);
+  } else {
+    CacheSize           = 0;
+    Pages               = EFI_SIZE_TO_PAGES (TotalLoadSize);
+    MicrocodePatchInRam = AllocatePages (Pages);
   }
 
-  MicrocodeShadowHob->MicrocodeCount = PatchCount;
-  CopyGuid (
-    &MicrocodeShadowHob->StorageType,
-    &gEdkiiMicrocodeStorageTypeFlashGuid
-    );
-  MicrocodeAddressInMemory = (UINT64 *)(MicrocodeShadowHob + 1);
-  Flashcontext             = (EFI_MICROCODE_STORAGE_TYPE_FLASH_CONTEXT *)(MicrocodeAddressInMemory + PatchCount);
-
-  //
-  // Allocate memory for microcode shadow operation.
-  //
-  MicrocodePatchInRam = AllocatePages (EFI_SIZE_TO_PAGES (TotalLoadSize));
   if (MicrocodePatchInRam == NULL) {
-    ASSERT (FALSE);
-    return;
+    return EFI_OUT_OF_RESOURCES;
   }
 
   //
-  // Shadow all the required microcode patches into memory
+  // Shadow all the required microcode patches into memory, reading each of them
+  // from flash once, and validate the copy in memory. An invalid patch is dropped
+  // by overwriting it with the next one.
   //
+  ValidCount = 0;
   for (Walker = MicrocodePatchInRam, Index = 0; Index < PatchCount; Index++) {
     CopyMem (
       Walker,
       (VOID *)Patches[Index].Address,
       Patches[Index].Size
       );
+    if (!IsValidMicrocode ((CPU_MICROCODE_HEADER *)Walker, Patches[Index].Size, 0, MicrocodeCpuId, CpuIdCount, TRUE)) {
+      DEBUG ((DEBUG_ERROR, "%a: Microcode patch at 0x%lx is invalid, skip it.\n", __FUNCTION__, (UINT64)Patches[Index].Address));
+      continue;
+    }
+
+    Patches[ValidCount++] = Patches[Index];
+    Walker               += Patches[Index].Size;
+  }
+
+  ShadowedSize = (UINTN)(Walker - (UINT8 *)MicrocodePatchInRam);
+
+  if (ValidCount == 0) {
+    if (Pages != 0) {
+      FreePages (MicrocodePatchInRam, Pages);
+    }
+
+    return EFI_NOT_FOUND;
+  }
+
+  //
+  // Init microcode shadow info HOB content.
+  //
+  HobDataLength = sizeof (EDKII_MICROCODE_SHADOW_INFO_HOB) +
+                  sizeof (UINT64) * ValidCount * 2;
+  if (CacheSize != 0) {
+    MicrocodeShadowHob = (EDKII_MICROCODE_SHADOW_INFO_HOB *)((UINT8 *)MicrocodePatchInRam + ALIGN_VALUE (ShadowedSize, 8));
+  } else {
+    MicrocodeShadowHob = AllocatePool (HobDataLength);
+    if (MicrocodeShadowHob == NULL) {
+      FreePages (MicrocodePatchInRam, Pages);
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  MicrocodeShadowHob->MicrocodeCount = ValidCount;
+  CopyGuid (
+    &MicrocodeShadowHob->StorageType,
+    &gEdkiiMicrocodeStorageTypeFlashGuid
+    );
+  MicrocodeAddressInMemory = (UINT64 *)(MicrocodeShadowHob + 1);
+  Flashcontext             = (EFI_MICROCODE_STORAGE_TYPE_FLASH_CONTEXT *)(MicrocodeAddressInMemory + ValidCount);
+
+  for (Walker = MicrocodePatchInRam, Index = 0; Index < ValidCount; Index++) {
     MicrocodeAddressInMemory[Index]              = (UINT64)(UINTN)Walker;
     Flashcontext->MicrocodeAddressInFlash[Index] = (UINT64)Patches[Index].Address;
     Walker                                      += Patches[Index].Size;
@@ -148,7 +372,7 @@ ShadowMicrocodePatchWorker (
   // Update the microcode patch related fields in CpuMpData
   //
   *Buffer     = (VOID *)(UINTN)MicrocodePatchInRam;
-  *BufferSize = TotalLoadSize;
+  *BufferSize = ShadowedSize;
 
   BuildGuidDataHob (
     &gEdkiiMicrocodeShadowInfoHobGuid,
@@ -156,6 +380,27 @@ ShadowMicrocodePatchWorker (
     HobDataLength
     );
 
+  if ((CacheSize != 0) && (CacheRecord == NULL)) {
+    //
+    // Publish the cache record with the content digests, for the LockBox.
+    //
+    ZeroMem (&Record, sizeof (Record));
+    Record.CacheAddress  = (UINT64)(UINTN)MicrocodePatchInRam;
+    Record.CacheSize     = EFI_PAGES_TO_SIZE (Pages);
+    Record.KeyHash       = *KeyHash;
+    Record.PatchDataSize = ShadowedSize;
+    Record.HobDataLength = HobDataLength;
+    if (!EFI_ERROR (MicrocodeShadowCacheComputeDigests (&Record))) {
+      BuildGuidDataHob (
+        &gEdkiiMicrocodeShadowCacheGuid,
+        &Record,
+        sizeof (Record)
+        );
+    }
+  } else if (CacheSize == 0) {
+    FreePool (MicrocodeShadowHob);
+  }
+
   DEBUG ((
     DEBUG_INFO,
     "%a: Required microcode patches have been loaded at 0x%lx, with size 0x%lx.\n",
@@ -164,7 +409,7 @@ ShadowMicrocodePatchWorker (
     *BufferSize
     ));
 
-  return;
+  return EFI_SUCCESS;
 }
 
 /**
@@ -285,17 +530,21 @@ ShadowMicrocode (
   OUT VOID                            **Buffer
   )
 {
-  EFI_STATUS                      Status;
-  UINT64                          FitPointer;
-  FIRMWARE_INTERFACE_TABLE_ENTRY  *FitEntry;
-  UINT32                          EntryNum;
-  UINT32                          Index;
-  MICROCODE_PATCH_INFO            *PatchInfoBuffer;
-  UINTN                           MaxPatchNumber;
-  CPU_MICROCODE_HEADER            *MicrocodeEntryPoint;
-  UINTN                           PatchCount;
-  UINTN                           TotalSize;
-  UINTN                           TotalLoadSize;
+  EFI_STATUS                           Status;
+  UINT64                               FitPointer;
+  FIRMWARE_INTERFACE_TABLE_ENTRY       *FitEntry;
+  UINT32                               EntryNum;
+  UINT32                               Index;
+  MICROCODE_PATCH_INFO                 *PatchInfoBuffer;
+  UINTN                                MaxPatchNumber;
+  CPU_MICROCODE_HEADER                 *MicrocodeEntryPoint;
+  UINTN                                PatchCount;
+  UINTN                                TotalSize;
+  UINTN                                TotalLoadSize;
+  UINT32                               KeyHash;
+  UINT32                               *CacheKey;
+  EDKII_MICROCODE_SHADOW_CACHE_RECORD  Record;
+  EDKII_MICROCODE_SHADOW_CACHE_RECORD  *CacheRecord;
 
   if ((BufferSize == NULL) || (Buffer == NULL)) {
     return EFI_INVALID_PARAMETER;
@@ -363,8 +612,41 @@ ShadowMicrocode (
       TotalLoadSize
       ));
 
-    ShadowMicrocodePatchWorker (PatchInfoBuffer, PatchCount, TotalLoadSize, BufferSize, Buffer);
-    Status = EFI_SUCCESS;
+    CacheKey = NULL;
+    if (FeaturePcdGet (PcdShadowMicrocodeS3Cache)) {
+      Status = GetMicrocodeShadowKeyHash (FitEntry, EntryNum, MicrocodeCpuId, CpuIdCount, PatchInfoBuffer, PatchCount, &KeyHash);
+      if (!EFI_ERROR (Status)) {
+        CacheKey = &KeyHash;
+      }
+    }
+
+    //
+    // On S3 resume, reuse the patches shadowed in the previous boot if the FIT
+    // microcode entries are unchanged. Otherwise shadow them again into the
+    // memory of the previous boot.
+    //
+    Status      = EFI_NOT_FOUND;
+    CacheRecord = NULL;
+    if ((CacheKey != NULL) && (GetBootModeHob () == BOOT_ON_S3_RESUME)) {
+      if (!EFI_ERROR (GetMicrocodeShadowCacheRecord (&Record))) {
+        CacheRecord = &Record;
+        Status      = ReuseMicrocodeShadowCache (CacheRecord, KeyHash, BufferSize, Buffer);
+      }
+    }
+
+    if (EFI_ERROR (Status)) {
+      Status = ShadowMicrocodePatchWorker (
+                 PatchInfoBuffer,
+                 PatchCount,
+                 TotalLoadSize,
+                 MicrocodeCpuId,
+                 CpuIdCount,
+                 CacheKey,
+                 CacheRecord,
+                 BufferSize,
+                 Buffer
+                 );
+    }
   } else {
     Status = EFI_NOT_FOUND;
   }
@@ -0,0 +1,61 @@
+/** @file
+  The definition for the Microcode Shadow Cache.
+
+  When PcdShadowMicrocodeS3Cache is TRUE, the shadow microcode PEIM keeps the
+  shadowed microcode patches and the EDKII_MICROCODE_SHADOW_INFO_HOB data in
+  reserved memory, and publishes a record of them in a GUIDed HOB with the GUID
+  below. The ShadowMicrocodeLockBoxDxe driver saves the record to the LockBox
+  under the same GUID, so the S3 resume path can restore it and reuse the
+  shadowed patches instead of reading them from flash.
+
+  The reserved memory is writable by the OS, so the record carries the SHA-256
+  digests of the content, and the content is only reused if it matches them.
+  The LockBox and digest services are provided to the PEIM by
+  PeiMicrocodeShadowCacheLib.
+
+  Copyright (c) 2021, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _MICROCODE_SHADOW_CACHE_H_
+#define _MICROCODE_SHADOW_CACHE_H_
+
+///
+/// The Global ID of the GUIDed HOB and the LockBox used to pass the microcode
+/// shadow cache record.
+///
+#define EDKII_MICROCODE_SHADOW_CACHE_GUID \
+  { \
+    0x204bc00f, 0xf9be, 0x4886, { 0x91, 0xc1, 0x15, 0xe2, 0xe6, 0x2e, 0x7e, 0xe3 } \
+  }
+
+extern EFI_GUID  gEdkiiMicrocodeShadowCacheGuid;
+
+typedef struct {
+  //
+  // Address and size of the reserved memory of the microcode shadow cache.
+  //
+  UINT64    CacheAddress;
+  UINT64    CacheSize;
+  //
+  // Hash of the FIT table, CPU IDs and patch headers the cache is built from.
+  //
+  UINT32    KeyHash;
+  UINT32    Reserved;
+  //
+  // Size of the shadowed patches at CacheAddress.
+  //
+  UINT64    PatchDataSize;
+  //
+  // Size of the EDKII_MICROCODE_SHADOW_INFO_HOB data following the patches,
+  // at CacheAddress + ALIGN_VALUE (PatchDataSize, 8).
+  //
+  UINT64    HobDataLength;
+  //
+  // SHA-256 digests of the shadowed patches and of the HOB data.
+  //
+  UINT8     PatchDataHash[32];
+  UINT8     HobDataHash[32];
+} EDKII_MICROCODE_SHADOW_CACHE_RECORD;
+
+#endif
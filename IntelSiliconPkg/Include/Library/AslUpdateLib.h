@@ -34,6 +34,7 @@
    @retval EFI_SUCCESS                  The function completed successfully.
    @retval EFI_NOT_FOUND                Failed to locate AcpiTable.
    @retval EFI_NOT_READY                Not ready to locate AcpiTable.
+   @retval EFI_BAD_BUFFER_SIZE          The Name is not an integer, or Length is not 1, 2, 4 or 8.
    @retval EFI_UNSUPPORTED              The function is not supported in this library.
 **/
 EFI_STATUS
@@ -56,6 +57,7 @@ UpdateNameAslCode (
   @retval EFI_SUCCESS          - The function completed successfully.
   @retval EFI_NOT_FOUND        - Failed to locate AcpiTable.
   @retval EFI_NOT_READY        - Not ready to locate AcpiTable.
+  @retval EFI_BAD_BUFFER_SIZE  - The Name is not an integer, or Length is not 1, 2, 4 or 8.
   @retval EFI_UNSUPPORTED      - The function is not supported in this library.
 **/
 EFI_STATUS
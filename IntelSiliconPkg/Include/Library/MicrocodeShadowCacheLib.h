@@ -0,0 +1,66 @@
+/** @file
+  Microcode shadow cache library.
+
+  Provides the LockBox and digest services used by the shadow microcode PEIM to
+  keep the shadowed microcode patches for S3 resume. The layout of the cache is
+  described in Guid/MicrocodeShadowCache.h.
+
+  Copyright (c) 2021, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __MICROCODE_SHADOW_CACHE_LIB_H__
+#define __MICROCODE_SHADOW_CACHE_LIB_H__
+
+#include <Guid/MicrocodeShadowCache.h>
+
+/**
+  Restore the microcode shadow cache record saved to the LockBox in a previous boot.
+
+  @param[out] CacheRecord          Pointer to receive the microcode shadow cache record.
+
+  @retval EFI_SUCCESS              The record is restored.
+  @retval EFI_NOT_FOUND            No microcode shadow cache record is saved.
+  @retval EFI_UNSUPPORTED          The microcode shadow cache is not supported.
+**/
+EFI_STATUS
+EFIAPI
+MicrocodeShadowCacheRestoreRecord (
+  OUT EDKII_MICROCODE_SHADOW_CACHE_RECORD  *CacheRecord
+  );
+
+/**
+  Compute the digests of the microcode shadow cache content into its record.
+
+  The PatchDataSize and HobDataLength bytes of the content at CacheAddress are
+  hashed into PatchDataHash and HobDataHash.
+
+  @param[in, out] CacheRecord      The microcode shadow cache record.
+
+  @retval EFI_SUCCESS              The digests are computed.
+  @retval EFI_DEVICE_ERROR         The digests cannot be computed.
+  @retval EFI_UNSUPPORTED          The microcode shadow cache is not supported.
+**/
+EFI_STATUS
+EFIAPI
+MicrocodeShadowCacheComputeDigests (
+  IN OUT EDKII_MICROCODE_SHADOW_CACHE_RECORD  *CacheRecord
+  );
+
+/**
+  Check that the microcode shadow cache content matches the digests of its record.
+
+  @param[in]  CacheRecord          The microcode shadow cache record.
+
+  @retval EFI_SUCCESS              The content matches the digests.
+  @retval EFI_VOLUME_CORRUPTED     The content does not match the digests.
+  @retval EFI_UNSUPPORTED          The microcode shadow cache is not supported.
+**/
+EFI_STATUS
+EFIAPI
+MicrocodeShadowCacheVerifyDigests (
+  IN CONST EDKII_MICROCODE_SHADOW_CACHE_RECORD  *CacheRecord
+  );
+
+#endif
@@ -0,0 +1,1338 @@
+/** @file
+  AML name-path index used by the ASL update library.
+
+  The AML term list of a DSDT/SSDT is walked once and the last NameSeg of every
+  Name, Method and OperationRegion object is recorded together with the chain of
+  enclosing PkgLength encodings. The statements of Method and If/Else/While
+  bodies are not decoded, so these bodies are scanned for the objects they
+  declare, which are recorded without the PkgLength chain. Lookups are then a
+  hash probe instead of a byte-by-byte signature scan of the whole table, and
+  integer values can be re-encoded with a different size by fixing up the
+  enclosing package lengths.
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Base.h>
+#include <Uefi/UefiBaseType.h>
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "AmlNameIndex.h"
+
+#define AML_NAME_SEG_SIZE           4
+#define AML_NAME_INDEX_CACHE_SIZE   4
+#define AML_NAME_INDEX_INITIAL_SIZE 64
+#define AML_MAX_INTEGER_ENCODING    9
+
+///
+/// A byte range of the original table replaced by a new encoding.
+///
+typedef struct {
+  UINT32    Offset;
+  UINT32    OldSize;
+  UINT32    NewSize;
+  UINT8     Data[AML_MAX_INTEGER_ENCODING];
+} AML_INDEX_EDIT;
+
+//
+// Indexes of the most recently updated tables, matched by signature and OEM table ID.
+//
+STATIC AML_NAME_INDEX  mAmlNameIndexCache[AML_NAME_INDEX_CACHE_SIZE];
+STATIC UINTN           mAmlNameIndexNext = 0;
+
+/**
+  Check if a byte is a valid lead character of a NameSeg.
+
+  @param[in] Char              The byte to check.
+
+  @retval TRUE                 The byte is 'A'-'Z' or '_'.
+  @retval FALSE                The byte cannot start a NameSeg.
+**/
+STATIC
+BOOLEAN
+AmlIsLeadNameChar (
+  IN UINT8  Char
+  )
+{
+  return (BOOLEAN)(((Char >= 'A') && (Char <= 'Z')) || (Char == '_'));
+}
+
+/**
+  Decode a PkgLength encoding.
+
+  @param[in]  Aml              The AML byte stream.
+  @param[in]  Offset           Offset of the PkgLength lead byte.
+  @param[in]  End              End of the enclosing term list.
+  @param[out] PkgLength        The decoded length, including the encoding bytes.
+  @param[out] EncodingSize     The number of bytes used by the encoding.
+
+  @retval TRUE                 The PkgLength is valid and lies within End.
+  @retval FALSE                The encoding is malformed or out of bounds.
+**/
+STATIC
+BOOLEAN
+AmlDecodePkgLength (
+  IN  CONST UINT8  *Aml,
+  IN  UINT32       Offset,
+  IN  UINT32       End,
+  OUT UINT32       *PkgLength,
+  OUT UINT8        *EncodingSize
+  )
+{
+  UINT8   Count;
+  UINT8   Index;
+  UINT32  Length;
+
+  if (Offset >= End) {
+    return FALSE;
+  }
+
+  Count = Aml[Offset] >> 6;
+  if (Count >= End - Offset) {
+    return FALSE;
+  }
+
+  if (Count == 0) {
+    Length = Aml[Offset] & 0x3F;
+  } else {
+    Length = Aml[Offset] & 0x0F;
+    for (Index = 0; Index < Count; Index++) {
+      Length |= (UINT32)Aml[Offset + 1 + Index] << (4 + 8 * Index);
+    }
+  }
+
+  if ((Length < (UINT32)Count + 1) || (Length > End - Offset)) {
+    return FALSE;
+  }
+
+  *PkgLength    = Length;
+  *EncodingSize = Count + 1;
+  return TRUE;
+}
+
+/**
+  Get the smallest PkgLength encoding size, not below MinSize, able to hold a body.
+
+  @param[in] BodyLength        The package length excluding the encoding bytes.
+  @param[in] MinSize           The minimum encoding size to use.
+
+  @return The encoding size in bytes, or 0 if the body is too large.
+**/
+STATIC
+UINT8
+AmlPkgLengthEncodingSize (
+  IN UINT64  BodyLength,
+  IN UINT8   MinSize
+  )
+{
+  STATIC CONST UINT32  MaxLength[] = { 0x3F, 0xFFF, 0xFFFFF, 0xFFFFFFF };
+  UINT8                Size;
+
+  for (Size = MAX (MinSize, 1); Size <= ARRAY_SIZE (MaxLength); Size++) {
+    if (BodyLength + Size <= MaxLength[Size - 1]) {
+      return Size;
+    }
+  }
+
+  return 0;
+}
+
+/**
+  Encode a PkgLength.
+
+  @param[in]  PkgLength        The package length, including the encoding bytes.
+  @param[in]  EncodingSize     The number of bytes to encode the length with.
+  @param[out] Data             Receives the encoding.
+**/
+STATIC
+VOID
+AmlEncodePkgLength (
+  IN  UINT32  PkgLength,
+  IN  UINT8   EncodingSize,
+  OUT UINT8   *Data
+  )
+{
+  UINT8  Index;
+
+  if (EncodingSize == 1) {
+    Data[0] = (UINT8)PkgLength;
+    return;
+  }
+
+  Data[0] = (UINT8)(((EncodingSize - 1) << 6) | (PkgLength & 0x0F));
+  for (Index = 1; Index < EncodingSize; Index++) {
+    Data[Index] = (UINT8)(PkgLength >> (4 + 8 * (Index - 1)));
+  }
+}
+
+/**
+  Parse a NameString.
+
+  @param[in]      Aml          The AML byte stream.
+  @param[in]      End          End of the enclosing term list.
+  @param[in, out] Offset       On input the start of the NameString, on output the byte after it.
+  @param[out]     NameOffset   Offset of the last NameSeg, or MAX_UINT32 for a NullName.
+
+  @retval TRUE                 The NameString was parsed.
+  @retval FALSE                The bytes are not a valid NameString.
+**/
+STATIC
+BOOLEAN
+AmlParseNameString (
+  IN     CONST UINT8  *Aml,
+  IN     UINT32       End,
+  IN OUT UINT32       *Offset,
+  OUT    UINT32       *NameOffset
+  )
+{
+  UINT32  Cursor;
+  UINT32  SegCount;
+
+  Cursor = *Offset;
+  if ((Cursor < End) && (Aml[Cursor] == AML_ROOT_CHAR)) {
+    Cursor++;
+  } else {
+    while ((Cursor < End) && (Aml[Cursor] == AML_PARENT_PREFIX_CHAR)) {
+      Cursor++;
+    }
+  }
+
+  if (Cursor >= End) {
+    return FALSE;
+  }
+
+  switch (Aml[Cursor]) {
+    case AML_ZERO_OP:
+      //
+      // NullName
+      //
+      SegCount = 0;
+      Cursor++;
+      break;
+    case AML_DUAL_NAME_PREFIX:
+      SegCount = 2;
+      Cursor++;
+      break;
+    case AML_MULTI_NAME_PREFIX:
+      if (Cursor + 1 >= End) {
+        return FALSE;
+      }
+
+      SegCount = Aml[Cursor + 1];
+      Cursor  += 2;
+      break;
+    default:
+      SegCount = 1;
+      break;
+  }
+
+  if (SegCount > (End - Cursor) / AML_NAME_SEG_SIZE) {
+    return FALSE;
+  }
+
+  *NameOffset = MAX_UINT32;
+  while (SegCount-- != 0) {
+    if (!AmlIsLeadNameChar (Aml[Cursor])) {
+      return FALSE;
+    }
+
+    *NameOffset = Cursor;
+    Cursor     += AML_NAME_SEG_SIZE;
+  }
+
+  *Offset = Cursor;
+  return TRUE;
+}
+
+/**
+  Get the encoded size of an integer constant from its opcode.
+
+  @param[in] Op                The opcode of the data object.
+
+  @return The number of bytes of the encoding, or 0 if Op is not an integer constant.
+**/
+STATIC
+UINT32
+AmlIntegerEncodingSize (
+  IN UINT8  Op
+  )
+{
+  switch (Op) {
+    case AML_ZERO_OP:
+    case AML_ONE_OP:
+    case AML_ONES_OP:
+      return 1;
+    case AML_BYTE_PREFIX:
+      return 2;
+    case AML_WORD_PREFIX:
+      return 3;
+    case AML_DWORD_PREFIX:
+      return 5;
+    case AML_QWORD_PREFIX:
+      return 9;
+    default:
+      return 0;
+  }
+}
+
+/**
+  Skip a DataRefObject or a simple TermArg (a constant or a name reference).
+
+  @param[in]      Aml          The AML byte stream.
+  @param[in]      End          End of the enclosing term list.
+  @param[in, out] Offset       On input the start of the object, on output the byte after it.
+
+  @retval TRUE                 The object was skipped.
+  @retval FALSE                The object is not a constant or name reference.
+**/
+STATIC
+BOOLEAN
+AmlSkipDataObject (
+  IN     CONST UINT8  *Aml,
+  IN     UINT32       End,
+  IN OUT UINT32       *Offset
+  )
+{
+  UINT32  Cursor;
+  UINT32  Size;
+  UINT32  PkgLength;
+  UINT8   EncodingSize;
+  UINT32  NameOffset;
+
+  Cursor = *Offset;
+  if (Cursor >= End) {
+    return FALSE;
+  }
+
+  Size = AmlIntegerEncodingSize (Aml[Cursor]);
+  if (Size == 0) {
+    switch (Aml[Cursor]) {
+      case AML_STRING_PREFIX:
+        for (Size = 1; (Cursor + Size < End) && (Aml[Cursor + Size] != 0); Size++) {
+        }
+
+        Size++;
+        break;
+      case AML_BUFFER_OP:
+      case AML_PACKAGE_OP:
+      case AML_VAR_PACKAGE_OP:
+        if (!AmlDecodePkgLength (Aml, Cursor + 1, End, &PkgLength, &EncodingSize)) {
+          return FALSE;
+        }
+
+        Size = 1 + PkgLength;
+        break;
+      case AML_EXT_OP:
+        if ((Cursor + 1 >= End) || (Aml[Cursor + 1] != AML_EXT_REVISION_OP)) {
+          return FALSE;
+        }
+
+        Size = 2;
+        break;
+      default:
+        //
+        // Reference to another named object.
+        //
+        if (!AmlParseNameString (Aml, End, &Cursor, &NameOffset)) {
+          return FALSE;
+        }
+
+        *Offset = Cursor;
+        return TRUE;
+    }
+  }
+
+  if (Size > End - Cursor) {
+    return FALSE;
+  }
+
+  *Offset = Cursor + Size;
+  return TRUE;
+}
+
+/**
+  Make room for one more element in a growable index array.
+
+  @param[in, out] Buffer       The array.
+  @param[in, out] Capacity     The number of elements allocated.
+  @param[in]      Count        The number of elements used.
+  @param[in]      ElementSize  The size of one element.
+
+  @retval TRUE                 One more element fits.
+  @retval FALSE                The array could not be grown.
+**/
+STATIC
+BOOLEAN
+AmlIndexReserve (
+  IN OUT VOID   **Buffer,
+  IN OUT UINTN  *Capacity,
+  IN     UINTN  Count,
+  IN     UINTN  ElementSize
+  )
+{
+  VOID   *NewBuffer;
+  UINTN  NewCapacity;
+
+  if (Count < *Capacity) {
+    return TRUE;
+  }
+
+  NewCapacity = (*Capacity == 0) ? AML_NAME_INDEX_INITIAL_SIZE : *Capacity * 2;
+  NewBuffer   = ReallocatePool (*Capacity * ElementSize, NewCapacity * ElementSize, *Buffer);
+  if (NewBuffer == NULL) {
+    return FALSE;
+  }
+
+  *Buffer   = NewBuffer;
+  *Capacity = NewCapacity;
+  return TRUE;
+}
+
+/**
+  Record a Name, Method or OperationRegion object.
+
+  @retval TRUE                 The object was recorded, or has no name to record.
+  @retval FALSE                Out of resources.
+**/
+STATIC
+BOOLEAN
+AmlIndexAddEntry (
+  IN OUT AML_NAME_INDEX         *Index,
+  IN     CONST UINT8            *Aml,
+  IN     AML_INDEX_OBJECT_TYPE  Type,
+  IN     UINT32                 ObjectOffset,
+  IN     UINT32                 NameOffset,
+  IN     UINT32                 DataOffset,
+  IN     UINT32                 Scope
+  )
+{
+  AML_INDEX_ENTRY  *Entry;
+
+  if (NameOffset == MAX_UINT32) {
+    return TRUE;
+  }
+
+  if (!AmlIndexReserve ((VOID **)&Index->Entries, &Index->EntryCapacity, Index->EntryCount, sizeof (AML_INDEX_ENTRY))) {
+    return FALSE;
+  }
+
+  Entry               = &Index->Entries[Index->EntryCount++];
+  Entry->NameSeg      = ReadUnaligned32 ((CONST UINT32 *)(Aml + NameOffset));
+  Entry->Type         = (UINT8)Type;
+  Entry->ObjectOffset = ObjectOffset;
+  Entry->NameOffset   = NameOffset;
+  Entry->DataOffset   = DataOffset;
+  Entry->Scope        = Scope;
+  return TRUE;
+}
+
+/**
+  Check if a NameSeg is the name of an object of a given type, from the bytes
+  preceding it, as the signature scan does.
+
+  @param[in]  Aml              The AML byte stream.
+  @param[in]  NameOffset       Offset of the NameSeg, at least 3.
+  @param[in]  Type             The object type.
+  @param[out] ObjectOffset     Returns the offset of the object opcode.
+
+  @retval TRUE                 The NameSeg follows the opcode of an object of the type.
+  @retval FALSE                The NameSeg does not name an object of the type.
+**/
+STATIC
+BOOLEAN
+AmlMatchObject (
+  IN  CONST UINT8            *Aml,
+  IN  UINT32                 NameOffset,
+  IN  AML_INDEX_OBJECT_TYPE  Type,
+  OUT UINT32                 *ObjectOffset
+  )
+{
+  switch (Type) {
+    case AmlIndexName:
+      *ObjectOffset = NameOffset - 1;
+      return (BOOLEAN)(Aml[NameOffset - 1] == AML_NAME_OP);
+    case AmlIndexMethod:
+      if (Aml[NameOffset - 3] == AML_METHOD_OP) {
+        *ObjectOffset = NameOffset - 3;
+        return TRUE;
+      }
+
+      *ObjectOffset = NameOffset - 2;
+      return (BOOLEAN)(Aml[NameOffset - 2] == AML_METHOD_OP);
+    case AmlIndexOpRegion:
+      *ObjectOffset = NameOffset - 2;
+      return (BOOLEAN)((Aml[NameOffset - 2] == AML_EXT_OP) && (Aml[NameOffset - 1] == AML_EXT_REGION_OP));
+    default:
+      return FALSE;
+  }
+}
+
+/**
+  Index the objects declared in a method or conditional body.
+
+  The statements of the body are not decoded, so the body is scanned for the
+  objects as the signature scan would find them. Their enclosing package
+  lengths are not known, so they are recorded with AML_INDEX_SCOPE_UNKNOWN.
+
+  @param[in, out] Index        The index being built.
+  @param[in]      Aml          The AML byte stream.
+  @param[in]      Offset       Start of the body.
+  @param[in]      End          End of the body.
+
+  @retval TRUE                 The body was indexed.
+  @retval FALSE                Out of resources.
+**/
+STATIC
+BOOLEAN
+AmlIndexCodeBody (
+  IN OUT AML_NAME_INDEX  *Index,
+  IN     CONST UINT8     *Aml,
+  IN     UINT32          Offset,
+  IN     UINT32          End
+  )
+{
+  UINT32  NameOffset;
+  UINT32  ObjectOffset;
+  UINT8   Type;
+
+  for (NameOffset = Offset; NameOffset + AML_NAME_SEG_SIZE <= End; NameOffset++) {
+    if (!AmlIsLeadNameChar (Aml[NameOffset])) {
+      continue;
+    }
+
+    for (Type = 0; Type < AmlIndexTypeMax; Type++) {
+      if (AmlMatchObject (Aml, NameOffset, (AML_INDEX_OBJECT_TYPE)Type, &ObjectOffset) && (ObjectOffset >= Offset)) {
+        if (!AmlIndexAddEntry (
+               Index,
+               Aml,
+               (AML_INDEX_OBJECT_TYPE)Type,
+               ObjectOffset,
+               NameOffset,
+               NameOffset + AML_NAME_SEG_SIZE,
+               AML_INDEX_SCOPE_UNKNOWN
+               ))
+        {
+          return FALSE;
+        }
+
+        break;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+STATIC
+VOID
+AmlIndexTermList (
+  IN OUT AML_NAME_INDEX  *Index,
+  IN     CONST UINT8     *Aml,
+  IN     UINT32          Offset,
+  IN     UINT32          End,
+  IN     UINT32          Scope
+  );
+
+/**
+  Index an object that opens a new scope: Scope, Device, Processor, PowerResource
+  or ThermalZone. The object is "Opcode PkgLength NameString Fixed TermList".
+
+  @param[in, out] Index        The index being built.
+  @param[in]      Aml          The AML byte stream.
+  @param[in, out] Offset       On input the object opcode, on output the byte after the object.
+  @param[in]      OpcodeSize   The size of the opcode, 1 or 2 for extended opcodes.
+  @param[in]      FixedSize    The number of fixed bytes between the NameString and the TermList.
+  @param[in]      End          End of the enclosing term list.
+  @param[in]      Scope        The enclosing scope.
+
+  @retval TRUE                 The object was indexed.
+  @retval FALSE                The object is malformed or out of resources.
+**/
+STATIC
+BOOLEAN
+AmlIndexScopeObject (
+  IN OUT AML_NAME_INDEX  *Index,
+  IN     CONST UINT8     *Aml,
+  IN OUT UINT32          *Offset,
+  IN     UINT32          OpcodeSize,
+  IN     UINT32          FixedSize,
+  IN     UINT32          End,
+  IN     UINT32          Scope
+  )
+{
+  UINT32           PkgOffset;
+  UINT32           PkgLength;
+  UINT8            EncodingSize;
+  UINT32           ObjectEnd;
+  UINT32           Cursor;
+  UINT32           NameOffset;
+  AML_INDEX_SCOPE  *NewScope;
+
+  PkgOffset = *Offset + OpcodeSize;
+  if (!AmlDecodePkgLength (Aml, PkgOffset, End, &PkgLength, &EncodingSize)) {
+    return FALSE;
+  }
+
+  ObjectEnd = PkgOffset + PkgLength;
+  Cursor    = PkgOffset + EncodingSize;
+  if (!AmlParseNameString (Aml, ObjectEnd, &Cursor, &NameOffset) || (FixedSize > ObjectEnd - Cursor)) {
+    return FALSE;
+  }
+
+  if (!AmlIndexReserve ((VOID **)&Index->Scopes, &Index->ScopeCapacity, Index->ScopeCount, sizeof (AML_INDEX_SCOPE))) {
+    return FALSE;
+  }
+
+  NewScope                  = &Index->Scopes[Index->ScopeCount];
+  NewScope->PkgOffset       = PkgOffset;
+  NewScope->PkgLength       = PkgLength;
+  NewScope->PkgEncodingSize = EncodingSize;
+  NewScope->Parent          = Scope;
+
+  AmlIndexTermList (Index, Aml, Cursor + FixedSize, ObjectEnd, (UINT32)Index->ScopeCount++);
+
+  *Offset = ObjectEnd;
+  return TRUE;
+}
+
+/**
+  Skip an object of the form "Opcode PkgLength ...".
+
+  @retval TRUE                 The object was skipped.
+  @retval FALSE                The PkgLength is malformed.
+**/
+STATIC
+BOOLEAN
+AmlSkipPkgObject (
+  IN     CONST UINT8  *Aml,
+  IN OUT UINT32       *Offset,
+  IN     UINT32       OpcodeSize,
+  IN     UINT32       End
+  )
+{
+  UINT32  PkgLength;
+  UINT8   EncodingSize;
+
+  if (!AmlDecodePkgLength (Aml, *Offset + OpcodeSize, End, &PkgLength, &EncodingSize)) {
+    return FALSE;
+  }
+
+  *Offset += OpcodeSize + PkgLength;
+  return TRUE;
+}
+
+/**
+  Index the named objects of a term list.
+
+  Objects that cannot be decoded stop the walk of this term list and mark the
+  index as incomplete; the enclosing term list continues after this scope.
+  Method and If/Else/While bodies are not decoded but scanned for objects.
+
+  @param[in, out] Index        The index being built.
+  @param[in]      Aml          The AML byte stream.
+  @param[in]      Offset       Start of the term list.
+  @param[in]      End          End of the term list.
+  @param[in]      Scope        The scope owning the term list.
+**/
+STATIC
+VOID
+AmlIndexTermList (
+  IN OUT AML_NAME_INDEX  *Index,
+  IN     CONST UINT8     *Aml,
+  IN     UINT32          Offset,
+  IN     UINT32          End,
+  IN     UINT32          Scope
+  )
+{
+  UINT32   ObjectOffset;
+  UINT32   NameOffset;
+  UINT32   DataOffset;
+  UINT32   PkgLength;
+  UINT8    EncodingSize;
+  BOOLEAN  Decoded;
+
+  while (Offset < End) {
+    ObjectOffset = Offset;
+    Decoded      = FALSE;
+
+    switch (Aml[Offset]) {
+      case AML_NAME_OP:
+        Offset++;
+        if (AmlParseNameString (Aml, End, &Offset, &NameOffset)) {
+          DataOffset = Offset;
+          Decoded    = AmlSkipDataObject (Aml, End, &Offset) &&
+                       AmlIndexAddEntry (Index, Aml, AmlIndexName, ObjectOffset, NameOffset, DataOffset, Scope);
+        }
+
+        break;
+
+      case AML_METHOD_OP:
+        if (AmlDecodePkgLength (Aml, Offset + 1, End, &PkgLength, &EncodingSize)) {
+          Offset += 1 + EncodingSize;
+          if (AmlParseNameString (Aml, ObjectOffset + 1 + PkgLength, &Offset, &NameOffset) &&
+              (Offset < ObjectOffset + 1 + PkgLength))
+          {
+            Decoded = AmlIndexAddEntry (Index, Aml, AmlIndexMethod, ObjectOffset, NameOffset, Offset, Scope) &&
+                      AmlIndexCodeBody (Index, Aml, Offset + 1, ObjectOffset + 1 + PkgLength);
+          }
+
+          Offset = ObjectOffset + 1 + PkgLength;
+        }
+
+        break;
+
+      case AML_SCOPE_OP:
+        Decoded = AmlIndexScopeObject (Index, Aml, &Offset, 1, 0, End, Scope);
+        break;
+
+      case AML_EXTERNAL_OP:
+        Offset++;
+        if (AmlParseNameString (Aml, End, &Offset, &NameOffset) && (End - Offset >= 2)) {
+          Offset += 2;
+          Decoded = TRUE;
+        }
+
+        break;
+
+      case AML_ALIAS_OP:
+        Offset++;
+        Decoded = AmlParseNameString (Aml, End, &Offset, &NameOffset) &&
+                  AmlParseNameString (Aml, End, &Offset, &NameOffset);
+        break;
+
+      case AML_IF_OP:
+      case AML_ELSE_OP:
+      case AML_WHILE_OP:
+        if (AmlDecodePkgLength (Aml, Offset + 1, End, &PkgLength, &EncodingSize)) {
+          Decoded = AmlIndexCodeBody (Index, Aml, Offset + 1 + EncodingSize, Offset + 1 + PkgLength);
+          Offset += 1 + PkgLength;
+        }
+
+        break;
+
+      case AML_EXT_OP:
+        if (Offset + 1 >= End) {
+          break;
+        }
+
+        switch (Aml[Offset + 1]) {
+          case AML_EXT_REGION_OP:
+            Offset += 2;
+            if (AmlParseNameString (Aml, End, &Offset, &NameOffset) && (Offset < End)) {
+              DataOffset = Offset++;
+              Decoded    = AmlSkipDataObject (Aml, End, &Offset) &&
+                           AmlSkipDataObject (Aml, End, &Offset) &&
+                           AmlIndexAddEntry (Index, Aml, AmlIndexOpRegion, ObjectOffset, NameOffset, DataOffset, Scope);
+            }
+
+            break;
+          case AML_EXT_DEVICE_OP:
+          case AML_EXT_THERMAL_ZONE_OP:
+            Decoded = AmlIndexScopeObject (Index, Aml, &Offset, 2, 0, End, Scope);
+            break;
+          case AML_EXT_PROCESSOR_OP:
+            //
+            // ProcID, PblkAddr and PblkLen
+            //
+            Decoded = AmlIndexScopeObject (Index, Aml, &Offset, 2, 6, End, Scope);
+            break;
+          case AML_EXT_POWER_RES_OP:
+            //
+            // SystemLevel and ResourceOrder
+            //
+            Decoded = AmlIndexScopeObject (Index, Aml, &Offset, 2, 3, End, Scope);
+            break;
+          case AML_EXT_FIELD_OP:
+          case AML_EXT_INDEX_FIELD_OP:
+          case AML_EXT_BANK_FIELD_OP:
+            Decoded = AmlSkipPkgObject (Aml, &Offset, 2, End);
+            break;
+          case AML_EXT_MUTEX_OP:
+            Offset += 2;
+            if (AmlParseNameString (Aml, End, &Offset, &NameOffset) && (Offset < End)) {
+              Offset++;
+              Decoded = TRUE;
+            }
+
+            break;
+          case AML_EXT_EVENT_OP:
+            Offset += 2;
+            Decoded = AmlParseNameString (Aml, End, &Offset, &NameOffset);
+            break;
+          case AML_EXT_DATA_REGION_OP:
+            Offset += 2;
+            Decoded = AmlParseNameString (Aml, End, &Offset, &NameOffset) &&
+                      AmlSkipDataObject (Aml, End, &Offset) &&
+                      AmlSkipDataObject (Aml, End, &Offset) &&
+                      AmlSkipDataObject (Aml, End, &Offset);
+            break;
+          default:
+            break;
+        }
+
+        break;
+
+      default:
+        break;
+    }
+
+    if (!Decoded) {
+      DEBUG ((DEBUG_VERBOSE, "AmlIndexTermList: stop at AML offset 0x%x (opcode 0x%02x)\n", ObjectOffset, Aml[ObjectOffset]));
+      Index->Complete = FALSE;
+      return;
+    }
+  }
+}
+
+/**
+  Hash a NameSeg and object type into a bucket.
+
+  @param[in] NameSeg           The NameSeg.
+  @param[in] Type              The object type.
+  @param[in] BucketCount       The number of buckets, a power of two.
+
+  @return The bucket number.
+**/
+STATIC
+UINTN
+AmlIndexHash (
+  IN UINT32  NameSeg,
+  IN UINT8   Type,
+  IN UINTN   BucketCount
+  )
+{
+  UINT32  Hash;
+
+  Hash  = (NameSeg + Type) * 0x9E3779B1;
+  Hash ^= Hash >> 16;
+  return (UINTN)Hash & (BucketCount - 1);
+}
+
+/**
+  Free the memory owned by an index and mark it empty.
+
+  @param[in, out] Index        The index to free.
+**/
+STATIC
+VOID
+AmlFreeNameIndex (
+  IN OUT AML_NAME_INDEX  *Index
+  )
+{
+  if (Index->Entries != NULL) {
+    FreePool (Index->Entries);
+  }
+
+  if (Index->Scopes != NULL) {
+    FreePool (Index->Scopes);
+  }
+
+  if (Index->Buckets != NULL) {
+    FreePool (Index->Buckets);
+  }
+
+  ZeroMem (Index, sizeof (AML_NAME_INDEX));
+}
+
+/**
+  Build the index of a DSDT/SSDT in one pass over its AML.
+
+  @param[in]  Table            The table to index.
+  @param[out] Index            The index to build.
+
+  @retval EFI_SUCCESS          The index was built.
+  @retval EFI_OUT_OF_RESOURCES The index cannot be allocated.
+**/
+STATIC
+EFI_STATUS
+AmlBuildNameIndex (
+  IN  CONST EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  OUT AML_NAME_INDEX                     *Index
+  )
+{
+  UINTN            EntryIndex;
+  UINTN            Bucket;
+  UINT32           Slot;
+  AML_INDEX_ENTRY  *Entry;
+
+  ZeroMem (Index, sizeof (AML_NAME_INDEX));
+  Index->Signature  = Table->Signature;
+  Index->OemTableId = Table->OemTableId;
+  Index->Length     = Table->Length;
+  Index->Complete   = TRUE;
+
+  if (Table->Length > sizeof (EFI_ACPI_DESCRIPTION_HEADER)) {
+    AmlIndexTermList (
+      Index,
+      (CONST UINT8 *)Table,
+      sizeof (EFI_ACPI_DESCRIPTION_HEADER),
+      Table->Length,
+      AML_INDEX_SCOPE_ROOT
+      );
+  }
+
+  Index->BucketCount = 16;
+  while (Index->BucketCount < Index->EntryCount * 2) {
+    Index->BucketCount <<= 1;
+  }
+
+  Index->Buckets = AllocateZeroPool (Index->BucketCount * sizeof (UINT32));
+  if (Index->Buckets == NULL) {
+    AmlFreeNameIndex (Index);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Keep the first object of each name and type, as the signature scan would find.
+  //
+  for (EntryIndex = 0; EntryIndex < Index->EntryCount; EntryIndex++) {
+    Entry  = &Index->Entries[EntryIndex];
+    Bucket = AmlIndexHash (Entry->NameSeg, Entry->Type, Index->BucketCount);
+    while ((Slot = Index->Buckets[Bucket]) != 0) {
+      if ((Index->Entries[Slot - 1].NameSeg == Entry->NameSeg) && (Index->Entries[Slot - 1].Type == Entry->Type)) {
+        break;
+      }
+
+      Bucket = (Bucket + 1) & (Index->BucketCount - 1);
+    }
+
+    if (Slot == 0) {
+      Index->Buckets[Bucket] = (UINT32)EntryIndex + 1;
+    }
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "AmlBuildNameIndex: Signature 0x%08x, %d objects in %d scopes%a\n",
+    Index->Signature,
+    (UINT32)Index->EntryCount,
+    (UINT32)Index->ScopeCount,
+    Index->Complete ? "" : " (incomplete)"
+    ));
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the cached index of a table, building it when needed.
+
+  @param[in]  Table            The table.
+  @param[in]  Rebuild          TRUE to discard a cached index of the table.
+  @param[out] Built            Returns TRUE if the index was built by this call.
+
+  @return The index, or NULL if it cannot be built.
+**/
+STATIC
+AML_NAME_INDEX *
+AmlGetNameIndex (
+  IN  CONST EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN  BOOLEAN                            Rebuild,
+  OUT BOOLEAN                            *Built
+  )
+{
+  UINTN           Slot;
+  AML_NAME_INDEX  *Index;
+
+  Index = NULL;
+  for (Slot = 0; Slot < AML_NAME_INDEX_CACHE_SIZE; Slot++) {
+    if ((mAmlNameIndexCache[Slot].Buckets != NULL) &&
+        (mAmlNameIndexCache[Slot].Signature == Table->Signature) &&
+        (mAmlNameIndexCache[Slot].OemTableId == Table->OemTableId))
+    {
+      Index = &mAmlNameIndexCache[Slot];
+      break;
+    }
+  }
+
+  if ((Index != NULL) && !Rebuild && (Index->Length == Table->Length)) {
+    *Built = FALSE;
+    return Index;
+  }
+
+  if (Index == NULL) {
+    Index             = &mAmlNameIndexCache[mAmlNameIndexNext];
+    mAmlNameIndexNext = (mAmlNameIndexNext + 1) % AML_NAME_INDEX_CACHE_SIZE;
+  }
+
+  AmlFreeNameIndex (Index);
+  *Built = TRUE;
+  if (EFI_ERROR (AmlBuildNameIndex (Table, Index))) {
+    return NULL;
+  }
+
+  return Index;
+}
+
+/**
+  Check that an index entry still describes the object in the table.
+
+  @param[in] Table             The table.
+  @param[in] Entry             The index entry.
+
+  @retval TRUE                 The opcode and NameSeg at the recorded offsets match.
+  @retval FALSE                The table content has changed.
+**/
+STATIC
+BOOLEAN
+AmlIndexEntryIsValid (
+  IN CONST EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN CONST AML_INDEX_ENTRY              *Entry
+  )
+{
+  CONST UINT8  *Aml;
+  UINT8        Op;
+
+  Aml = (CONST UINT8 *)Table;
+  if ((Entry->NameOffset + AML_NAME_SEG_SIZE > Table->Length) ||
+      (Entry->DataOffset >= Table->Length) ||
+      (ReadUnaligned32 ((CONST UINT32 *)(Aml + Entry->NameOffset)) != Entry->NameSeg))
+  {
+    return FALSE;
+  }
+
+  switch (Entry->Type) {
+    case AmlIndexName:
+      Op = AML_NAME_OP;
+      break;
+    case AmlIndexMethod:
+      Op = AML_METHOD_OP;
+      break;
+    default:
+      Op = AML_EXT_OP;
+      break;
+  }
+
+  return (BOOLEAN)(Aml[Entry->ObjectOffset] == Op);
+}
+
+/**
+  Look up an object in an index.
+
+  @return The entry, or NULL if the index has no such object.
+**/
+STATIC
+AML_INDEX_ENTRY *
+AmlIndexLookup (
+  IN AML_NAME_INDEX         *Index,
+  IN UINT32                 NameSeg,
+  IN AML_INDEX_OBJECT_TYPE  Type
+  )
+{
+  UINTN            Bucket;
+  UINT32           Slot;
+  AML_INDEX_ENTRY  *Entry;
+
+  Bucket = AmlIndexHash (NameSeg, (UINT8)Type, Index->BucketCount);
+  while ((Slot = Index->Buckets[Bucket]) != 0) {
+    Entry = &Index->Entries[Slot - 1];
+    if ((Entry->NameSeg == NameSeg) && (Entry->Type == Type)) {
+      return Entry;
+    }
+
+    Bucket = (Bucket + 1) & (Index->BucketCount - 1);
+  }
+
+  return NULL;
+}
+
+/**
+  Locate an object by scanning the table for its signature, for AML the index
+  walker could not decode.
+
+  @retval EFI_SUCCESS          The object was found.
+  @retval EFI_NOT_FOUND        The object is not in the table.
+**/
+STATIC
+EFI_STATUS
+AmlScanObject (
+  IN  CONST EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN  UINT32                             NameSeg,
+  IN  AML_INDEX_OBJECT_TYPE              Type,
+  OUT AML_INDEX_ENTRY                    *Entry
+  )
+{
+  CONST UINT8  *Aml;
+  UINT32       Offset;
+  UINT32       ObjectOffset;
+
+  Aml = (CONST UINT8 *)Table;
+  for (Offset = 3; Offset + AML_NAME_SEG_SIZE <= Table->Length; Offset++) {
+    if ((ReadUnaligned32 ((CONST UINT32 *)(Aml + Offset)) != NameSeg) ||
+        !AmlMatchObject (Aml, Offset, Type, &ObjectOffset))
+    {
+      continue;
+    }
+
+    Entry->NameSeg      = NameSeg;
+    Entry->Type         = (UINT8)Type;
+    Entry->ObjectOffset = ObjectOffset;
+    Entry->NameOffset   = Offset;
+    Entry->DataOffset   = Offset + AML_NAME_SEG_SIZE;
+    Entry->Scope        = AML_INDEX_SCOPE_UNKNOWN;
+    return EFI_SUCCESS;
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Find a Name, Method or OperationRegion object by the last NameSeg of its name path.
+
+  A cached index of the table is used, and built in one pass over the AML when the
+  table has not been indexed yet or has changed. When the index is incomplete and
+  does not contain the object, the table is scanned for the signature as before.
+
+  @param[in]  Table            The DSDT or SSDT to search.
+  @param[in]  NameSeg          The NameSeg of the object.
+  @param[in]  Type             The type of the object.
+  @param[out] Entry            Returns the location of the object.
+  @param[out] Index            Returns the index the entry belongs to, or NULL if the
+                               object was located by the signature scan.
+
+  @retval EFI_SUCCESS          The object was found.
+  @retval EFI_NOT_FOUND        The object is not in the table.
+**/
+EFI_STATUS
+AmlFindObject (
+  IN  CONST EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN  UINT32                             NameSeg,
+  IN  AML_INDEX_OBJECT_TYPE              Type,
+  OUT AML_INDEX_ENTRY                    *Entry,
+  OUT AML_NAME_INDEX                     **Index
+  )
+{
+  AML_NAME_INDEX   *NameIndex;
+  AML_INDEX_ENTRY  *Found;
+  BOOLEAN          Built;
+
+  *Index    = NULL;
+  NameIndex = AmlGetNameIndex (Table, FALSE, &Built);
+  if (NameIndex != NULL) {
+    Found = AmlIndexLookup (NameIndex, NameSeg, Type);
+    if (((Found == NULL) || !AmlIndexEntryIsValid (Table, Found)) && !Built) {
+      //
+      // The table changed since it was indexed.
+      //
+      NameIndex = AmlGetNameIndex (Table, TRUE, &Built);
+      Found     = (NameIndex == NULL) ? NULL : AmlIndexLookup (NameIndex, NameSeg, Type);
+    }
+
+    if ((Found != NULL) && AmlIndexEntryIsValid (Table, Found)) {
+      CopyMem (Entry, Found, sizeof (AML_INDEX_ENTRY));
+      *Index = NameIndex;
+      return EFI_SUCCESS;
+    }
+
+    if ((NameIndex != NULL) && NameIndex->Complete) {
+      return EFI_NOT_FOUND;
+    }
+  }
+
+  return AmlScanObject (Table, NameSeg, Type, Entry);
+}
+
+/**
+  Replace a byte range of a table and fix up every enclosing PkgLength.
+
+  @param[in]  Table            The table.
+  @param[in]  Index            The index of the table.
+  @param[in]  Scope            The innermost scope enclosing the range.
+  @param[in]  Offset           Offset of the range to replace.
+  @param[in]  OldSize          Size of the range to replace.
+  @param[in]  Data             The new content.
+  @param[in]  NewSize          Size of the new content.
+  @param[out] NewTable         Returns the newly allocated resized table.
+
+  @retval EFI_SUCCESS          The resized table was built.
+  @retval EFI_BAD_BUFFER_SIZE  A package length cannot be re-encoded.
+  @retval EFI_OUT_OF_RESOURCES The resized table cannot be allocated.
+**/
+STATIC
+EFI_STATUS
+AmlResizeObject (
+  IN  CONST EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN  CONST AML_NAME_INDEX               *Index,
+  IN  UINT32                             Scope,
+  IN  UINT32                             Offset,
+  IN  UINT32                             OldSize,
+  IN  CONST UINT8                        *Data,
+  IN  UINT32                             NewSize,
+  OUT EFI_ACPI_DESCRIPTION_HEADER        **NewTable
+  )
+{
+  AML_INDEX_EDIT         *Edits;
+  UINTN                  Depth;
+  UINTN                  EditIndex;
+  UINT32                 ScopeIndex;
+  CONST AML_INDEX_SCOPE  *ParentScope;
+  INT64                  Delta;
+  INT64                  BodyLength;
+  UINT8                  EncodingSize;
+  INT64                  NewLength;
+  UINT8                  *Resized;
+  UINT32                 Source;
+  UINT32                 Destination;
+
+  Depth = 0;
+  for (ScopeIndex = Scope; ScopeIndex != AML_INDEX_SCOPE_ROOT; ScopeIndex = Index->Scopes[ScopeIndex].Parent) {
+    Depth++;
+  }
+
+  Edits = AllocatePool ((Depth + 1) * sizeof (AML_INDEX_EDIT));
+  if (Edits == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Edits are ordered by offset: outermost PkgLength first, the object data last.
+  //
+  Edits[Depth].Offset  = Offset;
+  Edits[Depth].OldSize = OldSize;
+  Edits[Depth].NewSize = NewSize;
+  CopyMem (Edits[Depth].Data, Data, NewSize);
+  Delta = (INT64)NewSize - OldSize;
+
+  EditIndex = Depth;
+  for (ScopeIndex = Scope; ScopeIndex != AML_INDEX_SCOPE_ROOT; ScopeIndex = ParentScope->Parent) {
+    ParentScope  = &Index->Scopes[ScopeIndex];
+    BodyLength   = (INT64)ParentScope->PkgLength - ParentScope->PkgEncodingSize + Delta;
+    EncodingSize = (BodyLength < 0) ? 0 : AmlPkgLengthEncodingSize ((UINT64)BodyLength, ParentScope->PkgEncodingSize);
+    if (EncodingSize == 0) {
+      FreePool (Edits);
+      return EFI_BAD_BUFFER_SIZE;
+    }
+
+    EditIndex--;
+    Edits[EditIndex].Offset  = ParentScope->PkgOffset;
+    Edits[EditIndex].OldSize = ParentScope->PkgEncodingSize;
+    Edits[EditIndex].NewSize = EncodingSize;
+    AmlEncodePkgLength ((UINT32)BodyLength + EncodingSize, EncodingSize, Edits[EditIndex].Data);
+    Delta += (INT64)EncodingSize - ParentScope->PkgEncodingSize;
+  }
+
+  NewLength = (INT64)Table->Length + Delta;
+  if ((NewLength <= (INT64)sizeof (EFI_ACPI_DESCRIPTION_HEADER)) || (NewLength > MAX_UINT32)) {
+    FreePool (Edits);
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  Resized = AllocatePool ((UINTN)NewLength);
+  if (Resized == NULL) {
+    FreePool (Edits);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Source      = 0;
+  Destination = 0;
+  for (EditIndex = 0; EditIndex <= Depth; EditIndex++) {
+    CopyMem (Resized + Destination, (CONST UINT8 *)Table + Source, Edits[EditIndex].Offset - Source);
+    Destination += Edits[EditIndex].Offset - Source;
+    CopyMem (Resized + Destination, Edits[EditIndex].Data, Edits[EditIndex].NewSize);
+    Destination += Edits[EditIndex].NewSize;
+    Source       = Edits[EditIndex].Offset + Edits[EditIndex].OldSize;
+  }
+
+  CopyMem (Resized + Destination, (CONST UINT8 *)Table + Source, Table->Length - Source);
+  ((EFI_ACPI_DESCRIPTION_HEADER *)Resized)->Length = (UINT32)NewLength;
+
+  FreePool (Edits);
+  *NewTable = (EFI_ACPI_DESCRIPTION_HEADER *)Resized;
+  return EFI_SUCCESS;
+}
+
+/**
+  Replace the integer assigned to a Name object.
+
+  When the new value fits the existing encoding, the table is patched in place.
+  Otherwise the integer is re-encoded with the Byte/Word/DWord/QWord prefix that
+  matches Length, and a resized copy of the table is returned with every
+  enclosing PkgLength and the table length adjusted.
+
+  @param[in]  Table            The table containing the Name object.
+  @param[in]  Index            The index the entry belongs to, or NULL if unknown.
+  @param[in]  Entry            The Name object to update.
+  @param[in]  Buffer           The new integer value.
+  @param[in]  Length           Length of the new value: 1, 2, 4 or 8 bytes.
+  @param[out] NewTable         Returns NULL when Table was patched in place, or a
+                               newly allocated resized table that the caller must free.
+
+  @retval EFI_SUCCESS          The value was updated.
+  @retval EFI_BAD_BUFFER_SIZE  The object is not an integer, or the value cannot be re-encoded.
+  @retval EFI_OUT_OF_RESOURCES The resized table cannot be allocated.
+**/
+EFI_STATUS
+AmlUpdateNameInteger (
+  IN  EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN  AML_NAME_INDEX               *Index OPTIONAL,
+  IN  CONST AML_INDEX_ENTRY        *Entry,
+  IN  VOID                         *Buffer,
+  IN  UINTN                        Length,
+  OUT EFI_ACPI_DESCRIPTION_HEADER  **NewTable
+  )
+{
+  UINT8   *Data;
+  UINT8   Prefix;
+  UINT32  OldSize;
+  UINT8   Encoding[AML_MAX_INTEGER_ENCODING];
+
+  *NewTable = NULL;
+  Data      = (UINT8 *)Table + Entry->DataOffset;
+  OldSize   = AmlIntegerEncodingSize (*Data);
+  if ((OldSize == 0) || (OldSize > Table->Length - Entry->DataOffset)) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  switch (Length) {
+    case 1:
+      Prefix = AML_BYTE_PREFIX;
+      break;
+    case 2:
+      Prefix = AML_WORD_PREFIX;
+      break;
+    case 4:
+      Prefix = AML_DWORD_PREFIX;
+      break;
+    case 8:
+      Prefix = AML_QWORD_PREFIX;
+      break;
+    default:
+      return EFI_BAD_BUFFER_SIZE;
+  }
+
+  ///
+  /// Same size: patch in place.
+  ///
+  if (*Data == Prefix) {
+    CopyMem (Data + 1, Buffer, Length);
+    return EFI_SUCCESS;
+  }
+
+  if ((Length == 1) && ((*(UINT8 *)Buffer == 0) || (*(UINT8 *)Buffer == 1)) && ((*Data == AML_ZERO_OP) || (*Data == AML_ONE_OP))) {
+    CopyMem (Data, Buffer, Length);
+    return EFI_SUCCESS;
+  }
+
+  ///
+  /// The encoding size changes, which needs every enclosing PkgLength.
+  ///
+  if ((Index == NULL) || (Entry->Scope == AML_INDEX_SCOPE_UNKNOWN)) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  Encoding[0] = Prefix;
+  CopyMem (&Encoding[1], Buffer, Length);
+  return AmlResizeObject (
+           Table,
+           Index,
+           Entry->Scope,
+           Entry->DataOffset,
+           OldSize,
+           Encoding,
+           (UINT32)Length + 1,
+           NewTable
+           );
+}
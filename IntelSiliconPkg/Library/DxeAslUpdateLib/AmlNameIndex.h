@@ -0,0 +1,137 @@
+/** @file
+  Internal definitions of the AML name-path index used by the ASL update library.
+
+  The index is built with a single walk over the AML term list of a DSDT/SSDT
+  and maps the last NameSeg of every Name, Method and OperationRegion object
+  to its location in the table, so later updates do not need to rescan the
+  whole table.
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _AML_NAME_INDEX_H_
+#define _AML_NAME_INDEX_H_
+
+#include <Uefi/UefiBaseType.h>
+#include <IndustryStandard/Acpi.h>
+
+///
+/// Object types recorded in the index.
+///
+typedef enum {
+  AmlIndexName,
+  AmlIndexMethod,
+  AmlIndexOpRegion,
+  AmlIndexTypeMax
+} AML_INDEX_OBJECT_TYPE;
+
+///
+/// Scope value for objects whose enclosing package lengths are not known,
+/// e.g. objects located by the legacy signature scan or declared in a method
+/// or conditional body.
+///
+#define AML_INDEX_SCOPE_UNKNOWN  MAX_UINT32
+
+///
+/// Scope value for objects that are directly in the table root term list.
+///
+#define AML_INDEX_SCOPE_ROOT  (MAX_UINT32 - 1)
+
+///
+/// An enclosing object carrying a PkgLength (Scope, Device, Processor, ...).
+///
+typedef struct {
+  UINT32    PkgOffset;            ///< Table offset of the PkgLength encoding.
+  UINT32    PkgLength;            ///< Decoded PkgLength, including its own encoding bytes.
+  UINT8     PkgEncodingSize;      ///< Number of bytes used by the PkgLength encoding.
+  UINT32    Parent;               ///< Index of the enclosing scope or AML_INDEX_SCOPE_ROOT.
+} AML_INDEX_SCOPE;
+
+///
+/// An indexed Name, Method or OperationRegion object.
+///
+typedef struct {
+  UINT32    NameSeg;              ///< Last NameSeg of the object name path.
+  UINT8     Type;                 ///< AML_INDEX_OBJECT_TYPE.
+  UINT32    ObjectOffset;         ///< Table offset of the object opcode.
+  UINT32    NameOffset;           ///< Table offset of the last NameSeg.
+  UINT32    DataOffset;           ///< Name: DataRefObject, Method: MethodFlags, OpRegion: RegionSpace.
+  UINT32    Scope;                ///< Innermost enclosing scope, AML_INDEX_SCOPE_ROOT or AML_INDEX_SCOPE_UNKNOWN.
+} AML_INDEX_ENTRY;
+
+///
+/// NameSeg to object index of one ACPI table.
+///
+typedef struct {
+  UINT32             Signature;   ///< Signature of the indexed table.
+  UINT64             OemTableId;  ///< OEM table ID of the indexed table.
+  UINT32             Length;      ///< Length of the indexed table.
+  BOOLEAN            Complete;    ///< FALSE if part of the term list could not be decoded.
+  UINTN              EntryCount;
+  UINTN              EntryCapacity;
+  AML_INDEX_ENTRY    *Entries;
+  UINTN              ScopeCount;
+  UINTN              ScopeCapacity;
+  AML_INDEX_SCOPE    *Scopes;
+  UINTN              BucketCount; ///< Power of two; each bucket holds an entry index + 1, or 0 when empty.
+  UINT32             *Buckets;
+} AML_NAME_INDEX;
+
+/**
+  Find a Name, Method or OperationRegion object by the last NameSeg of its name path.
+
+  A cached index of the table is used, and built in one pass over the AML when the
+  table has not been indexed yet or has changed. When the index is incomplete and
+  does not contain the object, the table is scanned for the signature as before.
+
+  @param[in]  Table            The DSDT or SSDT to search.
+  @param[in]  NameSeg          The NameSeg of the object.
+  @param[in]  Type             The type of the object.
+  @param[out] Entry            Returns the location of the object.
+  @param[out] Index            Returns the index the entry belongs to, or NULL if the
+                               object was located by the signature scan.
+
+  @retval EFI_SUCCESS          The object was found.
+  @retval EFI_NOT_FOUND        The object is not in the table.
+**/
+EFI_STATUS
+AmlFindObject (
+  IN  CONST EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN  UINT32                             NameSeg,
+  IN  AML_INDEX_OBJECT_TYPE              Type,
+  OUT AML_INDEX_ENTRY                    *Entry,
+  OUT AML_NAME_INDEX                     **Index
+  );
+
+/**
+  Replace the integer assigned to a Name object.
+
+  When the new value fits the existing encoding, the table is patched in place.
+  Otherwise the integer is re-encoded with the Byte/Word/DWord/QWord prefix that
+  matches Length, and a resized copy of the table is returned with every
+  enclosing PkgLength and the table length adjusted.
+
+  @param[in]  Table            The table containing the Name object.
+  @param[in]  Index            The index the entry belongs to, or NULL if unknown.
+  @param[in]  Entry            The Name object to update.
+  @param[in]  Buffer           The new integer value.
+  @param[in]  Length           Length of the new value: 1, 2, 4 or 8 bytes.
+  @param[out] NewTable         Returns NULL when Table was patched in place, or a
+                               newly allocated resized table that the caller must free.
+
+  @retval EFI_SUCCESS          The value was updated.
+  @retval EFI_BAD_BUFFER_SIZE  The object is not an integer, or the value cannot be re-encoded.
+  @retval EFI_OUT_OF_RESOURCES The resized table cannot be allocated.
+**/
+EFI_STATUS
+AmlUpdateNameInteger (
+  IN  EFI_ACPI_DESCRIPTION_HEADER  *Table,
+  IN  AML_NAME_INDEX               *Index OPTIONAL,
+  IN  CONST AML_INDEX_ENTRY        *Entry,
+  IN  VOID                         *Buffer,
+  IN  UINTN                        Length,
+  OUT EFI_ACPI_DESCRIPTION_HEADER  **NewTable
+  );
+
+#endif
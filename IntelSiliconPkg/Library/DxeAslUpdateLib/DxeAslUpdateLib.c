@@ -22,6 +22,8 @@
 
 #include <Library/AslUpdateLib.h>
 
+#include "AmlNameIndex.h"
+
 //
 // Function implementations
 //
@@ -177,12 +179,10 @@ UpdateNameAslCode (
 {
   EFI_STATUS                   Status;
   EFI_ACPI_DESCRIPTION_HEADER  *Table;
-  UINT8                        *CurrPtr;
-  UINT8                        *EndPtr;
-  UINT32                       *Signature;
-  UINT8                        *DsdtPointer;
+  EFI_ACPI_DESCRIPTION_HEADER  *NewTable;
+  AML_NAME_INDEX               *NameIndex;
+  AML_INDEX_ENTRY              Entry;
   UINTN                        Handle;
-  UINT8                        DataSize;
 
   if (mAcpiTable == NULL) {
     InitializeAslUpdateLib ();
@@ -207,66 +207,45 @@ UpdateNameAslCode (
   ///
   /// Point to the beginning of the DSDT table
   ///
-  CurrPtr = (UINT8 *)Table;
-  if (CurrPtr == NULL) {
+  if (Table == NULL) {
     return EFI_NOT_FOUND;
   }
 
-  //
-  // EndPtr = beginning of table + length of table
-  //
-  EndPtr = CurrPtr + ((EFI_ACPI_COMMON_HEADER *)CurrPtr)->Length;
+  ///
+  /// Look up the Name object in the AML name index of the table.
+  ///
+  NewTable = NULL;
+  Status   = AmlFindObject (Table, AslSignature, AmlIndexName, &Entry, &NameIndex);
+  if (!EFI_ERROR (Status)) {
+    Status = AmlUpdateNameInteger (Table, NameIndex, &Entry, Buffer, Length, &NewTable);
+  }
+
+  if (EFI_ERROR (Status)) {
+    FreePool (Table);
+    return Status;
+  }
 
   ///
-  /// Loop through the ASL looking for values that we must fix up.
+  /// The integer encoding changed size, continue with the resized table.
   ///
-  for (DsdtPointer = CurrPtr; DsdtPointer < EndPtr; DsdtPointer++) {
-    ///
-    /// Get a pointer to compare for signature
-    ///
-    Signature = (UINT32 *)DsdtPointer;
-    ///
-    /// Check if this is the Device Object signature we are looking for
-    ///
-    if ((*Signature) == AslSignature) {
-      ///
-      /// Look for Name Encoding
-      ///
-      if (*(DsdtPointer-1) == AML_NAME_OP) {
-        ///
-        /// Check if size of new and old data is the same
-        ///
-        DataSize = *(DsdtPointer+4);
-        if (((Length == 1) && (DataSize == 0xA)) ||
-            ((Length == 2) && (DataSize == 0xB)) ||
-            ((Length == 4) && (DataSize == 0xC)))
-        {
-          CopyMem (DsdtPointer+5, Buffer, Length);
-        } else if ((Length == 1) && (((*(UINT8 *)Buffer) == 0) || ((*(UINT8 *)Buffer) == 1)) && ((DataSize == 0) || (DataSize == 1))) {
-          CopyMem (DsdtPointer+4, Buffer, Length);
-        } else {
-          FreePool (Table);
-          return EFI_BAD_BUFFER_SIZE;
-        }
-
-        Status = mAcpiTable->UninstallAcpiTable (
-                               mAcpiTable,
-                               Handle
-                               );
-        Handle = 0;
-        Status = mAcpiTable->InstallAcpiTable (
-                               mAcpiTable,
-                               Table,
-                               Table->Length,
-                               &Handle
-                               );
-        FreePool (Table);
-        return Status;
-      }
-    }
+  if (NewTable != NULL) {
+    FreePool (Table);
+    Table = NewTable;
   }
 
-  return EFI_NOT_FOUND;
+  Status = mAcpiTable->UninstallAcpiTable (
+                         mAcpiTable,
+                         Handle
+                         );
+  Handle = 0;
+  Status = mAcpiTable->InstallAcpiTable (
+                         mAcpiTable,
+                         Table,
+                         Table->Length,
+                         &Handle
+                         );
+  FreePool (Table);
+  return Status;
 }
 
 /**
@@ -294,11 +273,10 @@ UpdateSsdtNameAslCode (
 {
   EFI_STATUS                   Status;
   EFI_ACPI_DESCRIPTION_HEADER  *Table;
-  UINT8                        *CurrPtr;
-  UINT32                       *Signature;
-  UINT8                        *SsdtPointer;
+  EFI_ACPI_DESCRIPTION_HEADER  *NewTable;
+  AML_NAME_INDEX               *NameIndex;
+  AML_INDEX_ENTRY              Entry;
   UINTN                        Handle;
-  UINT8                        DataSize;
 
   if (mAcpiTable == NULL) {
     InitializeAslUpdateLib ();
@@ -322,58 +300,53 @@ UpdateSsdtNameAslCode (
   }
 
   ///
-  /// Point to the beginning of the DSDT table
+  /// Point to the beginning of the SSDT table
   ///
-  CurrPtr = (UINT8 *)Table;
-  if (CurrPtr == NULL) {
+  if (Table == NULL) {
     return EFI_NOT_FOUND;
   }
 
   ///
-  /// Loop through the ASL looking for values that we must fix up.
+  /// Look up the Name object in the AML name index of the table.
   ///
-  for (SsdtPointer = CurrPtr; SsdtPointer <= (CurrPtr + ((EFI_ACPI_COMMON_HEADER *)CurrPtr)->Length); SsdtPointer++) {
-    ///
-    /// Get a pointer to compare for signature
-    ///
-    Signature = (UINT32 *)SsdtPointer;
+  Status = AmlFindObject (Table, AslSignature, AmlIndexName, &Entry, &NameIndex);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = AmlUpdateNameInteger (Table, NameIndex, &Entry, Buffer, Length, &NewTable);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (NewTable != NULL) {
     ///
-    /// Check if this is the Device Object signature we are looking for
+    /// The installed table cannot grow or shrink in place, replace it with the resized copy.
     ///
-    if ((*Signature) == AslSignature) {
-      ///
-      /// Look for Name Encoding
-      ///
-      if (*(SsdtPointer-1) == AML_NAME_OP) {
-        ///
-        /// Check if size of new and old data is the same
-        ///
-        DataSize = *(SsdtPointer+4);
-        if (((Length == 1) && (DataSize == 0xA)) ||
-            ((Length == 2) && (DataSize == 0xB)) ||
-            ((Length == 4) && (DataSize == 0xC)))
-        {
-          CopyMem (SsdtPointer+5, Buffer, Length);
-        } else if ((Length == 1) && (((*(UINT8 *)Buffer) == 0) || ((*(UINT8 *)Buffer) == 1)) && ((DataSize == 0) || (DataSize == 1))) {
-          CopyMem (SsdtPointer+4, Buffer, Length);
-        } else {
-          return EFI_BAD_BUFFER_SIZE;
-        }
-
-        AcpiPlatformChecksum (
-          Table,
-          Table->Length,
-          OFFSET_OF (
-            EFI_ACPI_DESCRIPTION_HEADER,
-            Checksum
-            )
-          );
-        return Status;
-      }
-    }
+    Status = mAcpiTable->UninstallAcpiTable (
+                           mAcpiTable,
+                           Handle
+                           );
+    Handle = 0;
+    Status = mAcpiTable->InstallAcpiTable (
+                           mAcpiTable,
+                           NewTable,
+                           NewTable->Length,
+                           &Handle
+                           );
+    FreePool (NewTable);
+    return Status;
   }
 
-  return EFI_NOT_FOUND;
+  AcpiPlatformChecksum (
+    Table,
+    Table->Length,
+    OFFSET_OF (
+      EFI_ACPI_DESCRIPTION_HEADER,
+      Checksum
+      )
+    );
+  return Status;
 }
 
 /**
@@ -397,9 +370,8 @@ UpdateMethodAslCode (
 {
   EFI_STATUS                   Status;
   EFI_ACPI_DESCRIPTION_HEADER  *Table;
-  UINT8                        *CurrPtr;
-  UINT32                       *Signature;
-  UINT8                        *DsdtPointer;
+  AML_NAME_INDEX               *NameIndex;
+  AML_INDEX_ENTRY              Entry;
   UINTN                        Handle;
 
   if (mAcpiTable == NULL) {
@@ -425,49 +397,37 @@ UpdateMethodAslCode (
   ///
   /// Point to the beginning of the DSDT table
   ///
-  CurrPtr = (UINT8 *)Table;
-  if (CurrPtr == NULL) {
+  if (Table == NULL) {
     return EFI_NOT_FOUND;
   }
 
   ///
-  /// Loop through the ASL looking for values that we must fix up.
+  /// Look up the Method object in the AML name index of the table.
   ///
-  for (DsdtPointer = CurrPtr; DsdtPointer <= (CurrPtr + ((EFI_ACPI_COMMON_HEADER *)CurrPtr)->Length); DsdtPointer++) {
-    ///
-    /// Get a pointer to compare for signature
-    ///
-    Signature = (UINT32 *)DsdtPointer;
-    ///
-    /// Check if this is the Device Object signature we are looking for
-    ///
-    if ((*Signature) == AslSignature) {
-      ///
-      /// Look for Name Encoding
-      ///
-      if (  (*(DsdtPointer-3) == AML_METHOD_OP)
-         || (*(DsdtPointer-2) == AML_METHOD_OP)
-            )
-      {
-        CopyMem (DsdtPointer, Buffer, Length);
-        Status = mAcpiTable->UninstallAcpiTable (
-                               mAcpiTable,
-                               Handle
-                               );
-        Handle = 0;
-        Status = mAcpiTable->InstallAcpiTable (
-                               mAcpiTable,
-                               Table,
-                               Table->Length,
-                               &Handle
-                               );
-        FreePool (Table);
-        return Status;
-      }
-    }
+  Status = AmlFindObject (Table, AslSignature, AmlIndexMethod, &Entry, &NameIndex);
+  if (!EFI_ERROR (Status) && (Length > Table->Length - Entry.NameOffset)) {
+    Status = EFI_BAD_BUFFER_SIZE;
+  }
+
+  if (EFI_ERROR (Status)) {
+    FreePool (Table);
+    return Status;
   }
 
-  return EFI_NOT_FOUND;
+  CopyMem ((UINT8 *)Table + Entry.NameOffset, Buffer, Length);
+  Status = mAcpiTable->UninstallAcpiTable (
+                         mAcpiTable,
+                         Handle
+                         );
+  Handle = 0;
+  Status = mAcpiTable->InstallAcpiTable (
+                         mAcpiTable,
+                         Table,
+                         Table->Length,
+                         &Handle
+                         );
+  FreePool (Table);
+  return Status;
 }
 
 /**
@@ -0,0 +1,331 @@
+/** @file
+  Host based unit test of the AML name index of the ASL update library.
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../AmlNameIndex.h"
+
+#define UNIT_TEST_NAME     "AML Name Index UnitTest"
+#define UNIT_TEST_VERSION  "0.1"
+
+/// === TEST DATA ==================================================================================
+
+//
+// Method (MTH0, 0) { Name (INNR, 0x12) Return (INNR) }
+// Name (OUTR, One)
+//
+STATIC CONST UINT8  MethodBodyAml[] = {
+  AML_METHOD_OP,   0x12,   'M',  'T',  'H',  '0', 0x00,
+  AML_NAME_OP,     'I',    'N',  'N',  'R',  AML_BYTE_PREFIX, 0x12,
+  0xA4,            'I',    'N',  'N',  'R',
+  AML_NAME_OP,     'O',    'U',  'T',  'R',  AML_ONE_OP
+};
+
+//
+// Method (MTH1, 1) {
+//   If (Arg0) { Name (IFNM, 0x12) }
+//   Else { Name (ELNM, 0x1234) }
+//   Return (Zero)
+// }
+// Name (LAST, 0x56)
+//
+STATIC CONST UINT8  CodeBodyAml[] = {
+  AML_METHOD_OP,   0x1C,   'M',  'T',  'H',  '1', 0x01,
+  0xA0,            0x09,   0x68,
+  AML_NAME_OP,     'I',    'F',  'N',  'M',  AML_BYTE_PREFIX, 0x12,
+  0xA1,            0x09,
+  AML_NAME_OP,     'E',    'L',  'N',  'M',  AML_WORD_PREFIX, 0x34, 0x12,
+  0xA4,            AML_ZERO_OP,
+  AML_NAME_OP,     'L',    'A',  'S',  'T',  AML_BYTE_PREFIX, 0x56
+};
+
+//
+// A Method truncated after its NameSeg, which ends exactly at the table end.
+//
+STATIC CONST UINT8  TailNameAml[] = {
+  AML_METHOD_OP,   0x05,   'T',  'A',  'I',  'L'
+};
+
+//
+// Name (OUTR, One)
+//
+STATIC CONST UINT8  RootNameAml[] = {
+  AML_NAME_OP,     'O',    'U',  'T',  'R',  AML_ONE_OP
+};
+
+/// === HELPER FUNCTIONS ===========================================================================
+
+/**
+  Build an SSDT from an AML term list.
+
+  @param[in] Aml           The term list.
+  @param[in] AmlSize       The size of the term list.
+  @param[in] OemTableId    The OEM table ID, unique per test so that cached indexes do not mix.
+
+  @return The table, to be freed with FreePool, or NULL.
+**/
+STATIC
+EFI_ACPI_DESCRIPTION_HEADER *
+BuildTable (
+  IN CONST UINT8  *Aml,
+  IN UINT32       AmlSize,
+  IN UINT64       OemTableId
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER  *Table;
+
+  Table = AllocateZeroPool (sizeof (EFI_ACPI_DESCRIPTION_HEADER) + AmlSize);
+  if (Table == NULL) {
+    return NULL;
+  }
+
+  Table->Signature  = EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE;
+  Table->Length     = sizeof (EFI_ACPI_DESCRIPTION_HEADER) + AmlSize;
+  Table->OemTableId = OemTableId;
+  CopyMem (Table + 1, Aml, AmlSize);
+  return Table;
+}
+
+/// === TEST CASES =================================================================================
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+ShouldFindNameInMethodBody (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER  *Table;
+  EFI_ACPI_DESCRIPTION_HEADER  *NewTable;
+  AML_INDEX_ENTRY              Entry;
+  AML_NAME_INDEX               *Index;
+  UINT8                        Value;
+
+  Table = BuildTable (MethodBodyAml, sizeof (MethodBodyAml), SIGNATURE_64 ('A', 'M', 'L', 'T', 'E', 'S', 'T', '1'));
+  UT_ASSERT_NOT_NULL (Table);
+
+  //
+  // Objects outside of the method body come from the index.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (AmlFindObject (Table, SIGNATURE_32 ('M', 'T', 'H', '0'), AmlIndexMethod, &Entry, &Index));
+  UT_ASSERT_NOT_NULL (Index);
+  UT_ASSERT_EQUAL (Entry.ObjectOffset, sizeof (EFI_ACPI_DESCRIPTION_HEADER));
+
+  UT_ASSERT_NOT_EFI_ERROR (AmlFindObject (Table, SIGNATURE_32 ('O', 'U', 'T', 'R'), AmlIndexName, &Entry, &Index));
+  UT_ASSERT_NOT_NULL (Index);
+  UT_ASSERT_EQUAL (Entry.NameOffset, sizeof (EFI_ACPI_DESCRIPTION_HEADER) + 20);
+
+  //
+  // A name declared in the method body is indexed too and can be updated in place.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (AmlFindObject (Table, SIGNATURE_32 ('I', 'N', 'N', 'R'), AmlIndexName, &Entry, &Index));
+  UT_ASSERT_NOT_NULL (Index);
+  UT_ASSERT_EQUAL (Entry.ObjectOffset, sizeof (EFI_ACPI_DESCRIPTION_HEADER) + 7);
+  UT_ASSERT_EQUAL (Entry.NameOffset, sizeof (EFI_ACPI_DESCRIPTION_HEADER) + 8);
+
+  Value = 0x34;
+  UT_ASSERT_NOT_EFI_ERROR (AmlUpdateNameInteger (Table, Index, &Entry, &Value, sizeof (Value), &NewTable));
+  UT_ASSERT_EQUAL (NewTable, NULL);
+  UT_ASSERT_EQUAL (((UINT8 *)Table)[Entry.DataOffset + 1], 0x34);
+
+  FreePool (Table);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+ShouldIndexMethodAndConditionalBodies (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER  *Table;
+  EFI_ACPI_DESCRIPTION_HEADER  *NewTable;
+  AML_INDEX_ENTRY              Entry;
+  AML_NAME_INDEX               *Index;
+  UINT16                       Value;
+
+  Table = BuildTable (CodeBodyAml, sizeof (CodeBodyAml), SIGNATURE_64 ('A', 'M', 'L', 'T', 'E', 'S', 'T', '4'));
+  UT_ASSERT_NOT_NULL (Table);
+
+  UT_ASSERT_NOT_EFI_ERROR (AmlFindObject (Table, SIGNATURE_32 ('L', 'A', 'S', 'T'), AmlIndexName, &Entry, &Index));
+  UT_ASSERT_NOT_NULL (Index);
+  UT_ASSERT_TRUE (Index->Complete);
+  UT_ASSERT_EQUAL (Entry.NameOffset, sizeof (EFI_ACPI_DESCRIPTION_HEADER) + 30);
+  UT_ASSERT_EQUAL (Entry.Scope, AML_INDEX_SCOPE_ROOT);
+
+  //
+  // Names declared in the If and Else bodies come from the index, without their scope.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (AmlFindObject (Table, SIGNATURE_32 ('I', 'F', 'N', 'M'), AmlIndexName, &Entry, &Index));
+  UT_ASSERT_NOT_NULL (Index);
+  UT_ASSERT_EQUAL (Entry.ObjectOffset, sizeof (EFI_ACPI_DESCRIPTION_HEADER) + 10);
+  UT_ASSERT_EQUAL (Entry.Scope, AML_INDEX_SCOPE_UNKNOWN);
+
+  UT_ASSERT_NOT_EFI_ERROR (AmlFindObject (Table, SIGNATURE_32 ('E', 'L', 'N', 'M'), AmlIndexName, &Entry, &Index));
+  UT_ASSERT_NOT_NULL (Index);
+  UT_ASSERT_EQUAL (Entry.ObjectOffset, sizeof (EFI_ACPI_DESCRIPTION_HEADER) + 19);
+
+  Value = 0x5678;
+  UT_ASSERT_NOT_EFI_ERROR (AmlUpdateNameInteger (Table, Index, &Entry, &Value, sizeof (Value), &NewTable));
+  UT_ASSERT_EQUAL (NewTable, NULL);
+  UT_ASSERT_EQUAL (ReadUnaligned16 ((UINT16 *)((UINT8 *)Table + Entry.DataOffset + 1)), 0x5678);
+
+  //
+  // A missing name is reported from the complete index, without a signature scan.
+  //
+  UT_ASSERT_STATUS_EQUAL (
+    AmlFindObject (Table, SIGNATURE_32 ('N', 'O', 'N', 'E'), AmlIndexName, &Entry, &Index),
+    EFI_NOT_FOUND
+    );
+
+  FreePool (Table);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+ShouldFindNameAtTableEnd (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER  *Table;
+  AML_INDEX_ENTRY              Entry;
+  AML_NAME_INDEX               *Index;
+
+  Table = BuildTable (TailNameAml, sizeof (TailNameAml), SIGNATURE_64 ('A', 'M', 'L', 'T', 'E', 'S', 'T', '2'));
+  UT_ASSERT_NOT_NULL (Table);
+
+  UT_ASSERT_NOT_EFI_ERROR (AmlFindObject (Table, SIGNATURE_32 ('T', 'A', 'I', 'L'), AmlIndexMethod, &Entry, &Index));
+  UT_ASSERT_EQUAL (Index, NULL);
+  UT_ASSERT_EQUAL (Entry.NameOffset + 4, Table->Length);
+
+  FreePool (Table);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Test Case
+*/
+UNIT_TEST_STATUS
+EFIAPI
+ShouldReturnEfiNotFoundIfMissing (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER  *Table;
+  AML_INDEX_ENTRY              Entry;
+  AML_NAME_INDEX               *Index;
+
+  Table = BuildTable (RootNameAml, sizeof (RootNameAml), SIGNATURE_64 ('A', 'M', 'L', 'T', 'E', 'S', 'T', '3'));
+  UT_ASSERT_NOT_NULL (Table);
+
+  UT_ASSERT_STATUS_EQUAL (
+    AmlFindObject (Table, SIGNATURE_32 ('N', 'O', 'N', 'E'), AmlIndexName, &Entry, &Index),
+    EFI_NOT_FOUND
+    );
+
+  FreePool (Table);
+  return UNIT_TEST_PASSED;
+}
+
+/// === TEST ENGINE ================================================================================
+
+/**
+  Run the AML name index unit tests.
+
+  @retval EFI_SUCCESS     The tests were run.
+  @retval other           Some error occurred when setting up the tests.
+**/
+int
+main (
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework = NULL;
+  UNIT_TEST_SUITE_HANDLE      LookupTests;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&LookupTests, Framework, "AML Name Index Lookup Tests", "AmlNameIndex.Lookup", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for LookupTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    LookupTests,
+    "Should find and update a name declared in a method body",
+    "AmlNameIndex.Lookup.MethodBody",
+    ShouldFindNameInMethodBody,
+    NULL,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    LookupTests,
+    "Should index the names of method and conditional bodies",
+    "AmlNameIndex.Lookup.CodeBody",
+    ShouldIndexMethodAndConditionalBodies,
+    NULL,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    LookupTests,
+    "Should find a name segment ending at the table end",
+    "AmlNameIndex.Lookup.TableEnd",
+    ShouldFindNameAtTableEnd,
+    NULL,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    LookupTests,
+    "Should return EFI_NOT_FOUND for a name missing from a complete index",
+    "AmlNameIndex.Lookup.Missing",
+    ShouldReturnEfiNotFoundIfMissing,
+    NULL,
+    NULL,
+    NULL
+    );
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
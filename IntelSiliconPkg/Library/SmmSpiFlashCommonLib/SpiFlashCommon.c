@@ -8,8 +8,11 @@
 
 #include <Library/SpiFlashCommonLib.h>
 #include <Library/IoLib.h>
+#include <Library/CacheMaintenanceLib.h>
 #include <Protocol/Spi2.h>
 
+#define SPI_FLASH_PAGE_SIZE  0x100    // Common 256 bytes program page size
+
 PCH_SPI2_PROTOCOL  *mSpi2Protocol;
 
 //
@@ -19,6 +22,165 @@ UINTN  mBiosAreaBaseAddress = 0;
 UINTN  mBiosSize            = 0;
 UINTN  mBiosOffset          = 0;
 
+//
+// Number of bytes actually erased and programmed on the flash device. They are
+// internal to this instance and only read by the host based benchmark.
+//
+UINT64  mSpiFlashBytesErased     = 0;
+UINT64  mSpiFlashBytesProgrammed = 0;
+
+/**
+  Program the bytes of a chunk that differ from the flash contents.
+
+  The chunk is compared page by page with the memory-mapped flash. Pages that
+  already hold the data are skipped, and each run of changed pages is
+  programmed from its first to its last changed byte. Programming can only
+  change bits from 1 to 0, so a byte that needs a bit changed from 0 to 1
+  fails the write, as the flash would not match Buffer without an erase.
+
+  @param[in]  Offset            The offset of the chunk in the BIOS region.
+  @param[in]  Length            The length of the chunk.
+  @param[in]  Buffer            The source data buffer for the write.
+
+  @retval     EFI_SUCCESS       Operation is successful.
+  @retval     EFI_DEVICE_ERROR  If there is any device errors, or a bit of the
+                                chunk needs to change from 0 to 1. The pages
+                                before that byte may have been programmed.
+
+**/
+STATIC
+EFI_STATUS
+SpiFlashWriteChanged (
+  IN UINTN   Offset,
+  IN UINT32  Length,
+  IN UINT8   *Buffer
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       *Flash;
+  UINTN       Index;
+  UINTN       PageEnd;
+  UINTN       First;
+  UINTN       Last;
+  BOOLEAN     PageChanged;
+
+  Flash = (UINT8 *)(mBiosAreaBaseAddress + Offset);
+  WriteBackInvalidateDataCacheRange (Flash, Length);
+
+  //
+  // [First, Last) is the pending run of changed bytes, First is MAX_UINTN when
+  // there is none.
+  //
+  First = MAX_UINTN;
+  Last  = 0;
+  Index = 0;
+  while (Index < Length) {
+    PageEnd     = MIN (Length, ALIGN_VALUE (Offset + Index + 1, SPI_FLASH_PAGE_SIZE) - Offset);
+    PageChanged = FALSE;
+    for ( ; Index < PageEnd; Index++) {
+      if (Flash[Index] != Buffer[Index]) {
+        if ((Flash[Index] & Buffer[Index]) != Buffer[Index]) {
+          return EFI_DEVICE_ERROR;
+        }
+
+        if (First == MAX_UINTN) {
+          First = Index;
+        }
+
+        Last        = Index + 1;
+        PageChanged = TRUE;
+      }
+    }
+
+    if ((First != MAX_UINTN) && (!PageChanged || (Index == Length))) {
+      Status = mSpi2Protocol->FlashWrite (
+                                mSpi2Protocol,
+                                &gFlashRegionBiosGuid,
+                                (UINT32)(Offset + First),
+                                (UINT32)(Last - First),
+                                Buffer + First
+                                );
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+
+      mSpiFlashBytesProgrammed += Last - First;
+      First                     = MAX_UINTN;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Erase the sectors of a range that are not blank.
+
+  Each run of contiguous sectors that are not blank is erased with a single
+  request.
+
+  @param[in]  Offset            The offset of the range in the BIOS region.
+  @param[in]  Length            The length of the range, a multiple of SECTOR_SIZE_4KB.
+
+  @retval     EFI_SUCCESS       Operation is successful.
+  @retval     EFI_DEVICE_ERROR  If there is any device errors.
+
+**/
+STATIC
+EFI_STATUS
+SpiFlashEraseNonBlank (
+  IN UINTN  Offset,
+  IN UINTN  Length
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       *Flash;
+  UINTN       Sector;
+  UINTN       Index;
+  UINTN       RunStart;
+  BOOLEAN     Blank;
+
+  Flash = (UINT8 *)(mBiosAreaBaseAddress + Offset);
+  WriteBackInvalidateDataCacheRange (Flash, Length);
+
+  RunStart = MAX_UINTN;
+  for (Sector = 0; Sector <= Length; Sector += SECTOR_SIZE_4KB) {
+    Blank = TRUE;
+    if (Sector < Length) {
+      for (Index = Sector; Index < Sector + SECTOR_SIZE_4KB; Index++) {
+        if (Flash[Index] != 0xFF) {
+          Blank = FALSE;
+          break;
+        }
+      }
+    }
+
+    if (!Blank) {
+      if (RunStart == MAX_UINTN) {
+        RunStart = Sector;
+      }
+
+      continue;
+    }
+
+    if (RunStart != MAX_UINTN) {
+      Status = mSpi2Protocol->FlashErase (
+                                mSpi2Protocol,
+                                &gFlashRegionBiosGuid,
+                                (UINT32)(Offset + RunStart),
+                                (UINT32)(Sector - RunStart)
+                                );
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+
+      mSpiFlashBytesErased += Sector - RunStart;
+      RunStart              = MAX_UINTN;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
   Enable block protection on the Serial Flash device.
 
@@ -125,13 +287,21 @@ SpiFlashWrite (
       Length = RemainingBytes;
     }
 
-    Status = mSpi2Protocol->FlashWrite (
-                              mSpi2Protocol,
-                              &gFlashRegionBiosGuid,
-                              (UINT32)Offset,
-                              Length,
-                              Buffer
-                              );
+    if (FeaturePcdGet (PcdSpiFlashSkipUnchanged)) {
+      Status = SpiFlashWriteChanged (Offset, Length, Buffer);
+    } else {
+      Status = mSpi2Protocol->FlashWrite (
+                                mSpi2Protocol,
+                                &gFlashRegionBiosGuid,
+                                (UINT32)Offset,
+                                Length,
+                                Buffer
+                                );
+      if (!EFI_ERROR (Status)) {
+        mSpiFlashBytesProgrammed += Length;
+      }
+    }
+
     if (EFI_ERROR (Status)) {
       break;
     }
@@ -199,11 +369,19 @@ SpiFlashBlockErase (
   Status         = EFI_SUCCESS;
   RemainingBytes = *NumBytes;
 
+  if (FeaturePcdGet (PcdSpiFlashSkipUnchanged)) {
+    return SpiFlashEraseNonBlank (Offset, RemainingBytes);
+  }
+
   Status = mSpi2Protocol->FlashErase (
                             mSpi2Protocol,
                             &gFlashRegionBiosGuid,
                             (UINT32)Offset,
                             (UINT32)RemainingBytes
                             );
+  if (!EFI_ERROR (Status)) {
+    mSpiFlashBytesErased += RemainingBytes;
+  }
+
   return Status;
 }